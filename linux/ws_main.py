@@ -70,6 +70,8 @@ class SrcGroups:
 
 def options(opt):
     opt.load('compiler_cxx')
+    opt.add_option('--cycle-stats', action='store_true', default=False, dest='cycle_stats',
+                   help='count TSC cycles per DP hot path phase')
 
     
 def verify_cc_version (env):
@@ -90,6 +92,7 @@ def configure(conf):
 
     conf.load('g++')
     verify_cc_version(conf.env)
+    conf.env.CYCLE_STATS = conf.options.cycle_stats
 
 
 main_src = SrcGroup(dir='src',
@@ -109,6 +112,12 @@ main_src = SrcGroup(dir='src',
              'utl_json.cpp',
              'utl_cpuu.cpp',
              'msg_manager.cpp',
+             'telemetry_bin.cpp',
+             'hdr_histogram.cpp',
+             'utl_idle.cpp',
+             'template_cache.cpp',
+             'pcap_replay.cpp',
+             'rx_capture.cpp',
              'gtest/tuple_gen_test.cpp',
              'gtest/nat_test.cpp',
 
@@ -123,7 +132,9 @@ cmn_src = SrcGroup(dir='src/common',
         'basic_utils.cpp',
         'captureFile.cpp',
         'erf.cpp',
-        'pcap.cpp'
+        'pcap.cpp',
+        'pcapng.cpp',
+        'cap_file_out.cpp'
         ]);
 
          
@@ -373,13 +384,19 @@ build_types = [
 
 
 
+def get_cycle_stats_flags (bld):
+    if bld.env.CYCLE_STATS:
+        return ['-DTREX_CYCLE_STATS']
+    return []
+
+
 def build_prog (bld, build_obj):
     zmq_lib_path='external_libs/zmq/'
     bld.read_shlib( name='zmq' , paths=[top + zmq_lib_path] )
 
     bld.program(features='cxx cxxprogram', 
                 includes =includes_path,
-                cxxflags =build_obj.get_flags(),
+                cxxflags =build_obj.get_flags() + get_cycle_stats_flags(bld),
                 linkflags = build_obj.get_link_flags(),
                 source = build_obj.get_src(),
                 use = build_obj.get_use_libs(),
@@ -83,10 +83,13 @@ class SrcGroups:
 def options(opt):
     opt.load('compiler_cxx')
     opt.load('compiler_cc')
+    opt.add_option('--cycle-stats', action='store_true', default=False, dest='cycle_stats',
+                   help='count TSC cycles per DP hot path phase')
 
 def configure(conf):
     conf.load('g++')
     conf.load('gcc')
+    conf.env.CYCLE_STATS = conf.options.cycle_stats
 
 
 main_src = SrcGroup(dir='src',
@@ -107,6 +110,12 @@ main_src = SrcGroup(dir='src',
              'utl_yaml.cpp',
              'nat_check.cpp',
              'msg_manager.cpp',
+             'telemetry_bin.cpp',
+             'hdr_histogram.cpp',
+             'utl_idle.cpp',
+             'template_cache.cpp',
+             'pcap_replay.cpp',
+             'rx_capture.cpp',
              'pal/linux_dpdk/pal_utl.cpp',
              'pal/linux_dpdk/mbuf.cpp'
              ]);
@@ -117,6 +126,8 @@ cmn_src = SrcGroup(dir='src/common',
         'captureFile.cpp',
         'erf.cpp',
         'pcap.cpp',
+        'pcapng.cpp',
+        'cap_file_out.cpp',
         ]);
 
 net_src = SrcGroup(dir='src/common/Network/Packet',
@@ -592,6 +603,12 @@ build_types = [
               ]
 
 
+def get_cycle_stats_flags (bld):
+    if bld.env.CYCLE_STATS:
+        return ['-DTREX_CYCLE_STATS']
+    return []
+
+
 def build_prog (bld, build_obj):
 
     zmq_lib_path='external_libs/zmq/'
@@ -616,7 +633,7 @@ def build_prog (bld, build_obj):
 
     bld.program(features='cxx cxxprogram', 
                 includes =includes_path,
-                cxxflags =build_obj.get_cxx_flags(),
+                cxxflags =build_obj.get_cxx_flags() + get_cycle_stats_flags(bld),
                 linkflags = build_obj.get_link_flags() ,
                 lib=['pthread','dl'],
                 use =[build_obj.get_dpdk_target(),'zmq'],
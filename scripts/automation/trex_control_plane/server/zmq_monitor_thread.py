@@ -31,7 +31,8 @@ class ZmqMonitorSession(threading.Thread):
         self.socket     = self.context.socket(zmq.SUB)
         logger.info("ZMQ monitor started listening @ {pub}".format(pub=self.zmq_publisher))
         self.socket.connect(self.zmq_publisher)
-        self.socket.setsockopt(zmq.SUBSCRIBE, '')
+        # only the json messages, the binary telemetry (-pubb) is on the 'trex-bin' topic
+        self.socket.setsockopt(zmq.SUBSCRIBE, '{')
         
         while not self.stoprequest.is_set():
             try:
@@ -31,6 +31,13 @@ limitations under the License.
 #include "msg_manager.h"
 #include <common/cgen_map.h>
 #include "platform_cfg.h"
+#include "utl_seqlock.h"
+#include "telemetry_bin.h"
+#include "pcap_replay.h"
+#include <common/pcap.h>
+#include <common/pcapng.h>
+#include <pthread.h>
+#include <set>
 
 int test_policer(){
     CPolicer policer;
@@ -186,7 +193,7 @@ public:
         for (i=0; i<m_threads; i++) {
             lpt=fl.m_threads_info[i];
 
-            CFlowPktInfo *  pkt=lpt->m_cap_gen[0]->m_flow_info->GetPacket(0);
+            CFlowPktInfo *  pkt=lpt->m_cap_gen[0]->m_flow_info->get_family_flow(0)->GetPacket(0);
             m_saved_packet_padd_offset =pkt->m_pkt_indication.m_packet_padding;
 
             char buf[100];
@@ -598,6 +605,415 @@ TEST_F(basic, test_pcap_mode1) {
 }
 
 
+/* zero IPG trains sent by their first packet, the software split is exactly like the cap file */
+TEST_F(basic, test_pcap_mode_tso) {
+
+     CTestBasic t1;
+     CParserOption * po =&CGlobalInfo::m_options;
+     po->preview.setVMode(3);
+     po->preview.setFileWrite(true);
+     po->preview.set_tso_enable(true);
+     po->cfg_file ="cap2/test_pcap_mode_tso.yaml";
+     po->out_file ="exp/pcap_mode_tso";
+     t1.m_time_diff = 0.000005; // 5 nsec 
+     bool res=t1.init();
+     EXPECT_EQ_UINT32(1, res?1:0)<< "pass";
+     po->preview.set_tso_enable(false);
+}
+
+
+/* packets of the same side within 1msec are sent by one event, each one at its pcap time */
+TEST_F(basic, test_pcap_mode_train) {
+
+     CTestBasic t1;
+     CParserOption * po =&CGlobalInfo::m_options;
+     po->preview.setVMode(3);
+     po->preview.setFileWrite(true);
+     po->cfg_file ="cap2/test_pcap_mode_train.yaml";
+     po->out_file ="exp/pcap_mode_train";
+     t1.m_time_diff = 0.000005; // 5 nsec 
+     bool res=t1.init();
+     EXPECT_EQ_UINT32(1, res?1:0)<< "pass";
+}
+
+/* trains of many flows are interleaved, the output time never goes backwards */
+TEST_F(basic, test_pcap_mode_train_flows) {
+
+     CTestBasic t1;
+     CParserOption * po =&CGlobalInfo::m_options;
+     po->preview.setVMode(3);
+     po->preview.setFileWrite(true);
+     po->cfg_file ="cap2/test_pcap_mode_train_flows.yaml";
+     po->out_file ="exp/pcap_mode_train_flows";
+     t1.m_time_diff = 0.000005; // 5 nsec 
+     bool res=t1.init();
+     EXPECT_EQ_UINT32(1, res?1:0)<< "pass";
+
+     CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)"exp/pcap_mode_train_flows-0.erf",0);
+     ASSERT_TRUE(lp!=NULL);
+     CCapPktRaw raw_packet;
+     double last_time=0.0;
+     uint32_t cnt=0;
+     uint32_t back=0;
+     while ( lp->ReadPacket(&raw_packet) ) {
+         if ( raw_packet.get_time() < last_time ) {
+             back++;
+         }
+         last_time=raw_packet.get_time();
+         cnt++;
+     }
+     delete lp;
+     EXPECT_GT(cnt,1000U);
+     EXPECT_EQ_UINT32(0,back);
+}
+
+
+/* precise pacing in realtime, the gap error is measured against the schedule of the same run */
+TEST_F(basic, test_precise_pacing) {
+
+     CParserOption * po =&CGlobalInfo::m_options;
+     po->preview.setVMode(0);
+     po->preview.setFileWrite(true);
+     po->preview.set_precise_pacing_enable(true);
+     CGlobalInfo::set_realtime(true);
+     po->cfg_file ="cap2/test_precise_pacing.yaml";
+
+     CFlowGenList fl;
+     CErfIF erf_vif;
+     fl.Create();
+     fl.load_from_yaml(po->cfg_file,1);
+     fl.generate_p_thread_info(1);
+     CFlowGenListPerThread * lpt=fl.m_threads_info[0];
+     lpt->set_vif(&erf_vif);
+     EXPECT_TRUE(lpt->m_node_gen.m_is_precise);
+
+     CTimeHistogram & his=lpt->m_node_gen.m_ipg_err_his;
+     lpt->generate_erf("exp/precise_pacing-0.erf",po->preview);
+     printf(" ipg err cnt:%llu p50:%.1f usec max:%.1f usec \n",(unsigned long long)his.m_cnt,
+            his.get_percentile_usec(50.0),his.get_max_latency());
+     EXPECT_GT(his.m_cnt,100U);
+     EXPECT_LT(his.get_percentile_usec(50.0),50.0);
+
+     /* a schedule left from the previous run is 1 sec off, it must not be measured */
+     uint64_t cnt=his.m_cnt;
+     lpt->m_node_gen.m_last_tx_time -= 1.0;
+     lpt->generate_erf("exp/precise_pacing-0.erf",po->preview);
+     EXPECT_GT(his.m_cnt,cnt);
+     EXPECT_LT(his.get_max_latency(),100000.0);
+
+     fl.Delete();
+     CGlobalInfo::set_realtime(false);
+     po->preview.set_precise_pacing_enable(false);
+}
+
+
+/* the first run builds the template cache, the second one loads from it */
+TEST_F(basic, test_template_cache) {
+
+     const char * cache_file="exp/template_cache.bin";
+     unlink(cache_file);
+     int i;
+     for (i=0; i<2; i++) {
+         CTestBasic t1;
+         CParserOption * po =&CGlobalInfo::m_options;
+         po->preview.setVMode(3);
+         po->preview.setFileWrite(true);
+         po->cfg_file ="cap2/test_pcap_mode_train.yaml";
+         po->out_file ="exp/pcap_mode_train";
+         po->template_cache_file =cache_file;
+         t1.m_time_diff = 0.000005; // 5 nsec 
+         bool res=t1.init();
+         EXPECT_EQ_UINT32(1, res?1:0)<< "pass";
+     }
+     CGlobalInfo::m_options.template_cache_file="";
+
+     CFlowsYamlInfo yaml;
+     yaml.load_from_yaml_file("cap2/test_pcap_mode_train.yaml");
+     uint64_t hash=CTemplateCache::calc_hash("cap2/test_pcap_mode_train.yaml",&yaml);
+
+     CTemplateCache cache;
+     EXPECT_EQ_UINT32(0, cache.Open(cache_file,hash+1)?1:0);
+     EXPECT_EQ_UINT32(1, cache.Open(cache_file,hash)?1:0);
+     CCapFileFlowInfo flow;
+     flow.Create();
+     for (i=0; i<(int)yaml.m_vec.size(); i++) {
+         EXPECT_EQ_UINT32(1, cache.load(&flow)?1:0);
+     }
+     EXPECT_EQ_UINT32(0, cache.load(&flow)?1:0);
+     flow.Delete();
+     cache.Delete();
+     unlink(cache_file);
+}
+
+
+/* the templates loaded by 4 threads are the same as the ones of one thread, in the same order.
+   with ipv6 the packets are converted while they are loaded */
+static void parallel_template_load(bool ipv6){
+
+    CParserOption * po =&CGlobalInfo::m_options;
+    po->preview.set_ipv6_mode_enable(ipv6);
+    CFlowGenList fl1;
+    CFlowGenList fl4;
+    CPthreadJobRunner runner(4);
+    fl1.Create();
+    fl4.Create();
+    fl1.load_from_yaml("cap2/sfr.yaml",1);
+    fl4.load_from_yaml("cap2/sfr.yaml",1,&runner);
+    po->preview.set_ipv6_mode_enable(false);
+    EXPECT_EQ_UINT32(fl4.m_load_times.m_workers,4);
+    EXPECT_EQ_UINT32(fl1.m_cap_gen.size(),fl4.m_cap_gen.size());
+    int i;
+    for (i=0; i<(int)fl1.m_cap_gen.size(); i++) {
+        CCapFileFlowInfo * f1=&fl1.m_cap_gen[i]->m_flow_info;
+        CCapFileFlowInfo * f4=&fl4.m_cap_gen[i]->m_flow_info;
+        EXPECT_EQ(fl1.m_cap_gen[i]->m_info->m_name,fl4.m_cap_gen[i]->m_info->m_name);
+        EXPECT_EQ(f1->Size(),f4->Size());
+        EXPECT_EQ(f1->get_total_bytes(),f4->get_total_bytes());
+        EXPECT_EQ(f1->get_total_flows(),f4->get_total_flows());
+        uint32_t j;
+        for (j=0; j<f1->Size() && j<f4->Size(); j++) {
+            CFlowPktInfo * p1=f1->GetPacket(j);
+            CFlowPktInfo * p4=f4->GetPacket(j);
+            EXPECT_EQ(p1->m_packet->pkt_len,p4->m_packet->pkt_len);
+            EXPECT_EQ(0,memcmp(p1->m_packet->raw,p4->m_packet->raw,p1->m_packet->pkt_len));
+            EXPECT_EQ(p1->m_pkt_indication.m_cap_ipg,p4->m_pkt_indication.m_cap_ipg);
+            EXPECT_EQ(p1->m_pkt_indication.m_desc.getId(),p4->m_pkt_indication.m_desc.getId());
+            EXPECT_EQ(p4->m_pkt_indication.is_ipv6(),ipv6);
+        }
+    }
+    fl1.Delete();
+    fl4.Delete();
+}
+
+TEST_F(basic, test_parallel_template_load) {
+    parallel_template_load(false);
+}
+
+struct ipv6_convert_job_t {
+    pthread_t m_tid;
+    uint8_t   m_id;
+    uint32_t  m_bad;
+};
+
+/* convert a packet of its own again and again, the payload is the thread id */
+static void * ipv6_convert_thread(void * arg){
+    ipv6_convert_job_t * job=(ipv6_convert_job_t *)arg;
+    CCapPktRaw pkt(MAX_PKT_SIZE);
+    CPacketIndication ind;
+    uint16_t l4_len=64+job->m_id*100;
+    int i;
+    for (i=0; i<20000; i++) {
+        uint8_t * p=(uint8_t *)pkt.raw;
+        memset(p,0,14+20);
+        p[12]=0x08;
+        p[14]=0x45;
+        p[16]=(uint8_t)((20+l4_len)>>8);
+        p[17]=(uint8_t)(20+l4_len);
+        p[23]=17;
+        p[29]=job->m_id;
+        memset(p+14+20,job->m_id,l4_len);
+        pkt.pkt_len=14+20+l4_len;
+        if ( (!ind.ConvertPacketToIpv6InPlace(&pkt,14)) ||
+             (pkt.pkt_len != 14+40+l4_len) ||
+             (p[14+23] != job->m_id) ||
+             (p[14+40] != job->m_id) ||
+             (p[14+40+l4_len-1] != job->m_id) ) {
+            job->m_bad++;
+        }
+    }
+    return (NULL);
+}
+
+/* the conversion runs on the threads that load the templates */
+TEST_F(basic, test_ipv6_convert_threads) {
+    ipv6_convert_job_t jobs[4];
+    int i;
+    for (i=0; i<4; i++) {
+        jobs[i].m_id=i+1;
+        jobs[i].m_bad=0;
+        assert(pthread_create(&jobs[i].m_tid,NULL,ipv6_convert_thread,&jobs[i])==0);
+    }
+    for (i=0; i<4; i++) {
+        assert(pthread_join(jobs[i].m_tid,NULL)==0);
+        EXPECT_EQ_UINT32(jobs[i].m_bad,0);
+    }
+}
+
+TEST_F(basic, test_parallel_template_load_ipv6) {
+    int i;
+    for (i=0; i<4; i++) {
+        parallel_template_load(true);
+    }
+}
+
+
+/* one multi flow cap file, each flow with its own tuple at its offset in the file */
+TEST_F(basic, test_split_flows) {
+
+     CTestBasic t1;
+     CParserOption * po =&CGlobalInfo::m_options;
+     po->preview.setVMode(3);
+     po->preview.setFileWrite(true);
+     po->cfg_file ="cap2/test_split_flows.yaml";
+     po->out_file ="exp/split_flows";
+     t1.m_time_diff = 0.000005; // 5 nsec 
+     bool res=t1.init();
+     EXPECT_EQ_UINT32(1, res?1:0)<< "pass";
+}
+
+
+/* replay of a capture file, twice faster, second loop with other addresses */
+TEST_F(basic, test_pcap_replay) {
+
+     CTestBasic t1;
+     CParserOption * po =&CGlobalInfo::m_options;
+     po->preview.setVMode(3);
+     po->preview.setFileWrite(true);
+     po->cfg_file ="cap2/dns.yaml";
+     po->out_file ="exp/pcap_replay";
+     po->replay_file ="cap2/http_get.pcap";
+     po->m_replay_rate=2.0;
+     po->m_replay_loops=2;
+     po->m_replay_ip_offset=0x100;
+     t1.m_time_diff = 0.000005; // 5 nsec 
+     bool res=t1.init();
+     po->replay_file ="";
+     po->m_replay_rate=1.0;
+     po->m_replay_loops=1;
+     po->m_replay_ip_offset=0;
+     EXPECT_EQ_UINT32(1, res?1:0)<< "pass";
+}
+
+
+/* core of each sent packet by its address pair */
+class CReplaySplitIF : public CNullIF {
+public:
+    virtual int send_mbuf(pkt_dir_t dir, rte_mbuf_t *m, dsec_t time){
+        uint8_t * p=rte_pktmbuf_mtod(m, uint8_t*);
+        uint32_t src,dst;
+        memcpy(&src,p+14+12,4);
+        memcpy(&dst,p+14+16,4);
+        uint64_t key=(src<dst)?(((uint64_t)src<<32)|dst):(((uint64_t)dst<<32)|src);
+        m_cores[key].insert(m_core);
+        m_cnt++;
+        rte_pktmbuf_free(m);
+        return (0);
+    }
+public:
+    int m_core;
+    uint32_t m_cnt;
+    std::map<uint64_t,std::set<int> > m_cores;
+};
+
+/* udp packet of 16.0.0.flow -> 48.0.0.1, frag_off in 8 bytes units, without the udp header for a fragment with offset */
+static void replay_split_pkt(CCapPktRaw & raw,int flow,bool reply,uint16_t frag_off,bool more){
+    uint8_t p[14+20+8+16];
+    memset(p,0,sizeof(p));
+    p[12]=0x08;
+    uint8_t * ip=p+14;
+    uint16_t len=(frag_off==0)?(20+8+16):(20+16);
+    ip[0]=0x45;
+    ip[2]=len>>8;
+    ip[3]=len&0xff;
+    ip[6]=(more?0x20:0)|((frag_off>>8)&0x1f);
+    ip[7]=frag_off&0xff;
+    ip[8]=64;
+    ip[9]=17;
+    uint8_t c[4]={16,0,0,(uint8_t)flow};
+    uint8_t s[4]={48,0,0,1};
+    memcpy(ip+12,reply?s:c,4);
+    memcpy(ip+16,reply?c:s,4);
+    if ( frag_off==0 ) {
+        ip[20]=0x10;
+        ip[21]=(uint8_t)flow;
+        ip[22]=0x00;
+        ip[23]=53;
+    }
+    raw.pkt_len=14+len;
+    memcpy(raw.raw,p,raw.pkt_len);
+}
+
+/* with many cores each flow, its fragments and both directions, is sent by one core */
+TEST_F(basic, test_pcap_replay_split) {
+    std::string out="exp/pcap_replay_split.pcap";
+    CFileWriterBase * lpw=CCapWriterFactory::CreateWriter(LIBPCAP,(char *)out.c_str());
+    ASSERT_TRUE(lpw!=NULL);
+    CCapPktRaw raw;
+    raw.time_sec=1;
+    raw.time_nsec=0;
+    uint32_t total=0;
+    int flow;
+    for (flow=1; flow<=32; flow++) {
+        replay_split_pkt(raw,flow,false,0,false);
+        EXPECT_EQ(lpw->write_packet(&raw),true);
+        replay_split_pkt(raw,flow,false,0,true);
+        EXPECT_EQ(lpw->write_packet(&raw),true);
+        replay_split_pkt(raw,flow,false,3,false);
+        EXPECT_EQ(lpw->write_packet(&raw),true);
+        replay_split_pkt(raw,flow,true,0,false);
+        EXPECT_EQ(lpw->write_packet(&raw),true);
+        raw.time_nsec+=1000;
+        total+=4;
+    }
+    delete lpw;
+
+    /* the loader runs on the given cpu and not on the cpu of the caller */
+    cpu_set_t cpus;
+    ASSERT_EQ(sched_getaffinity(0,sizeof(cpus),&cpus),0);
+    int loader_cpu=-1;
+    int c;
+    for (c=0; c<CPU_SETSIZE; c++) {
+        if ( CPU_ISSET(c,&cpus) ) {
+            loader_cpu=c;
+        }
+    }
+    ASSERT_GE(loader_cpu,0);
+
+    CReplaySplitIF vif;
+    vif.m_cnt=0;
+    int threads=4;
+    int i;
+    for (i=0; i<threads; i++) {
+        CPcapReplay replay;
+        ASSERT_EQ(replay.Create(out,i,threads,0,1.0,1,0,false),true);
+        ASSERT_EQ(replay.start(0.0,loader_cpu),true);
+        vif.m_core=i;
+        double time=1000.0;
+        while ( replay.send(&vif,time) ) {
+            time=1000.0;
+        }
+        EXPECT_EQ(replay.get_loader_run_cpu(),loader_cpu);
+        replay.Delete();
+    }
+    EXPECT_EQ_UINT32(vif.m_cnt,total);
+    EXPECT_EQ_UINT32(vif.m_cores.size(),32);
+    std::set<int> used;
+    std::map<uint64_t,std::set<int> >::iterator it;
+    for (it=vif.m_cores.begin(); it!=vif.m_cores.end(); it++) {
+        EXPECT_EQ_UINT32(it->second.size(),1);
+        used.insert(*it->second.begin());
+    }
+    EXPECT_GT(used.size(),(size_t)1);
+}
+
+
+/* simulator output in pcapng */
+TEST_F(basic, test_pcapng_mode1) {
+
+     CTestBasic t1;
+     CParserOption * po =&CGlobalInfo::m_options;
+     po->preview.setVMode(3);
+     po->preview.setFileWrite(true);
+     po->preview.set_pcapng_mode_enable(true);
+     po->cfg_file ="cap2/test_pcap_mode1.yaml";
+     po->out_file ="exp/pcapng_mode1";
+     t1.m_time_diff = 0.000005; // 5 nsec 
+     bool res=t1.init();
+     EXPECT_EQ_UINT32(1, res?1:0)<< "pass";
+     po->preview.set_pcapng_mode_enable(false);
+}
+
+
 /* check override the low IPG */
 TEST_F(basic, test_pcap_mode2) {
 
@@ -672,7 +1088,8 @@ TEST_F(basic, latency2) {
     CLatencyPktInfo l;
     CCPortLatency port0;
     l.Create();
-    port0.Create(0,0,l.get_payload_offset(),l.get_pkt_size(),0);
+    port0.Create(0,0,l.get_payload_offset(),0);
+    port0.add_stream(l.get_rx_pkt_size());
 
 
     uint8_t  mac[]={0,0,0,1,0,0};
@@ -695,7 +1112,7 @@ TEST_F(basic, latency2) {
         p=rte_pktmbuf_mtod(m, uint8_t*);
         //utl_DumpBuffer(stdout,p,l.get_pkt_size(),0);
 
-        port0.update_packet(m);
+        port0.update_packet(m,0,l.get_payload_offset());
 
         p=rte_pktmbuf_mtod(m, uint8_t*);
         //utl_DumpBuffer(stdout,p,l.get_pkt_size(),0);
@@ -721,7 +1138,8 @@ TEST_F(basic, latency3) {
     CLatencyPktInfo l;
     CCPortLatency port0;
     l.Create();
-    port0.Create(0,0,l.get_payload_offset(),l.get_pkt_size(),0);
+    port0.Create(0,0,l.get_payload_offset(),0);
+    port0.add_stream(l.get_rx_pkt_size());
 
 
     uint8_t  mac[]={0,0,0,1,0,0};
@@ -739,7 +1157,7 @@ TEST_F(basic, latency3) {
 
     uint8_t *p;
     rte_mbuf_t * m=l.generate_pkt(0);
-    port0.update_packet(m);
+    port0.update_packet(m,0,l.get_payload_offset());
     p=rte_pktmbuf_mtod(m, uint8_t*);
     memset(p,0,l.get_pkt_size());
 
@@ -757,6 +1175,120 @@ TEST_F(basic, latency3) {
 }
 
 
+TEST_F(basic, latency_streams) {
+    CLatencyStreamYamlInfo s1;
+    s1.m_size = 128;
+    s1.m_dscp = 46;
+    s1.m_vlan = 100;
+
+    CLatencyPktInfo l0;
+    CLatencyPktInfo l1;
+    CCPortLatency port0;
+    EXPECT_EQ_UINT32(l0.Create()?1:0, (uint32_t)1)<< "pass";
+    EXPECT_EQ_UINT32(l1.Create(&s1)?1:0, (uint32_t)1)<< "pass";
+    EXPECT_EQ_UINT32(l1.get_pkt_size(), (uint32_t)132)<< "pass";
+    EXPECT_EQ_UINT32(l1.get_rx_pkt_size(), (uint32_t)128)<< "pass";
+
+    port0.Create(0,0,l0.get_payload_offset(),0,2);
+    port0.add_stream(l0.get_rx_pkt_size());
+    port0.add_stream(l1.get_rx_pkt_size());
+
+    l0.set_ip(0x01000000,0x02000000,0x01000000);
+    l1.set_ip(0x01000000,0x02000000,0x01000000);
+
+    int i;
+    CRx_check_header *  rx_p;
+    for (i=0; i<30; i++) {
+        CLatencyPktInfo * l= (i%3==0)?&l0:&l1;
+        uint16_t stream_id = (i%3==0)?0:1;
+        rte_mbuf_t * m=l->generate_pkt(0);
+        port0.update_packet(m,stream_id,l->get_payload_offset());
+        bool res=port0.check_packet(m,rx_p);
+        EXPECT_EQ_UINT32((uint32_t)res?1:0, (uint32_t)1)<< "pass";
+        rte_pktmbuf_free(m);
+    }
+    EXPECT_EQ_UINT32(port0.get_stream(0)->m_pkt_ok, (uint32_t)10)<< "pass";
+    EXPECT_EQ_UINT32(port0.get_stream(1)->m_pkt_ok, (uint32_t)20)<< "pass";
+    EXPECT_EQ_UINT32(port0.m_pkt_ok, (uint32_t)30)<< "pass";
+    EXPECT_EQ_UINT32(port0.m_seq_error, (uint32_t)0)<< "pass";
+    /* a stream histogram has only the counters of its precision */
+    EXPECT_LT(port0.get_stream(1)->m_hist.get_hdr().get_counts_len()*6,(uint32_t)CHdrHistogram::MAX_COUNTS);
+
+    /* stream 1 template with the stream 0 id, wrong length */
+    rte_mbuf_t * m=l1.generate_pkt(0);
+    port0.update_packet(m,0,l1.get_payload_offset());
+    EXPECT_EQ_UINT32(port0.check_packet(m,rx_p)?1:0, (uint32_t)0)<< "pass";
+    rte_pktmbuf_free(m);
+    EXPECT_EQ_UINT32(port0.get_stream(0)->m_length_error, (uint32_t)1)<< "pass";
+
+    /* unknown stream */
+    m=l0.generate_pkt(0);
+    port0.update_packet(m,0,l0.get_payload_offset());
+    latency_header * h=(latency_header *)(rte_pktmbuf_mtod(m, uint8_t*)+l0.get_payload_offset());
+    h->set_stream_id(7);
+    EXPECT_EQ_UINT32(port0.check_packet(m,rx_p)?1:0, (uint32_t)0)<< "pass";
+    rte_pktmbuf_free(m);
+    EXPECT_EQ_UINT32(port0.m_no_id, (uint32_t)1)<< "pass";
+
+    /* all the 24 bits of the magic are checked */
+    m=l0.generate_pkt(0);
+    port0.update_packet(m,0,l0.get_payload_offset());
+    h=(latency_header *)(rte_pktmbuf_mtod(m, uint8_t*)+l0.get_payload_offset());
+    h->magic ^= 0x100;
+    EXPECT_EQ_UINT32(port0.check_packet(m,rx_p)?1:0, (uint32_t)0)<< "pass";
+    rte_pktmbuf_free(m);
+    EXPECT_EQ_UINT32(port0.m_no_magic, (uint32_t)1)<< "pass";
+
+    std::string json;
+    port0.dump_json_v2(json);
+    EXPECT_EQ_UINT32(json.find("\"stream-1\"")!=std::string::npos?1:0, (uint32_t)1)<< "pass";
+    port0.DumpCounters(stdout);
+
+    port0.Delete();
+    l0.Delete();
+    l1.Delete();
+}
+
+
+TEST_F(basic, latency_clone) {
+    CLatencyStreamYamlInfo s1;
+    s1.m_size = 256;
+
+    CLatencyPktInfo l0;
+    CLatencyPktInfo l1;
+    CCPortLatency port0;
+    l0.Create();
+    l1.Create(&s1);
+    l0.set_ip(0x01000000,0x02000000,0x01000000);
+    l1.set_ip(0x01000000,0x02000000,0x01000000);
+
+    port0.Create(0,0,l0.get_payload_offset(),0,2);
+    port0.add_stream(l0.get_rx_pkt_size());
+    port0.add_stream(l1.get_rx_pkt_size());
+
+    EXPECT_EQ_UINT32(port0.is_tx_template_valid(0)?1:0, (uint32_t)0)<< "pass";
+    port0.set_tx_template(0,l0.generate_pkt(0),l0.get_payload_offset(),0);
+    port0.set_tx_template(1,l1.generate_pkt(0),l1.get_payload_offset(),0);
+    EXPECT_EQ_UINT32(port0.is_tx_template_valid(1)?1:0, (uint32_t)1)<< "pass";
+
+    int i;
+    CRx_check_header *  rx_p;
+    for (i=0; i<20; i++) {
+        uint16_t stream_id = i%2;
+        rte_mbuf_t * m=port0.clone_tx_packet(stream_id);
+        EXPECT_EQ_UINT32(rte_pktmbuf_pkt_len(m), (uint32_t)(stream_id?256:62))<< "pass";
+        bool res=port0.check_packet(m,rx_p);
+        EXPECT_EQ_UINT32((uint32_t)res?1:0, (uint32_t)1)<< "pass";
+        rte_pktmbuf_free(m);
+    }
+    EXPECT_EQ_UINT32(port0.get_stream(0)->m_pkt_ok, (uint32_t)10)<< "pass";
+    EXPECT_EQ_UINT32(port0.get_stream(1)->m_pkt_ok, (uint32_t)10)<< "pass";
+    EXPECT_EQ_UINT32(port0.m_seq_error, (uint32_t)0)<< "pass";
+
+    port0.Delete();
+    l0.Delete();
+    l1.Delete();
+}
 
 
 class CDummyLatencyHWBase : public CPortLatencyHWBase {
@@ -2468,6 +3000,105 @@ TEST_F(file_flow_info, f1) {
 
 }
 
+/* two templates of the same file share the const mbufs */
+TEST_F(file_flow_info, const_dedup) {
+    m_flow_info.load_cap_file("cap2/http_get.pcap",1,0) ;
+    uint64_t saved=CGlobalInfo::m_const_store.get_saved_bytes();
+    uint64_t total=CGlobalInfo::m_const_store.get_total_bytes();
+
+    CCapFileFlowInfo flow_info;
+    assert(flow_info.Create());
+    flow_info.load_cap_file("cap2/http_get.pcap",2,0) ;
+    ASSERT_EQ(flow_info.Size(),m_flow_info.Size());
+    uint64_t bytes=0;
+    int i;
+    for (i=0; i<m_flow_info.Size(); i++) {
+        CFlowPktInfo * lp1=m_flow_info.GetPacket((uint32_t)i);
+        CFlowPktInfo * lp2=flow_info.GetPacket((uint32_t)i);
+        EXPECT_EQ(lp1->m_big_mbuf[0],lp2->m_big_mbuf[0]);
+        if ( lp1->m_packet->pkt_len > FIRST_PKT_SIZE ) {
+            bytes+=lp1->m_packet->pkt_len - FIRST_PKT_SIZE;
+        }
+    }
+    EXPECT_GT(bytes,0ULL);
+    EXPECT_EQ(CGlobalInfo::m_const_store.get_saved_bytes(),saved+bytes);
+    EXPECT_EQ(CGlobalInfo::m_const_store.get_total_bytes(),total);
+
+    /* the first template keeps the mbufs */
+    flow_info.Delete();
+    EXPECT_EQ(CGlobalInfo::m_const_store.get_saved_bytes(),saved);
+    EXPECT_EQ(CGlobalInfo::m_const_store.get_total_bytes(),total);
+    for (i=0; i<m_flow_info.Size(); i++) {
+        CFlowPktInfo * lp1=m_flow_info.GetPacket((uint32_t)i);
+        if ( lp1->m_big_mbuf[0] ) {
+            EXPECT_EQ(memcmp(rte_pktmbuf_mtod(lp1->m_big_mbuf[0], char*),
+                             lp1->m_packet->raw+FIRST_PKT_SIZE,
+                             lp1->m_packet->pkt_len - FIRST_PKT_SIZE),0);
+        }
+    }
+}
+
+/* a packet above 2048 bytes, the const part is from the jumbo pool */
+TEST_F(file_flow_info, jumbo) {
+    std::string out="exp/jumbo.pcap";
+    CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)"cap2/dns.pcap",0);
+    ASSERT_TRUE(lp!=NULL);
+    CCapPktRaw pkt;
+    ASSERT_EQ(lp->ReadPacket(&pkt),true);
+
+    /* the dns query with a 9000 bytes frame and with the biggest one */
+    uint16_t sizes[]={9000,MAX_PKT_SIZE};
+    int s;
+    for (s=0; s<2; s++) {
+        uint16_t size=sizes[s];
+        CCapPktRaw jumbo(size);
+        memcpy(jumbo.raw,pkt.raw,pkt.pkt_len);
+        int i;
+        for (i=pkt.pkt_len; i<size; i++) {
+            jumbo.raw[i]=(char)i;
+        }
+        jumbo.pkt_len=size;
+        jumbo.time_sec=pkt.time_sec;
+        jumbo.time_nsec=pkt.time_nsec;
+        IPHeader * ipv4=(IPHeader *)(jumbo.raw+14);
+        ipv4->setTotalLength(size-14);
+        ipv4->updateCheckSum();
+        UDPHeader * udp=(UDPHeader *)(jumbo.raw+14+20);
+        udp->setLength(size-14-20);
+
+        CFileWriterBase * lpw=CCapWriterFactory::CreateWriter(LIBPCAP,(char *)out.c_str());
+        ASSERT_TRUE(lpw!=NULL);
+        EXPECT_EQ(lpw->write_packet(&jumbo),true);
+        delete lpw;
+
+        ASSERT_EQ(m_flow_info.load_cap_file(out,1,0),0);
+        remove(out.c_str());
+        ASSERT_EQ(m_flow_info.Size(),1);
+        CFlowPktInfo * lpi=m_flow_info.GetPacket(0);
+        ASSERT_EQ(lpi->m_packet->pkt_len,size);
+        ASSERT_TRUE(lpi->m_big_mbuf[0]!=NULL);
+        EXPECT_EQ(lpi->m_big_mbuf[0]->data_len,size-FIRST_PKT_SIZE);
+
+        CCCapFileMemoryUsage memory;
+        m_flow_info.get_total_memory(memory);
+        EXPECT_EQ(memory.m_buf[CCCapFileMemoryUsage::MASK_SIZE-1],1U);
+
+        /* header mbuf and the const one */
+        CGenNode node;
+        node.m_dest_ip  = 0x10000110;
+        node.m_src_ip   = 0x20000110;
+        node.m_src_port = 12;
+        rte_mbuf_t * m=lpi->generate_new_mbuf(&node);
+        EXPECT_EQ(m->pkt_len,(uint32_t)size);
+        EXPECT_EQ(m->nb_segs,2);
+        CCapPktRaw raw;
+        fill_pkt(&raw,m);
+        EXPECT_EQ(memcmp(raw.raw+FIRST_PKT_SIZE,jumbo.raw+FIRST_PKT_SIZE,size-FIRST_PKT_SIZE),0);
+        rte_pktmbuf_free(m);
+    }
+    delete lp;
+}
+
 TEST_F(file_flow_info, f2) {
     m_flow_info.load_cap_file("cap2/citrix.pcap",1,0) ;
     m_flow_info.update_info();
@@ -2594,8 +3225,8 @@ TEST_F(time_histogram, test_average) {
         m_hist.update();
     }
 
-    EXPECT_GT(m_hist.get_average_latency(),7400.0);
-    EXPECT_LT(m_hist.get_average_latency(),7600.0);
+    EXPECT_GT(m_hist.get_average_latency(),4990.0);
+    EXPECT_LT(m_hist.get_average_latency(),5010.0);
     
     m_hist.Dump(stdout);
 }
@@ -2619,7 +3250,391 @@ TEST_F(time_histogram, test_json) {
     printf(" %s \n",json.c_str());
 }
 
+TEST_F(time_histogram, test_percentile) {
+    int i;
+    for (i=0; i<9990; i++) {
+        m_hist.Add(1e-6);
+    }
+    for (i=0; i<10; i++) {
+        m_hist.Add(350e-6);
+    }
+    /* 1usec is under the linear part of the histogram, 64nsec resolution */
+    EXPECT_NEAR(m_hist.get_percentile_usec(50.0),1.0,0.064);
+    EXPECT_NEAR(m_hist.get_percentile_usec(99.9),1.0,0.064);
+    EXPECT_EQ(m_hist.get_percentile_usec(99.95),350.0);
+    EXPECT_EQ(m_hist.get_percentile_usec(100.0),350.0);
+
+    m_hist.Add(25e-6);
+    EXPECT_NEAR(m_hist.get_percentile_usec(99.9),25.0,0.025);
+}
 
+TEST_F(time_histogram, test_merge) {
+    CTimeHistogram h2;
+    h2.Create();
+    int i;
+    for (i=0; i<100; i++) {
+        m_hist.Add(20e-6);
+        h2.Add(2000e-6);
+    }
+    EXPECT_TRUE(m_hist.merge(h2));
+    EXPECT_EQ(m_hist.m_cnt,200);
+    EXPECT_EQ(m_hist.m_high_cnt,200);
+    EXPECT_NEAR(m_hist.get_percentile_usec(50.0),20.0,0.064);
+    EXPECT_NEAR(m_hist.get_percentile_usec(50.5),2000.0,2.0);
+    EXPECT_NEAR(m_hist.get_max_latency(),2000.0,1.0);
+
+    /* different precision can't be merged */
+    CTimeHistogram h3;
+    h3.Create(2);
+    EXPECT_FALSE(m_hist.merge(h3));
+
+    std::string  json ;
+    m_hist.dump_json("myHis",json );
+    EXPECT_NE(json.find("\"p99_99_usec\""),std::string::npos);
+    EXPECT_NE(json.find("{\"key\":20,\"val\":100}"),std::string::npos);
+    EXPECT_NE(json.find("{\"key\":2000,\"val\":100}"),std::string::npos);
+    h2.Delete();
+    h3.Delete();
+}
+
+TEST_F(time_histogram, hdr_precision) {
+    CHdrHistogram h;
+    EXPECT_TRUE(h.Create(100,10000000000ULL,3));
+    EXPECT_EQ(h.get_counts_len(),(uint32_t)CHdrHistogram::MAX_COUNTS);
+    /* does not fit the counters array */
+    EXPECT_FALSE(h.Create(1,10000000000ULL,3));
+    /* the counters follow the digits */
+    EXPECT_TRUE(h.Create(100,10000000000ULL,2));
+    EXPECT_LT(h.get_counts_len()*6,(uint32_t)CHdrHistogram::MAX_COUNTS);
+    EXPECT_TRUE(h.Create(100,10000000000ULL,3));
+
+    uint64_t v;
+    for (v=100000; v<10000000000ULL; v=v*3) {
+        uint64_t high=h.get_highest_equivalent_value(v);
+        EXPECT_GE(high,v);
+        /* 3 significant digits */
+        EXPECT_LE((double)(high-v),(double)v/1000.0);
+    }
+    h.add(20000000000ULL);
+    EXPECT_EQ(h.get_max(),20000000000ULL);
+    EXPECT_EQ(h.get_total(),1);
+
+    /* copy only the used counters */
+    CHdrHistogram h2;
+    h2.add(5000000);
+    h2=h;
+    EXPECT_EQ(h2.get_total(),1);
+    /* clamped to the highest trackable value */
+    EXPECT_GE(h2.get_value_at_percentile(100.0),10000000000ULL);
+    h.Reset();
+    h.add(1000);
+    h2=h;
+    EXPECT_EQ(h2.get_used_len(),h.get_used_len());
+    EXPECT_LE(h2.get_value_at_percentile(50.0),1063ULL);
+    h2.Dump(stdout);
+
+    /* the assignment copies into the counters of the target */
+    CHdrHistogram h3(100,10000000000ULL,2);
+    EXPECT_LT(h3.get_counts_cap(),(uint32_t)CHdrHistogram::MAX_COUNTS);
+    h3.add(3000000);
+    h2=h3;
+    EXPECT_EQ(h2.get_counts_cap(),(uint32_t)CHdrHistogram::MAX_COUNTS);
+    EXPECT_EQ(h2.get_counts_len(),h3.get_counts_len());
+    EXPECT_EQ(h2.get_total(),1);
+    EXPECT_EQ(h2.get_value_at_percentile(50.0),h3.get_value_at_percentile(50.0));
+    /* back to 3 digits, Create within the room does not allocate */
+    EXPECT_TRUE(h2.Create(100,10000000000ULL,3));
+    EXPECT_EQ(h2.get_counts_cap(),(uint32_t)CHdrHistogram::MAX_COUNTS);
+    EXPECT_EQ(h2.get_total(),0);
+    EXPECT_EQ(h2.get_count_at_index(h3.get_used_len()-1),0);
+}
+
+
+
+//////////////////////////////////////////////////////////////
+
+class gt_seqlock  : public testing::Test {
+
+protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+  }
+public:
+};
+
+struct CSeqLockTestObj {
+    uint64_t m_a;
+    uint64_t m_b[32];
+    uint64_t m_c;
+};
+
+static CSeqLockSnapshot<CSeqLockTestObj> seqlock_test_obj;
+static volatile bool seqlock_test_done;
+
+static void * seqlock_writer(void * arg){
+    uint64_t i;
+    for (i=1; i<200000; i++) {
+        CSeqLockTestObj & o=seqlock_test_obj.write_begin();
+        o.m_a=i;
+        int j;
+        for (j=0; j<32; j++) {
+            o.m_b[j]=i;
+        }
+        o.m_c=i;
+        seqlock_test_obj.write_end();
+    }
+    seqlock_test_done=true;
+    return (0);
+}
+
+TEST_F(gt_seqlock, seqlock1) {
+    CSeqLockSnapshot<CSeqLockTestObj> s;
+    CSeqLockTestObj o;
+    memset(&o,0,sizeof(o));
+    o.m_a=7;
+    o.m_c=8;
+    s.publish(o);
+    EXPECT_EQ(s.get_version(),1);
+
+    CSeqLockTestObj r;
+    EXPECT_EQ(s.read(r),0);
+    EXPECT_EQ(r.m_a,7);
+    EXPECT_EQ(r.m_c,8);
+}
+
+TEST_F(gt_seqlock, seqlock_no_tear) {
+    CSeqLockTestObj o;
+    memset(&o,0,sizeof(o));
+    seqlock_test_obj.publish(o);
+    seqlock_test_done=false;
+
+    pthread_t tid;
+    EXPECT_EQ(pthread_create(&tid,NULL,seqlock_writer,NULL),0);
+
+    int errors=0;
+    uint64_t last=0;
+    while ( !seqlock_test_done ) {
+        CSeqLockTestObj r;
+        seqlock_test_obj.read(r);
+        int j;
+        for (j=0; j<32; j++) {
+            if (r.m_b[j]!=r.m_a) {
+                errors++;
+            }
+        }
+        if ( (r.m_a != r.m_c) || (r.m_a < last) ) {
+            errors++;
+        }
+        last=r.m_a;
+    }
+    EXPECT_EQ(pthread_join(tid,NULL),0);
+    EXPECT_EQ(errors,0);
+}
+
+TEST_F(gt_seqlock, request1) {
+    CRequestSnapshot<CSeqLockTestObj> s;
+    CSeqLockTestObj o;
+    memset(&o,0,sizeof(o));
+    /* the first copy does not wait for a read */
+    EXPECT_TRUE(s.is_requested());
+    o.m_a=7;
+    s.write_begin()=o;
+    s.write_end();
+    EXPECT_FALSE(s.is_requested());
+
+    CSeqLockTestObj r;
+    s.read(r);
+    EXPECT_EQ(r.m_a,7);
+    /* the read asked for the next copy, a read without a copy gets the same */
+    EXPECT_TRUE(s.is_requested());
+    s.read(r);
+    EXPECT_EQ(r.m_a,7);
+    o.m_a=8;
+    s.write_begin()=o;
+    s.write_end();
+    s.read(r);
+    EXPECT_EQ(r.m_a,8);
+}
+
+static CRequestSnapshot<CTimeHistogram> * request_test_his;
+static volatile bool request_test_done;
+
+/* DP like writer, copies a live histogram only on request */
+static void * request_writer(void * arg){
+    CTimeHistogram live(2);
+    uint32_t i;
+    for (i=1; i<200000; i++) {
+        live.Add(0.000001*(double)(i % 1000));
+        if ( request_test_his->is_requested() ) {
+            request_test_his->write_begin()=live;
+            request_test_his->write_end();
+        }
+    }
+    request_test_done=true;
+    return (0);
+}
+
+TEST_F(gt_seqlock, request_histogram) {
+    CRequestSnapshot<CTimeHistogram> s;
+    request_test_his=&s;
+    request_test_done=false;
+    s.write_begin().Create(2);
+    s.write_end();
+    CTimeHistogram r(2);
+    s.read(r);
+
+    pthread_t tid;
+    EXPECT_EQ(pthread_create(&tid,NULL,request_writer,NULL),0);
+
+    int errors=0;
+    uint64_t last=0;
+    while ( !request_test_done ) {
+        s.read(r);
+        /* a consistent copy, the counters match the total */
+        CHdrHistogram & hdr=r.get_hdr();
+        uint64_t sum=0;
+        uint32_t j;
+        for (j=0; j<hdr.get_used_len(); j++) {
+            sum+=hdr.get_count_at_index(j);
+        }
+        if ( (sum != hdr.get_total()) || (sum < last) ) {
+            errors++;
+        }
+        last=sum;
+    }
+    EXPECT_EQ(pthread_join(tid,NULL),0);
+    EXPECT_EQ(errors,0);
+}
+
+//////////////////////////////////////////////////////////////
+
+class gt_dp_cycles  : public testing::Test {
+
+protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+      CDpCycleStats::set_cur(0);
+  }
+public:
+};
+
+TEST_F(gt_dp_cycles, add_cur) {
+    CDpCycleStats cs;
+    /* no owner, should not crash */
+    CDpCycleStats::add_cur(CDpCycleStats::cpTX_BURST,10);
+    EXPECT_EQ(cs.m_cnt[CDpCycleStats::cpTX_BURST],0);
+
+    CDpCycleStats::set_cur(&cs);
+    CDpCycleStats::add_cur(CDpCycleStats::cpTX_BURST,10);
+    CDpCycleStats::add_cur(CDpCycleStats::cpTX_BURST,30);
+    EXPECT_EQ(cs.m_cnt[CDpCycleStats::cpTX_BURST],2);
+    EXPECT_EQ(cs.m_cycles[CDpCycleStats::cpTX_BURST],40);
+
+    DP_CYCLE_START(t_test);
+    DP_CYCLE_END(t_test,cpMSG);
+    EXPECT_EQ(cs.m_cnt[CDpCycleStats::cpMSG],CDpCycleStats::is_enabled()?1:0);
+
+    std::string json;
+    cs.m_work_cycles=400;
+    cs.dump_json(0,json);
+    EXPECT_NE(json.find("\"tx_burst\":{\"cycles\":40,\"cnt\":2}"),std::string::npos);
+    cs.DumpHeader(stdout);
+    cs.Dump(0,stdout);
+}
+
+//////////////////////////////////////////////////////////////
+
+class gt_telemetry_bin  : public testing::Test {
+
+protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+  }
+public:
+};
+
+TEST_F(gt_telemetry_bin, encode_decode) {
+    std::string buf;
+    CTelemetryBinEncoder enc;
+    enc.begin(buf,CTelemetryBin::tbGLOBAL,17,123456789,
+              CTelemetryBin::G_LAST,2,CTelemetryBin::P_LAST);
+    enc.set(CTelemetryBin::G_TX_PKTS,0x1234567890ULL);
+    enc.set_double(CTelemetryBin::G_TX_BPS,10.5e9);
+    enc.set_rec(1,CTelemetryBin::P_OPACKETS,77);
+    enc.set_rec_double(1,CTelemetryBin::P_TX_BPS,1.25);
+
+    CTelemetryBinDecoder dec;
+    EXPECT_EQ(CTelemetryBinDecoder::is_bin_msg(buf.c_str(),buf.length()),true);
+    EXPECT_EQ(dec.decode(buf.c_str(),buf.length()),true);
+    EXPECT_EQ(dec.get_version(),TELEMETRY_BIN_VERSION);
+    EXPECT_EQ(dec.get_type(),CTelemetryBin::tbGLOBAL);
+    EXPECT_EQ(dec.get_seq(),17);
+    EXPECT_EQ(dec.get_time_usec(),123456789);
+    EXPECT_EQ(dec.get_num_rec(),2);
+    EXPECT_EQ(dec.get(CTelemetryBin::G_TX_PKTS),0x1234567890ULL);
+    EXPECT_EQ(dec.get(CTelemetryBin::G_RX_PKTS),0);
+    EXPECT_EQ(dec.get_double(CTelemetryBin::G_TX_BPS),10.5e9);
+    EXPECT_EQ(dec.get_rec(0,CTelemetryBin::P_OPACKETS),0);
+    EXPECT_EQ(dec.get_rec(1,CTelemetryBin::P_OPACKETS),77);
+    EXPECT_EQ(dec.get_rec_double(1,CTelemetryBin::P_TX_BPS),1.25);
+}
+
+TEST_F(gt_telemetry_bin, old_publisher) {
+    /* a publisher without the last global and port fields, they read as zero */
+    std::string buf;
+    CTelemetryBinEncoder enc;
+    enc.begin(buf,CTelemetryBin::tbGLOBAL,0,0,
+              CTelemetryBin::G_QUEUE_DELAY,1,CTelemetryBin::P_TX_BPS);
+    enc.set(CTelemetryBin::G_CPU_UTIL,7);
+    enc.set_rec(0,CTelemetryBin::P_OERRORS,5);
+
+    CTelemetryBinDecoder dec;
+    EXPECT_EQ(dec.decode(buf.c_str(),buf.length()),true);
+    EXPECT_EQ(dec.get(CTelemetryBin::G_CPU_UTIL),7);
+    EXPECT_EQ(dec.get(CTelemetryBin::G_QUEUE_DELAY),0);
+    EXPECT_EQ(dec.get_rec(0,CTelemetryBin::P_OERRORS),5);
+    EXPECT_EQ(dec.get_rec_double(0,CTelemetryBin::P_TX_BPS),0.0);
+    EXPECT_EQ(dec.get_rec(1,CTelemetryBin::P_OPACKETS),0);
+}
+
+TEST_F(gt_telemetry_bin, invalid) {
+    std::string json="{\"name\":\"trex-global\",\"type\":0,\"data\":{\"unknown\":0}}";
+    CTelemetryBinDecoder dec;
+    EXPECT_EQ(dec.decode(json.c_str(),json.length()),false);
+
+    std::string buf;
+    CTelemetryBinEncoder enc;
+    enc.begin(buf,CTelemetryBin::tbGLOBAL,0,0,CTelemetryBin::G_LAST,1,CTelemetryBin::P_LAST);
+    enc.set(CTelemetryBin::G_TX_PKTS,5);
+    enc.set_rec(0,CTelemetryBin::P_OPACKETS,6);
+    EXPECT_EQ(dec.decode(buf.c_str(),buf.length()),true);
+    EXPECT_EQ(dec.is_valid(),true);
+    /* truncated, nothing of the last good message is left */
+    EXPECT_EQ(dec.decode(buf.c_str(),buf.length()-8),false);
+    EXPECT_EQ(dec.is_valid(),false);
+    EXPECT_EQ(dec.get_version(),0);
+    EXPECT_EQ(dec.get_type(),0);
+    EXPECT_EQ(dec.get_seq(),0);
+    EXPECT_EQ(dec.get_time_usec(),0);
+    EXPECT_EQ(dec.get_num_rec(),0);
+    EXPECT_EQ(dec.get(CTelemetryBin::G_TX_PKTS),0);
+    EXPECT_EQ(dec.get_rec(0,CTelemetryBin::P_OPACKETS),0);
+    EXPECT_EQ(dec.get_rec_double(0,CTelemetryBin::P_TX_BPS),0.0);
+    EXPECT_EQ(dec.decode(buf.c_str(),10),false);
+    EXPECT_EQ(dec.get(CTelemetryBin::G_TX_PKTS),0);
+
+    /* never decoded */
+    CTelemetryBinDecoder dec2;
+    EXPECT_EQ(dec2.is_valid(),false);
+    EXPECT_EQ(dec2.get_seq(),0);
+    EXPECT_EQ(dec2.get_rec(0,CTelemetryBin::P_OPACKETS),0);
+}
 
 class gt_jitter  : public testing::Test {
 
@@ -2815,3 +3830,536 @@ TEST_F(gt_conf, t1) {
 #endif
 
 
+
+//////////////////////////////////////////////////////////////
+
+class gt_os_time  : public testing::Test {
+
+protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+  }
+public:
+};
+
+TEST_F(gt_os_time, freq) {
+    os_hr_clock_init();
+    hr_time_t freq=os_get_hr_freq();
+    EXPECT_GE(freq,(hr_time_t)100000000ULL);
+    EXPECT_LE(freq,(hr_time_t)10000000000ULL);
+
+    /* the clock follows the monotonic clock. a long window and a loose
+       bound, a preempted read in a loaded VM should not fail the test */
+    uint64_t ns0=platform_time_monotonic_nsec();
+    hr_time_t t0=os_get_hr_tick_64();
+    struct timespec req;
+    req.tv_sec  = 0;
+    req.tv_nsec = 250000000;
+    nanosleep(&req,0);
+    uint64_t ns1=platform_time_monotonic_nsec();
+    hr_time_t t1=os_get_hr_tick_64();
+    double d_mono=(double)(ns1-ns0)/1e9;
+    double d_hr=ptime_convert_hr_dsec(t1-t0);
+    EXPECT_NEAR(d_hr,d_mono,d_mono*0.05);
+
+    /* ordered reads do not go back */
+    hr_time_t a=os_get_hr_tick_64_ordered();
+    hr_time_t b=os_get_hr_tick_64_ordered();
+    EXPECT_GE(b,a);
+}
+
+TEST_F(gt_os_time, idle) {
+    CIdlePolicy idle;
+    idle.Create(false);
+    /* disabled, only spin */
+    EXPECT_EQ(idle.idle(0.01),false);
+    idle.Delete();
+
+    idle.Create(true);
+    EXPECT_EQ(idle.idle(0.000001),false);
+    /* a long gap sleeps and wakes up before the deadline. the scheduler of a loaded
+       host can be late, so most of the waits and not all of them */
+    int i;
+    int early=0;
+    for (i=0; i<20; i++) {
+        dsec_t start=now_sec();
+        dsec_t deadline=start+0.002;
+        EXPECT_EQ(idle.idle(deadline-now_sec()),true);
+        dsec_t wake=now_sec();
+        /* it did wait */
+        EXPECT_GE(wake-start,0.002-(CIdlePolicy::SLEEP_MARGIN_USEC/1000000.0)-0.00001);
+        if ( wake <= deadline ) {
+            early++;
+        }
+        idle.add_wake(wake-deadline);
+    }
+    EXPECT_GE(early,10);
+    EXPECT_EQ(idle.m_sleep_cnt,20ULL);
+    EXPECT_EQ(idle.m_wake_his.get_hdr().get_total(),20ULL);
+    idle.Dump(stdout);
+    idle.Delete();
+}
+
+
+class gt_pcap_mmap  : public testing::Test {
+
+protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+  }
+public:
+};
+
+/* write a copy of a usec pcap file, byte flipped and/or with nsec timestamps */
+static bool pcap_write_variant(std::string in,std::string out,bool flip,bool nsec){
+    FILE * fi=fopen(in.c_str(),"rb");
+    if (fi == NULL) {
+        return (false);
+    }
+    FILE * fo=fopen(out.c_str(),"wb");
+    assert(fo);
+    packet_file_header_t header;
+    assert(fread(&header,1,sizeof(header),fi)==sizeof(header));
+    header.magic = nsec?0xa1b23c4d:0xa1b2c3d4;
+    if (flip) {
+        header.magic         = PAL_NTOHL(header.magic);
+        header.version_major = PAL_NTOHS(header.version_major);
+        header.version_minor = PAL_NTOHS(header.version_minor);
+        header.snaplen       = PAL_NTOHL(header.snaplen);
+        header.linktype      = PAL_NTOHL(header.linktype);
+    }
+    fwrite(&header,1,sizeof(header),fo);
+    sf_pkthdr_t pkt_header;
+    char buf[MAX_PKT_SIZE];
+    while ( fread(&pkt_header,1,sizeof(pkt_header),fi)==sizeof(pkt_header) ) {
+        assert(pkt_header.caplen<=MAX_PKT_SIZE);
+        assert(fread(buf,1,pkt_header.caplen,fi)==pkt_header.caplen);
+        uint32_t caplen=pkt_header.caplen;
+        if (nsec) {
+            pkt_header.ts.msec *= 1000;
+        }
+        if (flip) {
+            pkt_header.ts.sec  = PAL_NTOHL(pkt_header.ts.sec);
+            pkt_header.ts.msec = PAL_NTOHL(pkt_header.ts.msec);
+            pkt_header.caplen  = PAL_NTOHL(pkt_header.caplen);
+            pkt_header.len     = PAL_NTOHL(pkt_header.len);
+        }
+        fwrite(&pkt_header,1,sizeof(pkt_header),fo);
+        fwrite(buf,1,caplen,fo);
+    }
+    fclose(fi);
+    fclose(fo);
+    return (true);
+}
+
+/* the mapped reader gives the same packets as the stream reader */
+static int pcap_cmp_readers(CCapReaderBase * lp1,CCapReaderBase * lp2){
+    CCapPktRaw raw_packet1;
+    CCapPktRaw raw_packet2;
+    int cnt=0;
+    while ( true ) {
+        bool has_pkt1 = lp1->ReadPacket(&raw_packet1);
+        bool has_pkt2 = lp2->ReadPacket(&raw_packet2);
+        if ( !has_pkt1  || !has_pkt2 ) {
+            if (has_pkt1 != has_pkt2 ) {
+                return (-1);
+            }
+            break;
+        }
+        if ( (raw_packet1.time_sec != raw_packet2.time_sec) ||
+             (raw_packet1.time_nsec != raw_packet2.time_nsec) ||
+             (!raw_packet1.Compare(&raw_packet2,true,0.0)) ) {
+            return (-1);
+        }
+        cnt++;
+    }
+    return (cnt);
+}
+
+TEST_F(gt_pcap_mmap, variants) {
+    std::string ref="avl/delay_10_http_browsing_0.pcap";
+    const char * names[4]={"usec","usec_flip","nsec","nsec_flip"};
+    int i;
+    for (i=0; i<4; i++) {
+        bool flip=(i&1)?true:false;
+        bool nsec=(i&2)?true:false;
+        std::string out="exp/pcap_mmap_"+std::string(names[i])+".pcap";
+        ASSERT_EQ(pcap_write_variant(ref,out,flip,nsec),true);
+
+        LibPCapReader     r1;
+        LibPCapMmapReader r2;
+        ASSERT_EQ(r1.Create((char *)ref.c_str()),true);
+        ASSERT_EQ(r2.Create((char *)out.c_str()),true);
+        EXPECT_EQ(r2.is_flip(),flip);
+        EXPECT_EQ(r2.is_nsec(),nsec);
+        EXPECT_GT(pcap_cmp_readers(&r1,&r2),0) << names[i];
+    }
+
+    /* the factory maps pcap files */
+    CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)ref.c_str(),0);
+    ASSERT_TRUE(lp!=NULL);
+    EXPECT_TRUE(dynamic_cast<LibPCapMmapReader *>(lp)!=NULL);
+    delete lp;
+}
+
+/* MB/s of the stream reader and the mapped reader, each packet is touched as the parser does */
+static double pcap_reader_mbps(CCapReaderBase * lp,int loops,uint64_t & sum){
+    CCapPktRaw raw_packet;
+    uint64_t bytes=0;
+    dsec_t start=now_sec();
+    int i;
+    for (i=0; i<loops; i++) {
+        lp->Rewind();
+        while ( lp->ReadPacket(&raw_packet) ) {
+            int j;
+            for (j=0; j<raw_packet.pkt_len; j+=64) {
+                sum+=(uint8_t)raw_packet.raw[j];
+            }
+            bytes+=raw_packet.pkt_len;
+        }
+    }
+    dsec_t d=now_sec()-start;
+    return ((double)bytes/(d*1e6));
+}
+
+TEST_F(gt_pcap_mmap, bench) {
+    std::string file="avl/delay_10_video_call_0.pcap";
+    int loops=20;
+    uint64_t sum1=0;
+    uint64_t sum2=0;
+    LibPCapReader     r1;
+    LibPCapMmapReader r2;
+    ASSERT_EQ(r1.Create((char *)file.c_str()),true);
+    ASSERT_EQ(r2.Create((char *)file.c_str()),true);
+    double mbps1=pcap_reader_mbps(&r1,loops,sum1);
+    double mbps2=pcap_reader_mbps(&r2,loops,sum2);
+    printf(" fread reader : %.1f MB/s \n",mbps1);
+    printf(" mmap reader  : %.1f MB/s \n",mbps2);
+    EXPECT_EQ(sum1,sum2);
+}
+
+
+class gt_pcapng  : public testing::Test {
+
+protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+  }
+public:
+};
+
+/* write and read back, nsec timestamps and the interface of each packet are kept */
+TEST_F(gt_pcapng, write_read) {
+    std::string ref="avl/delay_10_http_browsing_0.pcap";
+    std::string out="exp/pcapng_write_read.pcapng";
+    LibPCapReader r1;
+    ASSERT_EQ(r1.Create((char *)ref.c_str()),true);
+    CFileWriterBase * lpw=CCapWriterFactory::CreateWriter(PCAPNG,(char *)out.c_str());
+    ASSERT_TRUE(lpw!=NULL);
+    CCapPktRaw raw_packet;
+    int cnt=0;
+    while ( r1.ReadPacket(&raw_packet) ) {
+        raw_packet.time_nsec+=cnt;
+        raw_packet.setInterface(cnt%3);
+        EXPECT_EQ(lpw->write_packet(&raw_packet),true);
+        cnt++;
+    }
+    delete lpw;
+
+    r1.Rewind();
+    CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)out.c_str(),0);
+    ASSERT_TRUE(lp!=NULL);
+    EXPECT_TRUE(dynamic_cast<CPcapNgReader *>(lp)!=NULL);
+    CCapPktRaw raw_packet2;
+    int i;
+    for (i=0; i<cnt; i++) {
+        ASSERT_EQ(r1.ReadPacket(&raw_packet),true);
+        ASSERT_EQ(lp->ReadPacket(&raw_packet2),true);
+        EXPECT_EQ(raw_packet2.time_sec,raw_packet.time_sec);
+        EXPECT_EQ(raw_packet2.time_nsec,raw_packet.time_nsec+i);
+        EXPECT_EQ(raw_packet2.getInterface(),i%3);
+        raw_packet.setInterface(i%3);
+        EXPECT_EQ(raw_packet2.Compare(&raw_packet,true,1.0),true);
+    }
+    EXPECT_EQ(lp->ReadPacket(&raw_packet2),false);
+    delete lp;
+}
+
+static void pcapng_put32_be(std::string & s,uint32_t v){
+    s+=(char)(v>>24);
+    s+=(char)(v>>16);
+    s+=(char)(v>>8);
+    s+=(char)v;
+}
+
+/* big endian section with msec resolution */
+TEST_F(gt_pcapng, flip_resolution) {
+    std::string out="exp/pcapng_flip.pcapng";
+    std::string s;
+    /* SHB */
+    pcapng_put32_be(s,PCAPNG_BT_SHB);
+    pcapng_put32_be(s,28);
+    pcapng_put32_be(s,PCAPNG_BOM);
+    pcapng_put32_be(s,0x00010000);
+    pcapng_put32_be(s,0xffffffff);
+    pcapng_put32_be(s,0xffffffff);
+    pcapng_put32_be(s,28);
+    /* IDB, if_tsresol 3 */
+    pcapng_put32_be(s,PCAPNG_BT_IDB);
+    pcapng_put32_be(s,32);
+    pcapng_put32_be(s,0x00010000);
+    pcapng_put32_be(s,0);
+    pcapng_put32_be(s,(PCAPNG_OPT_IF_TSRESOL<<16)|1);
+    pcapng_put32_be(s,0x03000000);
+    pcapng_put32_be(s,0);
+    pcapng_put32_be(s,32);
+    /* EPB of 60 bytes at 1.5 sec */
+    pcapng_put32_be(s,PCAPNG_BT_EPB);
+    pcapng_put32_be(s,32+60);
+    pcapng_put32_be(s,0);
+    pcapng_put32_be(s,0);
+    pcapng_put32_be(s,1500);
+    pcapng_put32_be(s,60);
+    pcapng_put32_be(s,60);
+    s+=std::string(60,(char)0x55);
+    pcapng_put32_be(s,32+60);
+    FILE * fd=fopen(out.c_str(),"wb");
+    ASSERT_TRUE(fd!=NULL);
+    fwrite(s.c_str(),1,s.size(),fd);
+    fclose(fd);
+
+    CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)out.c_str(),0);
+    ASSERT_TRUE(lp!=NULL);
+    CCapPktRaw raw_packet;
+    ASSERT_EQ(lp->ReadPacket(&raw_packet),true);
+    EXPECT_EQ(raw_packet.pkt_len,60);
+    EXPECT_EQ(raw_packet.time_sec,1U);
+    EXPECT_EQ(raw_packet.time_nsec,500000000U);
+    EXPECT_EQ((uint8_t)raw_packet.raw[59],0x55);
+    EXPECT_EQ(lp->ReadPacket(&raw_packet),false);
+    delete lp;
+}
+
+
+class gt_cap_file_out  : public testing::Test {
+
+protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+  }
+public:
+};
+
+/* packets from segments, more than two output buffers, read back by the pcap reader */
+TEST_F(gt_cap_file_out, segs_libpcap) {
+    std::string out="exp/cap_file_out.pcap";
+    CFileWriterBase * lpw=CCapWriterFactory::CreateWriter(LIBPCAP,(char *)out.c_str());
+    ASSERT_TRUE(lpw!=NULL);
+    char buf[1500];
+    int i;
+    for (i=0; i<(int)sizeof(buf); i++) {
+        buf[i]=(char)i;
+    }
+    int cnt=(3*CCapFileOut::BUF_SIZE)/1000;
+    for (i=0; i<cnt; i++) {
+        uint16_t len=64+(i%1400);
+        /* header, first part and the rest, as an mbuf chain */
+        CCapPktSegs pkt;
+        pkt.add(buf,14);
+        pkt.add(buf+14,50);
+        pkt.add(buf+64,len-64);
+        pkt.time_sec  = i;
+        pkt.time_nsec = 1000;
+        EXPECT_EQ(lpw->write_packet_segs(pkt),true);
+    }
+    delete lpw;
+
+    LibPCapReader r1;
+    ASSERT_EQ(r1.Create((char *)out.c_str()),true);
+    CCapPktRaw raw_packet;
+    for (i=0; i<cnt; i++) {
+        ASSERT_EQ(r1.ReadPacket(&raw_packet),true);
+        ASSERT_EQ(raw_packet.pkt_len,64+(i%1400));
+        EXPECT_EQ(raw_packet.time_sec,(uint32_t)i);
+        EXPECT_EQ(memcmp(raw_packet.raw,buf,raw_packet.pkt_len),0);
+    }
+    EXPECT_EQ(r1.ReadPacket(&raw_packet),false);
+    remove(out.c_str());
+}
+
+
+class gt_rx_capture  : public testing::Test {
+
+protected:
+  virtual void SetUp() {
+  }
+
+  virtual void TearDown() {
+  }
+public:
+};
+
+/* packet of a capture file in an mbuf of two segments */
+static rte_mbuf_t * rx_capture_mbuf(CCapPktRaw * raw){
+    rte_mbuf_t * m=CGlobalInfo::pktmbuf_alloc(0,raw->pkt_len);
+    assert(m);
+    uint16_t first=(raw->pkt_len>64)?64:raw->pkt_len;
+    memcpy(rte_pktmbuf_append(m,first),raw->raw,first);
+    if ( raw->pkt_len>first ) {
+        rte_mbuf_t * m2=CGlobalInfo::pktmbuf_alloc(0,raw->pkt_len-first);
+        assert(m2);
+        memcpy(rte_pktmbuf_append(m2,raw->pkt_len-first),raw->raw+first,raw->pkt_len-first);
+        utl_rte_pktmbuf_add_last(m,m2);
+    }
+    return (m);
+}
+
+TEST_F(gt_rx_capture, filter) {
+    CRxCaptureFilter f;
+    EXPECT_EQ(f.Create("udp and"),false);
+    EXPECT_EQ(f.Create("src greater 10"),false);
+    EXPECT_EQ(f.Create("host 1.2.3"),false);
+    EXPECT_EQ(f.Create("net 16.0.0.0"),false);
+    EXPECT_EQ(f.Create("foo"),false);
+    EXPECT_EQ(f.Create(""),true);
+    EXPECT_EQ(f.is_empty(),true);
+
+    /* dns query 21.0.0.2 -> 22.0.0.12, the response back */
+    CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)"cap2/dns.pcap",0);
+    ASSERT_TRUE(lp!=NULL);
+    CCapPktRaw q;
+    CCapPktRaw r;
+    ASSERT_EQ(lp->ReadPacket(&q),true);
+    ASSERT_EQ(lp->ReadPacket(&r),true);
+    uint8_t * qp=(uint8_t *)q.raw;
+    uint8_t * rp=(uint8_t *)r.raw;
+
+    EXPECT_EQ(f.match(qp,q.pkt_len,q.pkt_len),true);
+    ASSERT_EQ(f.Create("udp and dst port 53"),true);
+    EXPECT_EQ(f.match(qp,q.pkt_len,q.pkt_len),true);
+    EXPECT_EQ(f.match(rp,r.pkt_len,r.pkt_len),false);
+    ASSERT_EQ(f.Create("src net 21.0.0.0/8 and not tcp"),true);
+    EXPECT_EQ(f.match(qp,q.pkt_len,q.pkt_len),true);
+    EXPECT_EQ(f.match(rp,r.pkt_len,r.pkt_len),false);
+    ASSERT_EQ(f.Create("tcp or src host 22.0.0.12"),true);
+    EXPECT_EQ(f.match(qp,q.pkt_len,q.pkt_len),false);
+    EXPECT_EQ(f.match(rp,r.pkt_len,r.pkt_len),true);
+    ASSERT_EQ(f.Create("ip6 || arp || vlan || icmp"),true);
+    EXPECT_EQ(f.match(qp,q.pkt_len,q.pkt_len),false);
+    ASSERT_EQ(f.Create("port 53 && less 20"),true);
+    EXPECT_EQ(f.match(qp,q.pkt_len,q.pkt_len),false);
+    ASSERT_EQ(f.Create("! ip6 && greater 20"),true);
+    EXPECT_EQ(f.match(qp,q.pkt_len,q.pkt_len),true);
+    delete lp;
+}
+
+/* rx side to the file and back, filter and snaplen */
+TEST_F(gt_rx_capture, file) {
+    std::string out="exp/rx_capture.pcap";
+    CRxCapture cap;
+    ASSERT_EQ(cap.Create(out,"tcp and greater 100",2,200,0),true);
+
+    CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)"cap2/http_get.pcap",0);
+    ASSERT_TRUE(lp!=NULL);
+    CCapPktRaw raw_packet;
+    std::vector<CCapPktRaw *> pkts;
+    uint64_t rx=0;
+    while ( lp->ReadPacket(&raw_packet) ) {
+        rx++;
+        if ( raw_packet.pkt_len >= 100 ) {
+            pkts.push_back(new CCapPktRaw(&raw_packet));
+        }
+        /* port 1, one ring keeps the order */
+        rte_mbuf_t * m=rx_capture_mbuf(&raw_packet);
+        cap.capture(1,m);
+        rte_pktmbuf_free(m);
+    }
+    delete lp;
+    cap.Delete();
+
+    CRxCaptureStats stats;
+    cap.get_stats(stats);
+    EXPECT_EQ(stats.m_rx,rx);
+    EXPECT_EQ(stats.m_filtered,rx-pkts.size());
+    EXPECT_EQ(stats.m_captured+stats.m_drop,(uint64_t)pkts.size());
+    EXPECT_EQ(stats.m_written,stats.m_captured);
+    EXPECT_EQ(stats.m_files,1ULL);
+    EXPECT_EQ(stats.m_write_error,0ULL);
+
+    lp=CCapReaderFactory::CreateReader((char *)out.c_str(),0);
+    ASSERT_TRUE(lp!=NULL);
+    int i=0;
+    while ( (i<(int)pkts.size()) && lp->ReadPacket(&raw_packet) ) {
+        uint16_t len=pkts[i]->pkt_len;
+        EXPECT_EQ(raw_packet.pkt_len,(len>200)?200:len);
+        EXPECT_EQ(memcmp(raw_packet.raw,pkts[i]->raw,raw_packet.pkt_len),0);
+        i++;
+    }
+    EXPECT_EQ(i,(int)stats.m_written);
+    delete lp;
+    for (i=0; i<(int)pkts.size(); i++) {
+        delete pkts[i];
+    }
+    remove(out.c_str());
+}
+
+/* a new file each few packets */
+TEST_F(gt_rx_capture, rotate) {
+    std::string out="exp/rx_capture_rotate.pcap";
+    CRxCapture cap;
+    /* header + 3 records of 64+16 bytes */
+    ASSERT_EQ(cap.Create(out,"",1,64,sizeof(packet_file_header_t)+3*(64+16)),true);
+
+    CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)"cap2/http_get.pcap",0);
+    ASSERT_TRUE(lp!=NULL);
+    CCapPktRaw raw_packet;
+    int cnt=0;
+    while ( (cnt<10) && lp->ReadPacket(&raw_packet) ) {
+        if ( raw_packet.pkt_len < 64 ) {
+            continue;
+        }
+        rte_mbuf_t * m=rx_capture_mbuf(&raw_packet);
+        cap.capture(0,m);
+        rte_pktmbuf_free(m);
+        cnt++;
+    }
+    delete lp;
+    cap.Delete();
+    ASSERT_EQ(cnt,10);
+
+    CRxCaptureStats stats;
+    cap.get_stats(stats);
+    EXPECT_EQ(stats.m_written,10ULL);
+    EXPECT_EQ(stats.m_files,4ULL);
+
+    int total=0;
+    int i;
+    for (i=0; i<4; i++) {
+        std::string name=out;
+        if ( i ) {
+            char buf[20];
+            sprintf(buf,".%d",i);
+            name+=buf;
+        }
+        lp=CCapReaderFactory::CreateReader((char *)name.c_str(),0);
+        ASSERT_TRUE(lp!=NULL);
+        int n=0;
+        while ( lp->ReadPacket(&raw_packet) ) {
+            EXPECT_EQ(raw_packet.pkt_len,64);
+            n++;
+        }
+        EXPECT_EQ(n,(i<3)?3:1);
+        total+=n;
+        delete lp;
+        remove(name.c_str());
+    }
+    EXPECT_EQ(total,10);
+}
@@ -23,7 +23,10 @@ limitations under the License.
 #include "utl_json.h"
 #include "utl_yaml.h"
 #include "msg_manager.h"
+#include "telemetry_bin.h"
 #include <common/basic_utils.h> 
+#include <pthread.h>
+#include <algorithm>
 
 
 #undef VALG
@@ -43,6 +46,7 @@ uint32_t getDualPortId(uint32_t thread_id){
 
 
 CRteMemPool       CGlobalInfo::m_mem_pool[MAX_SOCKETS_SUPPORTED];
+CConstMbufStore   CGlobalInfo::m_const_store;
 
 uint32_t           CGlobalInfo::m_nodes_pool_size = 10*1024;
 CParserOption      CGlobalInfo::m_options;
@@ -63,7 +67,7 @@ void CGlobalMemory::Dump(FILE *fd){
 
     int i=0; 
     for (i=0; i<MBUF_SIZE; i++) {
-        if ( (i>MBUF_2048) && (i<MBUF_DP_FLOWS)){
+        if ( ((i>MBUF_2048) && (i<MBUF_DP_FLOWS)) || (i==TRAFFIC_MBUF_9k) ){
             continue;
         }
         if ( i<TRAFFIC_MBUF_64 ){
@@ -92,6 +96,7 @@ void CGlobalMemory::set(const CPlatformMemoryYamlInfo &info,float mul){
     m_mbuf[MBUF_512]  += info.m_mbuf[TRAFFIC_MBUF_512];
     m_mbuf[MBUF_1024] += info.m_mbuf[TRAFFIC_MBUF_1024];
     m_mbuf[MBUF_2048] += info.m_mbuf[TRAFFIC_MBUF_2048];
+    m_mbuf[MBUF_9k]   += info.m_mbuf[TRAFFIC_MBUF_9k];
 }
 
 
@@ -169,6 +174,10 @@ bool CPlatformSocketInfoNoConfig::thread_phy_is_latency(physical_thread_id_t  ph
     return (phy_id==(m_threads_per_dual_if*m_dual_if+1));
 }
 
+physical_thread_id_t CPlatformSocketInfoNoConfig::get_master_phy_id(){
+    return (0);
+}
+
 
 void CPlatformSocketInfoNoConfig::dump(FILE *fd){
     fprintf(fd," there is no configuration file given \n");
@@ -394,6 +403,10 @@ bool CPlatformSocketInfoConfig::thread_phy_is_latency(physical_thread_id_t  phy_
     return (m_platform->m_latency_thread == phy_id?true:false);
 }
 
+physical_thread_id_t CPlatformSocketInfoConfig::get_master_phy_id(){
+    return (m_platform->m_master_thread);
+}
+
 
 
 ////////////////////////////////////////
@@ -469,6 +482,10 @@ bool CPlatformSocketInfo::thread_phy_is_latency(physical_thread_id_t  phy_id){
     return ( m_obj->thread_phy_is_latency(phy_id));
 }
 
+physical_thread_id_t CPlatformSocketInfo::get_master_phy_id(){
+    return ( m_obj->get_master_phy_id());
+}
+
 void CPlatformSocketInfo::dump(FILE *fd){
     m_obj->dump(fd);
 }
@@ -492,6 +509,7 @@ void CRteMemPool::dump(FILE *fd){
     DUMP_MBUF("mbuf_512",m_mbuf_pool_512);
     DUMP_MBUF("mbuf_1024",m_mbuf_pool_1024);
     DUMP_MBUF("mbuf_2048",m_big_mbuf_pool);
+    DUMP_MBUF("mbuf_9k",m_mbuf_pool_9k);
 }
 ////////////////////////////////////////
 
@@ -554,6 +572,12 @@ void CGlobalInfo::init_pools(uint32_t rx_buffers){
 
             assert(lpmem->m_mbuf_pool_1024);
 
+            lpmem->m_mbuf_pool_9k=utl_rte_mempool_create("_9k-pkt-const",
+                                                    lp->m_mbuf[MBUF_9k],
+                                                    CONST_9k_MBUF_SIZE,
+                                                    32,(i<<5)+ 7,i);
+
+            assert(lpmem->m_mbuf_pool_9k);
 
         }
     }
@@ -584,6 +608,7 @@ void CFlowYamlInfo::Dump(FILE *fd){
     fprintf(fd,"limit_was_set       : %d \n",m_limit_was_set?1:0);
     fprintf(fd,"cap_mode    : %d \n",m_cap_mode?1:0);
     fprintf(fd,"plugin_id   : %d \n",m_plugin_id);
+    fprintf(fd,"split_flows : %d \n",m_split_flows?1:0);
     fprintf(fd,"one_server  : %d \n",m_one_app_server?1:0);
     fprintf(fd,"one_server_was_set  : %d \n",m_one_app_server_was_set?1:0);
     if (m_dpPkt) {
@@ -656,6 +681,12 @@ void CPreviewMode::Dump(FILE *fd){
     fprintf(fd," no clean close  : %d\n", (int)getNoCleanFlowClose() );
     fprintf(fd," 1g mode         : %d\n", (int)get_1g_mode() );
     fprintf(fd," zmq_publish     : %d\n", (int)get_zmq_publish_enable() );
+    fprintf(fd," zmq_bin_publish : %d\n", (int)get_zmq_bin_publish_enable() );
+    fprintf(fd," precise_pacing  : %d\n", (int)get_precise_pacing_enable() );
+    fprintf(fd," low_power_idle  : %d\n", (int)get_low_power_idle_enable() );
+    fprintf(fd," tx_backpressure : %d\n", (int)get_tx_backpressure_enable() );
+    fprintf(fd," tso             : %d\n", (int)get_tso_enable() );
+    fprintf(fd," pcapng          : %d\n", (int)get_pcapng_mode_enable() );
     fprintf(fd," vlan_enable     : %d\n", (int)get_vlan_mode_enable() );
     fprintf(fd," mbuf_cache_disable  : %d\n", (int)isMbufCacheDisabled() );
     fprintf(fd," mac_ip_features : %d\n", (int)get_mac_ip_features_enable()?1:0 );
@@ -717,6 +748,9 @@ int CErfIF::open_file(std::string file_name){
         if ( m_preview_mode->get_pcap_mode_enable() ){
             file_type=LIBPCAP;
         }
+        if ( m_preview_mode->get_pcapng_mode_enable() ){
+            file_type=PCAPNG;
+        }
         m_writer = CCapWriterFactory::CreateWriter(file_type,(char *)file_name.c_str());
         if (m_writer == NULL) {
             fprintf(stderr,"ERROR can't create cap file %s ",(char *)file_name.c_str());
@@ -1245,10 +1279,10 @@ void CPacketIndication::ProcessIpv6Packet(CPacketParser *parser,
 }
 
 
-static uint8_t cbuff[MAX_PKT_SIZE];
-
+/* the templates are loaded by several threads, the scratch buffer is on the stack */
 bool CPacketIndication::ConvertPacketToIpv6InPlace(CCapPktRaw * pkt,
                                                        int offset){
+    uint8_t cbuff[MAX_PKT_SIZE];
 
     // Copy l2 data and set l2 type to ipv6
     memcpy(cbuff, pkt->raw, offset);
@@ -1278,6 +1312,9 @@ bool CPacketIndication::ConvertPacketToIpv6InPlace(CCapPktRaw * pkt,
     // Copy rest of packet
     uint16_t ipv4_offset = offset + ipv4->getHeaderLength();
     uint16_t ipv6_offset = offset + ipv6_hdrlen;
+    if ( (uint32_t)ipv6_offset + p_len > MAX_PKT_SIZE ) {
+        return(false);
+    }
     memcpy(cbuff+ipv6_offset,pkt->raw+ipv4_offset,p_len);
 
     ipv6_offset+=p_len;
@@ -1310,6 +1347,11 @@ void CPacketIndication::_ProcessPacket(CPacketParser *parser,
     Clean();
     CCPacketParserCounters * m_cnt=&parser->m_counter;
 
+    if ( CGlobalInfo::is_ipv6_enable() ) {
+        /* the packet grows in place, a packet of the mmap reader is copied first */
+        m_packet->own_raw();
+    }
+
     int offset = 0;
     char * packetBase;
     packetBase = m_packet->raw;
@@ -1741,10 +1783,8 @@ void CFlowPktInfo::alloc_const_mbuf(){
                 rte_mbuf_t        * m;
                 uint16_t pkt_s=(m_packet->pkt_len - FIRST_PKT_SIZE);
 
-                m = CGlobalInfo::pktmbuf_alloc(i,pkt_s);
+                m = CGlobalInfo::m_const_store.get(i,m_packet->raw+FIRST_PKT_SIZE,pkt_s);
                 BP_ASSERT(m);
-                char *p=rte_pktmbuf_append(m, pkt_s);
-                rte_memcpy(p,(m_packet->raw+FIRST_PKT_SIZE),pkt_s);
 
                 assert(m_big_mbuf[i]==NULL);
                 m_big_mbuf[i]=m;
@@ -1753,28 +1793,62 @@ void CFlowPktInfo::alloc_const_mbuf(){
     }
 }
 
+void CFlowPktInfo::alloc_tso_mbuf(){
+    uint16_t pkt_s=m_pkt_indication.m_payload_len;
+    int i;
+    for (i=0; i<MAX_SOCKETS_SUPPORTED; i++) {
+        if ( CGlobalInfo::m_socket.is_sockets_enable(i) ){
+            rte_mbuf_t        * m;
+            m = CGlobalInfo::m_const_store.get(i,(char *)m_pkt_indication.m_payload,pkt_s);
+            BP_ASSERT(m);
+
+            assert(m_tso_mbuf[i]==NULL);
+            m_tso_mbuf[i]=m;
+        }
+    }
+}
+
 void CFlowPktInfo::free_const_mbuf(){
     int i;
     for (i=0; i<MAX_SOCKETS_SUPPORTED; i++) {
         rte_mbuf_t   * m=m_big_mbuf[i];
         if (m) {
-            rte_pktmbuf_free(m );
+            CGlobalInfo::m_const_store.put(i,m);
             m_big_mbuf[i]=NULL;
         }
+        m=m_tso_mbuf[i];
+        if (m) {
+            CGlobalInfo::m_const_store.put(i,m);
+            m_tso_mbuf[i]=NULL;
+        }
     }
 }
 
 
-bool CFlowPktInfo::Create(CPacketIndication  * pkt_ind){
-    /* clone the packet*/
-    m_packet = new CCapPktRaw(pkt_ind->m_packet);
+bool CFlowPktInfo::Create(CPacketIndication  * pkt_ind,bool is_ref){
+    if ( is_ref ) {
+        /* the packet memory is owned by the caller, see CTemplateCache */
+        m_packet = new CCapPktRaw((int)0);
+        m_packet->CloneShalow(pkt_ind->m_packet);
+        m_packet->pkt_cnt   = pkt_ind->m_packet->pkt_cnt;
+        m_packet->time_sec  = pkt_ind->m_packet->time_sec;
+        m_packet->time_nsec = pkt_ind->m_packet->time_nsec;
+    }else{
+        /* clone the packet*/
+        m_packet = new CCapPktRaw(pkt_ind->m_packet);
+    }
     /* clone of the offsets */
     m_pkt_indication.Clone(pkt_ind,m_packet);
 
     int i;
     for (i=0; i<MAX_SOCKETS_SUPPORTED; i++) {
         m_big_mbuf[i] = NULL;
+        m_tso_mbuf[i] = NULL;
     }
+    m_tso_segs=0;
+    m_tso_mss=0;
+    m_tso_payload=0;
+    m_train_len=0;
     alloc_const_mbuf();
     return (true);
 }
@@ -1987,6 +2061,151 @@ void CCapFileFlowInfo::update_info(){
 }
 
 
+/* a packet that can be in a TSO train */
+static bool is_tso_pkt(CFlowPktInfo * lp){
+    CPacketIndication * pi=&lp->m_pkt_indication;
+    return ( pi->m_desc.IsTcp() && 
+             (!pi->is_ipv6()) &&
+             (!pi->m_desc.IsPluginEnable()) &&
+             (!pi->m_desc.IsLearn()) &&
+             pi->m_desc.IsPcapTiming() &&
+             (!pi->m_desc.IsLastPkt()) &&
+             (pi->m_payload_len > 0) );
+}
+
+/* lp continues the train of head, prev is the last packet of the train */
+static bool is_tso_next(CFlowPktInfo * head,
+                        CFlowPktInfo * prev,
+                        CFlowPktInfo * lp){
+    CPacketIndication * hi=&head->m_pkt_indication;
+    CPacketIndication * pi=&prev->m_pkt_indication;
+    CPacketIndication * li=&lp->m_pkt_indication;
+    if ( !is_tso_pkt(lp) ) {
+        return (false);
+    }
+    /* back to back in the pcap, same flow and side */
+    if ( (pi->m_cap_ipg != 0.0) || 
+         (li->m_desc.getFlowId() != hi->m_desc.getFlowId()) ||
+         (li->m_desc.IsInitSide() != hi->m_desc.IsInitSide()) ) {
+        return (false);
+    }
+    /* the NIC cuts MSS segments and copies the header of the first one */
+    if ( (pi->m_payload_len != hi->m_payload_len) ||
+         (li->m_payload_len > hi->m_payload_len) ||
+         (li->getPayloadOffset() != hi->getPayloadOffset()) ) {
+        return (false);
+    }
+    TCPHeader * ht=hi->l4.m_tcp;
+    TCPHeader * pt=pi->l4.m_tcp;
+    TCPHeader * lt=li->l4.m_tcp;
+    if ( (lt->getSeqNumber() != pt->getSeqNumber()+pi->m_payload_len) ||
+         (lt->getAckNumber() != ht->getAckNumber()) ||
+         (lt->getWindowSize() != ht->getWindowSize()) ) {
+        return (false);
+    }
+    /* only the last segment may have PSH */
+    if ( (pt->getFlags() != TCPHeader::Flag::ACK) ||
+         ((lt->getFlags() & ~TCPHeader::Flag::PSH) != TCPHeader::Flag::ACK) ) {
+        return (false);
+    }
+    return (true);
+}
+
+void CCapFileFlowInfo::update_tso(){
+    /* the rx-check and NAT options are per packet */
+    if ( get_is_rx_filter_enable() ) {
+        return;
+    }
+    int i=0;
+    while ( i < (int)Size() ) {
+        CFlowPktInfo * head=GetPacket((uint32_t)i);
+        uint32_t payload=head->m_pkt_indication.m_payload_len;
+        int n=1;
+        if ( is_tso_pkt(head) ) {
+            while ( ((i+n) < (int)Size()) && (n < TSO_MAX_SEGS) ) {
+                CFlowPktInfo * lp=GetPacket((uint32_t)(i+n));
+                if ( (payload+lp->m_pkt_indication.m_payload_len) > TSO_MAX_PAYLOAD ) {
+                    break;
+                }
+                if ( !is_tso_next(head,GetPacket((uint32_t)(i+n-1)),lp) ) {
+                    break;
+                }
+                payload+=lp->m_pkt_indication.m_payload_len;
+                n++;
+            }
+        }
+        if ( n > 1 ) {
+            head->m_tso_segs    = n;
+            head->m_tso_mss     = head->m_pkt_indication.m_payload_len;
+            head->m_tso_payload = payload;
+            int j;
+            for (j=1; j<n; j++) {
+                CFlowPktInfo * lp=GetPacket((uint32_t)(i+j));
+                lp->m_tso_segs = 1;
+                lp->alloc_tso_mbuf();
+            }
+            m_tso_trains++;
+        }
+        i+=n;
+    }
+    if ( m_tso_trains ) {
+        fprintf(stdout," -- %u TSO trains \n",m_tso_trains);
+    }
+}
+
+
+/* a packet that can be in a packet train, the per packet NAT/plugin state is kept */
+static bool is_train_pkt(CFlowPktInfo * lp){
+    CPacketIndication * pi=&lp->m_pkt_indication;
+    return ( pi->m_desc.IsPcapTiming() &&
+             (!pi->m_desc.IsPluginEnable()) &&
+             (!pi->m_desc.IsLearn()) );
+}
+
+/* number of packets of one send, a TSO train is sent as one */
+static int get_train_step(CFlowPktInfo * lp){
+    return ( lp->is_tso_head()?lp->m_tso_segs:1 );
+}
+
+void CCapFileFlowInfo::update_trains(dsec_t gap){
+    int i=0;
+    while ( i < (int)Size() ) {
+        CFlowPktInfo * head=GetPacket((uint32_t)i);
+        int n=get_train_step(head);
+        uint16_t sends=1;
+        dsec_t span=0.0;
+        if ( is_train_pkt(head) ) {
+            while ( (i+n) < (int)Size() ) {
+                CFlowPktInfo * prev=GetPacket((uint32_t)(i+n-1));
+                CFlowPktInfo * lp=GetPacket((uint32_t)(i+n));
+                int step=get_train_step(lp);
+                if ( (n+step) > TRAIN_MAX_PKTS ) {
+                    break;
+                }
+                /* the whole train, first to last packet, is inside the gap.
+                   same side goes to the same interface */
+                span += prev->m_pkt_indication.m_cap_ipg;
+                if ( (!is_train_pkt(lp)) ||
+                     (span > gap) ||
+                     (lp->m_pkt_indication.m_desc.IsInitSide() != head->m_pkt_indication.m_desc.IsInitSide()) ) {
+                    break;
+                }
+                n+=step;
+                sends++;
+            }
+        }
+        if ( sends > 1 ) {
+            head->m_train_len = sends;
+            m_trains++;
+        }
+        i+=n;
+    }
+    if ( m_trains ) {
+        fprintf(stdout," -- %u packet trains \n",m_trains);
+    }
+}
+
+
 int CCapFileFlowInfo::load_cap_file(std::string cap_file,uint16_t _id,uint8_t plugin_id){
     RemoveAll();
 
@@ -2132,6 +2351,30 @@ int CCapFileFlowInfo::load_cap_file(std::string cap_file,uint16_t _id,uint8_t pl
     }
 
 
+    update_pkts_ipg();
+    m_total_errors += parser.m_counter.getTotalErrors();
+
+
+    /* dump the flow */
+    //Dump(stdout);
+
+    //flow.Dump(stdout);
+    flow.Delete();
+    //parser.Dump(stdout);
+    parser.Delete();
+    //fprintf(stdout," -- finish loading cap file \n");
+    //fprintf(stdout,"\n");
+    delete lp;
+    if ( m_total_errors > 0 ) {
+        parser.m_counter.Dump(stdout);
+        printf(" ERORR in one of the cap file, you should have one flow per cap file, valid plugin or split_flows \n");
+        return(-1);
+    }
+    return (0);
+}
+
+/* m_cap_ipg has the time of the packet, set it to the time to the next one */
+void CCapFileFlowInfo::update_pkts_ipg(){
     /* set the last */
     CFlowPktInfo * last_pkt =GetPacket((uint32_t)(Size()-1));
     last_pkt->m_pkt_indication.m_desc.SetIsLastPkt(true);
@@ -2154,27 +2397,242 @@ int CCapFileFlowInfo::load_cap_file(std::string cap_file,uint16_t _id,uint8_t pl
     }
 
     GetPacket((uint32_t)Size()-1)->m_pkt_indication.m_cap_ipg=0.0;
-    m_total_errors += parser.m_counter.getTotalErrors();
+}
 
 
-    /* dump the flow */
-    //Dump(stdout);
+int CCapFileFlowInfo::load_cap_file_flows(std::string cap_file,uint16_t _id){
+    RemoveAll();
+
+    fprintf(stdout," -- loading cap file %s, split to flows \n",cap_file.c_str());
+    CPacketParser parser;
+    CPacketIndication pkt_indication;
+    CCapReaderBase * lp=CCapReaderFactory::CreateReader((char *)cap_file.c_str(),0);
+
+    if (lp == 0) {
+        printf(" ERROR file %s does not exist or not supported \n",(char *)cap_file.c_str());
+        return (-1);
+    }
+
+    CFlowTableMap flow;
+
+    parser.Create();
+    flow.Create(0);
+
+    bool time_was_set=false;
+    double first_time=0.0;
+    double last_time=0.0;
+    CCapPktRaw raw_packet;
+    int cnt=0;
+    while ( true ) {
+        if ( lp->ReadPacket(&raw_packet) ==false ){
+            break;
+        }
+        cnt++;
+
+        if ( !time_was_set ){
+            first_time=raw_packet.get_time();
+            last_time=first_time;
+            time_was_set=true;
+        }else{
+            if (raw_packet.get_time()<last_time) {
+                printf(" ERROR not valid pcap file,timestamp is negative at packet %d \n",cnt);
+                exit(-1);        
+            }
+            last_time=raw_packet.get_time();
+        }
+
+        if ( !parser.ProcessPacket(&pkt_indication, &raw_packet) ||
+             !pkt_indication.m_desc.IsValidPkt() ){
+            printf("ERROR packet %d is not supported, should be IP(0x0800)/TCP/UDP format try to convert it using Wireshark !\n",cnt);
+            exit(-1);
+        }
+
+        pkt_indication.m_desc.SetId(_id);
+        bool is_fif;
+        CFlow * lpflow=flow.process(pkt_indication.m_flow_key,is_fif);
+        CCapFileFlowInfo * lpfi;
+        if ( is_fif ) {
+            /* a new flow, its template starts at the offset of this packet */
+            lpflow->flow_id     = (uint32_t)m_family.size();
+            lpflow->is_fif_swap = pkt_indication.m_desc.IsSwapTuple();
+            lpfi = new CCapFileFlowInfo();
+            lpfi->Create();
+            lpfi->m_total_flows = 1;
+            m_family.push_back(lpfi);
+            m_family_start.push_back(raw_packet.get_time()-first_time);
+        }else{
+            lpfi = m_family[lpflow->flow_id];
+        }
+
+        /* check that we don't have reserve TTL for duplication  */
+        uint8_t ttl = pkt_indication.getTTL();
+        if ( (ttl == TTL_RESERVE_DUPLICATE) || 
+             (ttl == (TTL_RESERVE_DUPLICATE-1)) ) {
+                pkt_indication.setTTL(TTL_RESERVE_DUPLICATE-4);
+        }
+
+        pkt_indication.m_cap_ipg = raw_packet.get_time();
+        pkt_indication.m_flow    = lpflow;
+        pkt_indication.m_desc.SetFlowId(0);
+        pkt_indication.m_desc.SetFlowPktNum(lpflow->pkt_id);
+        lpflow->pkt_id++;
+        pkt_indication.m_desc.SetInitSide( ((lpflow->is_fif_swap?true:false) == 
+                                             pkt_indication.m_desc.IsSwapTuple())?true:false );
+
+        /* the template of the flow points to the copy in the store */
+        CCapPktRaw * pkt=pkt_indication.m_packet;
+        CCapPktRaw shared_pkt((int)0);
+        shared_pkt.raw       = m_store.add(pkt->raw,pkt->pkt_len);
+        shared_pkt.pkt_len   = pkt->pkt_len;
+        shared_pkt.time_sec  = pkt->time_sec;
+        shared_pkt.time_nsec = pkt->time_nsec;
+        shared_pkt.pkt_cnt   = lpfi->Size()+1; /* index in the flow, see update_next_pkt_in_flow */
+        shared_pkt.setDoNotFree(true);
+
+        CPacketIndication shared_ind;
+        shared_ind.Clone(&pkt_indication,&shared_pkt);
+        lpfi->Append(&shared_ind,true);
+        lpfi->m_total_bytes += pkt->pkt_len;
+        m_total_bytes       += pkt->pkt_len;
+        m_total_pkts++;
+    }
+
+    int i;
+    for (i=0; i<(int)m_family.size(); i++) {
+        m_family[i]->update_pkts_ipg();
+    }
+    m_total_flows   = m_family.size();
+    m_total_errors += parser.m_counter.getTotalErrors();
 
-    //flow.Dump(stdout);
     flow.Delete();
-    //parser.Dump(stdout);
     parser.Delete();
-    //fprintf(stdout," -- finish loading cap file \n");
-    //fprintf(stdout,"\n");
     delete lp;
     if ( m_total_errors > 0 ) {
         parser.m_counter.Dump(stdout);
-        printf(" ERORR in one of the cap file, you should have one flow per cap file or valid plugin \n");
+        printf(" ERORR in cap file %s \n",cap_file.c_str());
         return(-1);
     }
+    if ( m_total_flows == 0 ) {
+        printf(" ERORR no flows in cap file %s \n",cap_file.c_str());
+        return(-1);
+    }
+    printf(" -- %llu flows, %llu packets, %llu bytes in store \n",(unsigned long long)m_total_flows,
+           (unsigned long long)m_total_pkts,(unsigned long long)m_store.get_total_bytes());
     return (0);
 }
 
+
+char * CCapPktStore::add(char * pkt,uint16_t len){
+    uint32_t size=(uint32_t)my_utl_align_up(len,ALIGN);
+    if ( size > m_left ) {
+        char * block=(char *)malloc(BLOCK_SIZE+ALIGN);
+        assert(block);
+        m_blocks.push_back(block);
+        m_cur  = (char *)my_utl_align_up((uintptr_t)block,ALIGN);
+        m_left = BLOCK_SIZE;
+    }
+    char * p=m_cur;
+    memcpy(p,pkt,len);
+    m_cur  += size;
+    m_left -= size;
+    m_total_bytes += len;
+    return (p);
+}
+
+CConstMbufStore::CConstMbufStore(){
+    pthread_mutex_init(&m_lock,NULL);
+    m_total_bytes=0;
+    m_saved_bytes=0;
+    m_shared_pkts=0;
+}
+
+CConstMbufStore::~CConstMbufStore(){
+    pthread_mutex_destroy(&m_lock);
+}
+
+/* FNV-1a of the length and the bytes */
+uint64_t CConstMbufStore::hash(const char * p,uint16_t len){
+    uint64_t h=0xcbf29ce484222325ULL;
+    h = (h ^ len) * 0x100000001b3ULL;
+    int i;
+    for (i=0; i<len; i++) {
+        h = (h ^ (uint8_t)p[i]) * 0x100000001b3ULL;
+    }
+    return (h);
+}
+
+rte_mbuf_t * CConstMbufStore::get(socket_id_t socket,const char * p,uint16_t len){
+    uint64_t h=hash(p,len);
+    pthread_mutex_lock(&m_lock);
+    std::vector<entry_t> & list=m_map[socket][h];
+    int i;
+    for (i=0; i<(int)list.size(); i++) {
+        rte_mbuf_t * m=list[i].m_mbuf;
+        if ( (m->data_len == len) && (memcmp(rte_pktmbuf_mtod(m, char*),p,len)==0) ) {
+            rte_mbuf_refcnt_update(m,1);
+            list[i].m_uses++;
+            m_saved_bytes+=len;
+            m_shared_pkts++;
+            pthread_mutex_unlock(&m_lock);
+            return (m);
+        }
+    }
+    rte_mbuf_t * m = CGlobalInfo::pktmbuf_alloc(socket,len);
+    if ( m ) {
+        char *d=rte_pktmbuf_append(m, len);
+        rte_memcpy(d,p,len);
+        entry_t e;
+        e.m_mbuf=m;
+        e.m_uses=1;
+        list.push_back(e);
+        m_total_bytes+=len;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return (m);
+}
+
+void CConstMbufStore::put(socket_id_t socket,rte_mbuf_t * m){
+    uint16_t len=m->data_len;
+    uint64_t h=hash(rte_pktmbuf_mtod(m, char*),len);
+    pthread_mutex_lock(&m_lock);
+    store_map_t::iterator it=m_map[socket].find(h);
+    assert(it!=m_map[socket].end());
+    std::vector<entry_t> & list=it->second;
+    int i;
+    for (i=0; i<(int)list.size(); i++) {
+        if ( list[i].m_mbuf == m ) {
+            break;
+        }
+    }
+    assert(i<(int)list.size());
+    if ( --list[i].m_uses == 0 ) {
+        m_total_bytes-=len;
+        list.erase(list.begin()+i);
+        if ( list.size()==0 ) {
+            m_map[socket].erase(it);
+        }
+    }else{
+        m_saved_bytes-=len;
+        m_shared_pkts--;
+    }
+    pthread_mutex_unlock(&m_lock);
+    /* the DP may still hold it */
+    rte_pktmbuf_free(m);
+}
+
+
+void CCapPktStore::Delete(){
+    int i;
+    for (i=0; i<(int)m_blocks.size(); i++) {
+        free(m_blocks[i]);
+    }
+    m_blocks.clear();
+    m_cur=0;
+    m_left=0;
+    m_total_bytes=0;
+}
+
+
 void CCapFileFlowInfo::update_pcap_mode(){
     int i;
     for (i=0; i<(int)Size(); i++) {
@@ -2186,11 +2644,22 @@ void CCapFileFlowInfo::update_pcap_mode(){
 void CCapFileFlowInfo::get_total_memory(CCCapFileMemoryUsage & memory){
     memory.clear();
     int i;
+    if ( is_family() ) {
+        for (i=0; i<(int)m_family.size(); i++) {
+            CCCapFileMemoryUsage flow_memory;
+            m_family[i]->get_total_memory(flow_memory);
+            memory.Add(flow_memory);
+        }
+        return;
+    }
     for (i=0; i<(int)Size(); i++) {
         CFlowPktInfo * lp=GetPacket((uint32_t)i);
         if ( lp->m_packet->pkt_len > FIRST_PKT_SIZE ) {
             memory.add_size(lp->m_packet->pkt_len - FIRST_PKT_SIZE);
         }
+        if ( lp->m_tso_segs == 1 ) {
+            memory.add_size(lp->m_pkt_indication.m_payload_len);
+        }
     }
 }
 
@@ -2198,6 +2667,16 @@ void CCapFileFlowInfo::get_total_memory(CCCapFileMemoryUsage & memory){
 double CCapFileFlowInfo::get_cap_file_length_sec(){
     dsec_t sum=0.0;
     int i;
+    if ( is_family() ) {
+        /* the last flow to end */
+        for (i=0; i<(int)m_family.size(); i++) {
+            dsec_t end=m_family_start[i]+m_family[i]->get_cap_file_length_sec();
+            if ( end > sum ) {
+                sum=end;
+            }
+        }
+        return (sum);
+    }
     for (i=0; i<(int)Size(); i++) {
         CFlowPktInfo * lp=GetPacket((uint32_t)i);
         sum+=lp->m_pkt_indication.m_cap_ipg;
@@ -2226,6 +2705,11 @@ void CCapFileFlowInfo::Dump(FILE *fd){
 
 
     int i;
+    for (i=0; i<(int)m_family.size(); i++) {
+        fprintf(fd,"flow : %d start : %f \n",i,m_family_start[i]);
+        fprintf(fd,"===========\n");
+        m_family[i]->Dump(fd);
+    }
     //CCapPacket::DumpHeader(fd);
     for (i=0; i<(int)Size(); i++) {
         fprintf(fd,"pkt_id : %d \n",i+1);
@@ -2236,11 +2720,11 @@ void CCapFileFlowInfo::Dump(FILE *fd){
 }
 
 // add pkt indication
-void CCapFileFlowInfo::Append(CPacketIndication * pkt_indication){
+void CCapFileFlowInfo::Append(CPacketIndication * pkt_indication,bool is_ref){
 
     CFlowPktInfo * lp;
     lp = new CFlowPktInfo();
-    lp->Create( pkt_indication );
+    lp->Create( pkt_indication,is_ref );
     m_flow_pkts.push_back(lp);
 }
 
@@ -2252,22 +2736,24 @@ void CCCapFileMemoryUsage::Add(const CCCapFileMemoryUsage & obj){
         m_buf[i] += obj.m_buf[i];
     }
     m_total_bytes +=obj.m_total_bytes;
-
+    m_saved_bytes +=obj.m_saved_bytes;
+    m_shared_pkts +=obj.m_shared_pkts;
 }
 
 
 void CCCapFileMemoryUsage::dump(FILE *fd){
     fprintf(fd, " Memory usage \n");
     int i;
-    int c_size=CCCapFileMemoryUsage::SIZE_MIN;
     int c_total=0;
 
     for (i=0; i<CCCapFileMemoryUsage::MASK_SIZE; i++) {
+        int c_size=get_size(i);
         fprintf(fd," size_%-7d   : %lu \n",c_size,m_buf[i]);
         c_total +=m_buf[i]*c_size;
-        c_size = c_size*2;
     }
     fprintf(fd," Total    : %s  %.0f%% util due to buckets \n",double_to_human_str(c_total,"bytes",KBYE_1024).c_str(),100.0*float(c_total)/float(m_total_bytes) );
+    fprintf(fd," Shared   : %llu const payloads, %s saved \n",(unsigned long long)m_shared_pkts,
+            double_to_human_str((double)m_saved_bytes,"bytes",KBYE_1024).c_str());
 }
 
 
@@ -2275,12 +2761,18 @@ bool CCapFileFlowInfo::Create(){
     m_total_bytes=0;
     m_total_errors = 0;
     m_total_flows  = 0;
+    m_tso_trains   = 0;
+    m_trains       = 0;
+    m_total_pkts   = 0;
     return (true);
 }
 
 
 void CCapFileFlowInfo::dump_pkt_sizes(void){
     int i;
+    for (i=0; i<(int)m_family.size(); i++) {
+        m_family[i]->dump_pkt_sizes();
+    }
     for (i=0; i<(int)Size(); i++) {
         flow_pkt_info_t lp=GetPacket((uint32_t)i);
         CGenNode node;
@@ -2298,6 +2790,7 @@ void CCapFileFlowInfo::RemoveAll(){
     m_total_bytes=0;
     m_total_errors = 0;
     m_total_flows  = 0;
+    m_total_pkts   = 0;
     for (i=0; i<(int)Size(); i++) {
         flow_pkt_info_t lp=GetPacket((uint32_t)i);
         lp->Delete();
@@ -2305,6 +2798,15 @@ void CCapFileFlowInfo::RemoveAll(){
     }
     // free all the pointers 
     m_flow_pkts.clear();
+
+    /* the flows point to the store */
+    for (i=0; i<(int)m_family.size(); i++) {
+        m_family[i]->Delete();
+        delete m_family[i];
+    }
+    m_family.clear();
+    m_family_start.clear();
+    m_store.Delete();
 }
 
 void CCapFileFlowInfo::Delete(){
@@ -2368,6 +2870,31 @@ void operator >> (const YAML::Node& node, CVlanYamlInfo & fi) {
 
 
 
+void operator >> (const YAML::Node& node, CLatencyStreamYamlInfo & fi) {
+    uint32_t tmp;
+    try {
+      node["rate"] >> fi.m_rate;
+    }catch ( const std::exception& e ) {
+    }
+    try {
+      node["size"] >> tmp;
+      fi.m_size = tmp;
+    }catch ( const std::exception& e ) {
+    }
+    try {
+      node["dscp"] >> tmp;
+      fi.m_dscp = tmp & 0x3f;
+    }catch ( const std::exception& e ) {
+    }
+    try {
+      node["vlan"] >> tmp;
+      fi.m_vlan = tmp & 0xfff;
+    }catch ( const std::exception& e ) {
+    }
+}
+
+
+
 void operator >> (const YAML::Node& node, CFlowYamlInfo & fi) {
    node["name"] >> fi.m_name;
    node["cps"] >>  fi.m_k_cps;
@@ -2431,6 +2958,17 @@ void operator >> (const YAML::Node& node, CFlowYamlInfo & fi) {
        exit(-1);
    }
 
+   try {
+       node["split_flows"] >> fi.m_split_flows;
+   } catch ( const std::exception& e ) {
+       fi.m_split_flows = false;
+   }
+
+   if ( ( fi.m_split_flows ) && (fi.m_plugin_id !=0) ){
+       fprintf(stderr," split_flows can't be set when plugin is set, you must have only one of the options set");
+       exit(-1);
+   }
+
 
    try {
        int i;
@@ -2545,6 +3083,15 @@ void operator >> (const YAML::Node& node, CFlowsYamlInfo & flows_info) {
        flows_info.m_cap_overide_ipg = 0;
    }
 
+   try {
+       node["cap_train_gap"] >> t;
+       flows_info.m_cap_train_gap = t/1000000.0;
+       flows_info.m_cap_train_gap_set = true;
+   } catch ( const std::exception& e ) {
+       flows_info.m_cap_train_gap_set = false;
+       flows_info.m_cap_train_gap = 0;
+   }
+
    try {
        node["wlength"] >> flows_info.m_wlength;
        flows_info.m_wlength_set=true;
@@ -2572,6 +3119,20 @@ void operator >> (const YAML::Node& node, CFlowsYamlInfo & flows_info) {
      flows_info.m_mac_replace_by_ip =false;
    }
 
+   try {
+     const YAML::Node& lat_info = node["latency_streams"];
+     for(unsigned i=0;i<lat_info.size();i++) {
+         if ( flows_info.m_latency_streams.size() == MAX_LATENCY_STREAMS ) {
+             printf(" WARNING only %d latency streams are supported \n",MAX_LATENCY_STREAMS);
+             break;
+         }
+         CLatencyStreamYamlInfo fi;
+         lat_info[i] >> fi;
+         flows_info.m_latency_streams.push_back(fi);
+     }
+   } catch ( const std::exception& e ) {
+   }
+
 
    const YAML::Node& mac_info = node["mac"];
    for(unsigned i=0;i<mac_info.size();i++) {
@@ -2589,6 +3150,10 @@ void operator >> (const YAML::Node& node, CFlowsYamlInfo & flows_info) {
    }
 }
 
+void CLatencyStreamYamlInfo::Dump(FILE *fd){
+    fprintf(fd," latency stream rate : %.1f size : %d dscp : %d vlan : %d \n",m_rate,m_size,m_dscp,m_vlan);
+}
+
 void CVlanYamlInfo::Dump(FILE *fd){
     fprintf(fd," vlan enable : %d  \n",m_enable);
     fprintf(fd," vlan val    : %d ,%d \n",m_vlan_per_port[0],m_vlan_per_port[1]);
@@ -2631,6 +3196,12 @@ void CFlowsYamlInfo::Dump(FILE *fd){
         fprintf(fd," cap_override_ipg  : %f \n",m_cap_overide_ipg);
     }
 
+    if ( !m_cap_train_gap_set ){
+        fprintf(fd," cap_train_gap  : wasn't set  \n");
+    }else{
+        fprintf(fd," cap_train_gap     : %f \n",m_cap_train_gap);
+    }
+
     if ( !m_wlength_set ){
         fprintf(fd," wlength      : wasn't set  \n");
     }else{
@@ -2640,9 +3211,13 @@ void CFlowsYamlInfo::Dump(FILE *fd){
     fprintf(fd," one_server_for_application_was_set : %d  \n",m_one_app_server_was_set?1:0);
 
     m_vlan_info.Dump(fd);
+    int i;
+    for (i=0; i<(int)m_latency_streams.size(); i++) {
+        fprintf(fd," %d :",i);
+        m_latency_streams[i].Dump(fd);
+    }
 
     fprintf(fd," mac base   : ");
-    int i;
     for (i=0; i<(int)m_mac_base.size(); i++) {
         if (i< (int)(m_mac_base.size()-1) ) {
             fprintf(fd,"0x%02x,",m_mac_base[i]);
@@ -2862,7 +3437,7 @@ void CFlowGeneratorRecPerThread::Dump(FILE *fd){
 
 void CFlowGeneratorRecPerThread::getFlowStats(CFlowStats * stats){
 
-    double t_pkt=(double)m_flow_info->Size();
+    double t_pkt=(double)m_flow_info->get_total_pkts();
     double t_bytes=(double)m_flow_info->get_total_bytes();
     double cps=m_info->m_k_cps *1000.0;
     double mb_sec   = (cps*t_bytes*8.0)/(_1Mb_DOUBLE);
@@ -2912,7 +3487,7 @@ void CFlowGeneratorRec::Dump(FILE *fd){
 
 void CFlowGeneratorRec::getFlowStats(CFlowStats * stats){
 
-    double t_pkt=(double)m_flow_info.Size();
+    double t_pkt=(double)m_flow_info.get_total_pkts();
     double t_bytes=(double)m_flow_info.get_total_bytes();
     double cps=m_info->m_k_cps *1000.0;
     double mb_sec   = (cps*t_bytes*8.0)/(_1Mb_DOUBLE);
@@ -2952,24 +3527,25 @@ void CFlowGeneratorRec::getFlowStats(CFlowStats * stats){
 }
 
 
-void CFlowGeneratorRec::fixup_ipg_if_needed(void){
+void CFlowGeneratorRec::fixup_ipg_if_needed(CCapFileFlowInfo * flow_info){
     if  ( m_flows_info->m_cap_mode ) {
-        m_flow_info.update_pcap_mode();
+        flow_info->update_pcap_mode();
     }
 
     if ( (m_flows_info->m_cap_mode) && 
          (m_flows_info->m_cap_ipg_min_set) &&
          (m_flows_info->m_cap_overide_ipg_set) 
          ){
-        m_flow_info.update_min_ipg(m_flows_info->m_cap_ipg_min,
-                                   m_flows_info->m_cap_overide_ipg);
+        flow_info->update_min_ipg(m_flows_info->m_cap_ipg_min,
+                                  m_flows_info->m_cap_overide_ipg);
     }
 }
 
 
 bool CFlowGeneratorRec::Create(CFlowYamlInfo * info,
                                CFlowsYamlInfo * flows_info,
-                               uint16_t _id){
+                               uint16_t _id,
+                               CTemplateCache * cache){
     BP_ASSERT(info);
     m_id=_id;
     m_info=info;
@@ -2981,17 +3557,37 @@ bool CFlowGeneratorRec::Create(CFlowYamlInfo * info,
     m_policer.set_level(0.0);
     m_policer.set_bucket_size(100.0);
 
-    int res=m_flow_info.load_cap_file(info->m_name.c_str(),_id,m_info->m_plugin_id);
+    if ( cache ) {
+        /* already processed */
+        return (cache->load(&m_flow_info));
+    }
+
+    int res;
+    if ( m_info->m_split_flows ) {
+        res=m_flow_info.load_cap_file_flows(info->m_name.c_str(),_id);
+    }else{
+        res=m_flow_info.load_cap_file(info->m_name.c_str(),_id,m_info->m_plugin_id);
+    }
     if ( res==0 ) {
-        fixup_ipg_if_needed();
-        std::string  err;
-        /* verify that template are valid */
-        bool is_valid=m_flow_info.is_valid_template_load_time(err);
-        if (!is_valid) {
-            printf("\n ERROR template file is not valid  '%s' \n",err.c_str());
-            return (false);
+        uint32_t i;
+        for (i=0; i<m_flow_info.get_family_size(); i++) {
+            CCapFileFlowInfo * flow_info=m_flow_info.get_family_flow(i);
+            fixup_ipg_if_needed(flow_info);
+            std::string  err;
+            /* verify that template are valid */
+            bool is_valid=flow_info->is_valid_template_load_time(err);
+            if (!is_valid) {
+                printf("\n ERROR template file is not valid  '%s' \n",err.c_str());
+                return (false);
+            }
+            flow_info->update_info(); 
+            if ( CGlobalInfo::m_options.preview.get_tso_enable() ) {
+                flow_info->update_tso();
+            }
+            if ( m_flows_info->m_cap_train_gap_set ) {
+                flow_info->update_trains(m_flows_info->m_cap_train_gap);
+            }
         }
-        m_flow_info.update_info(); 
         return (true);
     }else{
         return (false);
@@ -3035,12 +3631,29 @@ bool  CNodeGenerator::Create(CFlowGenListPerThread  *  parent){
    m_parent=parent;
    m_socket_id =0;
    m_is_realtime =CGlobalInfo::is_realtime();
-   m_realtime_his.Create();
+   m_realtime_his.Create(LATENESS_DIGITS);
+   m_late_cnt=0;
+   m_late_offset=0.0;
+   m_is_precise = m_is_realtime && CGlobalInfo::m_options.preview.get_precise_pacing_enable();
+   m_ipg_err_his.Create(LATENESS_DIGITS);
+   m_last_tx_tick=0;
+   m_last_tx_time=0.0;
+   m_idle.Create(m_is_realtime && CGlobalInfo::m_options.preview.get_low_power_idle_enable());
+   m_is_tx_bp = m_is_realtime && CGlobalInfo::m_options.preview.get_tx_backpressure_enable();
+   m_tx_bp_cnt=0;
+   m_tx_bp_offset=0.0;
+   m_json_hist=0;
    return(true);
 }
 
 void  CNodeGenerator::Delete(){
     m_realtime_his.Delete();
+    m_ipg_err_his.Delete();
+    m_idle.Delete();
+    if ( m_json_hist ) {
+        delete m_json_hist;
+        m_json_hist=0;
+    }
 }
 
 
@@ -3082,7 +3695,27 @@ int CNodeGenerator::flush_one_node_to_file(CGenNode * node){
     return (m_v_if->send_node(node));
 }
 
-int CNodeGenerator::update_stats(CGenNode * node){
+/* the rest of a packet train in the same event, the node is left on the last
+   packet of the train. the train goes out in one burst so all its packets are
+   stamped with the time of the head, this keeps the output in time order */
+inline void CNodeGenerator::flush_train(CGenNode * node){
+    uint16_t sends=node->m_pkt_info->m_train_len;
+    dsec_t head_time=node->m_time;
+    dsec_t pkt_time;
+    uint16_t i;
+    for (i=1; i<sends; i++) {
+        node->update_next_pkt_in_flow();
+        pkt_time=node->m_time;
+        node->m_time=head_time;
+        flush_one_node_to_file(node);
+        #ifdef _DEBUG
+        update_stats(node);
+        #endif
+        node->m_time=pkt_time;
+    }
+}
+
+int CNodeGenerator::update_stats(CGenNode * node){
     if ( m_preview_mode.getVMode() >2 ){
         fprintf(stdout," %llu ,",m_cnt);
         node->Dump(stdout);
@@ -3102,6 +3735,7 @@ bool CFlowGenListPerThread::Create(uint32_t           thread_id,
     m_core_id= core_id;
     m_tcp_dpc= 0;
     m_udp_dpc=0;
+    m_replay=0;
     m_max_threads=max_threads;
     m_thread_id=thread_id;
 
@@ -3122,6 +3756,7 @@ bool CFlowGenListPerThread::Create(uint32_t           thread_id,
     printf(" pool %p \n",m_node_pool);
     m_node_gen.Create(this);
     m_flow_id_to_node_lookup.Create();
+    publish_stats();
 
     /* split the clients to threads */
     CTupleGenYamlInfo * tuple_gen = &m_flow_list->m_yaml_info.m_tuple_gen;
@@ -3291,6 +3926,7 @@ void CFlowGenListPerThread::Delete(){
 
     m_smart_gen.Delete(); 
     m_node_gen.Delete();
+    stop_replay();
     Clean();
     m_cpu_cp_u.Delete();
 }
@@ -3309,13 +3945,155 @@ void CFlowGenListPerThread::Clean(){
 
 //uint64_t _start_time;
 
-void CNodeGenerator::dump_json(std::string & json){
+void CDpStatsSnapshot::Clear(){
+    m_stats.clear();
+    m_if_stats[CLIENT_SIDE].Clear();
+    m_if_stats[SERVER_SIDE].Clear();
+    m_late_cnt=0;
+    m_late_offset=0.0;
+    m_tpause_cnt=0;
+    m_sleep_cnt=0;
+    m_tx_bp_cnt=0;
+    m_tx_bp_offset=0.0;
+    m_cycle_stats.Clear();
+}
+
+void CDpHistSnapshot::dump_json(std::string & json){
 
     json="{\"name\":\"tx-gen\",\"type\":0,\"data\":{";
     m_realtime_his.dump_json("realtime-hist",json);
     json+="\"unknown\":0}}" ;
 }
 
+void CDpStatsSnapshot::dump_lateness_json(int core,CDpHistSnapshot & hist,std::string & json){
+    char buff[200];
+    sprintf(buff,"\"core-%d\":{",core);
+    json+=std::string(buff);
+    hist.m_realtime_his.dump_json("realtime-hist",json);
+    json+=add_json("max_usec",hist.m_realtime_his.get_max_latency());
+    json+=add_json("p99_9_usec",hist.m_realtime_his.get_percentile_usec(99.9));
+    json+=add_json("late_cnt",m_late_cnt);
+    json+=add_json("late_offset_usec",m_late_offset*1000000.0);
+    if ( CGlobalInfo::m_options.preview.get_precise_pacing_enable() ) {
+        hist.m_ipg_err_his.dump_json("ipg-err-hist",json);
+    }
+    if ( CGlobalInfo::m_options.preview.get_low_power_idle_enable() ) {
+        hist.m_wake_his.dump_json("wake-hist",json);
+        json+=add_json("tpause_cnt",m_tpause_cnt);
+        json+=add_json("sleep_cnt",m_sleep_cnt);
+    }
+    if ( CGlobalInfo::m_options.preview.get_tx_backpressure_enable() ) {
+        json+=add_json("tx_bp_cnt",m_tx_bp_cnt);
+        json+=add_json("tx_bp_offset_usec",m_tx_bp_offset*1000000.0);
+        json+=add_json("tx_delay",m_if_stats[CLIENT_SIDE].m_tx_delay+
+                                  m_if_stats[SERVER_SIDE].m_tx_delay);
+    }
+    json+=add_json("tx_queue_full",m_if_stats[CLIENT_SIDE].m_tx_queue_full+
+                                   m_if_stats[SERVER_SIDE].m_tx_queue_full,true);
+    json+="},";
+}
+
+void CDpStatsSnapshot::DumpLateness(int core,CDpHistSnapshot & hist,FILE *fd){
+    fprintf(fd," %4d  %10.0f  %10.0f  %10llu  %14.0f  %10llu \n",
+            core,
+            hist.m_realtime_his.get_max_latency(),
+            hist.m_realtime_his.get_percentile_usec(99.9),
+            (unsigned long long)m_late_cnt,
+            m_late_offset*1000000.0,
+            (unsigned long long)(m_if_stats[CLIENT_SIDE].m_tx_queue_full+
+                                 m_if_stats[SERVER_SIDE].m_tx_queue_full));
+}
+
+void CFlowGenListPerThread::publish_stats(void){
+    CDpStatsSnapshot & snap=m_stats_snapshot.write_begin();
+    snap.m_stats = m_stats;
+    CVirtualIF * v_if=m_node_gen.m_v_if;
+    if ( v_if ) {
+        snap.m_if_stats[CLIENT_SIDE] = v_if->m_stats[CLIENT_SIDE];
+        snap.m_if_stats[SERVER_SIDE] = v_if->m_stats[SERVER_SIDE];
+    }else{
+        snap.m_if_stats[CLIENT_SIDE].Clear();
+        snap.m_if_stats[SERVER_SIDE].Clear();
+    }
+    snap.m_late_cnt     = m_node_gen.m_late_cnt;
+    snap.m_late_offset  = m_node_gen.m_late_offset;
+    if ( m_node_gen.m_idle.is_enable() ) {
+        snap.m_tpause_cnt = m_node_gen.m_idle.m_tpause_cnt;
+        snap.m_sleep_cnt  = m_node_gen.m_idle.m_sleep_cnt;
+    }
+    snap.m_tx_bp_cnt    = m_node_gen.m_tx_bp_cnt;
+    snap.m_tx_bp_offset = m_node_gen.m_tx_bp_offset;
+    snap.m_cycle_stats  = m_cycle_stats;
+    snap.m_cycle_stats.m_work_cycles = m_cpu_dp_u.get_work_cycles();
+    m_stats_snapshot.write_end();
+
+    /* the histograms only when the master asked, not each tick */
+    if ( m_hist_snapshot.is_requested() ) {
+        CDpHistSnapshot & hist=m_hist_snapshot.write_begin();
+        hist.m_realtime_his = m_node_gen.m_realtime_his;
+        if ( m_node_gen.m_is_precise ) {
+            hist.m_ipg_err_his = m_node_gen.m_ipg_err_his;
+        }
+        if ( m_node_gen.m_idle.is_enable() ) {
+            hist.m_wake_his = m_node_gen.m_idle.m_wake_his;
+        }
+        m_hist_snapshot.write_end();
+    }
+}
+
+void CFlowGenListPerThread::get_hist_snapshot(CDpHistSnapshot & hist){
+#ifndef RTE_DPDK
+    /* the simulator has no DP core running beside the reader, serve the request here */
+    m_hist_snapshot.request();
+    publish_stats();
+#endif
+    m_hist_snapshot.read(hist);
+}
+
+/* master side, read the snapshot and not the live histogram */
+void CNodeGenerator::dump_json(std::string & json){
+    if ( m_json_hist == 0 ) {
+        m_json_hist = new CDpHistSnapshot();
+    }
+    m_parent->get_hist_snapshot(*m_json_hist);
+    m_json_hist->dump_json(json);
+}
+
+
+/* wait for the TSC tick of n_time, return the lateness */
+inline dsec_t CNodeGenerator::wait_precise(dsec_t n_time,
+                                           CFlowGenListPerThread * thread){
+    hr_time_t target = start_time + ptime_convert_dsec_hr(n_time);
+    hr_time_t msg_limit = ptime_convert_dsec_hr(0.00003);
+    hr_time_t cur;
+    bool once=false;
+    while ( true ) {
+        cur = os_get_hr_tick_64();
+        int64_t d=(int64_t)(cur-target);
+        if ( d >= 0 ) {
+            return ( ptime_convert_hr_dsec((hr_time_t)d) );
+        }
+        if ( (!once) && ((hr_time_t)(-d) > msg_limit) ) {
+            /* check the msg queue once, only if there is time for it */
+            thread->check_msgs();
+            once=true;
+        }
+        rte_pause();
+    }
+}
+
+/* send the packet now and measure the gap from the previous one */
+inline void CNodeGenerator::flush_precise(dsec_t n_time){
+    m_v_if->flush_tx_queue();
+    hr_time_t cur=os_get_hr_tick_64();
+    if ( m_last_tx_tick ) {
+        dsec_t gap = ptime_convert_hr_dsec(cur - m_last_tx_tick);
+        dsec_t err = gap - (n_time - m_last_tx_time);
+        m_ipg_err_his.Add(err>0.0?err:-err);
+    }
+    m_last_tx_tick = cur;
+    m_last_tx_time = n_time;
+}
 
 int CNodeGenerator::flush_file(dsec_t max_time, 
                                dsec_t d_time,
@@ -3332,6 +4110,11 @@ int CNodeGenerator::flush_file(dsec_t max_time,
     uint32_t events=0;
     bool done=false;
 
+    /* the first packet of a run has no gap to measure */
+    m_last_tx_tick=0;
+    m_last_tx_time=0.0;
+
+    CDpCycleStats::set_cur(&thread->m_cycle_stats);
     thread->m_cpu_dp_u.start_work();
     while (!m_p_queue.empty()) {
         node = m_p_queue.top();
@@ -3354,30 +4137,58 @@ int CNodeGenerator::flush_file(dsec_t max_time,
             thread->m_cpu_dp_u.commit();
             bool once=false;
 
-            while ( true ) {
-                dt = now_sec() - n_time ;
+            if ( unlikely( m_is_precise ) ) {
+                dt = wait_precise(n_time,thread);
+            }else{
+                bool idled=false;
+                while ( true ) {
+                    dt = now_sec() - n_time ;
 
-                if (dt> (-0.00003)) {
-                    break;
-                }
+                    if (dt> (-0.00003)) {
+                        break;
+                    }
 
-                if (!once) {
-                    /* check the msg queue once */
-                    thread->check_msgs();
-                    once=true;
-                }
+                    if (!once) {
+                        /* check the msg queue once */
+                        thread->check_msgs();
+                        once=true;
+                        /* the time of the check */
+                        continue;
+                    }
 
-                rte_pause();
+                    /* spin on short gaps, sleep or tpause on long gaps */
+                    if ( m_idle.idle(-(dt+0.00003)) ) {
+                        idled=true;
+                    }
+                }
+                if ( unlikely( idled ) ) {
+                    m_idle.add_wake(dt);
+                }
             }
             thread->m_cpu_dp_u.start_work();
 
             /* add offset in case of faliures more than 100usec */
             if ( unlikely( dt > 0.000100 ) ) {
                 offset += dt;
+                m_late_cnt++;
+                m_late_offset += dt;
             }
-            /* update histogram */
-            if ( unlikely( events % 16 ) ==0 ) {
-                 m_realtime_his.Add(dt);
+            /* update histogram, every event so the tail is not lost */
+            m_realtime_his.Add(dt);
+
+            if ( unlikely( m_is_tx_bp ) ) {
+                if ( m_v_if->is_tx_backpressure() ) {
+                    /* the NIC did not take the last packets, wait for it and push the schedule.
+                       the wait is not lateness of the generator */
+                    dsec_t bp_start=now_sec();
+                    while ( m_v_if->is_tx_backpressure() ) {
+                        rte_pause();
+                    }
+                    dsec_t bp_time=now_sec()-bp_start;
+                    offset += bp_time;
+                    m_tx_bp_cnt++;
+                    m_tx_bp_offset += bp_time;
+                }
             }
             /* flush evey 10 usec */
             if ( now_sec() - flush_time > 0.00001 ){
@@ -3398,8 +4209,16 @@ int CNodeGenerator::flush_file(dsec_t max_time,
                 #ifdef _DEBUG
                 update_stats(node);
                 #endif
+                if ( unlikely( node->m_pkt_info->is_train_head() ) ) {
+                    flush_train(node);
+                }
+                if ( unlikely( m_is_precise ) ) {
+                    flush_precise(n_time);
+                }
             }
+            DP_CYCLE_START(t_pop);
             m_p_queue.pop();
+            DP_CYCLE_END(t_pop,cpSCHED_POP);
             if ( node->is_last_in_flow() ) {
                 if ((node->is_repeat_flow()) && (always==false)) {
                     /* Flow is repeated, reschedule it */
@@ -3410,7 +4229,9 @@ int CNodeGenerator::flush_file(dsec_t max_time,
                 }
             }else{
                 node->update_next_pkt_in_flow();
+                DP_CYCLE_START(t_push);
                 m_p_queue.push(node);
+                DP_CYCLE_END(t_push,cpSCHED_PUSH);
             }
         }else{
             if ((type == CGenNode::FLOW_FIF)) {
@@ -3433,7 +4254,9 @@ int CNodeGenerator::flush_file(dsec_t max_time,
                 }
 
             }else{
+                DP_CYCLE_START(t_msg);
                 handle_slow_messages(type,node,thread,always);
+                DP_CYCLE_END(t_msg,cpMSG);
             }
         }
     }
@@ -3445,6 +4268,8 @@ int CNodeGenerator::flush_file(dsec_t max_time,
         // free the left other
         thread->handler_defer_job_flush();
     }
+    /* last counters are visible to the master */
+    thread->publish_stats();
     return (0);
 }
 
@@ -3496,6 +4321,7 @@ void CNodeGenerator::handle_slow_messages(uint8_t type,
             if ( type == CGenNode::FLOW_SYNC ){
                 thread->check_msgs();      /* check messages */
                 m_v_if->flush_tx_queue(); /* flush pkt each timeout */
+                thread->publish_stats();   /* counters for the master */
                 m_p_queue.pop();
                 if ( always == false) {
                     node->m_time += SYNC_TIME_OUT;
@@ -3505,8 +4331,18 @@ void CNodeGenerator::handle_slow_messages(uint8_t type,
                 }
 
             }else{
-                printf(" ERROR type is not valid %d \n",type);
-                assert(0);
+                if ( type == CGenNode::FLOW_PCAP_REPLAY ){
+                    m_p_queue.pop();
+                    /* the node moves to the time of the next packet of the file */
+                    if ( (always == false) && thread->m_replay->send(m_v_if,node->m_time) ) {
+                        m_p_queue.push(node);
+                    }else{
+                        thread->free_node(node);
+                    }
+                }else{
+                    printf(" ERROR type is not valid %d \n",type);
+                    assert(0);
+                }
             }
         }
     }
@@ -3617,16 +4453,32 @@ int CFlowGenListPerThread::generate_flows_roundrobin(bool *done){
     }
 
     if (found) {
-        /* generate the flow into the generator*/
-        CGenNode * node= create_node() ;
+        if ( unlikely(cur->m_flow_info->is_family()) ) {
+            /* every flow of the cap file with its own tuple, at its offset */
+            CCapFileFlowInfo * family=cur->m_flow_info;
+            uint32_t j;
+            for (j=0; j<family->get_family_size(); j++) {
+                CGenNode * node= create_node() ;
+                family->get_family_flow(j)->generate_flow(&cur->tuple_gen,
+                                                          &m_node_gen,
+                                                          m_cur_time_sec+family->get_family_start(j),
+                                                          m_cur_flow_id,
+                                                          cur->m_info,
+                                                          node);
+                m_cur_flow_id++;
+            }
+        }else{
+            /* generate the flow into the generator*/
+            CGenNode * node= create_node() ;
 
-        cur->generate_flow(&m_node_gen,m_cur_time_sec,m_cur_flow_id,node);
-        m_cur_flow_id++;
+            cur->generate_flow(&m_node_gen,m_cur_time_sec,m_cur_flow_id,node);
+            m_cur_flow_id++;
+        }
 
         /* this is estimation */
         m_stats.m_total_open_flows += cur->m_flow_info->get_total_flows();
         m_stats.m_total_bytes += cur->m_flow_info->get_total_bytes();
-        m_stats.m_total_pkt   += cur->m_flow_info->Size();
+        m_stats.m_total_pkt   += cur->m_flow_info->get_total_pkts();
         inc_current_template();
     }
     return (0);
@@ -3713,6 +4565,7 @@ void CFlowGenListPerThread::check_msgs(void){
     if ( likely ( m_ring_from_rx->isEmpty() ) ){
         return;
     }
+    DP_CYCLE_START(t_msg);
     #ifdef  NAT_TRACE_
     printf(" %.03f got message from RX \n",now_sec());
     #endif
@@ -3742,6 +4595,42 @@ void CFlowGenListPerThread::check_msgs(void){
 
         CGlobalInfo::free_node(node);
     }
+    DP_CYCLE_END(t_msg,cpMSG);
+}
+
+
+bool CFlowGenListPerThread::start_replay(){
+    CParserOption * po=&CGlobalInfo::m_options;
+    /* the loader shares the master core, the DP cores are busy polling */
+    int loader_cpu = CGlobalInfo::is_realtime()?(int)CGlobalInfo::m_socket.get_master_phy_id():-1;
+    m_replay = new CPcapReplay();
+    if ( !m_replay->Create(po->replay_file,
+                           m_thread_id,
+                           m_max_threads,
+                           m_node_gen.m_socket_id,
+                           po->m_replay_rate,
+                           po->m_replay_loops,
+                           po->m_replay_ip_offset,
+                           CGlobalInfo::is_realtime()) ||
+         !m_replay->start(m_cur_time_sec,loader_cpu) ) {
+        stop_replay();
+        return (false);
+    }
+    CGenNode * node= create_node() ;
+    node->m_type = CGenNode::FLOW_PCAP_REPLAY;
+    node->m_time = m_cur_time_sec;
+    m_node_gen.add_node(node);
+    return (true);
+}
+
+
+void CFlowGenListPerThread::stop_replay(){
+    if ( m_replay ) {
+        m_replay->Delete();
+        m_replay->Dump(stdout);
+        delete m_replay;
+        m_replay=0;
+    }
 }
 
 
@@ -3766,11 +4655,20 @@ void CFlowGenListPerThread::generate_erf(std::string erf_file_name,
     m_stats.clear();
 
     fprintf(stdout," Generating erf file ...  \n");
-    CGenNode * node= create_node() ;
-    /* add periodic */
-    node->m_type = CGenNode::FLOW_FIF;
-    node->m_time = m_cur_time_sec;
-    m_node_gen.add_node(node);
+    CGenNode * node;
+    if ( CGlobalInfo::m_options.replay_file.size() ) {
+        /* the capture file instead of the templates */
+        if ( !start_replay() ) {
+            m_node_gen.close_file(this);
+            return;
+        }
+    }else{
+        node= create_node() ;
+        /* add periodic */
+        node->m_type = CGenNode::FLOW_FIF;
+        node->m_time = m_cur_time_sec;
+        m_node_gen.add_node(node);
+    }
 
     double old_offset=0.0;
 
@@ -3795,6 +4693,7 @@ void CFlowGenListPerThread::generate_erf(std::string erf_file_name,
         /* clean close */
         m_node_gen.flush_file(m_cur_time_sec, d_time_flow, true,this,old_offset);
     }
+    stop_replay();
 
     if (m_preview_mode.getVMode() > 1 ) {
         fprintf(stdout,"\n\n");
@@ -3840,6 +4739,7 @@ void CFlowGenList::clean_p_thread_info(void){
 void CFlowGenList::Delete(){
     clean_p_thread_info();
     Clean();
+    m_tmpl_cache.Delete();
 }
 
 int CFlowGenList::load_from_mac_file(std::string file_name) {
@@ -3865,10 +4765,75 @@ int CFlowGenList::load_from_mac_file(std::string file_name) {
 }
 
 
+/* templates of load_from_yaml, each worker takes the next one. the result is kept
+   in the slot of the template so the order does not depend on the workers */
+struct CTemplateLoadJob {
+    CFlowsYamlInfo *                 m_yaml;
+    std::vector<CFlowGeneratorRec *> m_recs;
+    std::vector<uint8_t>             m_res;
+    std::vector<dsec_t>              m_time;
+    volatile uint32_t                m_next;
+};
+
+static void template_load_worker(void * arg){
+    CTemplateLoadJob * job=(CTemplateLoadJob *)arg;
+    while ( true ) {
+        uint32_t i=__sync_fetch_and_add(&job->m_next,1);
+        if ( i >= job->m_recs.size() ) {
+            break;
+        }
+        dsec_t start=now_sec();
+        CFlowGeneratorRec * lp=new CFlowGeneratorRec();
+        job->m_res[i]  = lp->Create(&job->m_yaml->m_vec[i],job->m_yaml,i)?1:0;
+        job->m_recs[i] = lp;
+        job->m_time[i] = now_sec()-start;
+    }
+}
+
+struct pthread_job_t {
+    pthread_t   m_tid;
+    void     (* m_func)(void *);
+    void *      m_arg;
+};
+
+static void * pthread_job_thread(void * arg){
+    pthread_job_t * job=(pthread_job_t *)arg;
+    job->m_func(job->m_arg);
+    return (NULL);
+}
+
+void CPthreadJobRunner::run(void (*func)(void *),void * arg){
+    std::vector<pthread_job_t> jobs(m_workers-1);
+    int i;
+    for (i=0; i<(int)jobs.size(); i++) {
+        jobs[i].m_func = func;
+        jobs[i].m_arg  = arg;
+        assert(pthread_create(&jobs[i].m_tid,NULL,pthread_job_thread,&jobs[i])==0);
+    }
+    func(arg);
+    for (i=0; i<(int)jobs.size(); i++) {
+        assert(pthread_join(jobs[i].m_tid,NULL)==0);
+    }
+}
+
+void CFlowGenLoadTimes::Dump(FILE *fd){
+    fprintf(fd," -- startup : yaml        %.3f msec \n",m_yaml);
+    fprintf(fd," -- startup : templates   %.3f msec, %s %u workers, %.3f msec of work \n",
+            m_templates,m_from_cache?"from cache,":"",m_workers,m_templates_work);
+    if ( m_cache_save > 0.0 ) {
+        fprintf(fd," -- startup : cache save  %.3f msec \n",m_cache_save);
+    }
+    fprintf(fd," -- startup : total       %.3f msec \n",m_total);
+}
+
+
 int CFlowGenList::load_from_yaml(std::string file_name,
-                                 uint32_t num_threads){
+                                 uint32_t num_threads,
+                                 CParallelJobRunner * runner){
     is_mac_info_configured = false;
     uint8_t idx;
+    m_load_times.Clear();
+    dsec_t load_start=now_sec();
     m_yaml_info.load_from_yaml_file(file_name);
     if (m_yaml_info.verify_correctness(num_threads) ==false){
         exit(0);
@@ -3905,17 +4870,67 @@ int CFlowGenList::load_from_yaml(std::string file_name,
 
     int i=0;
     Clean();
-    bool all_template_has_one_direction=true;
+    m_tmpl_cache.Delete();
+    m_load_times.m_yaml = (now_sec()-load_start)*1000.0;
+
+    std::string cache_file = CGlobalInfo::m_options.template_cache_file;
+    CTemplateCache * cache=0;
+    uint64_t cache_hash=0;
+    dsec_t phase_start=now_sec();
     for (i=0; i<(int)m_yaml_info.m_vec.size(); i++) {
-        CFlowGeneratorRec * lp=new CFlowGeneratorRec();
-        if ( lp->Create(&m_yaml_info.m_vec[i],&m_yaml_info,i) == false){
+        if ( cache_file.size() && m_yaml_info.m_vec[i].m_split_flows ) {
+            printf(" -- template cache does not support split_flows templates, it is not used \n");
+            cache_file="";
+        }
+    }
+    if ( cache_file.size() ) {
+        cache_hash = CTemplateCache::calc_hash(file_name,&m_yaml_info);
+        if ( m_tmpl_cache.Open(cache_file,cache_hash) ) {
+            cache=&m_tmpl_cache;
+        }
+    }
+
+    CTemplateLoadJob job;
+    uint32_t num_templates=(uint32_t)m_yaml_info.m_vec.size();
+    job.m_yaml = &m_yaml_info;
+    job.m_recs.resize(num_templates,0);
+    job.m_res.resize(num_templates,0);
+    job.m_time.resize(num_templates,0.0);
+    job.m_next = 0;
+
+    if ( cache ) {
+        /* the cache is read in order, nothing to parse */
+        for (i=0; i<(int)num_templates; i++) {
+            CFlowGeneratorRec * lp=new CFlowGeneratorRec();
+            job.m_res[i]  = lp->Create(&m_yaml_info.m_vec[i],&m_yaml_info,i,cache)?1:0;
+            job.m_recs[i] = lp;
+        }
+        m_load_times.m_workers=1;
+    }else{
+        CPthreadJobRunner def_runner(std::min(num_threads,num_templates));
+        if ( runner == 0 ) {
+            runner = &def_runner;
+        }
+        runner->run(template_load_worker,&job);
+        m_load_times.m_workers=std::min(runner->get_workers(),num_templates);
+    }
+    m_load_times.m_from_cache = (cache?true:false);
+    m_load_times.m_templates = (now_sec()-phase_start)*1000.0;
+    for (i=0; i<(int)num_templates; i++) {
+        m_load_times.m_templates_work += job.m_time[i]*1000.0;
+    }
+
+    bool all_template_has_one_direction=true;
+    for (i=0; i<(int)num_templates; i++) {
+        CFlowGeneratorRec * lp=job.m_recs[i];
+        if ( job.m_res[i] == 0 ){
             fprintf(stdout,"\n ERROR reading YAML template files, please verify that they are valid \n\n");
             exit(-1);
             return (-1);
         }
         m_cap_gen.push_back(lp);
 
-        if (lp->m_flow_info.GetPacket(0)->m_pkt_indication.m_desc.IsBiDirectionalFlow() ) {
+        if (lp->m_flow_info.get_family_flow(0)->GetPacket(0)->m_pkt_indication.m_desc.IsBiDirectionalFlow() ) {
             all_template_has_one_direction=false;
         }
     }
@@ -3923,6 +4938,18 @@ int CFlowGenList::load_from_yaml(std::string file_name,
     if ( CGlobalInfo::is_learn_mode() && all_template_has_one_direction ) {
         fprintf(stdout,"\n Warning --learn mode has nothing to do when all templates are one directional, please remove it  \n");
     }
+
+    if ( cache_file.size() && (cache == 0) ) {
+        phase_start=now_sec();
+        std::vector<CCapFileFlowInfo *> flows;
+        for (i=0; i<(int)m_cap_gen.size(); i++) {
+            flows.push_back(&m_cap_gen[i]->m_flow_info);
+        }
+        CTemplateCache::save(cache_file,cache_hash,flows);
+        m_load_times.m_cache_save = (now_sec()-phase_start)*1000.0;
+    }
+    m_load_times.m_total = (now_sec()-load_start)*1000.0;
+    m_load_times.Dump(stdout);
     return (0);
 }
 
@@ -3949,6 +4976,85 @@ double CFlowGenList::GetCpuUtil(){
 }
 
 
+void CFlowGenList::DumpLateness(FILE *fd){
+    fprintf(fd," scheduling lateness per core \n");
+    fprintf(fd," ---------------------------- \n");
+    fprintf(fd," %4s  %10s  %10s  %10s  %14s  %10s \n",
+            "core","max[usec]","p99.9[usec]","late-cnt","late-off[usec]","queue-full");
+    int i;
+    for (i=0; i<(int)m_threads_info.size(); i++) {
+        m_threads_info[i]->get_stats_snapshot(m_snap);
+        m_threads_info[i]->get_hist_snapshot(m_hist);
+        m_snap.DumpLateness(i,m_hist,fd);
+    }
+    if ( CGlobalInfo::m_options.preview.get_precise_pacing_enable() ) {
+        fprintf(fd," inter packet gap error per core (precise pacing) \n");
+        fprintf(fd," %4s  %10s  %10s  %10s \n","core","p50[usec]","p99.9[usec]","max[usec]");
+        for (i=0; i<(int)m_threads_info.size(); i++) {
+            m_threads_info[i]->get_hist_snapshot(m_hist);
+            fprintf(fd," %4d  %10.2f  %10.2f  %10.2f \n",
+                    i,
+                    m_hist.m_ipg_err_his.get_percentile_usec(50.0),
+                    m_hist.m_ipg_err_his.get_percentile_usec(99.9),
+                    m_hist.m_ipg_err_his.get_max_latency());
+        }
+    }
+    if ( CGlobalInfo::m_options.preview.get_low_power_idle_enable() ) {
+        fprintf(fd," lateness after a low power wait per core \n");
+        fprintf(fd," %4s  %10s  %10s  %10s  %10s \n","core","p99.9[usec]","max[usec]","tpause","sleep");
+        for (i=0; i<(int)m_threads_info.size(); i++) {
+            m_threads_info[i]->get_stats_snapshot(m_snap);
+            m_threads_info[i]->get_hist_snapshot(m_hist);
+            fprintf(fd," %4d  %10.2f  %10.2f  %10llu  %10llu \n",
+                    i,
+                    m_hist.m_wake_his.get_percentile_usec(99.9),
+                    m_hist.m_wake_his.get_max_latency(),
+                    (unsigned long long)m_snap.m_tpause_cnt,
+                    (unsigned long long)m_snap.m_sleep_cnt);
+        }
+    }
+}
+
+/* tx-gen message, realtime-hist is the first core for backward compatibility */
+void CFlowGenList::dump_lateness_json(std::string & json){
+    json="{\"name\":\"tx-gen\",\"type\":0,\"data\":{";
+    int i;
+    for (i=0; i<(int)m_threads_info.size(); i++) {
+        m_threads_info[i]->get_stats_snapshot(m_json_snap);
+        m_threads_info[i]->get_hist_snapshot(m_json_hist);
+        if (i==0) {
+            m_json_hist.m_realtime_his.dump_json("realtime-hist",json);
+        }
+        m_json_snap.dump_lateness_json(i,m_json_hist,json);
+    }
+    json+="\"unknown\":0}}" ;
+}
+
+void CFlowGenList::DumpCycles(FILE *fd){
+    if ( !CDpCycleStats::is_enabled() ) {
+        fprintf(fd," cycle accounting is not compiled in, configure with --cycle-stats \n");
+        return;
+    }
+    int i;
+    for (i=0; i<(int)m_threads_info.size(); i++) {
+        m_threads_info[i]->get_stats_snapshot(m_snap);
+        if (i==0) {
+            m_snap.m_cycle_stats.DumpHeader(fd);
+        }
+        m_snap.m_cycle_stats.Dump(i,fd);
+    }
+}
+
+void CFlowGenList::dump_cycles_json(std::string & json){
+    json="{\"name\":\"trex-dp-cycles\",\"type\":0,\"data\":{";
+    int i;
+    for (i=0; i<(int)m_threads_info.size(); i++) {
+        m_threads_info[i]->get_stats_snapshot(m_json_snap);
+        m_json_snap.m_cycle_stats.dump_json(i,json);
+    }
+    json+="\"unknown\":0}}" ;
+}
+
 void CFlowGenList::Update(){
 
     int i;
@@ -4002,6 +5108,9 @@ void CFlowGenList::DumpCsv(FILE *fd){
     fprintf(fd,"\n");
     sum.m_name= "sum";
     sum.Dump(fd);
+    /* the sharing is between the templates, so only for the sum */
+    sum.m_memory.m_saved_bytes = CGlobalInfo::m_const_store.get_saved_bytes();
+    sum.m_memory.m_shared_pkts = CGlobalInfo::m_const_store.get_shared_pkts();
     sum.m_memory.dump(fd);
 }
 
@@ -4376,39 +5485,56 @@ int CNullIF::send_node(CGenNode * node){
 
 int CErfIF::send_node(CGenNode * node){
    if ( m_preview_mode->getFileWrite() ){
+       CFlowPktInfo * lp=node->m_pkt_info;
+       write_node_pkt(node,lp);
+       if ( unlikely( lp->is_tso_head() ) ) {
+           /* software split of the train, each packet from its own header */
+           uint32_t index=lp->m_pkt_indication.m_packet->pkt_cnt;
+           int i;
+           for (i=1; i<lp->m_tso_segs; i++) {
+               write_node_pkt(node,node->m_flow_info->GetPacket(index-1+i));
+           }
+       }
+   }
+   return (0);
+}
 
-    CFlowPktInfo * lp=node->m_pkt_info;
+int CErfIF::write_node_pkt(CGenNode * node,CFlowPktInfo * lp){
     rte_mbuf_t * m=lp->generate_new_mbuf(node);
 
+    pkt_dir_t dir=node->cur_interface_dir();
+    uint8_t p_id = (uint8_t)dir;
+
+    if ( likely( !CGlobalInfo::m_options.preview.get_vlan_mode_enable() ) ){
+        write_mbuf(m,node->m_time,p_id);
+        rte_pktmbuf_free(m);
+        return (0);
+    }
+
     fill_pkt(m_raw,m);
     CPktNsecTimeStamp t_c(node->m_time);
     m_raw->time_nsec = t_c.m_time_nsec;
     m_raw->time_sec  = t_c.m_time_sec;
 
-    pkt_dir_t dir=node->cur_interface_dir();
-    uint8_t p_id = (uint8_t)dir;
-    
     m_raw->setInterface(p_id);
 
     /* update mac addr dest/src 12 bytes */
     uint8_t *p=(uint8_t *)m_raw->raw;
     memcpy(p,CGlobalInfo::m_options.get_dst_src_mac_addr(p_id),12);
 
-    /* If vlan is enabled, add vlan header */
-    if ( unlikely( CGlobalInfo::m_options.preview.get_vlan_mode_enable() ) ){
-            /* retrieve vlan ID and  form vlan tag */
-            uint8_t vlan_port = (node->m_src_ip &1);
-            uint16_t vlan_protocol = EthernetHeader::Protocol::VLAN;
-            uint16_t vlan_id = CGlobalInfo::m_options.m_vlan_port[vlan_port];
-            uint32_t vlan_tag = (vlan_protocol << 16) | vlan_id;
-            vlan_tag = PKT_HTONL(vlan_tag);
+    /* vlan is enabled, add vlan header. retrieve vlan ID and form vlan tag */
+    uint8_t vlan_port = (node->m_src_ip &1);
+    uint16_t vlan_protocol = EthernetHeader::Protocol::VLAN;
+    uint16_t vlan_id = CGlobalInfo::m_options.m_vlan_port[vlan_port];
+    uint32_t vlan_tag = (vlan_protocol << 16) | vlan_id;
+    vlan_tag = PKT_HTONL(vlan_tag);
 
-            /* insert vlan tag and adjust packet size */
-            memcpy(cbuff+4, p+12, m_raw->pkt_len-12);
-            memcpy(cbuff, &vlan_tag, 4);
-            memcpy(p+12, cbuff, m_raw->pkt_len-8);
-            m_raw->pkt_len += 4;
-    }
+    /* insert vlan tag and adjust packet size */
+    uint8_t cbuff[MAX_PKT_SIZE];
+    memcpy(cbuff+4, p+12, m_raw->pkt_len-12);
+    memcpy(cbuff, &vlan_tag, 4);
+    memcpy(p+12, cbuff, m_raw->pkt_len-8);
+    m_raw->pkt_len += 4;
 
     //utl_DumpBuffer(stdout,p,  12,0);
 
@@ -4420,8 +5546,43 @@ int CErfIF::send_node(CGenNode * node){
 
     BP_ASSERT(res);
     rte_pktmbuf_free(m);
-   }
-   return (0);
+    return (0);
+}
+
+
+/* the writer takes the packet from the mbuf segments, the first segment is
+   owned by the packet so the mac addr is updated in place */
+int CErfIF::write_mbuf(rte_mbuf_t *m, dsec_t time, uint8_t p_id){
+    memcpy(rte_pktmbuf_mtod(m, uint8_t*),CGlobalInfo::m_options.get_dst_src_mac_addr(p_id),12);
+
+    CPktNsecTimeStamp t_c(time);
+    CCapPktSegs pkt;
+    pkt.time_nsec = t_c.m_time_nsec;
+    pkt.time_sec  = t_c.m_time_sec;
+    pkt.setInterface(p_id);
+
+    BP_ASSERT(m_writer);
+    bool res;
+    if ( likely( fill_pkt_segs(&pkt,m) ) ) {
+        res=m_writer->write_packet_segs(pkt);
+    }else{
+        fill_pkt(m_raw,m);
+        m_raw->time_nsec = t_c.m_time_nsec;
+        m_raw->time_sec  = t_c.m_time_sec;
+        m_raw->setInterface(p_id);
+        res=m_writer->write_packet(m_raw);
+    }
+    BP_ASSERT(res);
+    return (0);
+}
+
+
+int CErfIF::send_mbuf(pkt_dir_t dir, rte_mbuf_t *m, dsec_t time){
+    if ( m_preview_mode->getFileWrite() ){
+        write_mbuf(m,time,(uint8_t)dir);
+    }
+    rte_pktmbuf_free(m);
+    return (0);
 }
 
 
@@ -4458,29 +5619,65 @@ const uint8_t sctp_pkt[]={
 
 // 20+8+20`
 
-void CLatencyPktInfo::Create(){
-    m_packet = new CCapPktRaw( sizeof(sctp_pkt) );
+bool CLatencyPktInfo::Create(const CLatencyStreamYamlInfo * stream){
+    uint16_t size = sizeof(sctp_pkt);
+    uint16_t vlan = 0;
+    uint8_t  dscp = 0;
+    if ( stream ) {
+        if ( stream->m_size ) {
+            size = stream->m_size;
+        }
+        vlan = stream->m_vlan;
+        dscp = stream->m_dscp;
+    }
+    if ( (size < sizeof(sctp_pkt)) || (size > MAX_STREAM_PKT_SIZE) ) {
+        printf(" ERROR latency stream size %d should be between %d and %d \n",size,(int)sizeof(sctp_pkt),MAX_STREAM_PKT_SIZE);
+        return (false);
+    }
+    if ( vlan && CGlobalInfo::m_options.preview.get_vlan_mode_enable() ) {
+        printf(" WARNING latency stream vlan %d is ignored in vlan mode \n",vlan);
+        vlan = 0;
+    }
+    /* the vlan tag is part of the template, the rx port skips it */
+    uint16_t vlan_len = vlan?4:0;
+    uint16_t ip_offset = 14+vlan_len;
+
+    m_packet = new CCapPktRaw( size+vlan_len );
     m_packet->pkt_cnt=0;
     m_packet->time_sec=0;
     m_packet->time_nsec=0;
-    memcpy(m_packet->raw,sctp_pkt,sizeof(sctp_pkt));
-    m_packet->pkt_len=sizeof(sctp_pkt);
+    memset(m_packet->raw,0,size+vlan_len);
+    memcpy(m_packet->raw,sctp_pkt,12);
+    if ( vlan ) {
+        uint8_t * p=(uint8_t *)m_packet->raw+12;
+        p[0]=0x81;
+        p[1]=0x00;
+        p[2]=(vlan>>8) & 0x0f;
+        p[3]=vlan & 0xff;
+    }
+    memcpy(m_packet->raw+12+vlan_len,sctp_pkt+12,sizeof(sctp_pkt)-12);
+    m_packet->pkt_len=size+vlan_len;
+
+    IPHeader * ipv4=(IPHeader *)(m_packet->raw+ip_offset);
+    ipv4->setTotalLength(size-14);
+    ipv4->setTOS((dscp<<2) | (ipv4->getTOS() & 0x3));
+    ipv4->updateCheckSum();
 
     m_pkt_indication.m_packet  =m_packet;
 
     m_pkt_indication.m_ether = (EthernetHeader *)m_packet->raw;
-    m_pkt_indication.l3.m_ipv4=(IPHeader       *)(m_packet->raw+14);
+    m_pkt_indication.l3.m_ipv4=ipv4;
     m_pkt_indication.m_is_ipv6 = false;
-    m_pkt_indication.l4.m_udp=(UDPHeader *)m_packet->raw+14+20;
-    m_pkt_indication.m_payload=(uint8_t *)m_packet->raw+14+20+16;
+    m_pkt_indication.l4.m_udp=(UDPHeader *)(m_packet->raw+ip_offset+20);
+    m_pkt_indication.m_payload=(uint8_t *)m_packet->raw+ip_offset+20+8;
     m_pkt_indication.m_payload_len=0;
     m_pkt_indication.m_packet_padding=4;
 
 
     m_pkt_indication.m_ether_offset =0;
-    m_pkt_indication.m_ip_offset =14;
-    m_pkt_indication.m_udp_tcp_offset = 34;
-    m_pkt_indication.m_payload_offset = 34+8;
+    m_pkt_indication.m_ip_offset =ip_offset;
+    m_pkt_indication.m_udp_tcp_offset = ip_offset+20;
+    m_pkt_indication.m_payload_offset = ip_offset+20+8;
 
     CPacketDescriptor * lpd=&m_pkt_indication.m_desc;
     lpd->Clear();
@@ -4502,7 +5699,7 @@ void CLatencyPktInfo::Create(){
     m_dummy_node.m_src_port =  0x11;
     m_dummy_node.m_flow_id =0;
     m_dummy_node.m_flags =CGenNode::NODE_FLAGS_LATENCY;
-    
+    return (true);
 }
 
 
@@ -4554,12 +5751,82 @@ void CLatencyPktInfo::Delete(){
     delete m_packet;
 }
 
-void CCPortLatency::reset(){
+#define DPL_J(f)  json+=add_json(#f,f);
+#define DPL_J_LAST(f)  json+=add_json(#f,f,true);
+
+void CCPortLatencyStream::Create(uint16_t pkt_size){
+    m_tx_seq    =0x12345678;
+    m_pkt_size  =pkt_size;
+    m_tx_offset =0;
+    m_tx_tmpl_ip=0;
+    m_tx_tmpl   =0;
+    m_hist.Create(HIST_DIGITS);
+    reset();
+}
+
+void CCPortLatencyStream::Delete(){
+    if ( m_tx_tmpl ) {
+        rte_pktmbuf_free(m_tx_tmpl);
+        m_tx_tmpl=0;
+    }
+    m_hist.Delete();
+}
+
+void CCPortLatencyStream::reset(){
     m_rx_seq    =m_tx_seq;
+    m_tx_pkt_ok =0;
+    m_tx_pkt_err=0;
+    m_tx_pkt_drop=0;
+    m_pkt_ok    =0;
+    m_seq_error =0;
+    m_length_error=0;
+    m_hist.Reset();
+    m_jitter.reset();
+}
+
+void CCPortLatencyStream::dump_json(uint16_t id,std::string & json){
+    char buff[200];
+    sprintf(buff,"\"stream-%d\": {",id);
+    json+=std::string(buff);
+    m_hist.dump_json("hist",json);
+    json+="\"stats\" : {";
+    DPL_J(m_tx_pkt_ok);
+    DPL_J(m_tx_pkt_err);
+    DPL_J(m_tx_pkt_drop);
+    DPL_J(m_pkt_ok);
+    DPL_J(m_seq_error);
+    DPL_J(m_length_error);
+    /* must be last */
+    json+=add_json("m_jitter",get_jitter_usec(),true);
+    json+="}},";
+}
+
+void CCPortLatencyStream::DumpHeader(FILE *fd){
+    fprintf(fd,"   stream |   tx_ok , rx_ok  ,error,    average   ,   max   , Jitter \n");
+}
+
+void CCPortLatencyStream::Dump(uint16_t id,FILE *fd){
+    m_hist.update();
+    fprintf(fd,"   %6d |%8lu,%8lu,%4lu,   %8.0f  ,%8.0f,%8d \n",
+                    id,
+                    m_tx_pkt_ok,
+                    m_pkt_ok,
+                    get_errors()+m_tx_pkt_err,
+                    m_hist.get_average_latency(),
+                    m_hist.get_max_latency(),
+                    get_jitter_usec());
+}
+
+void CCPortLatency::reset(){
+    int i;
+    for (i=0; i<(int)m_num_streams; i++) {
+        m_streams[i].reset();
+    }
     m_pad       = 0;
 
     m_tx_pkt_err=0;
     m_tx_pkt_ok =0;
+    m_tx_pkt_drop=0;
     m_pkt_ok=0;
     m_rx_check=0;
     m_no_magic=0;
@@ -4582,37 +5849,84 @@ static uint8_t nat_is_port_can_send(uint8_t port_id){
 bool CCPortLatency::Create(CLatencyManager * parent,
                            uint8_t id,
                            uint16_t offset,
-                           uint16_t pkt_size,
-                           CCPortLatency * rx_port){
+                           CCPortLatency * rx_port,
+                           uint16_t max_streams){
     m_parent    = parent;
     m_id        = id;
-    m_tx_seq    =0x12345678;
     m_offset    = offset;
-    m_pkt_size  = pkt_size;
     m_rx_port   = rx_port;
     m_nat_can_send = nat_is_port_can_send(m_id);
     m_nat_learn    = m_nat_can_send;
     m_nat_external_ip=0;
 
     m_hist.Create();
+    m_streams     = new CCPortLatencyStream[max_streams];
+    m_num_streams = 0;
+    m_max_streams = max_streams;
     reset();
     return (true);
 }
 
+void CCPortLatency::add_stream(uint16_t pkt_size){
+    assert(m_num_streams < m_max_streams);
+    m_streams[m_num_streams].Create(pkt_size);
+    m_num_streams++;
+}
+
 void CCPortLatency::Delete(){
+    int i;
+    for (i=0; i<(int)m_num_streams; i++) {
+        m_streams[i].Delete();
+    }
+    delete [] m_streams;
+    m_streams=0;
+    m_num_streams=0;
+    m_max_streams=0;
     m_hist.Delete();
 }
 
-void CCPortLatency::update_packet(rte_mbuf_t * m){
+void CCPortLatency::set_tx_template(uint16_t stream_id,rte_mbuf_t * m,uint16_t offset,uint32_t nat_ip){
+    CCPortLatencyStream * lps=get_stream(stream_id);
     uint8_t *p=rte_pktmbuf_mtod(m, uint8_t*);
     /* update mac addr dest/src 12 bytes */
     memcpy(p,CGlobalInfo::m_options.get_dst_src_mac_addr(m_id),12);
+    /* the header is written in the first segment, the rest is const */
+    assert((uint32_t)offset+sizeof(latency_header) <= m->data_len);
+    if ( lps->m_tx_tmpl ) {
+        rte_pktmbuf_free(lps->m_tx_tmpl);
+    }
+    lps->m_tx_tmpl    = m;
+    lps->m_tx_offset  = offset;
+    lps->m_tx_tmpl_ip = nat_ip;
+}
+
+rte_mbuf_t * CCPortLatency::clone_tx_packet(uint16_t stream_id){
+    CCPortLatencyStream * lps=get_stream(stream_id);
+    rte_mbuf_t * tmpl=lps->m_tx_tmpl;
+    rte_mbuf_t * m=rte_pktmbuf_alloc(tmpl->pool);
+    if ( m == 0 ) {
+        return (0);
+    }
+    /* copy the first segment, share the const tail of big packets */
+    char *p=rte_pktmbuf_append(m, tmpl->data_len);
+    memcpy(p,rte_pktmbuf_mtod(tmpl, char*),tmpl->data_len);
+    if ( tmpl->next ) {
+        utl_rte_pktmbuf_add_after(m,tmpl->next);
+    }
+    update_packet(m,stream_id,lps->m_tx_offset);
+    return (m);
+}
 
-    latency_header * h=(latency_header *)(p+m_offset);
-    h->magic = LATENCY_MAGIC | m_id ;
+void CCPortLatency::update_packet(rte_mbuf_t * m,uint16_t stream_id,uint16_t offset){
+    uint8_t *p=rte_pktmbuf_mtod(m, uint8_t*);
+
+    CCPortLatencyStream * lps=get_stream(stream_id);
+    latency_header * h=(latency_header *)(p+offset);
+    h->magic = latency_header::get_magic(m_id);
+    h->set_stream_id(stream_id);
     h->time_stamp = os_get_hr_tick_64();
-    h->seq = m_tx_seq;
-    m_tx_seq++;
+    h->seq = lps->m_tx_seq;
+    lps->m_tx_seq++;
 }
 
 
@@ -4637,11 +5951,27 @@ void CCPortLatency::dump_json_v2(std::string & json ){
     char buff[200];
     sprintf(buff,"\"port-%d\": {",m_id);
     json+=std::string(buff);
+    if ( m_num_streams > 1 ) {
+        int i;
+        for (i=0; i<(int)m_num_streams; i++) {
+            m_streams[i].dump_json(i,json);
+        }
+    }
     m_hist.dump_json("hist",json);
     dump_counters_json(json);
     json+="},";
 }
 
+void CCPortLatency::dump_bin(CTelemetryBinEncoder & enc,uint16_t rec){
+    enc.set_rec(rec,CTelemetryBin::LP_TX_DROP,m_tx_pkt_drop);
+    enc.set_rec(rec,CTelemetryBin::LP_TX_PKTS,m_tx_pkt_ok);
+    enc.set_rec(rec,CTelemetryBin::LP_RX_PKTS,m_pkt_ok);
+    enc.set_rec(rec,CTelemetryBin::LP_ERRORS,m_unsup_prot+m_no_magic+m_no_id+m_seq_error+m_length_error);
+    enc.set_rec_double(rec,CTelemetryBin::LP_AVG_USEC,m_hist.get_average_latency());
+    enc.set_rec_double(rec,CTelemetryBin::LP_MAX_USEC,m_hist.get_max_latency());
+    enc.set_rec(rec,CTelemetryBin::LP_JITTER_USEC,get_jitter_usec());
+}
+
 void CCPortLatency::dump_json(std::string & json ){
     json += get_field("avg",m_hist.get_average_latency() );
     json += get_field("max",m_hist.get_max_latency() );
@@ -4671,14 +6001,12 @@ void CCPortLatency::DumpShort(FILE *fd){
 
 }
 
-#define DPL_J(f)  json+=add_json(#f,f);
-#define DPL_J_LAST(f)  json+=add_json(#f,f,true);
-
 void CCPortLatency::dump_counters_json(std::string & json ){
 
     json+="\"stats\" : {";
     DPL_J(m_tx_pkt_ok);
     DPL_J(m_tx_pkt_err);
+    DPL_J(m_tx_pkt_drop);
     DPL_J(m_pkt_ok);
     DPL_J(m_unsup_prot);
     DPL_J(m_no_magic);
@@ -4701,6 +6029,7 @@ void CCPortLatency::DumpCounters(FILE *fd){
     fprintf(fd," -----------\n");
 
     DP_A1(m_tx_pkt_err);
+    DP_A1(m_tx_pkt_drop);
     DP_A1(m_tx_pkt_ok);
     DP_A1(m_pkt_ok);
     DP_A1(m_unsup_prot);
@@ -4715,6 +6044,13 @@ void CCPortLatency::DumpCounters(FILE *fd){
     fprintf(fd," -----------\n");
     m_hist.Dump(fd);
     fprintf(fd," %-40s : %llu \n","jitter",get_jitter_usec());
+    if ( m_num_streams > 1 ) {
+        CCPortLatencyStream::DumpHeader(fd);
+        int i;
+        for (i=0; i<(int)m_num_streams; i++) {
+            m_streams[i].Dump(i,fd);
+        }
+    }
 }
 
 bool CCPortLatency::dump_packet(rte_mbuf_t * m){
@@ -4845,35 +6181,63 @@ bool CCPortLatency::check_packet(rte_mbuf_t * m,CRx_check_header * & rx_p){
         do_learn(parser.m_ipv4->getSourceIp());
     }
 
-    if ( (pkt_size-vlan_offset) != m_pkt_size ) {
+    /* the header is read in place, a jumbo packet is a chain of rx mbufs */
+    uint16_t seg_size = (m->data_len < pkt_size)?m->data_len:pkt_size;
+    if ( (seg_size-vlan_offset) < (m_offset+sizeof(latency_header)) ) {
         m_length_error++;
         return (false);
     }
 
     latency_header * h=(latency_header *)(p+m_offset+vlan_offset);
 
-    if ( (h->magic & 0xffffff00) != LATENCY_MAGIC ){
+    if ( (h->magic & LATENCY_MAGIC_MASK) != LATENCY_MAGIC ){
         m_no_magic++;
         return (false);
     }
 
-    if ( h->seq != m_rx_seq ){
+    /* the stream id is an index, no lookup */
+    uint16_t stream_id=h->get_stream_id();
+    if ( stream_id >= m_num_streams ) {
+        m_no_id++;
+        return (false);
+    }
+    CCPortLatencyStream * lps=get_stream(stream_id);
+
+    if ( (pkt_size-vlan_offset) != lps->m_pkt_size ) {
+        lps->m_length_error++;
+        m_length_error++;
+        return (false);
+    }
+
+    if ( h->seq != lps->m_rx_seq ){
+        lps->m_seq_error++;
         m_seq_error++;
-        m_rx_seq =h->seq +1;
+        lps->m_rx_seq =h->seq +1;
         return (false);
     }else{
-        m_rx_seq++;
+        lps->m_rx_seq++;
     }
+    lps->m_pkt_ok++;
     m_pkt_ok++;
     uint64_t d = (os_get_hr_tick_64() - h->time_stamp );
     dsec_t ctime=ptime_convert_hr_dsec(d);
     m_hist.Add(ctime);
     m_jitter.calc(ctime);
+    lps->m_hist.Add(ctime);
+    lps->m_jitter.calc(ctime);
     return (true);
 }
 
 void CLatencyManager::Delete(){
-    m_pkt_gen.Delete();
+    int i;
+    for (i=0; i<(int)m_streams.size(); i++) {
+        m_streams[i]->m_pkt_gen.Delete();
+        delete m_streams[i];
+    }
+    m_streams.clear();
+    for (i=0; i<m_max_ports; i++) {
+        m_ports[i].m_port.Delete();
+    }
 
     if ( get_is_rx_check_mode() ) {
         m_rx_check_manager.Delete();
@@ -4882,6 +6246,18 @@ void CLatencyManager::Delete(){
         m_nat_check_manager.Delete();
     }
     m_cpu_cp_u.Delete();
+    m_idle.Delete();
+    close_rx_capture();
+}
+
+/* join the writer and flush the last buffer of the capture file */
+void CLatencyManager::close_rx_capture(){
+    if ( m_rx_capture ) {
+        m_rx_capture->Delete();
+        m_rx_capture->Dump(stdout);
+        delete m_rx_capture;
+        m_rx_capture=0;
+    }
 }
 
 /* 0->1
@@ -4904,21 +6280,45 @@ bool CLatencyManager::Create(CLatencyManagerCfg * cfg){
     m_port_mask =0xffffffff;
     m_do_stop =false;
     m_is_active =false;
-    m_pkt_gen.Create();
+    m_cps= cfg->m_cps;
+    m_d_time =ptime_convert_dsec_hr((1.0/m_cps));
+    m_delta_sec =(1.0/m_cps);
+    m_rx_capture=0;
+
+    /* no streams in the yaml, one default stream at the -l rate */
+    std::vector<CLatencyStreamYamlInfo> streams_info=cfg->m_streams;
+    if ( streams_info.size() == 0 ) {
+        streams_info.push_back(CLatencyStreamYamlInfo());
+    }
     int i;
+    for (i=0; i<(int)streams_info.size(); i++) {
+        CLatencyStream * ls=new CLatencyStream();
+        if ( !ls->m_pkt_gen.Create(&streams_info[i]) ) {
+            delete ls;
+            return (false);
+        }
+        double rate = streams_info[i].m_rate>0.0?streams_info[i].m_rate:m_cps;
+        ls->m_delta_sec = 1.0/rate;
+        m_streams.push_back(ls);
+    }
+    m_hist_all.Create();
     for (i=0; i<m_max_ports; i++) {
         CLatencyManagerPerPort * lp=&m_ports[i];
         CCPortLatency * lpo=&m_ports[swap_port(i)].m_port;
 
         lp->m_io=cfg->m_ports[i];
+        lp->m_tx_cnt=0;
+        /* the rx side skips the vlan tag, so the offset is the same for all the streams */
         lp->m_port.Create(this,
                           i,
-                          m_pkt_gen.get_payload_offset(),
-                          m_pkt_gen.get_pkt_size(),lpo );
+                          14+20+8,
+                          lpo,
+                          (uint16_t)m_streams.size() );
+        int j;
+        for (j=0; j<(int)m_streams.size(); j++) {
+            lp->m_port.add_stream(m_streams[j]->m_pkt_gen.get_rx_pkt_size());
+        }
     }
-    m_cps= cfg->m_cps;
-    m_d_time =ptime_convert_dsec_hr((1.0/m_cps));
-    m_delta_sec =(1.0/m_cps);
 
         
     if ( get_is_rx_check_mode() ) {
@@ -4927,30 +6327,128 @@ bool CLatencyManager::Create(CLatencyManagerCfg * cfg){
      }
 
 
-    m_pkt_gen.set_ip(cfg->m_client_ip.v4,cfg->m_server_ip.v4,cfg->m_dual_port_mask);
+    /* the rx of these modes is not only latency packets, keep polling */
+    m_idle.Create( CGlobalInfo::m_options.preview.get_low_power_idle_enable() &&
+                   (!get_is_rx_check_mode()) &&
+                   (!CGlobalInfo::is_learn_mode()) &&
+                   (!CGlobalInfo::m_options.preview.get_vm_one_queue_enable()) );
+    m_last_tx_sec=0.0;
+
+    set_ip(cfg->m_client_ip.v4,cfg->m_server_ip.v4,cfg->m_dual_port_mask);
     m_cpu_cp_u.Create(&m_cpu_dp_u);
     if ( CGlobalInfo::is_learn_mode() ){
         m_nat_check_manager.Create();
     }
+    if ( CGlobalInfo::m_options.rx_capture_file != "" ) {
+        m_rx_capture=new CRxCapture();
+        if ( !m_rx_capture->Create(CGlobalInfo::m_options.rx_capture_file,
+                                   CGlobalInfo::m_options.rx_capture_filter,
+                                   m_max_ports,
+                                   CGlobalInfo::m_options.m_rx_capture_snaplen,
+                                   (uint64_t)CGlobalInfo::m_options.m_rx_capture_rotate_mb*1024*1024) ) {
+            delete m_rx_capture;
+            m_rx_capture=0;
+            return (false);
+        }
+    }
     return (true);
 }
 
 
-void  CLatencyManager::send_pkt_all_ports(){
+uint16_t CLatencyManager::get_latency_header_offset(rte_mbuf_t * m){
+    EthernetHeader * et=rte_pktmbuf_mtod(m, EthernetHeader *);
+    uint16_t offset=14+20+8;
+    if ( et->getNextProtocol() == EthernetHeader::Protocol::VLAN ) {
+        offset+=4;
+    }
+    return (offset);
+}
+
+/* queue the packet of the stream on all the ports, flush_tx() sends them */
+void  CLatencyManager::add_pkt_all_ports(uint16_t stream_id){
     m_start_time = os_get_hr_tick_64();
+    CLatencyPktInfo * pkt_gen=&m_streams[stream_id]->m_pkt_gen;
     int i;
     for (i=0; i<m_max_ports; i++) {
         if ( m_port_mask & (1<<i)  ){
             CLatencyManagerPerPort * lp=&m_ports[i];
             if (lp->m_port.can_send_packet() ){
-                rte_mbuf_t * m=m_pkt_gen.generate_pkt(i,lp->m_port.external_nat_ip());
-                lp->m_port.update_packet(m);
-                if ( lp->m_io->tx(m) == 0 ){
-                    lp->m_port.m_tx_pkt_ok++;
-                }else{
-                    lp->m_port.m_tx_pkt_err++;
+                if ( !lp->m_port.is_tx_template_valid(stream_id) ) {
+                    /* first packet or a new nat address, build the packet of this port once */
+                    uint32_t nat_ip=lp->m_port.external_nat_ip();
+                    lp->m_port.set_tx_template(stream_id,
+                                               pkt_gen->generate_pkt(i,nat_ip),
+                                               pkt_gen->get_payload_offset(),
+                                               nat_ip);
+                }
+                rte_mbuf_t * m=lp->m_port.clone_tx_packet(stream_id);
+                if ( m == 0 ) {
+                    lp->m_port.m_tx_pkt_drop++;
+                    lp->m_port.get_stream(stream_id)->m_tx_pkt_drop++;
+                    continue;
                 }
+                assert(lp->m_tx_cnt<MAX_LATENCY_TX_BURST);
+                lp->m_tx_stream[lp->m_tx_cnt]=stream_id;
+                lp->m_tx_pkts[lp->m_tx_cnt]=m;
+                lp->m_tx_cnt++;
+            }
+        }
+    }
+}
+
+/* one burst per port */
+void  CLatencyManager::flush_tx(){
+    int i;
+    for (i=0; i<m_max_ports; i++) {
+        CLatencyManagerPerPort * lp=&m_ports[i];
+        if ( lp->m_tx_cnt == 0 ) {
+            continue;
+        }
+        uint16_t sent=lp->m_io->tx_burst(lp->m_tx_pkts,lp->m_tx_cnt);
+        uint16_t j;
+        for (j=0; j<lp->m_tx_cnt; j++) {
+            CCPortLatencyStream * lps=lp->m_port.get_stream(lp->m_tx_stream[j]);
+            if ( j < sent ){
+                lp->m_port.m_tx_pkt_ok++;
+                lps->m_tx_pkt_ok++;
+            }else{
+                /* queue is full */
+                rte_pktmbuf_free(lp->m_tx_pkts[j]);
+                lp->m_port.m_tx_pkt_err++;
+                lps->m_tx_pkt_err++;
+            }
+        }
+        lp->m_tx_cnt=0;
+    }
+}
 
+/* a latency packet that was sent was not received yet. the RX timestamp is taken
+   when it is polled, a sleep while it is in flight would add to its latency. lost
+   packets are not pending after LATENCY_RX_PENDING_SEC */
+bool  CLatencyManager::is_rx_pending(double c_time){
+    if ( (c_time - m_last_tx_sec) > LATENCY_RX_PENDING_SEC ) {
+        return (false);
+    }
+    uint64_t tx=0;
+    uint64_t rx=0;
+    int i;
+    for (i=0; i<m_max_ports; i++) {
+        CCPortLatency * lp=&m_ports[i].m_port;
+        tx+=lp->m_tx_pkt_ok;
+        rx+=lp->m_pkt_ok+lp->m_seq_error+lp->m_length_error+lp->m_no_ipv4_option;
+    }
+    return (rx<tx);
+}
+
+/* cnt ticks of the stream were skipped */
+void  CLatencyManager::drop_pkt_all_ports(uint16_t stream_id,uint64_t cnt){
+    int i;
+    for (i=0; i<m_max_ports; i++) {
+        if ( m_port_mask & (1<<i)  ){
+            CLatencyManagerPerPort * lp=&m_ports[i];
+            if (lp->m_port.can_send_packet() ){
+                lp->m_port.m_tx_pkt_drop+=cnt;
+                lp->m_port.get_stream(stream_id)->m_tx_pkt_drop+=cnt;
             }
         }
     }
@@ -4984,6 +6482,9 @@ void  CLatencyManager::wait_for_rx_dump(){
 void CLatencyManager::handle_rx_pkt(CLatencyManagerPerPort * lp,
                                     rte_mbuf_t * m){
     CRx_check_header *rxc;
+    if ( unlikely(m_rx_capture!=NULL) ){
+        m_rx_capture->capture((uint8_t)(lp-m_ports),m);
+    }
     lp->m_port.check_packet(m,rxc);
     if ( unlikely(rxc!=NULL) ){
         m_rx_check_manager.handle_packet(rxc);
@@ -5081,17 +6582,25 @@ void  CLatencyManager::start(int iter){
     m_do_stop =false;
     m_is_active =false;
     int cnt=0;
+    int burst;
 
     double n_time;
+    double c_time;
     CGenNode * node = new CGenNode();
     node->m_type = CGenNode::FLOW_SYNC;   /* general stuff */
     node->m_time = now_sec()+0.007;
     m_p_queue.push(node);
 
-    node = new CGenNode();
-    node->m_type = CGenNode::FLOW_PKT; /* latency */
-    node->m_time = now_sec(); /* 1/cps rate */
-    m_p_queue.push(node);
+    /* one node per stream, the flow id is the stream id */
+    int i;
+    for (i=0; i<(int)m_streams.size(); i++) {
+        node = new CGenNode();
+        node->m_type = CGenNode::FLOW_PKT; /* latency */
+        node->m_flow_id = i;
+        /* spread the streams so they do not burst together */
+        node->m_time = now_sec()+ (m_streams[i]->m_delta_sec*i)/m_streams.size(); /* 1/rate of the stream */
+        m_p_queue.push(node);
+    }
     bool do_try_rx_queue =CGlobalInfo::m_options.preview.get_vm_one_queue_enable()?true:false;
 
 
@@ -5100,8 +6609,11 @@ void  CLatencyManager::start(int iter){
         n_time = node->m_time;
 
         /* wait for event */
+        bool idled=false;
+        double dt;
         while ( true ) {
-            double dt = now_sec() - n_time ;
+            double c_time = now_sec();
+            dt = c_time - n_time ;
             if (dt> (0.0)) {
                 break;
             }
@@ -5109,7 +6621,16 @@ void  CLatencyManager::start(int iter){
                 try_rx_queues();
             }
             try_rx();
-            rte_pause();
+            if ( m_idle.is_enable() && !is_rx_pending(c_time) ) {
+                if ( m_idle.idle(-dt) ) {
+                    idled=true;
+                }
+            }else{
+                rte_pause();
+            }
+        }
+        if ( idled && (node->m_type == CGenNode::FLOW_PKT) ) {
+            m_idle.add_wake(dt);
         }
 
         switch (node->m_type) {
@@ -5125,10 +6646,28 @@ void  CLatencyManager::start(int iter){
             break;
         case CGenNode::FLOW_PKT:
             m_cpu_dp_u.start_work();
-            send_pkt_all_ports();
-            m_p_queue.pop();
-            node->m_time += m_delta_sec;
-            m_p_queue.push(node);
+            /* all the streams that are due go in one burst per port */
+            burst=0;
+            c_time=now_sec();
+            do {
+                CLatencyStream * ls=m_streams[node->m_flow_id];
+                add_pkt_all_ports((uint16_t)node->m_flow_id);
+                m_p_queue.pop();
+                node->m_time += ls->m_delta_sec;
+                if ( (c_time - node->m_time) > (ls->m_delta_sec*MAX_LATENCY_TX_BURST) ) {
+                    /* too late to catch up, skip the ticks */
+                    uint64_t skip=(uint64_t)((c_time - node->m_time)/ls->m_delta_sec);
+                    node->m_time += skip*ls->m_delta_sec;
+                    drop_pkt_all_ports((uint16_t)node->m_flow_id,skip);
+                }
+                m_p_queue.push(node);
+                burst++;
+                node = m_p_queue.top();
+            } while ( (burst<MAX_LATENCY_TX_BURST) && 
+                      (node->m_type == CGenNode::FLOW_PKT) && 
+                      (node->m_time <= c_time) );
+            flush_tx();
+            m_last_tx_sec=c_time;
             m_cpu_dp_u.commit();
             break;
         }
@@ -5157,6 +6696,8 @@ void  CLatencyManager::start(int iter){
     if ( get_is_rx_check_mode() ) {
         m_rx_check_manager.tw_drain();
     }
+    /* nothing is received from now on, the process may exit without Delete */
+    close_rx_capture();
 
 }
 
@@ -5208,7 +6749,10 @@ uint64_t CLatencyManager::get_total_bytes(){
     uint64_t t=0;
     for (i=0; i<m_max_ports; i++) {
         CLatencyManagerPerPort * lp=&m_ports[i];
-        t+=lp->m_port.m_tx_pkt_ok* (m_pkt_gen.get_pkt_size()+4);
+        int j;
+        for (j=0; j<lp->m_port.get_num_streams(); j++) {
+            t+=lp->m_port.get_stream(j)->m_tx_pkt_ok* (m_streams[j]->m_pkt_gen.get_pkt_size()+4);
+        }
     }
     return  t;
 
@@ -5243,16 +6787,30 @@ void CLatencyManager::dump_json_v2(std::string & json ){
     json="{\"name\":\"trex-latecny-v2\",\"type\":0,\"data\":{";
     json+=add_json("cpu_util",m_cpu_cp_u.GetVal());
 
+    m_hist_all.Reset();
     int i;
     for (i=0; i<m_max_ports; i++) {
         CLatencyManagerPerPort * lp=&m_ports[i];
         lp->m_port.dump_json_v2(json);
+        m_hist_all.merge(lp->m_port.m_hist);
     }
+    m_hist_all.dump_json("all-hist",json);
 
     json+="\"unknown\":0}}"  ;
 
 }
 
+void CLatencyManager::dump_bin(std::string & buf,uint32_t seq,uint64_t time_usec){
+    CTelemetryBinEncoder enc;
+    enc.begin(buf,CTelemetryBin::tbLATENCY,seq,time_usec,
+              CTelemetryBin::L_LAST,m_max_ports,CTelemetryBin::LP_LAST);
+    enc.set_double(CTelemetryBin::L_CPU_UTIL,m_cpu_cp_u.GetVal());
+    int i;
+    for (i=0; i<m_max_ports; i++) {
+        m_ports[i].m_port.dump_bin(enc,i);
+    }
+}
+
 void CLatencyManager::DumpRxCheck(FILE *fd){
     if ( get_is_rx_check_mode() ) {
         fprintf(fd," rx checker : \n");
@@ -5300,6 +6858,9 @@ void CLatencyManager::Dump(FILE *fd){
         CLatencyManagerPerPort * lp=&m_ports[i];
         lp->m_port.DumpCounters(fd);
     }
+    if ( m_idle.is_enable() ) {
+        m_idle.Dump(fd);
+    }
 }
 
 void CLatencyManager::DumpRxCheckVerification(FILE *fd,
@@ -6619,6 +8180,12 @@ bool CSimplePacketParser::Parse(){
         default:
         break;
     }
+    /* the headers must be in the first segment */
+    if ( unlikely(m->data_len < m_option_offset) ) {
+        protocol = 0;
+        ipv4 = 0;
+        ipv6 = 0;
+    }
     m_protocol =protocol;
     m_ipv4=ipv4;
     m_ipv6=ipv6;
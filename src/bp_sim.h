@@ -31,6 +31,7 @@ limitations under the License.
 #include <fstream>
 #include <string>
 #include <queue>
+#include <pthread.h>
 #include "mbuf.h"
 #include <common/c_common.h>
 #include <common/captureFile.h>
@@ -48,7 +49,9 @@ limitations under the License.
 #include "rx_check_header.h"
 #include "rx_check.h"
 #include "time_histogram.h"
+#include "utl_seqlock.h"
 #include "utl_cpuu.h"
+#include "utl_idle.h"
 #include "tuple_gen.h"
 #include "utl_jitter.h"
 #include "msg_manager.h"
@@ -56,6 +59,9 @@ limitations under the License.
 #include <common/cgen_map.h>
 #include <arpa/inet.h>
 #include "platform_cfg.h"
+#include "template_cache.h"
+#include "pcap_replay.h"
+#include "rx_capture.h"
 
 #undef NAT_TRACE_
 
@@ -234,6 +240,7 @@ public:
 
 class CGenNode;
 class CFlowYamlInfo;
+class CTelemetryBinEncoder;
 class CFlowGenListPerThread ;
 
 
@@ -268,6 +275,7 @@ public:
     uint64_t   m_tx_rx_check_pkt;
     uint64_t   m_tx_bytes;
     uint64_t   m_tx_drop;
+    uint64_t   m_tx_delay;      /* not taken by the NIC, kept and sent later (tx backpressure) */
     uint64_t   m_tx_queue_full;
     uint64_t   m_tx_alloc_error;
 
@@ -280,6 +288,7 @@ public:
         m_tx_rx_check_pkt +=obj->m_tx_rx_check_pkt;
         m_tx_bytes   += obj->m_tx_bytes;
         m_tx_drop    += obj->m_tx_drop;
+        m_tx_delay   += obj->m_tx_delay;
         m_tx_alloc_error += obj->m_tx_alloc_error;
         m_tx_queue_full +=obj->m_tx_queue_full;
         m_template.Add(&obj->m_template);
@@ -290,6 +299,7 @@ public:
        m_tx_rx_check_pkt=0;
        m_tx_bytes=0;
        m_tx_drop=0;
+       m_tx_delay=0;
        m_tx_alloc_error=0;
        m_tx_queue_full=0;
        m_template.Clear();
@@ -307,6 +317,7 @@ void CVirtualIFPerSideStats::Dump(FILE *fd){
     DP_B(m_tx_rx_check_pkt);
     DP_B(m_tx_bytes);  
     DP_B(m_tx_drop);  
+    DP_B(m_tx_delay);
     DP_B(m_tx_alloc_error);
     DP_B(m_tx_queue_full);
     m_template.Dump(fd);
@@ -350,6 +361,18 @@ public:
     virtual void send_one_pkt(pkt_dir_t       dir, rte_mbuf_t      *m){
     }
 
+    /**
+     * send a ready packet (pcap replay), the interface owns the mbuf
+     * 
+     * @param dir
+     * @param m
+     * @param time  time of the packet, for the file
+     */
+    virtual int send_mbuf(pkt_dir_t dir, rte_mbuf_t *m, dsec_t time){
+        rte_pktmbuf_free(m);
+        return (0);
+    }
+
 
     /**
      * flush all pending packets into the stream 
@@ -358,6 +381,15 @@ public:
      */
     virtual int flush_tx_queue(void)=0;
 
+    /**
+     * retry the packets the NIC did not take (tx backpressure)
+     * 
+     * @return true if there are still packets waiting
+     */
+    virtual bool is_tx_backpressure(void){
+        return (false);
+    }
+
 public:
 
 
@@ -382,6 +414,10 @@ public:
 #define MAX_BUF_SIZE     (2048)
 #define CONST_MBUF_SIZE (MAX_BUF_SIZE + sizeof(struct rte_mbuf) + RTE_PKTMBUF_HEADROOM)
 
+/* jumbo packets, one segment of the const part. the biggest packet of the readers */
+#define MAX_JUMBO_BUF_SIZE  (MAX_PKT_SIZE)
+#define CONST_9k_MBUF_SIZE  (MAX_JUMBO_BUF_SIZE + sizeof(struct rte_mbuf) + RTE_PKTMBUF_HEADROOM)
+
 /* this is the first small part of the packet that we manipulate */
 #define FIRST_PKT_SIZE 64
 #define CONST_SMALL_MBUF_SIZE (FIRST_PKT_SIZE + sizeof(struct rte_mbuf) + RTE_PKTMBUF_HEADROOM)
@@ -646,6 +682,60 @@ public:
         return (btGetMaskBit32(m_flags1,4,4) ? true:false);
     }
 
+    /* publish binary telemetry in addition to the json */
+    void set_zmq_bin_publish_enable(bool enable){
+        btSetMaskBit32(m_flags1,6,6,enable?1:0);
+    }
+
+    bool get_zmq_bin_publish_enable(){
+        return (btGetMaskBit32(m_flags1,6,6) ? true:false);
+    }
+
+    /* DP waits for the exact TSC tick of each packet and flushes it, lower Mpps */
+    void set_precise_pacing_enable(bool enable){
+        btSetMaskBit32(m_flags1,8,8,enable?1:0);
+    }
+
+    bool get_precise_pacing_enable(){
+        return (btGetMaskBit32(m_flags1,8,8) ? true:false);
+    }
+
+    /* sleep or tpause on long gaps to the next event instead of spinning */
+    void set_low_power_idle_enable(bool enable){
+        btSetMaskBit32(m_flags1,9,9,enable?1:0);
+    }
+
+    bool get_low_power_idle_enable(){
+        return (btGetMaskBit32(m_flags1,9,9) ? true:false);
+    }
+
+    /* keep the packets the NIC did not take and push the schedule, instead of dropping them */
+    void set_tx_backpressure_enable(bool enable){
+        btSetMaskBit32(m_flags1,10,10,enable?1:0);
+    }
+
+    bool get_tx_backpressure_enable(){
+        return (btGetMaskBit32(m_flags1,10,10) ? true:false);
+    }
+
+    /* zero IPG TCP trains of a template are sent by their first packet, NIC TSO or software split */
+    void set_tso_enable(bool enable){
+        btSetMaskBit32(m_flags1,11,11,enable?1:0);
+    }
+
+    bool get_tso_enable(){
+        return (btGetMaskBit32(m_flags1,11,11) ? true:false);
+    }
+
+    /* export the simulator file in pcapng format */
+    void set_pcapng_mode_enable(bool enable){
+        btSetMaskBit32(m_flags1,12,12,enable?1:0);
+    }
+
+    bool get_pcapng_mode_enable(){
+        return (btGetMaskBit32(m_flags1,12,12) ? true:false);
+    }
+
 
 
 
@@ -707,6 +797,13 @@ public:
         m_run_flags=0;
         prefix="";
         m_mac_splitter=0;
+        m_pub_interval_msec=500;
+        m_mtu=0;
+        m_replay_rate=1.0;
+        m_replay_loops=1;
+        m_replay_ip_offset=0;
+        m_rx_capture_snaplen=2048;
+        m_rx_capture_rotate_mb=0;
     }
 
     CPreviewMode    preview;
@@ -731,6 +828,8 @@ public:
     uint16_t        m_run_flags;
     uint8_t         m_mac_splitter;
     uint8_t         m_pad;
+    uint32_t        m_pub_interval_msec; /* zmq telemetry publish interval */
+    uint16_t        m_mtu;               /* port MTU, 0 for the default */
 
 
     std::string     cfg_file;
@@ -739,6 +838,15 @@ public:
 
     std::string     out_file;
     std::string     prefix;
+    std::string     template_cache_file; /* precompiled templates, empty for none */
+    std::string     replay_file;         /* capture file to replay instead of the templates, empty for none */
+    double          m_replay_rate;       /* speed up of the replay file */
+    uint32_t        m_replay_loops;
+    uint32_t        m_replay_ip_offset;  /* added to the IPv4 addresses each loop */
+    std::string     rx_capture_file;     /* pcap of the packets received by the latency core, empty for none */
+    std::string     rx_capture_filter;
+    uint16_t        m_rx_capture_snaplen;
+    uint32_t        m_rx_capture_rotate_mb; /* 0 for one file */
 
                                  
     CMacAddrCfg     m_mac_addr[MAX_LATENCY_PORTS];
@@ -880,6 +988,8 @@ public:
 
     virtual bool thread_phy_is_master(physical_thread_id_t  phy_id)=0;
     virtual bool thread_phy_is_latency(physical_thread_id_t  phy_id)=0;
+    /* physical thread of the master, for the helper threads that must not run on a DP core */
+    virtual physical_thread_id_t get_master_phy_id()=0;
 
     virtual void dump(FILE *fd)=0;
 };
@@ -922,6 +1032,7 @@ public:
 
     bool thread_phy_is_master(physical_thread_id_t  phy_id);
     bool thread_phy_is_latency(physical_thread_id_t  phy_id);
+    physical_thread_id_t get_master_phy_id();
 
     virtual void dump(FILE *fd);
 
@@ -968,6 +1079,7 @@ public:
 
     bool thread_phy_is_master(physical_thread_id_t  phy_id);
     bool thread_phy_is_latency(physical_thread_id_t  phy_id);
+    physical_thread_id_t get_master_phy_id();
 
 public:
     virtual void dump(FILE *fd);
@@ -1032,6 +1144,7 @@ public:
 
     bool thread_phy_is_master(physical_thread_id_t  phy_id);
     bool thread_phy_is_latency(physical_thread_id_t  phy_id);
+    physical_thread_id_t get_master_phy_id();
 
     void dump(FILE *fd);
 
@@ -1046,7 +1159,7 @@ class CRteMemPool {
 public:
     inline rte_mbuf_t   * _rte_pktmbuf_alloc(rte_mempool_t * mp ){
         rte_mbuf_t   * m=rte_pktmbuf_alloc(mp);
-        if ( likely(m>0) ) {
+        if ( likely(m!=0) ) {
             return (m);
         }
         dump_in_case_of_error(stderr);
@@ -1064,9 +1177,11 @@ public:
             m = _rte_pktmbuf_alloc(m_mbuf_pool_512);
         }else if (size < _1024_MBUF_SIZE) {
             m = _rte_pktmbuf_alloc(m_mbuf_pool_1024);
-        }else{
-            assert(size<MAX_BUF_SIZE);
+        }else if (size < MAX_BUF_SIZE) {
             m = _rte_pktmbuf_alloc(m_big_mbuf_pool);
+        }else{
+            assert(size<=MAX_JUMBO_BUF_SIZE);
+            m = _rte_pktmbuf_alloc(m_mbuf_pool_9k);
         }
         return (m);
     }
@@ -1090,11 +1205,57 @@ public:
     rte_mempool_t *   m_mbuf_pool_256;  
     rte_mempool_t *   m_mbuf_pool_512;  
     rte_mempool_t *   m_mbuf_pool_1024;  
+    rte_mempool_t *   m_mbuf_pool_9k;    /* jumbo packets */
     rte_mempool_t *   m_mbuf_global_nodes;  
     uint32_t          m_pool_id;
 };
 
 
+/**
+ * const mbufs of the templates by content, per socket.
+ * templates (and directions) with the same payload bytes share one mbuf,
+ * each owner holds a reference of it. the templates are loaded in parallel,
+ * so get/put are under a lock, the DP only reads the mbufs
+ */
+class CConstMbufStore {
+public:
+    CConstMbufStore();
+    ~CConstMbufStore();
+
+    /* mbuf with a copy of p, the one of an earlier get in case of the same bytes */
+    rte_mbuf_t * get(socket_id_t socket,const char * p,uint16_t len);
+
+    /* release the reference of get */
+    void put(socket_id_t socket,rte_mbuf_t * m);
+
+    uint64_t get_saved_bytes(){
+        return (m_saved_bytes);
+    }
+    uint64_t get_shared_pkts(){
+        return (m_shared_pkts);
+    }
+    uint64_t get_total_bytes(){
+        return (m_total_bytes);
+    }
+
+private:
+    struct entry_t {
+        rte_mbuf_t * m_mbuf;
+        uint32_t     m_uses;
+    };
+    typedef std::map<uint64_t,std::vector<entry_t> > store_map_t; /* hash of the bytes */
+
+    static uint64_t hash(const char * p,uint16_t len);
+
+private:
+    pthread_mutex_t m_lock;
+    store_map_t     m_map[MAX_SOCKETS_SUPPORTED];
+    uint64_t        m_total_bytes;  /* allocated */
+    uint64_t        m_saved_bytes;  /* not allocated as they are shared */
+    uint64_t        m_shared_pkts;
+};
+
+
 
 
 class CGlobalInfo {
@@ -1169,6 +1330,7 @@ public:
 
 public:
     static CRteMemPool       m_mem_pool[MAX_SOCKETS_SUPPORTED];
+    static CConstMbufStore   m_const_store;
 
     static uint32_t          m_nodes_pool_size;     
     static CParserOption     m_options;
@@ -1245,11 +1407,30 @@ public:
 
 
 
+/* one latency stream, latency_streams in the traffic yaml */
+struct CLatencyStreamYamlInfo {
+    CLatencyStreamYamlInfo(){
+        m_rate=0.0;
+        m_size=0;
+        m_dscp=0;
+        m_vlan=0;
+    }
+    double          m_rate;  /* pkt/sec from each port, 0 is the -l rate */
+    uint16_t        m_size;  /* packet size without FCS and vlan tag, 0 is the default */
+    uint8_t         m_dscp;
+    uint16_t        m_vlan;  /* 802.1Q tag in the packet, 0 for none */
+
+public:
+    void Dump(FILE *fd);
+};
+
+
 struct CFlowYamlInfo {
     CFlowYamlInfo(){
         m_dpPkt=0;
         m_server_addr=0;
         m_cap_mode=false;
+        m_split_flows=false;
     }
     
     std::string     m_name;
@@ -1269,6 +1450,7 @@ struct CFlowYamlInfo {
     bool            m_cap_mode_was_set;
     bool            m_wlength_set;
     bool            m_limit_was_set;
+    bool            m_split_flows; /* every flow of the cap file is generated with its own tuple */
     CFlowYamlDynamicPyloadPlugin * m_dpPkt; /* plugin */
 
 public:
@@ -1324,7 +1506,8 @@ public:
         FLOW_FIF=1,
         FLOW_DEFER_PORT_RELEASE=2,
         FLOW_PKT_NAT=3,
-        FLOW_SYNC=4     /* called evey 1 msec */
+        FLOW_SYNC=4,     /* called evey 1 msec */
+        FLOW_PCAP_REPLAY=5 /* packets of the replay file, see CPcapReplay */
 
     };
 
@@ -1706,6 +1889,7 @@ public:
      */
     virtual int send_node(CGenNode * node);
 
+    virtual int send_mbuf(pkt_dir_t dir, rte_mbuf_t *m, dsec_t time);
 
 
     /**
@@ -1716,6 +1900,10 @@ public:
     virtual int flush_tx_queue(void);
 
 
+private:
+    int write_node_pkt(CGenNode * node,CFlowPktInfo * lp);
+    int write_mbuf(rte_mbuf_t *m, dsec_t time, uint8_t p_id);
+
 private:
     CFileWriterBase         * m_writer;
     CCapPktRaw              * m_raw;
@@ -1736,6 +1924,17 @@ static inline int fill_pkt(CCapPktRaw  * raw,rte_mbuf_t * m){
     return (0);
 }
 
+/* the buffers of the mbuf chain, false in case there are too many */
+static inline bool fill_pkt_segs(CCapPktSegs * pkt,rte_mbuf_t * m){
+    while (m != NULL) {
+        if ( !pkt->add(rte_pktmbuf_mtod(m, char *),m->data_len) ) {
+            return (false);
+        }
+        m = m->next;
+    }
+    return (true);
+}
+
 
 class CNullIF : public CVirtualIF {
 
@@ -1767,8 +1966,15 @@ public:
 };
 
 
+class CDpStatsSnapshot;
+class CDpHistSnapshot;
+
 class CNodeGenerator {
 public:
+    enum {
+        LATENESS_DIGITS = 2 /* the histogram is copied on each request of the master, keep it small */
+    };
+
     bool  Create(CFlowGenListPerThread  *  parent);
     void  Delete();
 
@@ -1809,7 +2015,10 @@ public:
 
 private:
     int   flush_one_node_to_file(CGenNode * node);
+    inline void flush_train(CGenNode * node);
     int   update_stats(CGenNode * node);
+    inline dsec_t wait_precise(dsec_t n_time,CFlowGenListPerThread * thread);
+    inline void   flush_precise(dsec_t n_time);
     FORCE_NO_INLINE void  handle_slow_messages(uint8_t type,
                                              CGenNode * node,
                                              CFlowGenListPerThread * thread,
@@ -1824,10 +2033,61 @@ public:
     CFlowGenListPerThread  *  m_parent;
     CPreviewMode              m_preview_mode;
     uint64_t                  m_cnt;
-    CTimeHistogram            m_realtime_his;  
+    CTimeHistogram            m_realtime_his; /* lateness of each event, LATENESS_DIGITS precision */
+    uint64_t                  m_late_cnt;     /* events more than 100usec late, each one pushed the schedule */
+    dsec_t                    m_late_offset;  /* total time the schedule was pushed */
+
+    bool                      m_is_precise;   /* precise pacing mode */
+    CTimeHistogram            m_ipg_err_his;  /* |sent gap - scheduled gap| of each packet, precise pacing */
+    hr_time_t                 m_last_tx_tick; /* 0 before the first packet */
+    dsec_t                    m_last_tx_time; /* scheduled time of the last packet */
+
+    CIdlePolicy               m_idle;         /* low power wait on long gaps */
+
+    bool                      m_is_tx_bp;     /* tx backpressure mode */
+    uint64_t                  m_tx_bp_cnt;    /* events that waited for the NIC */
+    dsec_t                    m_tx_bp_offset; /* total time the schedule was pushed by the NIC */
+    CDpHistSnapshot *         m_json_hist;    /* master side copy of dump_json, allocated on first use */
 };
 
 
+/* DP counters as seen by the master. published by the DP core each sync
+   tick, the master never reads the live counters of other cores.
+   scalars only, the histograms are in CDpHistSnapshot */
+class CDpStatsSnapshot {
+public:
+    void Clear();
+    void dump_lateness_json(int core,CDpHistSnapshot & hist,std::string & json);
+    void DumpLateness(int core,CDpHistSnapshot & hist,FILE *fd);
+public:
+    CFlowGenStats             m_stats;
+    CVirtualIFPerSideStats    m_if_stats[CS_NUM];
+    uint64_t                  m_late_cnt;
+    dsec_t                    m_late_offset;
+    uint64_t                  m_tpause_cnt;
+    uint64_t                  m_sleep_cnt;
+    uint64_t                  m_tx_bp_cnt;
+    dsec_t                    m_tx_bp_offset;
+    CDpCycleStats             m_cycle_stats;
+};
+
+/* DP histograms as seen by the master. copied by the DP core on the request
+   of the master, assigned only, never copy constructed */
+class CDpHistSnapshot {
+public:
+    CDpHistSnapshot() : m_realtime_his(CNodeGenerator::LATENESS_DIGITS),
+                        m_ipg_err_his(CNodeGenerator::LATENESS_DIGITS),
+                        m_wake_his(CNodeGenerator::LATENESS_DIGITS) {
+    }
+    void dump_json(std::string & json);
+public:
+    CTimeHistogram            m_realtime_his;
+    CTimeHistogram            m_ipg_err_his;
+    CTimeHistogram            m_wake_his;
+};
+
+
+
 class CPolicer {
 
 public:
@@ -2484,7 +2744,8 @@ public:
 
 class CFlowPktInfo {
 public:
-    bool Create(CPacketIndication  * pkt_ind);
+    /* is_ref: point to the packet memory of pkt_ind instead of a copy */
+    bool Create(CPacketIndication  * pkt_ind,bool is_ref=false);
     void Delete();
     void Dump(FILE *fd);
     inline void replace_tuple(CGenNode * node);
@@ -2524,6 +2785,23 @@ public:
      */
     void   mask_as_learn();
 
+    /* first packet of a TSO train, see CCapFileFlowInfo::update_tso */
+    bool is_tso_head(){
+        return (m_tso_segs>1);
+    }
+
+    /* const mbuf with only the payload, for a packet inside a TSO train */
+    void alloc_tso_mbuf();
+
+    rte_mbuf_t    *  get_tso_mbuf(socket_id_t socket_id){
+        return (m_tso_mbuf[socket_id]);
+    }
+
+    /* first packet of a packet train, see CCapFileFlowInfo::update_trains */
+    bool is_train_head(){
+        return (m_train_len>1);
+    }
+
 private:
     inline void append_big_mbuf(rte_mbuf_t * m,
                                               CGenNode * node);
@@ -2549,6 +2827,13 @@ public:
     CPacketIndication   m_pkt_indication;
     CCapPktRaw        * m_packet; 
     rte_mbuf_t        * m_big_mbuf[MAX_SOCKETS_SUPPORTED]; /* allocate big mbug per socket */
+
+    uint16_t            m_tso_segs;    /* first packet of a train, number of packets in it. 1 inside a train, 0 otherwise */
+    uint16_t            m_tso_mss;     /* payload of each packet of the train but the last */
+    uint32_t            m_tso_payload; /* payload of all the train */
+    rte_mbuf_t        * m_tso_mbuf[MAX_SOCKETS_SUPPORTED]; /* packet inside a train, payload only */
+
+    uint16_t            m_train_len;   /* first packet of a packet train, number of sends of its event (a TSO train is one send). 0 otherwise */
 };
 
 
@@ -2877,9 +3162,12 @@ inline void CFlowPktInfo::append_big_mbuf(rte_mbuf_t * m,
 
 inline rte_mbuf_t * CFlowPktInfo::do_generate_new_mbuf(CGenNode * node){
     rte_mbuf_t        * m;
+    DP_CYCLE_START(t_alloc);
     /* alloc small packet buffer*/
     m = CGlobalInfo::pktmbuf_alloc_small(node->get_socket_id());
     assert(m);
+    DP_CYCLE_END(t_alloc,cpMBUF_ALLOC);
+    DP_CYCLE_START(t_rewrite);
     uint16_t len= ( m_packet->pkt_len > FIRST_PKT_SIZE) ?FIRST_PKT_SIZE:m_packet->pkt_len;
     /* append*/
     char *p=rte_pktmbuf_append(m, len);
@@ -2891,6 +3179,7 @@ inline rte_mbuf_t * CFlowPktInfo::do_generate_new_mbuf(CGenNode * node){
     update_pkt_info(p,node);
 
     append_big_mbuf(m,node);
+    DP_CYCLE_END(t_rewrite,cpPKT_REWRITE);
 
     return m;
 }
@@ -2920,7 +3209,10 @@ inline rte_mbuf_t * CFlowPktInfo::do_generate_new_mbuf_big(CGenNode * node){
 inline rte_mbuf_t * CFlowPktInfo::generate_new_mbuf(CGenNode * node){
 
     if ( m_pkt_indication.m_desc.IsPluginEnable() ) {
-        return ( on_node_generate_mbuf( node->get_plugin_id(),node,this) );
+        DP_CYCLE_START(t_plugin);
+        rte_mbuf_t * m=on_node_generate_mbuf( node->get_plugin_id(),node,this);
+        DP_CYCLE_END(t_plugin,cpPLUGIN);
+        return (m);
     }
     return  (do_generate_new_mbuf(node));
 }
@@ -2940,29 +3232,39 @@ public:
         SIZE_512   = 512,
         SIZE_1024  = 1024,
         SIZE_2048  = 2048,
-        MASK_SIZE =6
+        SIZE_9K    = MAX_JUMBO_BUF_SIZE, /* the jumbo pool, not a power of 2 */
+        MASK_SIZE =7
       };
 
+  /* size of the mbufs of bucket i */
+  static int get_size(int i){
+      return ( (i<MASK_SIZE-1)?(SIZE_MIN<<i):SIZE_9K );
+  }
+
   void clear(){
       int i;
       for (i=0; i<CCCapFileMemoryUsage::MASK_SIZE; i++) {
           m_buf[i] = 0;
       }
       m_total_bytes=0;
+      m_saved_bytes=0;
+      m_shared_pkts=0;
   }
 
   void add_size(uint32_t size){
       m_total_bytes+=size;
-      int c_size=CCCapFileMemoryUsage::SIZE_MIN;
       int i;
-      for (i=0; i<CCCapFileMemoryUsage::MASK_SIZE; i++) {
-          if (size<c_size) {
+      for (i=0; i<CCCapFileMemoryUsage::MASK_SIZE-1; i++) {
+          if (size<(uint32_t)get_size(i)) {
               m_buf[i]+=1;
               return;
           }
-          c_size = c_size*2;
       }
-      printf("ERROR pkt size bigger than %d is not supported !\n",CCCapFileMemoryUsage::SIZE_2048);
+      if (size<=(uint32_t)SIZE_9K) {
+          m_buf[MASK_SIZE-1]+=1;
+          return;
+      }
+      printf("ERROR pkt size bigger than %d is not supported !\n",CCCapFileMemoryUsage::SIZE_9K);
       exit(1);
   }
   void dump(FILE *fd);
@@ -2972,9 +3274,46 @@ public:
 public:
     uint32_t m_buf[MASK_SIZE];
     uint64_t m_total_bytes;
+    uint64_t m_saved_bytes;  /* const payloads shared with another template, see CConstMbufStore */
+    uint64_t m_shared_pkts;
+};
+
+
+/* packet bytes of the flows of a split cap file, many packets in one block */
+class CCapPktStore {
+public:
+    enum {
+        BLOCK_SIZE = (1024*1024),
+        ALIGN      = 128       /* the DP expects the template packets aligned */
+    };
+
+    CCapPktStore(){
+        m_cur=0;
+        m_left=0;
+        m_total_bytes=0;
+    }
+
+    /* copy of the packet */
+    char * add(char * pkt,uint16_t len);
+
+    uint64_t get_total_bytes(){
+        return (m_total_bytes);
+    }
+
+    void Delete();
+
+private:
+    std::vector<char *> m_blocks;
+    char *              m_cur;
+    uint32_t            m_left;
+    uint64_t            m_total_bytes;
 };
 
 
+#define TSO_MAX_SEGS    16    /* packets in a TSO train */
+#define TSO_MAX_PAYLOAD 60000 /* payload of a TSO train, the IP total length is 16 bit */
+#define TRAIN_MAX_PKTS  32    /* packets sent by one event of a packet train */
+
 class CCapFileFlowInfo {
 public:
     bool Create();
@@ -2983,14 +3322,45 @@ public:
         return (m_flow_pkts.size());
     }
     inline CFlowPktInfo * GetPacket(uint32_t index);
-    void Append(CPacketIndication * pkt_indication);
+    void Append(CPacketIndication * pkt_indication,bool is_ref=false);
     void RemoveAll();
     void dump_pkt_sizes(void);
     int load_cap_file(std::string cap_file,uint16_t _id,uint8_t plugin_id);
 
+    /* load a multi flow cap file as a family, a template per flow with the offset of
+       its first packet in the file. the packets are kept in one store */
+    int load_cap_file_flows(std::string cap_file,uint16_t _id);
+
+    inline bool is_family(){
+        return (m_family.size()?true:false);
+    }
+    /* the flows to generate, this one in case it is not a family */
+    inline uint32_t get_family_size(){
+        return (is_family()?(uint32_t)m_family.size():1);
+    }
+    inline CCapFileFlowInfo * get_family_flow(uint32_t index){
+        return (is_family()?m_family[index]:this);
+    }
+    inline dsec_t get_family_start(uint32_t index){
+        return (is_family()?m_family_start[index]:0.0);
+    }
+
     /* update flow info */
     void update_info();
 
+    /* mark the TSO trains, call after update_info */
+    void update_tso();
+    uint32_t get_tso_trains(){
+        return (m_tso_trains);
+    }
+
+    /* mark the packet trains, packets of the same side that span up to gap are sent by one event.
+       call after update_tso */
+    void update_trains(dsec_t gap);
+    uint32_t get_trains(){
+        return (m_trains);
+    }
+
     bool is_valid_template_load_time(std::string & err);
 
     void save_to_erf(std::string cap_file_name,int pcap);
@@ -3013,6 +3383,11 @@ public:
         return (m_total_errors);
     }
 
+    /* packets of all the flows of a family */
+    inline uint64_t get_total_pkts(){
+        return (is_family()?m_total_pkts:Size());
+    }
+
     // return the cap file length in sec 
     double get_cap_file_length_sec();
 
@@ -3028,10 +3403,22 @@ public:
     void Dump(FILE *fd);
 
 private:
+    void update_pkts_ipg();
+
+private:
+    friend class CTemplateCache;
+
     std::vector<flow_pkt_info_t> m_flow_pkts;
     uint64_t                     m_total_bytes;
     uint64_t                     m_total_flows;
     uint64_t                     m_total_errors;
+    uint32_t                     m_tso_trains;
+    uint32_t                     m_trains;
+
+    std::vector<CCapFileFlowInfo *> m_family;      /* flows of a split cap file */
+    std::vector<dsec_t>             m_family_start;
+    uint64_t                        m_total_pkts;
+    CCapPktStore                    m_store;
 };
 
 
@@ -3065,6 +3452,9 @@ public:
     double          m_cap_overide_ipg;
     bool            m_cap_overide_ipg_set;
 
+    double          m_cap_train_gap;
+    bool            m_cap_train_gap_set;
+
     uint32_t        m_wlength;
     bool            m_wlength_set;
 
@@ -3073,6 +3463,7 @@ public:
     bool            m_mac_replace_by_ip;
 
     CVlanYamlInfo   m_vlan_info;
+    std::vector     <CLatencyStreamYamlInfo> m_latency_streams;
     CTupleGenYamlInfo m_tuple_gen;
     bool              m_tuple_gen_was_set;
 
@@ -3163,9 +3554,11 @@ public:
 class CFlowGeneratorRec {
 
 public:
+    /* cache: load the template from it instead of the cap file */
     bool Create(CFlowYamlInfo * info,
                 CFlowsYamlInfo * flow_info,
-                uint16_t _id);
+                uint16_t _id,
+                CTemplateCache * cache=0);
     void Delete();
 public:
     
@@ -3178,7 +3571,7 @@ public:
     CPolicer         m_policer;   
     uint16_t         m_id;
 private: 
-    void fixup_ipg_if_needed();
+    void fixup_ipg_if_needed(CCapFileFlowInfo * flow_info);
 };
 
 class CPPSMeasure {
@@ -3312,6 +3705,18 @@ public:
         return ( m_cpu_cp_u.GetVal());
     }
 
+    /* DP side, copy the live counters into the snapshot block and the
+       histograms in case the master asked for them */
+    void publish_stats(void);
+
+    /* master side, consistent copy of the last published counters */
+    void get_stats_snapshot(CDpStatsSnapshot & snap){
+        m_stats_snapshot.read(snap);
+    }
+
+    /* master side, copy of the histograms made on the previous request */
+    void get_hist_snapshot(CDpHistSnapshot & hist);
+
 private:
     void check_msgs(void);
     void handel_nat_msg(CGenNodeNatInfo * msg);
@@ -3319,6 +3724,9 @@ private:
 
     void terminate_nat_flows(CGenNode *node);
 
+    bool start_replay(void);
+    void stop_replay(void);
+
 
     void init_from_global(CClientPortion &);
     void defer_client_port_free(CGenNode *p);
@@ -3381,15 +3789,21 @@ public:
     CBwMeasure                       m_mb_sec;
     CCpuUtlDp                        m_cpu_dp_u;
     CCpuUtlCp                        m_cpu_cp_u;
+    CDpCycleStats                    m_cycle_stats;
 
 private:
     CGenNodeDeferPort     *          m_tcp_dpc;
     CGenNodeDeferPort     *          m_udp_dpc;
 
+    CPcapReplay *                    m_replay; /* replay of a capture file, NULL for none */
+
     CNodeRing *                      m_ring_from_rx; /* ring latency thread -> dp */
     CNodeRing *                      m_ring_to_rx;   /* ring dp -> latency thread */
 
     flow_id_node_t                   m_flow_id_to_node_lookup;
+
+    CSeqLockSnapshot<CDpStatsSnapshot> m_stats_snapshot; /* written by DP, read by master */
+    CRequestSnapshot<CDpHistSnapshot>  m_hist_snapshot;  /* copied by DP on the request of the master */
 };
 
 inline CGenNode * CFlowGenListPerThread::create_node(void){
@@ -3423,6 +3837,46 @@ typedef struct mac_mapping_ {
     uint32_t         ip;
 } mac_mapping_t;
 
+/* runs a job on the cores that are free at init time, the template loading of CFlowGenList */
+class CParallelJobRunner {
+public:
+    virtual ~CParallelJobRunner(){
+    }
+    virtual uint32_t get_workers()=0;
+    /* call func(arg) on every worker, returns when all of them are done */
+    virtual void run(void (*func)(void *),void * arg)=0;
+};
+
+/* posix threads, the caller is one of the workers */
+class CPthreadJobRunner : public CParallelJobRunner {
+public:
+    CPthreadJobRunner(uint32_t workers){
+        m_workers=workers?workers:1;
+    }
+    virtual uint32_t get_workers(){
+        return (m_workers);
+    }
+    virtual void run(void (*func)(void *),void * arg);
+private:
+    uint32_t m_workers;
+};
+
+/* startup time per phase of load_from_yaml, msec */
+struct CFlowGenLoadTimes {
+    dsec_t   m_yaml;
+    dsec_t   m_templates;      /* wall time */
+    dsec_t   m_templates_work; /* sum of the time of each template */
+    dsec_t   m_cache_save;
+    dsec_t   m_total;
+    uint32_t m_workers;
+    bool     m_from_cache;
+
+    void Clear(){
+        memset(this,0,sizeof(*this));
+    }
+    void Dump(FILE *fd);
+};
+
 class CFlowGenList {
 
 public:
@@ -3435,7 +3889,8 @@ public:
 
 public:
 
-    int load_from_yaml(std::string csv_file,uint32_t num_threads);
+    /* runner: loads the templates in parallel, a thread per DP thread in case it is not given */
+    int load_from_yaml(std::string csv_file,uint32_t num_threads,CParallelJobRunner * runner=0);
     int load_from_mac_file(std::string csv_file);
 public:
     void Dump(FILE *fd);
@@ -3443,6 +3898,12 @@ public:
     void DumpPktSize();
     void Update();
     double GetCpuUtil();
+    /* scheduling lateness of all the DP cores */
+    void DumpLateness(FILE *fd);
+    void dump_lateness_json(std::string & json);
+    /* cycles per phase of all the DP cores, TREX_CYCLE_STATS */
+    void DumpCycles(FILE *fd);
+    void dump_cycles_json(std::string & json);
 
 public:
     double get_total_kcps();
@@ -3460,6 +3921,14 @@ public:
     std::vector<CFlowGenListPerThread   *> m_threads_info;  
     bool                             is_mac_info_configured;
     std::map<uint32_t, mac_addr_align_t>    m_mac_info;  /* global mac info loaded form mac_file*/
+    CTemplateCache                   m_tmpl_cache; /* memory of the templates in case they were loaded from cache */
+    CFlowGenLoadTimes                m_load_times;
+    /* copies of the DP snapshots, one per reader thread and reused. the console
+       dumps are called by the master, the json by the telemetry sampler */
+    CDpStatsSnapshot                 m_snap;
+    CDpStatsSnapshot                 m_json_snap;
+    CDpHistSnapshot                  m_hist;
+    CDpHistSnapshot                  m_json_hist;
 };
 
 
@@ -3477,7 +3946,9 @@ inline void CCapFileFlowInfo::generate_flow(CTupleTemplateGeneratorSmart   * tup
 
     node->m_type=CGenNode::FLOW_PKT;
     CTupleBase  tuple;
+    DP_CYCLE_START(t_tuple);
     tuple_gen->GenerateTuple(tuple);
+    DP_CYCLE_END(t_tuple,cpTUPLE_GEN);
 
     /* add the first packet of the flow */
     CFlowPktInfo *  lp=GetPacket((uint32_t)0);
@@ -3563,7 +4034,11 @@ inline void CFlowGeneratorRecPerThread::generate_flow(CNodeGenerator * gen,
 
 class CLatencyPktInfo {
 public:
-    void Create();
+    enum {
+        MAX_STREAM_PKT_SIZE = 1514 /* without FCS and vlan tag */
+    };
+    /* stream NULL for the default packet */
+    bool Create(const CLatencyStreamYamlInfo * stream=0);
     void Delete();
     void set_ip(uint32_t src,
                 uint32_t dst,
@@ -3582,6 +4057,11 @@ public:
         return ( m_packet->pkt_len );
     }
 
+    /* size of the packet as seen by the rx port, without the vlan tag */
+    uint16_t get_rx_pkt_size(void){
+        return ( m_packet->pkt_len - m_pkt_indication.m_ip_offset + 14 );
+    }
+
 private:
     ipaddr_t            m_client_ip;
     ipaddr_t            m_server_ip;
@@ -3594,17 +4074,34 @@ private:
 };
 
 
-#define LATENCY_MAGIC 0x12345600
+#define LATENCY_MAGIC       0x12345600
+#define LATENCY_MAGIC_MASK  0xffffff00
+#define MAX_LATENCY_STREAMS 1024 /* per port. only the configured streams are allocated */
 
+/* the header is the first 16 bytes of the SCTP payload. the stream id is in
+   the low 16 bits of the SCTP verification tag, the 4 bytes before the header,
+   so it is in the first mbuf segment also with a vlan tag */
 struct  latency_header {
 
     uint64_t time_stamp;
-    uint32_t magic;
-    uint32_t seq;
+    uint32_t magic;     /* LATENCY_MAGIC | port id */
+    uint32_t seq;       /* per port and stream */
 
     uint8_t get_id(){
         return( magic & 0xff);
     }
+    static uint32_t get_magic(uint8_t port_id){
+        return ( LATENCY_MAGIC | port_id );
+    }
+    uint16_t get_stream_id(){
+        uint8_t * p=(uint8_t *)this-2;
+        return ( (p[0]<<8) | p[1] );
+    }
+    void set_stream_id(uint16_t stream_id){
+        uint8_t * p=(uint8_t *)this-2;
+        p[0]=stream_id>>8;
+        p[1]=stream_id & 0xff;
+    }
 };
 
 
@@ -3639,16 +4136,72 @@ private:
 
 
 class CLatencyManager ;
+
+// per port and latency stream
+class CCPortLatencyStream {
+public:
+    enum {
+        HIST_DIGITS = 2 /* many streams per port, keep the histogram small (~21KB) */
+    };
+    CCPortLatencyStream() : m_hist(HIST_DIGITS) {
+    }
+    void Create(uint16_t pkt_size);
+    void Delete();
+    void reset();
+
+    uint32_t get_jitter_usec(void){
+        return ((uint32_t)(m_jitter.get_jitter()*1000000.0));
+    }
+    uint64_t get_errors(){
+        return ( m_seq_error+m_length_error );
+    }
+
+    void dump_json(uint16_t id,std::string & json);
+    void Dump(uint16_t id,FILE *fd);
+    static void DumpHeader(FILE *fd);
+
+public:
+     uint32_t m_tx_seq;
+     uint32_t m_rx_seq;
+     uint16_t m_pkt_size;  /* expected size on rx, without vlan tag */
+     uint16_t m_tx_offset; /* latency header offset in m_tx_tmpl */
+     uint32_t m_tx_tmpl_ip;/* nat external ip m_tx_tmpl was built with */
+     rte_mbuf_t * m_tx_tmpl; /* ready packet of this port, cloned on each send */
+
+     uint64_t m_tx_pkt_ok;
+     uint64_t m_tx_pkt_err;  /* tx queue was full */
+     uint64_t m_tx_pkt_drop; /* not sent, the latency thread was late */
+     uint64_t m_pkt_ok;
+     uint64_t m_seq_error;
+     uint64_t m_length_error;
+     CTimeHistogram  m_hist;
+     CJitter         m_jitter;
+};
+
 // per port 
 class CCPortLatency {
 public:
+    CCPortLatency(){
+        m_streams=0;
+        m_num_streams=0;
+        m_max_streams=0;
+    }
+    /* the streams and their histograms are allocated here, max_streams at once */
     bool Create(CLatencyManager * parent,
                 uint8_t id,
                 uint16_t offset,
-                uint16_t pkt_size,
-                CCPortLatency * rx_port
+                CCPortLatency * rx_port,
+                uint16_t max_streams=1
                 );
     void Delete();
+    /* streams are added in the order of their id, up to max_streams. no allocation */
+    void add_stream(uint16_t pkt_size);
+    uint16_t get_num_streams(){
+        return (m_num_streams);
+    }
+    CCPortLatencyStream * get_stream(uint16_t stream_id){
+        return (&m_streams[stream_id]);
+    }
     void reset();
     bool can_send_packet(){
         if ( !CGlobalInfo::is_learn_mode() ) {
@@ -3660,7 +4213,17 @@ public:
         return (m_nat_external_ip);
     }
 
-    void update_packet(rte_mbuf_t * m);
+    /* offset of the latency header in m, depends on the stream template */
+    void update_packet(rte_mbuf_t * m,uint16_t stream_id,uint16_t offset);
+
+    /* keep m as the ready packet of the stream, m is owned by the port */
+    void set_tx_template(uint16_t stream_id,rte_mbuf_t * m,uint16_t offset,uint32_t nat_ip);
+    bool is_tx_template_valid(uint16_t stream_id){
+        CCPortLatencyStream * lps=get_stream(stream_id);
+        return ( (lps->m_tx_tmpl!=0) && (lps->m_tx_tmpl_ip==m_nat_external_ip) );
+    }
+    /* copy of the ready packet with a new seq/timestamp, NULL if there is no mbuf */
+    rte_mbuf_t * clone_tx_packet(uint16_t stream_id);
 
     bool do_learn(uint32_t external_ip);
 
@@ -3677,6 +4240,7 @@ public:
     void DumpShort(FILE *fd);
     void dump_json(std::string & json );
     void dump_json_v2(std::string & json );
+    void dump_bin(CTelemetryBinEncoder & enc,uint16_t rec);
 
     uint32_t get_jitter_usec(void){
         return ((uint32_t)(m_jitter.get_jitter()*1000000.0));
@@ -3710,19 +4274,18 @@ private:
      bool              m_nat_can_send;
      uint32_t          m_nat_external_ip;
 
-     uint32_t m_tx_seq;
-     uint32_t m_rx_seq;
-
      uint8_t  m_pad;
      uint8_t  m_id;
-     uint16_t m_offset;
+     uint16_t m_offset;   /* latency header offset on rx, without vlan */
 
-     uint16_t m_pkt_size;
-     uint16_t pad1[3];
+     CCPortLatencyStream * m_streams; /* m_max_streams, index is the stream id */
+     uint16_t m_num_streams;
+     uint16_t m_max_streams;
 
 public:
      uint64_t m_tx_pkt_ok;
-     uint64_t m_tx_pkt_err;
+     uint64_t m_tx_pkt_err;  /* tx queue was full */
+     uint64_t m_tx_pkt_drop; /* not sent, the latency thread was late */
 
      uint64_t m_pkt_ok;
      uint64_t m_unsup_prot;
@@ -3734,7 +4297,7 @@ public:
 
 
      uint64_t m_length_error;
-     CTimeHistogram  m_hist; /* all window */
+     CTimeHistogram  m_hist; /* all window, all the streams */
      CJitter         m_jitter; 
 };
 
@@ -3742,6 +4305,18 @@ public:
 class CPortLatencyHWBase {
 public:
     virtual int tx(rte_mbuf_t * m)=0;
+    /* return the number of packets that were sent, the caller should free the rest.
+       the default is for ports that keep m in case tx() fails */
+    virtual uint16_t tx_burst(rte_mbuf_t ** tx_pkts,
+                              uint16_t nb_pkts){
+        uint16_t i;
+        for (i=0; i<nb_pkts; i++) {
+            if ( tx(tx_pkts[i]) != 0 ) {
+                break;
+            }
+        }
+        return (i);
+    }
     virtual rte_mbuf_t * rx()=0;
     virtual uint16_t rx_burst(struct rte_mbuf **rx_pkts, 
                                uint16_t nb_pkts){
@@ -3765,10 +4340,21 @@ public:
     ipaddr_t             m_client_ip;
     ipaddr_t             m_server_ip;
     uint32_t             m_dual_port_mask;
+    std::vector<CLatencyStreamYamlInfo> m_streams; /* empty for one default stream at m_cps */
 
 };
 
 
+/* one latency stream, the same template is sent from all the ports */
+class CLatencyStream {
+public:
+    CLatencyPktInfo        m_pkt_gen;
+    double                 m_delta_sec; /* 1/rate */
+};
+
+
+#define MAX_LATENCY_TX_BURST 32
+#define LATENCY_RX_PENDING_SEC 0.010 /* a latency packet not received after it is lost */
 
 class CLatencyManagerPerPort {
 public:
@@ -3776,6 +4362,10 @@ public:
      CPortLatencyHWBase  *  m_io;
      uint32_t               m_flag;
 
+     /* packets of this tick, sent in one burst */
+     uint16_t               m_tx_cnt;
+     uint16_t               m_tx_stream[MAX_LATENCY_TX_BURST];
+     rte_mbuf_t *           m_tx_pkts[MAX_LATENCY_TX_BURST];
 };
 
 
@@ -3793,7 +4383,10 @@ public:
     void set_ip(uint32_t client_ip,
                 uint32_t server_ip,
                 uint32_t mask_dual_port){
-        m_pkt_gen.set_ip(client_ip,server_ip,mask_dual_port);
+        int i;
+        for (i=0; i<(int)m_streams.size(); i++) {
+            m_streams[i]->m_pkt_gen.set_ip(client_ip,server_ip,mask_dual_port);
+        }
     }
 
 public:
@@ -3803,12 +4396,13 @@ public:
     void DumpRxCheck(FILE *fd); // dump all
     void DumpShortRxCheck(FILE *fd); // dump short histogram of latency 
     void rx_check_dump_json(std::string & json);
-    uint16_t get_latency_header_offset(){
-        return ( m_pkt_gen.get_payload_offset() );
-    }
+    /* latency header offset of a latency packet, the stream template may have a vlan tag */
+    static uint16_t get_latency_header_offset(rte_mbuf_t * m);
     void update();
     void dump_json(std::string & json ); // dump to json 
     void dump_json_v2(std::string & json );
+    /* compact binary telemetry, see telemetry_bin.h */
+    void dump_bin(std::string & buf,uint32_t seq,uint64_t time_usec);
 
 
 
@@ -3827,7 +4421,10 @@ public:
     }
 
 private:
-    void  send_pkt_all_ports();
+    void  add_pkt_all_ports(uint16_t stream_id);
+    void  flush_tx();
+    void  drop_pkt_all_ports(uint16_t stream_id,uint64_t cnt);
+    bool  is_rx_pending(double c_time);
     void  try_rx();
     void  try_rx_queues();
     void  run_rx_queue_msgs(uint8_t thread_id,
@@ -3835,6 +4432,7 @@ private:
 	void  wait_for_rx_dump();
     void  handle_rx_pkt(CLatencyManagerPerPort * lp,
                         rte_mbuf_t * m);
+    void  close_rx_capture();
 
 
 private:
@@ -3847,7 +4445,7 @@ private:
 private:
      pqueue_t                m_p_queue; /* priorty queue */
      bool                    m_is_active;
-     CLatencyPktInfo         m_pkt_gen;
+     std::vector<CLatencyStream *> m_streams; /* index is the stream id */
      CLatencyManagerPerPort  m_ports[MAX_LATENCY_PORTS];
      uint64_t                m_d_time; // calc tick betwen sending 
      double                  m_cps;
@@ -3859,6 +4457,10 @@ private:
      CNatRxManager           m_nat_check_manager;
      CCpuUtlDp               m_cpu_dp_u;
      CCpuUtlCp               m_cpu_cp_u;
+     CTimeHistogram          m_hist_all;      /* all the ports merged, built by dump_json_v2 */
+     CIdlePolicy             m_idle;          /* low power wait between ticks */
+     double                  m_last_tx_sec;   /* time of the last burst */
+     CRxCapture *            m_rx_capture;    /* NULL when the capture is disabled */
 
      volatile bool           m_do_stop __rte_cache_aligned ;
 
@@ -3889,6 +4491,11 @@ inline bool CGenNode::is_repeat_flow(){
 }
 
 inline void CGenNode::update_next_pkt_in_flow(void){
+        if ( unlikely( m_pkt_info->is_tso_head() ) ) {
+            /* the train was sent by its first packet, continue from the last one */
+            m_pkt_info = m_flow_info->GetPacket(m_pkt_info->m_pkt_indication.m_packet->pkt_cnt+
+                                                m_pkt_info->m_tso_segs-2);
+        }
         if ( likely ( m_pkt_info->m_pkt_indication.m_desc.IsPcapTiming()) ){
             m_time     += m_pkt_info->m_pkt_indication.m_cap_ipg ;
         }else{
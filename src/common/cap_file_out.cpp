@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "cap_file_out.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+CCapFileOut::CCapFileOut(){
+    m_fd = -1;
+    m_buf[0] = NULL;
+    m_buf[1] = NULL;
+    m_len = 0;
+    m_cur = 0;
+    m_thread_started = false;
+    m_pending = NULL;
+    m_pending_len = 0;
+    m_exit = false;
+    m_error = false;
+    pthread_mutex_init(&m_lock,NULL);
+    pthread_cond_init(&m_cond,NULL);
+}
+
+CCapFileOut::~CCapFileOut(){
+    Close();
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+bool CCapFileOut::Create(char * name){
+    m_fd = open(name,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if (m_fd < 0) {
+        printf(" ERROR create file \n");
+        return (false);
+    }
+    int i;
+    for (i=0; i<2; i++) {
+        if ( posix_memalign((void **)&m_buf[i],BUF_ALIGN,BUF_SIZE) != 0 ) {
+            m_buf[i] = NULL;
+            Close();
+            return (false);
+        }
+    }
+    m_len = 0;
+    m_cur = 0;
+    m_pending = NULL;
+    m_exit = false;
+    m_error = false;
+    m_thread_started = (pthread_create(&m_thread,NULL,writer_thread,this) == 0);
+    return (true);
+}
+
+bool CCapFileOut::write_buf(char * p,uint32_t len){
+    while (len > 0) {
+        ssize_t n = write(m_fd,p,len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (false);
+        }
+        p   += n;
+        len -= (uint32_t)n;
+    }
+    return (true);
+}
+
+void * CCapFileOut::writer_thread(void * obj){
+    ((CCapFileOut *)obj)->writer();
+    return (NULL);
+}
+
+void CCapFileOut::writer(){
+    pthread_mutex_lock(&m_lock);
+    while (true) {
+        while ( (m_pending == NULL) && !m_exit ) {
+            pthread_cond_wait(&m_cond,&m_lock);
+        }
+        if (m_pending == NULL) {
+            break;
+        }
+        char *   p   = m_pending;
+        uint32_t len = m_pending_len;
+        pthread_mutex_unlock(&m_lock);
+        bool res = write_buf(p,len);
+        pthread_mutex_lock(&m_lock);
+        if (!res) {
+            m_error = true;
+        }
+        m_pending = NULL;
+        pthread_cond_broadcast(&m_cond);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+/* give the current buffer to the thread, continue on the other one once the thread is done with it */
+bool CCapFileOut::swap(){
+    if (m_len == 0) {
+        return (!m_error);
+    }
+    if (!m_thread_started) {
+        bool res = write_buf(m_buf[m_cur],m_len);
+        m_len = 0;
+        if (!res) {
+            m_error = true;
+        }
+        return (res);
+    }
+    pthread_mutex_lock(&m_lock);
+    while (m_pending != NULL) {
+        pthread_cond_wait(&m_cond,&m_lock);
+    }
+    bool res = !m_error;
+    if (res) {
+        m_pending     = m_buf[m_cur];
+        m_pending_len = m_len;
+        pthread_cond_broadcast(&m_cond);
+    }
+    pthread_mutex_unlock(&m_lock);
+    m_cur ^= 1;
+    m_len = 0;
+    return (res);
+}
+
+bool CCapFileOut::Close(){
+    bool res = true;
+    if (m_fd >= 0) {
+        res = swap();
+        if (m_thread_started) {
+            pthread_mutex_lock(&m_lock);
+            m_exit = true;
+            pthread_cond_broadcast(&m_cond);
+            pthread_mutex_unlock(&m_lock);
+            pthread_join(m_thread,NULL);
+            m_thread_started = false;
+        }
+        if (m_error) {
+            res = false;
+        }
+        close(m_fd);
+        m_fd = -1;
+    }
+    free(m_buf[0]);
+    free(m_buf[1]);
+    m_buf[0] = NULL;
+    m_buf[1] = NULL;
+    m_len = 0;
+    return (res);
+}
@@ -0,0 +1,86 @@
+#ifndef __CAP_FILE_OUT_H__
+#define __CAP_FILE_OUT_H__
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * output of the capture file writers.
+ * the records are built in place in one of two big page aligned buffers, a
+ * full buffer is written by a background thread while the other one is
+ * filled. in case the thread can't be created the buffer is written inline.
+ * a write error is reported by the next reserve and by Close
+ */
+class CCapFileOut {
+public:
+    enum {
+        BUF_SIZE  = (4*1024*1024),
+        BUF_ALIGN = 4096
+    };
+
+    CCapFileOut();
+    ~CCapFileOut();
+
+    bool Create(char * name);
+
+    /* room for size bytes in the buffer, NULL in case of a write error */
+    inline char * reserve(uint32_t size){
+        if ( m_len + size > BUF_SIZE ) {
+            if ( !swap() ) {
+                return (NULL);
+            }
+        }
+        char * p = m_buf[m_cur]+m_len;
+        m_len += size;
+        return (p);
+    }
+
+    /* write the rest and close, false in case a write failed */
+    bool Close();
+
+    bool is_open(){
+        return (m_fd >= 0);
+    }
+
+private:
+    CCapFileOut(CCapFileOut &);
+
+    bool swap();
+    bool write_buf(char * p,uint32_t len);
+    static void * writer_thread(void * obj);
+    void writer();
+
+private:
+    int             m_fd;
+    char *          m_buf[2];
+    uint32_t        m_len;          /* used bytes of the current buffer */
+    uint8_t         m_cur;
+    bool            m_thread_started;
+
+    /* hand off to the writer thread, under m_lock */
+    pthread_t       m_thread;
+    pthread_mutex_t m_lock;
+    pthread_cond_t  m_cond;
+    char *          m_pending;      /* buffer of the thread, NULL when it is idle */
+    uint32_t        m_pending_len;
+    bool            m_exit;
+    bool            m_error;
+};
+
+#endif
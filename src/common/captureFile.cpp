@@ -16,6 +16,7 @@ limitations under the License.
 #include "captureFile.h"
 #include "pcap.h"
 #include "erf.h"
+#include "pcapng.h"
 #include "basic_utils.h"
 #include <stdlib.h>
 #include <errno.h>
@@ -50,7 +51,7 @@ CCapPktRaw::CCapPktRaw(CCapPktRaw  *obj){
     pkt_len=obj->pkt_len;
     time_sec=obj->time_sec;
     time_nsec=obj->time_nsec;
-    assert ((pkt_len>0) && (pkt_len<MAX_PKT_SIZE) );
+    assert ((pkt_len>0) && (pkt_len<=MAX_PKT_SIZE) );
     raw = (char *)m_handle.malloc(pkt_len,PKT_ALIGN);
     // copy the packet 
     memcpy(raw,obj->raw,pkt_len);
@@ -103,6 +104,18 @@ char * CCapPktRaw::append(uint16_t len){
 }
 
 
+void CCapPktRaw::own_raw(){
+    if ( !is_ref_raw() ) {
+        return;
+    }
+    m_handle.free();
+    char * p = (char *)m_handle.malloc((uint16_t)MAX_PKT_SIZE,PKT_ALIGN);
+    memcpy(p,raw,pkt_len);
+    raw = p;
+    btSetMaskBit16(flags,1,1,0);
+}
+
+
 void CCapPktRaw::CloneShalow(CCapPktRaw  *obj){
     pkt_len=obj->pkt_len;
     raw = obj->raw;
@@ -245,9 +258,12 @@ CCapReaderBase * CCapReaderFactory::CreateReader(char * name, int loops)
     // close the file
     fclose(f);
 
-    for (capture_type_e i = LIBPCAP ; i<LAST_TYPE ; i = (capture_type_e(i+1)) )
+    /* map the file if possible, the stream readers are the fallback */
+    static const capture_type_e reader_order[] = { LIBPCAP_MMAP, LIBPCAP, PCAPNG, ERF };
+
+    for (int i = 0 ; i < (int)(sizeof(reader_order)/sizeof(reader_order[0])) ; i++ )
 	{
-		CCapReaderBase * next = CCapReaderFactory::CreateReaderInstace(i);
+		CCapReaderBase * next = CCapReaderFactory::CreateReaderInstace(reader_order[i]);
 		if (next == NULL || next->Create(name,loops)) {
 			return next;
 		}
@@ -255,7 +271,7 @@ CCapReaderBase * CCapReaderFactory::CreateReader(char * name, int loops)
 	}
 
     printf("\nERROR: file %s format not supported",name);
-    printf("\nERROR: formats supported are LIBPCAP and ERF. other formats are deprecated\n\n");
+    printf("\nERROR: formats supported are LIBPCAP, PCAPNG and ERF. other formats are deprecated\n\n");
 
 	return NULL;
 }
@@ -268,6 +284,10 @@ CCapReaderBase * CCapReaderFactory::CreateReaderInstace(capture_type_e type)
 		return new CErfFileReader();
 	case LIBPCAP:
 		return new LibPCapReader();
+	case LIBPCAP_MMAP:
+		return new LibPCapMmapReader();
+	case PCAPNG:
+		return new CPcapNgReader();
 	default:
 		printf("Got unsupported file type\n");
 		return NULL;
@@ -277,6 +297,21 @@ CCapReaderBase * CCapReaderFactory::CreateReaderInstace(capture_type_e type)
 
 
 	
+bool CFileWriterBase::write_packet_segs(const CCapPktSegs & pkt)
+{
+    if (pkt.pkt_len > MAX_PKT_SIZE) {
+        return false;
+    }
+    CCapPktRaw raw(MAX_PKT_SIZE);
+    pkt.copy_to(raw.raw);
+    raw.pkt_len   = pkt.pkt_len;
+    raw.time_sec  = pkt.time_sec;
+    raw.time_nsec = pkt.time_nsec;
+    raw.setInterface(pkt.getInterface());
+    return write_packet(&raw);
+}
+
+
 /**
  * The factory function will create the matching reader instance
  * according to the type.
@@ -320,6 +355,8 @@ CFileWriterBase  * CCapWriterFactory::createWriterInsance(capture_type_e type )
 		return new LibPCapWriter();
 	case ERF:
 		return new CErfFileWriter();
+	case PCAPNG:
+		return new CPcapNgWriter();
 		// other is not supported yet.
 	default:
 		return NULL;
@@ -24,6 +24,7 @@ limitations under the License.
 #include <math.h>
 #include <stdlib.h>
 #include <string>
+#include <string.h>
 #ifdef WIN32
 #pragma warning(disable:4786)
 #endif
@@ -32,10 +33,12 @@ limitations under the License.
 typedef enum capture_type {
 	LIBPCAP,
 	ERF,
+	PCAPNG,
+	LIBPCAP_MMAP, /* reader only */
 	LAST_TYPE
 } capture_type_e;
 
-#define MAX_PKT_SIZE (2048)
+#define MAX_PKT_SIZE (9216) /* jumbo frames */
 
 #define READER_MAX_PACKET_SIZE MAX_PKT_SIZE
 
@@ -145,6 +148,19 @@ public:
         return ( ( btGetMaskBit16(flags,0,0) ? true:false) );
     }
 
+    /* raw points to the memory of the reader (zero copy), the own buffer is kept */
+    void set_ref_raw(char * p){
+        raw = p;
+        btSetMaskBit16(flags,1,1,1);
+    }
+
+    bool is_ref_raw(){
+        return ( ( btGetMaskBit16(flags,1,1) ? true:false) );
+    }
+
+    /* copy a referenced packet to an own buffer of MAX_PKT_SIZE, to change it in place */
+    void own_raw();
+
     bool Compare(CCapPktRaw * obj,int dump,double dsec);
 
     
@@ -212,6 +228,65 @@ private:
 	static CCapReaderBase * CreateReaderInstace(capture_type_e type);
 };
 
+/**
+ * a packet as a list of segments (the buffers of an mbuf chain), the writer
+ * copies the segments to the file without a CCapPktRaw in the middle
+ */
+class CCapPktSegs {
+public:
+    enum {
+        MAX_SEGS = 8
+    };
+
+    CCapPktSegs(){
+        time_sec  = 0;
+        time_nsec = 0;
+        pkt_len   = 0;
+        m_if      = 0;
+        m_cnt     = 0;
+    }
+
+    /* false in case there are too many segments */
+    bool add(const char * p,uint16_t len){
+        if (m_cnt == MAX_SEGS) {
+            return (false);
+        }
+        m_seg[m_cnt]     = p;
+        m_seg_len[m_cnt] = len;
+        m_cnt++;
+        pkt_len += len;
+        return (true);
+    }
+
+    void setInterface(uint8_t _if){
+        m_if = _if;
+    }
+
+    uint8_t getInterface() const {
+        return (m_if);
+    }
+
+    /* copy the packet to p, pkt_len bytes */
+    void copy_to(char * p) const {
+        int i;
+        for (i=0; i<m_cnt; i++) {
+            memcpy(p,m_seg[i],m_seg_len[i]);
+            p += m_seg_len[i];
+        }
+    }
+
+public:
+    uint32_t     time_sec;
+    uint32_t     time_nsec;
+    uint16_t     pkt_len;
+private:
+    uint8_t      m_if;
+    uint8_t      m_cnt;
+    const char * m_seg[MAX_SEGS];
+    uint16_t     m_seg_len[MAX_SEGS];
+};
+
+
 /**
  * Interface for capture file writer.
  *
@@ -224,6 +299,9 @@ public:
 	virtual bool Create(char * name) = 0;
     virtual bool write_packet(CCapPktRaw * lpPacket)=0;
 
+    /* write a packet from its segments, by default it is copied to a CCapPktRaw */
+    virtual bool write_packet_segs(const CCapPktSegs & pkt);
+
 };
 
 
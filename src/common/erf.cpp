@@ -222,9 +222,7 @@ int erf_read(wtap *wth,char *p,uint32_t *sec,uint32_t *nsec)
 
 
 bool CErfFileWriter::Create(char *file_name){
-    m_fd=CAP_FOPEN_64(file_name,"wb");
-    if (m_fd==0) {
-        printf(" ERROR create file \n");
+    if (!m_out.Create(file_name)) {
         return(false);
     }
     m_cnt=0;
@@ -232,10 +230,7 @@ bool CErfFileWriter::Create(char *file_name){
 }
 
 void CErfFileWriter::Delete(){
-    if (m_fd) {
-       fclose(m_fd);
-       m_fd=0;
-    }
+    m_out.Close();
 }
 
 
@@ -243,19 +238,18 @@ typedef struct erf_dummy_header_ {
     uint16_t dummy;
 }erf_dummy_header_t ;
 
-static uint32_t frame_check[20];
-
 bool CErfFileWriter::write_packet(CCapPktRaw * lpPacket){
-    erf_header_t header;
-    erf_dummy_header_t dummy;
-    
-    dummy.dummy =0;
-    memset(&header,0,sizeof(erf_header_t));
-    double nsec_frac = 4294967295.9 *(lpPacket->time_nsec /1000000000.0);
-    uint64_t ts= (((uint64_t)lpPacket->time_sec) <<32) +((uint32_t)nsec_frac);
-    header.ts =ts;
+    CCapPktSegs pkt;
+    pkt.add(lpPacket->raw,lpPacket->pkt_len);
+    pkt.time_sec  = lpPacket->time_sec;
+    pkt.time_nsec = lpPacket->time_nsec;
+    pkt.setInterface(lpPacket->getInterface());
+    return (write_packet_segs(pkt));
+}
 
-    uint16_t size=lpPacket->pkt_len;
+/* the record is built in the output buffer: header, dummy, packet, frame check and align */
+bool CErfFileWriter::write_packet_segs(const CCapPktSegs & pkt){
+    uint16_t size=pkt.pkt_len;
 
     uint16_t total_size=(uint16_t)size+sizeof(erf_header_t)+2+4;
     uint16_t align = (total_size & 0x7);
@@ -263,20 +257,31 @@ bool CErfFileWriter::write_packet(CCapPktRaw * lpPacket){
         align = 8-align;
     }
 
-    header.flags =4+lpPacket->getInterface();
-    header.type =TYPE_ETH;
-    header.wlen = g_ntohs((uint16_t)size+4);
-    header.rlen = g_ntohs(total_size+align);
-
-    int n = fwrite(&header,1,sizeof(header),m_fd);
-    n+= fwrite(&dummy,1,sizeof(dummy),m_fd);
-    n+= fwrite(lpPacket->raw,1,size,m_fd);
-    n+= fwrite(frame_check,1,4+align,m_fd);
+    char * p=m_out.reserve(total_size+align);
+    if (p == NULL) {
+        return false;
+    }
 
-	if (n < (int)(total_size+align)) {
-		return false;
-	}
-	return true;
+    erf_header_t * header=(erf_header_t *)p;
+    memset(header,0,sizeof(erf_header_t));
+    double nsec_frac = 4294967295.9 *(pkt.time_nsec /1000000000.0);
+    uint64_t ts= (((uint64_t)pkt.time_sec) <<32) +((uint32_t)nsec_frac);
+    header->ts =ts;
+    header->flags =4+pkt.getInterface();
+    header->type =TYPE_ETH;
+    header->wlen = g_ntohs((uint16_t)size+4);
+    header->rlen = g_ntohs(total_size+align);
+    p+=sizeof(erf_header_t);
+
+    erf_dummy_header_t * dummy=(erf_dummy_header_t *)p;
+    dummy->dummy =0;
+    p+=sizeof(erf_dummy_header_t);
+
+    pkt.copy_to(p);
+    p+=size;
+    memset(p,0,4+align);
+    m_cnt++;
+    return true;
 }
 
 
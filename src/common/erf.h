@@ -53,6 +53,7 @@
 #ifndef __W_ERF_H__
 #define __W_ERF_H__
 #include "captureFile.h"
+#include "cap_file_out.h"
 /* Record type defines */
 #define TYPE_LEGACY	0
 #define TYPE_HDLC_POS	1
@@ -224,8 +225,9 @@ public:
     virtual bool Create(char *file_name);
     void Delete();
     virtual bool write_packet(CCapPktRaw * lpPacket);
+    virtual bool write_packet_segs(const CCapPktSegs & pkt);
 private:
-    FILE *m_fd;
+    CCapFileOut m_out;
     int m_cnt;
 
 };
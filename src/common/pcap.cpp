@@ -17,6 +17,10 @@ limitations under the License.
 #include "pcap.h"
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "pal_utl.h"
 
 
@@ -24,6 +28,8 @@ limitations under the License.
 
 static uint32_t MAGIC_NUM_FLIP = 0xd4c3b2a1;
 static uint32_t MAGIC_NUM_DONT_FLIP = 0xa1b2c3d4;
+static uint32_t MAGIC_NUM_NSEC_FLIP = 0x4d3cb2a1;
+static uint32_t MAGIC_NUM_NSEC_DONT_FLIP = 0xa1b23c4d;
 
 
 LibPCapReader::LibPCapReader()
@@ -178,9 +184,154 @@ bool LibPCapReader::ReadPacket(CCapPktRaw *lpPacket)
    return true;
 }
 
+LibPCapMmapReader::LibPCapMmapReader()
+{
+    m_base = NULL;
+    m_offset = 0;
+    m_file_size = 0;
+    m_is_flip = false;
+    m_is_nsec = false;
+}
+
+LibPCapMmapReader::~LibPCapMmapReader()
+{
+    if (m_base) {
+        munmap(m_base,m_file_size);
+    }
+}
+
+void LibPCapMmapReader::Rewind() {
+    if (m_base) {
+        init();
+    }
+}
+
+bool LibPCapMmapReader::Create(char * name, int loops)
+{
+    this->m_loops = loops;
+
+    if (name == NULL) {
+        return false;
+    }
+
+    if (m_base) {
+        return true;
+    }
+
+    int fd = open(name,O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if ( (fstat(fd,&st) != 0) || 
+         (!S_ISREG(st.st_mode)) ||
+         (st.st_size < (off_t)sizeof(packet_file_header_t)) ) {
+        close(fd);
+        return false;
+    }
+    m_file_size = st.st_size;
+
+    /* private and writable, the parser may fix fields of the packet */
+    void * p = mmap(NULL,m_file_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    m_base = (char *)p;
+
+    /* hints only, read once from start to end */
+    madvise(m_base,m_file_size,MADV_SEQUENTIAL);
+    #ifdef MADV_HUGEPAGE
+    madvise(m_base,m_file_size,MADV_HUGEPAGE);
+    #endif
+
+    if (init()) {
+        return true;
+    }
+    munmap(m_base,m_file_size);
+    m_base = NULL;
+    return false;
+}
+
+bool LibPCapMmapReader::init()
+{
+    packet_file_header_t * header=(packet_file_header_t *)m_base;
+    uint32_t magic=header->magic;
+
+    if (magic == MAGIC_NUM_DONT_FLIP) {
+        m_is_flip = false;
+        m_is_nsec = false;
+    } else if (magic == MAGIC_NUM_FLIP) {
+        m_is_flip = true;
+        m_is_nsec = false;
+    } else if (magic == MAGIC_NUM_NSEC_DONT_FLIP) {
+        m_is_flip = false;
+        m_is_nsec = true;
+    } else if (magic == MAGIC_NUM_NSEC_FLIP) {
+        m_is_flip = true;
+        m_is_nsec = true;
+    } else {
+        // capture file in not libpcap format.
+        return false;
+    }
+    m_offset = sizeof(packet_file_header_t);
+    return true;
+}
+
+void LibPCapMmapReader::flip(sf_pkthdr_t * toflip)
+{
+   toflip->ts.sec  = PAL_NTOHL(toflip->ts.sec);
+   toflip->ts.msec = PAL_NTOHL(toflip->ts.msec);
+   toflip->len     = PAL_NTOHL(toflip->len);
+   toflip->caplen  = PAL_NTOHL(toflip->caplen);
+}
+
+bool LibPCapMmapReader::ReadPacket(CCapPktRaw *lpPacket)
+{
+    if (m_base == NULL) {
+        return false;
+    }
+
+    if (m_offset == m_file_size) {
+        /* reached end of file - do we loop ?*/
+        if (m_loops > 0) {
+            init();
+        }
+    }
+    if (m_offset + sizeof(sf_pkthdr_t) > m_file_size) {
+        return false;
+    }
+
+    sf_pkthdr_t pkt_header;
+    memcpy(&pkt_header,m_base+m_offset,sizeof(sf_pkthdr_t));
+    if (m_is_flip) {
+        flip(&pkt_header);
+    }
+    if (pkt_header.caplen > READER_MAX_PACKET_SIZE) {
+        printf(" ERROR packet of %u bytes is bigger than %u \n",pkt_header.caplen,(uint32_t)READER_MAX_PACKET_SIZE);
+        return false;
+    }
+    if (m_offset + sizeof(sf_pkthdr_t) + pkt_header.caplen > m_file_size) {
+        /* truncated file */
+        return false;
+    }
+
+    lpPacket->set_ref_raw(m_base+m_offset+sizeof(sf_pkthdr_t));
+    lpPacket->pkt_len   = pkt_header.caplen;
+    lpPacket->time_sec  = pkt_header.ts.sec;
+    lpPacket->time_nsec = m_is_nsec?pkt_header.ts.msec:pkt_header.ts.msec*1000;
+    m_offset += sizeof(sf_pkthdr_t) + pkt_header.caplen;
+
+    /* decrease packet limit count */
+    if (m_loops > 0) {
+        m_loops--;
+    }
+    lpPacket->pkt_cnt++;
+    return true;
+}
+
 LibPCapWriter::LibPCapWriter()
 {
-	m_file_handler = NULL;
 	m_timestamp = 0;
     m_is_open = false;
 }
@@ -196,8 +347,7 @@ LibPCapWriter::~LibPCapWriter()
 void LibPCapWriter::Close()
 {
 	if (m_is_open) {
-		fclose(m_file_handler);
-		m_file_handler = NULL;
+		m_out.Close();
 		m_is_open = false;
 	}
 }
@@ -218,9 +368,7 @@ bool LibPCapWriter::Create(char * name)
 		return true;
 	}
 
-	m_file_handler = CAP_FOPEN_64(name,"wb");
-    if (m_file_handler == 0) {
-        printf(" ERROR create file \n");
+    if (!m_out.Create(name)) {
         return(false);
     }
     /* prepare the write counter */
@@ -239,22 +387,20 @@ bool LibPCapWriter::init()
 
 	// prepare the file header (one time header for each libpcap file)
 	// and write it.
-	packet_file_header_t header;
-    header.magic   = MAGIC_NUM_DONT_FLIP;
-    header.version_major  = 0x0002;
-    header.version_minor  = 0x0004;
-    header.thiszone       = 0;
-    header.sigfigs        = 0;
-    header.snaplen        = 2000;
-	header.linktype       = 1;
-
-    int n = fwrite(&header,1,sizeof(header),m_file_handler);
-	if ( n == sizeof(packet_file_header_t )) {
-		m_is_open = true;
-		return true;
+	packet_file_header_t * header = (packet_file_header_t *)m_out.reserve(sizeof(packet_file_header_t));
+	if (header == NULL) {
+		m_out.Close();
+		return false;
 	}
-    fclose(m_file_handler);
-	return false;
+    header->magic   = MAGIC_NUM_DONT_FLIP;
+    header->version_major  = 0x0002;
+    header->version_minor  = 0x0004;
+    header->thiszone       = 0;
+    header->sigfigs        = 0;
+    header->snaplen        = MAX_PKT_SIZE;
+	header->linktype       = 1;
+	m_is_open = true;
+	return true;
 }
 
 
@@ -267,27 +413,41 @@ bool LibPCapWriter::init()
  * @return bool  - true on success.
  */
 bool LibPCapWriter::write_packet(CCapPktRaw * lpPacket)
+{
+    CCapPktSegs pkt;
+    pkt.add(lpPacket->raw,lpPacket->pkt_len);
+    pkt.time_sec  = lpPacket->time_sec;
+    pkt.time_nsec = lpPacket->time_nsec;
+    return write_packet_segs(pkt);
+}
+
+/**
+ * Write packet from its segments, the header and the packet
+ * are built in the output buffer.
+ */
+bool LibPCapWriter::write_packet_segs(const CCapPktSegs & pkt)
 {
 	if (!m_is_open) {
 		return false;
 	}
 
+	char * p = m_out.reserve(sizeof(sf_pkthdr_t) + pkt.pkt_len);
+	if (p == NULL) {
+		return false;
+	}
+
 	// build the packet libpcap header
-    sf_pkthdr_t pkt_header;
-	pkt_header.caplen = lpPacket->pkt_len;
-	pkt_header.len = lpPacket->pkt_len;
-	pkt_header.ts.msec = (lpPacket->time_nsec/1000);
-	pkt_header.ts.sec  = lpPacket->time_sec;
+    sf_pkthdr_t * pkt_header = (sf_pkthdr_t *)p;
+	pkt_header->caplen = pkt.pkt_len;
+	pkt_header->len = pkt.pkt_len;
+	pkt_header->ts.msec = (pkt.time_nsec/1000);
+	pkt_header->ts.sec  = pkt.time_sec;
 
 	m_timestamp++;
 
-	// write header and then the packet.
-	int n = fwrite(&pkt_header,1,sizeof(sf_pkthdr_t),m_file_handler);
-    n+= fwrite(lpPacket->raw,1,lpPacket->pkt_len,m_file_handler);
+	// and then the packet.
+    pkt.copy_to(p+sizeof(sf_pkthdr_t));
 
-	if (n< ( (int)sizeof(sf_pkthdr_t) + lpPacket->pkt_len)) {
-		return false;
-	}
     /* advance the counter on success */
     m_pkt_count++;
     return true;
@@ -19,6 +19,7 @@ limitations under the License.
 
 
 #include "captureFile.h"
+#include "cap_file_out.h"
 #include <stdio.h>
 
 typedef struct pcaptime {
@@ -96,6 +97,43 @@ private:
 
 };
 
+/**
+ * libpcap reader that maps the file, the packets are not copied.
+ * ReadPacket points lpPacket->raw into the map (private, a write to the
+ * packet does not change the file) so the packet is valid until the reader
+ * is deleted. handles byte flipped and nanosecond files.
+ * CCapReaderFactory uses it for any file that can be mapped.
+ */
+class LibPCapMmapReader : public CCapReaderBase
+{
+public:
+    LibPCapMmapReader();
+
+    virtual ~LibPCapMmapReader();
+
+    bool Create(char * name, int loops = 0);
+
+    virtual bool ReadPacket(CCapPktRaw *lpPacket);
+    virtual void Rewind();
+
+    bool is_flip(){
+        return (m_is_flip);
+    }
+    bool is_nsec(){
+        return (m_is_nsec);
+    }
+
+private:
+    LibPCapMmapReader(LibPCapMmapReader &);
+
+    bool init();
+    void flip(sf_pkthdr_t * toflip);
+    char *   m_base;
+    uint64_t m_offset;
+    bool     m_is_flip;
+    bool     m_is_nsec;
+};
+
 /**
  * Libpcap file format writer.
  * Implements CFileWrirerBase interface
@@ -126,6 +164,7 @@ public:
      * @return true on success.
 	 */
 	virtual bool write_packet(CCapPktRaw * lpPacket);
+	virtual bool write_packet_segs(const CCapPktSegs & pkt);
     /**
      * 
      * returns the count of packets so far written
@@ -142,7 +181,7 @@ public:
 private:
 
 	bool init();
-	FILE * m_file_handler;
+	CCapFileOut m_out;
 	uint64_t m_timestamp;
     bool m_is_open;
     uint32_t m_pkt_count;
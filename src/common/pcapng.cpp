@@ -0,0 +1,407 @@
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "pcapng.h"
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include "pal_utl.h"
+
+
+static inline uint32_t pcapng_pad4(uint32_t len){
+    return ((len+3) & ~3);
+}
+
+
+void CPcapNgIf::to_time(uint64_t ts,uint32_t & sec,uint32_t & nsec){
+    uint64_t s    = ts / m_units;
+    uint64_t frac = ts % m_units;
+    if (m_units == 1000000000ULL) {
+        nsec = (uint32_t)frac;
+    } else if (m_units <= 10000000000ULL) {
+        /* frac*1e9 fits in 64 bit */
+        nsec = (uint32_t)(frac*1000000000ULL/m_units);
+    } else {
+        nsec = (uint32_t)((double)frac*1000000000.0/(double)m_units);
+    }
+    sec = (uint32_t)((int64_t)s + m_offset_sec);
+}
+
+
+CPcapNgReader::CPcapNgReader()
+{
+    m_file_handler = NULL;
+    m_is_flip = false;
+    m_buf = NULL;
+    m_buf_size = 0;
+    m_file_size = 0;
+}
+
+CPcapNgReader::~CPcapNgReader()
+{
+    if (m_file_handler) {
+        fclose(m_file_handler);
+    }
+    free(m_buf);
+}
+
+inline uint32_t CPcapNgReader::get32(uint32_t v){
+    return (m_is_flip?PAL_NTOHL(v):v);
+}
+
+inline uint16_t CPcapNgReader::get16(uint16_t v){
+    return (m_is_flip?PAL_NTOHS(v):v);
+}
+
+bool CPcapNgReader::Create(char * name, int loops)
+{
+    this->m_loops = loops;
+
+    if (name == NULL) {
+        return false;
+    }
+    if (m_file_handler) {
+        return true;
+    }
+    m_file_handler = CAP_FOPEN_64(name,"rb");
+    if (m_file_handler == 0) {
+        printf(" failed to open cap file %s : errno : %d\n",name, errno);
+        return false;
+    }
+    CAP_FSEEK_64 (m_file_handler, 0, SEEK_END);
+    m_file_size = CAP_FTELL_64 (m_file_handler);
+    rewind (m_file_handler);
+
+    /* the file starts with a section header */
+    pcapng_block_hdr_t hdr;
+    if ( read_block(hdr) && (hdr.type == PCAPNG_BT_SHB) ) {
+        return true;
+    }
+    fclose(m_file_handler);
+    m_file_handler = NULL;
+    return false;
+}
+
+void CPcapNgReader::Rewind()
+{
+    if (m_file_handler) {
+        rewind(m_file_handler);
+        pcapng_block_hdr_t hdr;
+        read_block(hdr);
+    }
+}
+
+/* read the next block to m_buf (body and trailer), a section header updates the byte order */
+bool CPcapNgReader::read_block(pcapng_block_hdr_t & hdr)
+{
+    uint32_t n_hdr = sizeof(pcapng_block_hdr_t);
+    if (fread(&hdr,1,n_hdr,m_file_handler) != n_hdr) {
+        return false;
+    }
+    if (hdr.type == PCAPNG_BT_SHB) {
+        uint32_t bom;
+        if (fread(&bom,1,sizeof(bom),m_file_handler) != sizeof(bom)) {
+            return false;
+        }
+        if (bom == PCAPNG_BOM) {
+            m_is_flip = false;
+        } else if (bom == PAL_NTOHL(PCAPNG_BOM)) {
+            m_is_flip = true;
+        } else {
+            return false;
+        }
+        /* new section, new interfaces */
+        m_ifs.clear();
+        n_hdr += sizeof(bom);
+    }
+    hdr.type   = get32(hdr.type);
+    hdr.length = get32(hdr.length);
+    if ( (hdr.length < n_hdr+4) ||
+         (hdr.length & 3) ||
+         (hdr.length > PCAPNG_MAX_BLOCK) ) {
+        return false;
+    }
+    uint32_t len = hdr.length - n_hdr;
+    if (len > m_buf_size) {
+        char * p = (char *)realloc(m_buf,len);
+        if (p == NULL) {
+            return false;
+        }
+        m_buf = p;
+        m_buf_size = len;
+    }
+    if (fread(m_buf,1,len,m_file_handler) != len) {
+        return false;
+    }
+    return true;
+}
+
+bool CPcapNgReader::read_idb(uint32_t body_len)
+{
+    if (body_len < sizeof(pcapng_idb_t)) {
+        return false;
+    }
+    pcapng_idb_t * idb = (pcapng_idb_t *)m_buf;
+    CPcapNgIf lif;
+    lif.m_linktype = get16(idb->linktype);
+    lif.m_snaplen  = get32(idb->snaplen);
+
+    uint32_t off = sizeof(pcapng_idb_t);
+    while (off + 4 <= body_len) {
+        uint16_t code;
+        uint16_t len;
+        memcpy(&code,m_buf+off,2);
+        memcpy(&len,m_buf+off+2,2);
+        code = get16(code);
+        len  = get16(len);
+        off += 4;
+        if ( (code == PCAPNG_OPT_ENDOFOPT) || (off + len > body_len) ) {
+            break;
+        }
+        uint8_t * v = (uint8_t *)(m_buf+off);
+        if ( (code == PCAPNG_OPT_IF_TSRESOL) && (len == 1) ) {
+            /* MSB set, power of 2, otherwise power of 10 */
+            if (v[0] & 0x80) {
+                if ((v[0] & 0x7f) < 64) {
+                    lif.m_units = (1ULL << (v[0] & 0x7f));
+                }
+            } else if (v[0] <= 19) {
+                uint64_t units = 1;
+                int i;
+                for (i=0; i<v[0]; i++) {
+                    units *= 10;
+                }
+                lif.m_units = units;
+            }
+        }
+        if ( (code == PCAPNG_OPT_IF_TSOFFSET) && (len == 8) ) {
+            uint32_t w[2];
+            memcpy(w,v,8);
+            if (m_is_flip) {
+                lif.m_offset_sec = (int64_t)(((uint64_t)PAL_NTOHL(w[0]) << 32) | PAL_NTOHL(w[1]));
+            } else {
+                int64_t val;
+                memcpy(&val,v,8);
+                lif.m_offset_sec = val;
+            }
+        }
+        off += pcapng_pad4(len);
+    }
+    m_ifs.push_back(lif);
+    return true;
+}
+
+bool CPcapNgReader::read_epb(uint32_t body_len,CCapPktRaw *lpPacket)
+{
+    if (body_len < sizeof(pcapng_epb_t)) {
+        return false;
+    }
+    pcapng_epb_t * epb = (pcapng_epb_t *)m_buf;
+    uint32_t if_id  = get32(epb->if_id);
+    uint32_t caplen = get32(epb->caplen);
+    if ( (if_id >= m_ifs.size()) ||
+         (sizeof(pcapng_epb_t) + caplen > body_len) ) {
+        return false;
+    }
+    if (caplen > READER_MAX_PACKET_SIZE) {
+        printf(" ERROR packet of %u bytes is bigger than %u \n",caplen,(uint32_t)READER_MAX_PACKET_SIZE);
+        return false;
+    }
+    uint64_t ts = ((uint64_t)get32(epb->ts_hi) << 32) | get32(epb->ts_lo);
+    m_ifs[if_id].to_time(ts,lpPacket->time_sec,lpPacket->time_nsec);
+
+    memcpy(lpPacket->raw,m_buf+sizeof(pcapng_epb_t),caplen);
+    lpPacket->pkt_len = caplen;
+    lpPacket->setInterface((uint8_t)if_id);
+    return true;
+}
+
+bool CPcapNgReader::ReadPacket(CCapPktRaw *lpPacket)
+{
+    if (m_file_handler == NULL) {
+        return false;
+    }
+
+    while ( true ) {
+        if (CAP_FTELL_64(m_file_handler) == m_file_size) {
+            /* reached end of file - do we loop ?*/
+            if (m_loops > 0) {
+                Rewind();
+            }
+        }
+        pcapng_block_hdr_t hdr;
+        if (!read_block(hdr)) {
+            return false;
+        }
+        uint32_t n_hdr = sizeof(pcapng_block_hdr_t);
+        uint32_t body_len = hdr.length - n_hdr - 4;
+
+        switch (hdr.type) {
+        case PCAPNG_BT_IDB:
+            if (!read_idb(body_len)) {
+                return false;
+            }
+            break;
+        case PCAPNG_BT_EPB:
+            if (!read_epb(body_len,lpPacket)) {
+                return false;
+            }
+            /* decrease packet limit count */
+            if (m_loops > 0) {
+                m_loops--;
+            }
+            lpPacket->pkt_cnt++;
+            return true;
+        default:
+            /* SHB is handled by read_block, other blocks are not used */
+            break;
+        }
+    }
+}
+
+
+CPcapNgWriter::CPcapNgWriter()
+{
+    m_pkt_count = 0;
+    m_ifs_cnt = 0;
+    m_is_open = false;
+}
+
+CPcapNgWriter::~CPcapNgWriter()
+{
+    Close();
+}
+
+void CPcapNgWriter::Close()
+{
+    if (m_is_open) {
+        m_out.Close();
+        m_is_open = false;
+    }
+}
+
+bool CPcapNgWriter::Create(char * name)
+{
+    if (name == NULL) {
+        return false;
+    }
+    if (m_is_open) {
+        return true;
+    }
+    if (!m_out.Create(name)) {
+        return(false);
+    }
+    m_pkt_count = 0;
+    m_ifs_cnt = 0;
+    int i;
+    for (i=0; i<MAX_IFS; i++) {
+        m_if_id[i] = -1;
+    }
+    m_is_open = true;
+    return write_shb();
+}
+
+bool CPcapNgWriter::write_shb()
+{
+    uint32_t size = sizeof(pcapng_block_hdr_t)+sizeof(pcapng_shb_t)+4;
+    char * p = m_out.reserve(size);
+    if (p == NULL) {
+        return false;
+    }
+    pcapng_block_hdr_t * hdr = (pcapng_block_hdr_t *)p;
+    hdr->type   = PCAPNG_BT_SHB;
+    hdr->length = size;
+    pcapng_shb_t * shb = (pcapng_shb_t *)(p+sizeof(pcapng_block_hdr_t));
+    shb->bom            = PCAPNG_BOM;
+    shb->version_major  = 1;
+    shb->version_minor  = 0;
+    shb->section_len_lo = 0xffffffff;
+    shb->section_len_hi = 0xffffffff;
+    memcpy(p+size-4,&size,4);
+    return true;
+}
+
+/* ethernet, no snaplen, nsec resolution */
+bool CPcapNgWriter::write_idb()
+{
+    uint32_t size = sizeof(pcapng_block_hdr_t)+sizeof(pcapng_idb_t)+4+4+4+4;
+    char * p = m_out.reserve(size);
+    if (p == NULL) {
+        return false;
+    }
+    memset(p,0,size);
+    pcapng_block_hdr_t * hdr = (pcapng_block_hdr_t *)p;
+    hdr->type   = PCAPNG_BT_IDB;
+    hdr->length = size;
+    pcapng_idb_t * idb = (pcapng_idb_t *)(p+sizeof(pcapng_block_hdr_t));
+    idb->linktype = 1;
+    idb->snaplen  = 0;
+    uint16_t * opt = (uint16_t *)(p+sizeof(pcapng_block_hdr_t)+sizeof(pcapng_idb_t));
+    opt[0] = PCAPNG_OPT_IF_TSRESOL;
+    opt[1] = 1;
+    *((uint8_t *)&opt[2]) = 9;
+    /* opt[4],opt[5] end of options */
+    memcpy(p+size-4,&size,4);
+    return true;
+}
+
+bool CPcapNgWriter::write_packet(CCapPktRaw * lpPacket)
+{
+    CCapPktSegs pkt;
+    pkt.add(lpPacket->raw,lpPacket->pkt_len);
+    pkt.time_sec  = lpPacket->time_sec;
+    pkt.time_nsec = lpPacket->time_nsec;
+    pkt.setInterface(lpPacket->getInterface());
+    return write_packet_segs(pkt);
+}
+
+bool CPcapNgWriter::write_packet_segs(const CCapPktSegs & pkt)
+{
+    if (!m_is_open) {
+        return false;
+    }
+    uint8_t lif = pkt.getInterface();
+    if (m_if_id[lif] < 0) {
+        m_if_id[lif] = m_ifs_cnt++;
+        if (!write_idb()) {
+            return false;
+        }
+    }
+
+    uint32_t caplen = pkt.pkt_len;
+    uint32_t size = sizeof(pcapng_block_hdr_t)+sizeof(pcapng_epb_t)+pcapng_pad4(caplen)+4;
+    char * p = m_out.reserve(size);
+    if (p == NULL) {
+        return false;
+    }
+    pcapng_block_hdr_t * hdr = (pcapng_block_hdr_t *)p;
+    hdr->type   = PCAPNG_BT_EPB;
+    hdr->length = size;
+    pcapng_epb_t * epb = (pcapng_epb_t *)(p+sizeof(pcapng_block_hdr_t));
+    uint64_t ts = (uint64_t)pkt.time_sec*1000000000ULL + pkt.time_nsec;
+    epb->if_id  = m_if_id[lif];
+    epb->ts_hi  = (uint32_t)(ts >> 32);
+    epb->ts_lo  = (uint32_t)ts;
+    epb->caplen = caplen;
+    epb->len    = caplen;
+    char * data = p+sizeof(pcapng_block_hdr_t)+sizeof(pcapng_epb_t);
+    pkt.copy_to(data);
+    memset(data+caplen,0,pcapng_pad4(caplen)-caplen);
+    memcpy(p+size-4,&size,4);
+
+    m_pkt_count++;
+    return true;
+}
@@ -0,0 +1,160 @@
+#ifndef __PCAPNG_H__
+#define __PCAPNG_H__
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "captureFile.h"
+#include "cap_file_out.h"
+#include <stdio.h>
+#include <vector>
+
+#define PCAPNG_BT_SHB     0x0A0D0D0A /* section header block */
+#define PCAPNG_BT_IDB     0x00000001 /* interface description block */
+#define PCAPNG_BT_EPB     0x00000006 /* enhanced packet block */
+
+#define PCAPNG_BOM        0x1A2B3C4D /* byte order magic */
+
+#define PCAPNG_OPT_ENDOFOPT   0
+#define PCAPNG_OPT_IF_TSRESOL 9
+#define PCAPNG_OPT_IF_TSOFFSET 14
+
+#define PCAPNG_MAX_BLOCK  (16*1024*1024) /* a bigger block is a corrupted file */
+
+typedef struct pcapng_block_hdr {
+    uint32_t type;
+    uint32_t length;         /* total length, the trailer repeats it */
+} pcapng_block_hdr_t;
+
+typedef struct pcapng_shb {
+    uint32_t bom;
+    uint16_t version_major;
+    uint16_t version_minor;
+    uint32_t section_len_lo; /* -1, not specified */
+    uint32_t section_len_hi;
+} pcapng_shb_t;
+
+typedef struct pcapng_idb {
+    uint16_t linktype;
+    uint16_t reserved;
+    uint32_t snaplen;
+} pcapng_idb_t;
+
+typedef struct pcapng_epb {
+    uint32_t if_id;
+    uint32_t ts_hi;
+    uint32_t ts_lo;
+    uint32_t caplen;
+    uint32_t len;
+} pcapng_epb_t;
+
+
+/* interface of the current section */
+class CPcapNgIf {
+public:
+    CPcapNgIf(){
+        m_linktype=0;
+        m_snaplen=0;
+        m_units=1000000; /* default is usec */
+        m_offset_sec=0;
+    }
+
+    /* timestamp units to sec/nsec */
+    void to_time(uint64_t ts,uint32_t & sec,uint32_t & nsec);
+
+public:
+    uint16_t m_linktype;
+    uint32_t m_snaplen;
+    uint64_t m_units;      /* timestamp units per sec */
+    int64_t  m_offset_sec;
+};
+
+/**
+ * pcapng reader, SHB/IDB/EPB. other blocks are skipped.
+ * each interface has its own timestamp resolution, the interface id of the
+ * packet is kept in CCapPktRaw (the low bits)
+ */
+class CPcapNgReader : public CCapReaderBase
+{
+public:
+    CPcapNgReader();
+
+    virtual ~CPcapNgReader();
+
+    bool Create(char * name, int loops = 0);
+
+    virtual bool ReadPacket(CCapPktRaw *lpPacket);
+    virtual void Rewind();
+
+private:
+    CPcapNgReader(CPcapNgReader &);
+
+    bool read_block(pcapng_block_hdr_t & hdr);
+    bool read_shb(pcapng_block_hdr_t & hdr);
+    bool read_idb(uint32_t body_len);
+    bool read_epb(uint32_t body_len,CCapPktRaw *lpPacket);
+    inline uint32_t get32(uint32_t v);
+    inline uint16_t get16(uint16_t v);
+
+private:
+    FILE *                 m_file_handler;
+    bool                   m_is_flip;
+    char *                 m_buf;      /* body of the current block */
+    uint32_t               m_buf_size;
+    std::vector<CPcapNgIf> m_ifs;
+};
+
+
+/**
+ * pcapng writer. one section, an IDB with nsec resolution is added the first
+ * time an interface (CCapPktRaw::getInterface) is seen. blocks are
+ * built in the buffers of CCapFileOut
+ */
+class CPcapNgWriter : public CFileWriterBase
+{
+public:
+    enum {
+        MAX_IFS   = 8
+    };
+
+    CPcapNgWriter();
+    virtual ~CPcapNgWriter();
+
+    bool Create(char * name);
+    virtual bool write_packet(CCapPktRaw * lpPacket);
+    virtual bool write_packet_segs(const CCapPktSegs & pkt);
+
+    uint32_t get_pkt_count(){
+        return (m_pkt_count);
+    }
+
+    /* flush the buffer and close */
+    void Close();
+
+private:
+    bool write_shb();
+    bool write_idb();
+
+private:
+    CCapFileOut m_out;
+    uint32_t m_pkt_count;
+    uint32_t m_ifs_cnt;
+    int32_t  m_if_id[MAX_IFS]; /* CCapPktRaw interface to IDB index, -1 before its IDB */
+    bool     m_is_open;
+};
+
+#endif
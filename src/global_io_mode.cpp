@@ -38,6 +38,7 @@ void CTrexGlobalIoMode::set_mode(CliDumpMode  mode){
         m_ap_mode=apENABLE;
         m_l_mode=lDISABLE;
         m_rc_mode=rcDISABLE;
+        m_cy_mode=cyDISABLE;
         break;
     }
 }
@@ -96,6 +97,13 @@ bool CTrexGlobalIoMode::handle_io_modes(void){
                 m_rc_mode = rcDISABLE;
             }
             break;
+        case ccGCY:
+            m_g_mode=gNORMAL;
+            m_cy_mode++;
+            if (m_cy_mode == cyLAST) {
+                m_cy_mode = cyDISABLE;
+            }
+            break;
         }
     }
     return false;
@@ -109,6 +117,7 @@ void CTrexGlobalIoMode::Dump(FILE *fd){
     fprintf(fd," ap    : %d \n",(int)m_ap_mode);
     fprintf(fd," l     : %d \n",(int)m_l_mode);
     fprintf(fd," rc    : %d \n",(int)m_rc_mode);
+    fprintf(fd," cy    : %d \n",(int)m_cy_mode);
 }
 
 void CTrexGlobalIoMode::DumpHelp(FILE *fd){
@@ -121,6 +130,7 @@ void CTrexGlobalIoMode::DumpHelp(FILE *fd){
         fprintf(fd,"  a  : Global ports Toggle mode, disable -> enable \n");
         fprintf(fd,"  l  : Latency      Toggle mode, disable -> enable -> enhanced  \n");
         fprintf(fd,"  r  : Rx check  Toggle mode, disable -> enable -> enhanced  \n");
+        fprintf(fd,"  c  : DP cycles per phase Toggle mode, disable -> enable (build with --cycle-stats) \n");
         fprintf(fd,"  Press h or 1 to go back to Normal mode \n");
 }
 
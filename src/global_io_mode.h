@@ -36,6 +36,7 @@ public:
         m_ap_mode=apENABLE;
         m_l_mode=lENABLE;
         m_rc_mode=rcENABLE;
+        m_cy_mode=cyDISABLE;
     }
     /* 0 - disable -> normal 
        h - help -> normal 
@@ -44,6 +45,7 @@ public:
        3 - ap
        4 - ll
        5 - rx
+       6 - cycles
     */
     enum Chars{
         ccHELP='h',
@@ -52,7 +54,8 @@ public:
         ccGPP='p',
         ccGAP='a',
         ccGL='l',
-        ccGRC='r'
+        ccGRC='r',
+        ccGCY='c'
     };
 
     enum CliDumpMode {
@@ -101,12 +104,20 @@ public:
     };
     typedef uint8_t RxCheckMode_t;
 
+    enum CyclesMode {
+        cyDISABLE  =0, 
+        cyENABLE   =1,  
+        cyLAST     =2
+    };
+    typedef uint8_t CyclesMode_t;
+
     Global_t                m_g_mode;
     bool                    m_g_disable_first;
     PerPortCountersMode_t   m_pp_mode;
     AllPortCountersMode_t   m_ap_mode;
     LatecnyMode_t           m_l_mode;
     RxCheckMode_t           m_rc_mode;
+    CyclesMode_t            m_cy_mode;
 
 public:
     void set_mode(CliDumpMode  mode);
@@ -0,0 +1,231 @@
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "hdr_histogram.h"
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+
+CHdrHistogram::CHdrHistogram(){
+    m_counts=0;
+    m_counts_len=0;
+    m_counts_cap=0;
+    m_used_len=0;
+    reserve_counts(MAX_COUNTS);
+    Create(100,10000000000ULL,MAX_DIGITS);
+}
+
+CHdrHistogram::CHdrHistogram(uint64_t lowest,uint64_t highest,uint8_t digits){
+    m_counts=0;
+    m_counts_len=0;
+    m_counts_cap=0;
+    m_used_len=0;
+    if ( !Create(lowest,highest,digits) ) {
+        Create(100,10000000000ULL,MAX_DIGITS);
+    }
+}
+
+CHdrHistogram::~CHdrHistogram(){
+    delete [] m_counts;
+}
+
+/* setup only, room for len zero counters */
+void CHdrHistogram::reserve_counts(uint32_t len){
+    if ( len > m_counts_cap ) {
+        delete [] m_counts;
+        m_counts = new uint64_t[len];
+        m_counts_cap = len;
+        memset(m_counts,0,sizeof(uint64_t)*len);
+        m_used_len = 0;
+    }
+}
+
+/* copy only the used counters, the snapshot of a mostly low histogram is cheap */
+CHdrHistogram & CHdrHistogram::operator=(const CHdrHistogram & o){
+    if ( this == &o ) {
+        return (*this);
+    }
+    /* the counters of the target are never reallocated */
+    assert(o.m_counts_len <= m_counts_cap);
+    m_counts_len  = o.m_counts_len;
+    m_lowest      = o.m_lowest;
+    m_highest     = o.m_highest;
+    m_digits      = o.m_digits;
+    m_unit_magnitude = o.m_unit_magnitude;
+    m_sub_bucket_half_count_magnitude = o.m_sub_bucket_half_count_magnitude;
+    m_sub_bucket_count      = o.m_sub_bucket_count;
+    m_sub_bucket_half_count = o.m_sub_bucket_half_count;
+    m_sub_bucket_mask       = o.m_sub_bucket_mask;
+    m_bucket_count = o.m_bucket_count;
+    m_total = o.m_total;
+    m_min   = o.m_min;
+    m_max   = o.m_max;
+
+    uint32_t len=o.m_used_len;
+    memcpy(m_counts,o.m_counts,sizeof(uint64_t)*len);
+    if ( m_used_len > len ) {
+        memset(&m_counts[len],0,sizeof(uint64_t)*(m_used_len-len));
+    }
+    m_used_len = len;
+    return (*this);
+}
+
+bool CHdrHistogram::Create(uint64_t lowest,uint64_t highest,uint8_t digits){
+    if ( (lowest < 1) || (digits < 1) || (digits > MAX_DIGITS) || (highest < 2*lowest) ) {
+        return (false);
+    }
+    uint32_t largest_single_unit = 2*(uint32_t)pow(10.0,(double)digits);
+    uint8_t  sub_bucket_count_magnitude = (uint8_t)ceil(log2((double)largest_single_unit));
+
+    uint8_t  unit_magnitude = (uint8_t)(63 - __builtin_clzll(lowest));
+    uint32_t sub_bucket_count = 1<<sub_bucket_count_magnitude;
+
+    uint64_t smallest_untrackable = ((uint64_t)sub_bucket_count) << unit_magnitude;
+    uint32_t buckets = 1;
+    while ( smallest_untrackable <= highest ) {
+        if ( smallest_untrackable > (UINT64_MAX/4) ) {
+            buckets++;
+            break;
+        }
+        smallest_untrackable <<= 1;
+        buckets++;
+    }
+    uint32_t counts_len = (buckets+1)*(sub_bucket_count/2);
+    if ( counts_len > MAX_COUNTS ) {
+        return (false);
+    }
+
+    m_lowest         = lowest;
+    m_highest        = highest;
+    m_digits         = digits;
+    m_unit_magnitude = unit_magnitude;
+    m_sub_bucket_half_count_magnitude = sub_bucket_count_magnitude-1;
+    m_sub_bucket_count      = sub_bucket_count;
+    m_sub_bucket_half_count = sub_bucket_count/2;
+    m_sub_bucket_mask       = ((uint64_t)sub_bucket_count-1) << unit_magnitude;
+    m_bucket_count   = buckets;
+
+    reserve_counts(counts_len);
+    m_counts_len = counts_len;
+    Reset();
+    return (true);
+}
+
+void CHdrHistogram::Reset(){
+    if ( m_used_len ) {
+        memset(m_counts,0,sizeof(uint64_t)*m_used_len);
+    }
+    m_used_len = 0;
+    m_total    = 0;
+    m_min      = UINT64_MAX;
+    m_max      = 0;
+}
+
+bool CHdrHistogram::merge(const CHdrHistogram & o){
+    if ( (m_lowest != o.m_lowest) ||
+         (m_highest != o.m_highest) ||
+         (m_digits != o.m_digits) ) {
+        return (false);
+    }
+    uint32_t i;
+    for (i=0; i<o.m_used_len; i++) {
+        m_counts[i] += o.m_counts[i];
+    }
+    if ( o.m_used_len > m_used_len ) {
+        m_used_len = o.m_used_len;
+    }
+    m_total += o.m_total;
+    if ( o.m_max > m_max ) {
+        m_max = o.m_max;
+    }
+    if ( o.m_min < m_min ) {
+        m_min = o.m_min;
+    }
+    return (true);
+}
+
+void CHdrHistogram::get_index_location(uint32_t idx,
+                                       uint32_t & bucket_idx,
+                                       uint32_t & sub_bucket_idx) const {
+    int32_t b = (int32_t)(idx >> m_sub_bucket_half_count_magnitude) - 1;
+    uint32_t sb = (idx & (m_sub_bucket_half_count - 1)) + m_sub_bucket_half_count;
+    if ( b < 0 ) {
+        sb -= m_sub_bucket_half_count;
+        b   = 0;
+    }
+    bucket_idx     = (uint32_t)b;
+    sub_bucket_idx = sb;
+}
+
+uint64_t CHdrHistogram::get_lowest_value_at_index(uint32_t idx) const {
+    uint32_t b,sb;
+    get_index_location(idx,b,sb);
+    return ( ((uint64_t)sb) << (b + m_unit_magnitude) );
+}
+
+uint64_t CHdrHistogram::get_range_at_index(uint32_t idx) const {
+    uint32_t b,sb;
+    get_index_location(idx,b,sb);
+    return ( 1ULL << (b + m_unit_magnitude) );
+}
+
+uint64_t CHdrHistogram::get_median_value_at_index(uint32_t idx) const {
+    return ( get_lowest_value_at_index(idx) + (get_range_at_index(idx)>>1) );
+}
+
+uint64_t CHdrHistogram::get_highest_equivalent_value(uint64_t v) const {
+    if ( v > m_highest ) {
+        v = m_highest;
+    }
+    uint32_t idx=get_counts_index(v);
+    return ( get_lowest_value_at_index(idx) + get_range_at_index(idx) - 1 );
+}
+
+uint64_t CHdrHistogram::get_value_at_percentile(double p) const {
+    if ( m_total == 0 ) {
+        return (0);
+    }
+    if ( p > 100.0 ) {
+        p = 100.0;
+    }
+    uint64_t target=(uint64_t)ceil(((double)m_total*p)/100.0);
+    if ( target < 1 ) {
+        target = 1;
+    }
+    uint64_t sum=0;
+    uint32_t i;
+    for (i=0; i<m_used_len; i++) {
+        sum += m_counts[i];
+        if ( sum >= target ) {
+            uint64_t res = get_lowest_value_at_index(i) + get_range_at_index(i) - 1;
+            return ( (res < m_max)?res:m_max );
+        }
+    }
+    return (m_max);
+}
+
+void CHdrHistogram::Dump(FILE *fd){
+    fprintf(fd," range      : %llu-%llu, %u digits, %u counters \n",
+            (unsigned long long)m_lowest,(unsigned long long)m_highest,
+            (unsigned)m_digits,(unsigned)m_counts_len);
+    fprintf(fd," total      : %llu \n",(unsigned long long)m_total);
+    fprintf(fd," min/max    : %llu/%llu \n",(unsigned long long)get_min(),(unsigned long long)m_max);
+}
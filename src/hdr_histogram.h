@@ -0,0 +1,163 @@
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+  HDR style log-linear histogram of integer values (nsec for latency).
+
+  the range is split to buckets, each one covers twice the range of the
+  previous one with the same number of sub buckets, so the relative error is
+  fixed over the whole range (10^-digits). below 2^(digits resolution) units
+  the resolution is the lowest discernible value.
+
+  the counters array is allocated once, at setup, by the constructor or by a
+  Create that needs more counters than the object has. 2 digits take about 1/8
+  of the memory of 3 digits. add(), merge(), Reset() and the assignment never
+  allocate, the assignment copies into the counters of the target so the target
+  must have room for the configuration of the source (the default constructor
+  has room for any). add() is a single writer, no lock.
+  two histograms with the same configuration can be merged.
+*/
+class CHdrHistogram {
+public:
+    enum {
+        MAX_DIGITS = 3,
+        MAX_COUNTS = 19456 /* largest counters array, 3 significant digits from 100nsec to 10sec */
+    };
+
+    /* room for MAX_COUNTS counters */
+    CHdrHistogram();
+    /* room only for the counters of this configuration */
+    CHdrHistogram(uint64_t lowest,uint64_t highest,uint8_t digits);
+    CHdrHistogram & operator=(const CHdrHistogram & o);
+    ~CHdrHistogram();
+
+    /* lowest discernible value, highest trackable value, significant digits 1..3.
+       return false in case the configuration needs more than MAX_COUNTS counters.
+       allocates only in case the object has less room than the configuration needs */
+    bool Create(uint64_t lowest,uint64_t highest,uint8_t digits);
+    void Reset();
+
+    inline void add(uint64_t v){
+        if ( v > m_highest ) {
+            /* count it at the top, the max still has the real value */
+            if ( v > m_max ) {
+                m_max = v;
+            }
+            v = m_highest;
+        }
+        uint32_t idx=get_counts_index(v);
+        m_counts[idx]++;
+        m_total++;
+        if ( idx >= m_used_len ) {
+            m_used_len = idx+1;
+        }
+        if ( v > m_max ) {
+            m_max = v;
+        }
+        if ( v < m_min ) {
+            m_min = v;
+        }
+    }
+
+    /* add the counters of o, false in case the configuration is different */
+    bool merge(const CHdrHistogram & o);
+
+    /* p in 0..100, the highest value equivalent to the one at the percentile, capped by the max */
+    uint64_t get_value_at_percentile(double p) const;
+
+    uint64_t get_total() const {
+        return (m_total);
+    }
+    uint64_t get_max() const {
+        return (m_max);
+    }
+    uint64_t get_min() const {
+        return ( (m_total==0)?0:m_min );
+    }
+    uint32_t get_counts_len() const {
+        return (m_counts_len);
+    }
+    /* counters allocated, at least get_counts_len() */
+    uint32_t get_counts_cap() const {
+        return (m_counts_cap);
+    }
+
+    /* walk the counters, all the counters from get_used_len() are zero */
+    uint32_t get_used_len() const {
+        return (m_used_len);
+    }
+    uint64_t get_count_at_index(uint32_t idx) const {
+        return (m_counts[idx]);
+    }
+    /* middle of the range of values counted at idx */
+    uint64_t get_median_value_at_index(uint32_t idx) const;
+
+    uint64_t get_highest_equivalent_value(uint64_t v) const;
+
+    void Dump(FILE *fd);
+
+private:
+    inline uint32_t get_bucket_index(uint64_t v) const {
+        uint32_t pow2ceiling = 64 - __builtin_clzll(v | m_sub_bucket_mask);
+        return (pow2ceiling - m_unit_magnitude - (m_sub_bucket_half_count_magnitude + 1));
+    }
+
+    inline uint32_t get_counts_index(uint64_t v) const {
+        uint32_t bucket_idx     = get_bucket_index(v);
+        uint32_t sub_bucket_idx = (uint32_t)(v >> (bucket_idx + m_unit_magnitude));
+        return ( ((bucket_idx + 1) << m_sub_bucket_half_count_magnitude) +
+                 (sub_bucket_idx - m_sub_bucket_half_count) );
+    }
+
+    void get_index_location(uint32_t idx,uint32_t & bucket_idx,uint32_t & sub_bucket_idx) const;
+    uint64_t get_lowest_value_at_index(uint32_t idx) const;
+    uint64_t get_range_at_index(uint32_t idx) const;
+    void reserve_counts(uint32_t len);
+    /* not copyable, the copy would allocate. assign to a histogram with room */
+    CHdrHistogram(const CHdrHistogram & o);
+
+private:
+    uint64_t m_lowest;
+    uint64_t m_highest;
+    uint8_t  m_digits;
+    uint8_t  m_unit_magnitude;
+    uint8_t  m_sub_bucket_half_count_magnitude;
+    uint32_t m_sub_bucket_count;
+    uint32_t m_sub_bucket_half_count;
+    uint64_t m_sub_bucket_mask;
+    uint32_t m_bucket_count;
+    uint32_t m_counts_len; /* counters of the configuration */
+    uint32_t m_counts_cap; /* counters allocated */
+    uint32_t m_used_len;   /* highest counter that is not zero + 1 */
+
+    uint64_t m_total;
+    uint64_t m_min;
+    uint64_t m_max;
+
+    uint64_t * m_counts;   /* m_counts_cap counters */
+};
+
+#endif
@@ -29,7 +29,8 @@ limitations under the License.
 
 // An enum for all the option types
 enum { OPT_HELP, OPT_CFG, OPT_NODE_DUMP, OP_STATS,
-          OPT_FILE_OUT, OPT_UT, OPT_PCAP, OPT_IPV6, OPT_MAC_FILE};
+          OPT_FILE_OUT, OPT_UT, OPT_PCAP, OPT_PCAPNG, OPT_IPV6, OPT_MAC_FILE, OPT_TEMPLATE_CACHE,
+          OPT_REPLAY, OPT_REPLAY_RATE, OPT_REPLAY_LOOPS, OPT_REPLAY_IP_OFFSET};
       
 
 /* these are the argument types:
@@ -49,6 +50,12 @@ static CSimpleOpt::SOption parser_options[] =
     { OPT_FILE_OUT , "-o",          SO_REQ_SEP },
     { OPT_NODE_DUMP , "-v",         SO_REQ_SEP },
     { OPT_PCAP,       "--pcap",       SO_NONE   },
+    { OPT_PCAPNG,     "--pcapng",     SO_NONE   },
+    { OPT_TEMPLATE_CACHE, "--template-cache", SO_REQ_SEP },
+    { OPT_REPLAY,           "--replay",           SO_REQ_SEP },
+    { OPT_REPLAY_RATE,      "--replay-rate",      SO_REQ_SEP },
+    { OPT_REPLAY_LOOPS,     "--replay-loops",     SO_REQ_SEP },
+    { OPT_REPLAY_IP_OFFSET, "--replay-ip-offset", SO_REQ_SEP },
     { OPT_IPV6,       "--ipv6",       SO_NONE   },
 
     
@@ -73,6 +80,12 @@ static int usage(){
     printf("  Warning : This program can generate huge-files (TB ) watch out! try this only on local drive \n");
     printf(" \n");
     printf(" --pcap  export the file in pcap mode \n");
+    printf(" --pcapng  export the file in pcapng mode \n");
+    printf(" --template-cache [file]  load the templates precompiled from file \n");
+    printf(" --replay [file]  replay the capture file instead of the templates of the profile \n");
+    printf(" --replay-rate [n]  speed up of the replay, 2.0 is twice faster \n");
+    printf(" --replay-loops [n]  number of loops of the replay file \n");
+    printf(" --replay-ip-offset [n]  added to the IPv4 addresses in each loop \n");
     printf(" Examples: ");
     printf("  1) preview show csv stats \n");
     printf("  #>bp_sim -f cfg.yaml -v 1 \n");
@@ -133,6 +146,24 @@ static int parse_options(int argc, char *argv[], CParserOption* po ) {
             case OPT_PCAP:
                 po->preview.set_pcap_mode_enable(true);
                 break;
+            case OPT_PCAPNG:
+                po->preview.set_pcapng_mode_enable(true);
+                break;
+            case OPT_TEMPLATE_CACHE:
+                po->template_cache_file = args.OptionArg();
+                break;
+            case OPT_REPLAY:
+                po->replay_file = args.OptionArg();
+                break;
+            case OPT_REPLAY_RATE:
+                po->m_replay_rate = atof(args.OptionArg());
+                break;
+            case OPT_REPLAY_LOOPS:
+                po->m_replay_loops = atoi(args.OptionArg());
+                break;
+            case OPT_REPLAY_IP_OFFSET:
+                po->m_replay_ip_offset = atoi(args.OptionArg());
+                break;
             default:
                 usage();
                 return -1;
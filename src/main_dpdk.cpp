@@ -50,6 +50,8 @@ limitations under the License.
 #include <rte_mempool.h>
 #include <rte_mbuf.h>
 #include <rte_random.h>
+#include <rte_ip.h>
+#include <rte_tcp.h>
 #include "bp_sim.h"
 #include "os_time.h"
 #include <common/arg/SimpleGlob.h>
@@ -70,6 +72,7 @@ extern "C" {
 #include "global_io_mode.h"
 #include "utl_term_io.h"
 #include "msg_manager.h"
+#include "telemetry_bin.h"
 #include "platform_cfg.h"
 
 
@@ -81,6 +84,7 @@ extern "C" {
 
 #define BP_MAX_PKT      32
 #define MAX_PKT_BURST   32
+#define MAX_TX_OVERFLOW (4*MAX_PKT_BURST) /* per queue, tx backpressure */
 
 
 #define BP_MAX_PORTS (MAX_LATENCY_PORTS)
@@ -139,6 +143,11 @@ public:
     virtual void get_extended_stats(CPhyEthIF * _if,CPhyEthIFStats *stats)=0;
     virtual void clear_extended_stats(CPhyEthIF * _if)=0;
     virtual int  wait_for_stable_link()=0;
+
+    /* TCP segmentation offload of multi segment IPv4 packets */
+    virtual bool tso_is_supported(){
+        return (false);
+    }
 };
 
 
@@ -249,6 +258,10 @@ public:
     virtual void get_extended_stats(CPhyEthIF * _if,CPhyEthIFStats *stats);
     virtual void clear_extended_stats(CPhyEthIF * _if);
     virtual int wait_for_stable_link();
+
+    virtual bool tso_is_supported(){
+        return (true);
+    }
 };
 
 class CTRexExtendedDriverBase40G : public CTRexExtendedDriverBase10G {
@@ -281,6 +294,11 @@ public:
     virtual void get_extended_stats(CPhyEthIF * _if,CPhyEthIFStats *stats);
     virtual void clear_extended_stats(CPhyEthIF * _if);
     virtual int wait_for_stable_link();
+
+    /* the i40e PMD of this DPDK does not implement TSO, software split */
+    virtual bool tso_is_supported(){
+        return (false);
+    }
 private:
     void add_rules(CPhyEthIF * _if,
                    enum rte_eth_flow_type type,
@@ -463,7 +481,24 @@ enum { OPT_HELP,
 	OPT_VLAN,
     OPT_VIRT_ONE_TX_RX_QUEUE,
     OPT_PREFIX,
-    OPT_MAC_SPLIT
+    OPT_MAC_SPLIT,
+    OPT_PUB_INTERVAL,
+    OPT_PUB_BIN,
+    OPT_PRECISE_PACING,
+    OPT_LOW_POWER_IDLE,
+    OPT_TX_BACKPRESSURE,
+    OPT_TSO,
+    OPT_PCAPNG,
+    OPT_TEMPLATE_CACHE,
+    OPT_REPLAY,
+    OPT_REPLAY_RATE,
+    OPT_REPLAY_LOOPS,
+    OPT_REPLAY_IP_OFFSET,
+    OPT_RX_CAPTURE,
+    OPT_RX_CAPTURE_FILTER,
+    OPT_RX_CAPTURE_SNAPLEN,
+    OPT_RX_CAPTURE_ROTATE,
+    OPT_MTU
 
 };
 
@@ -502,15 +537,32 @@ static CSimpleOpt::SOption parser_options[] =
     { OPT_PLATFORM_FACTOR     , "-pm",  SO_REQ_SEP },
 
     { OPT_PUB_DISABLE     , "-pubd",  SO_NONE },
+    { OPT_PUB_INTERVAL    , "-pubi",  SO_REQ_SEP },
+    { OPT_PUB_BIN         , "-pubb",  SO_NONE },
 
 
     { OPT_BW_FACTOR     , "-m",  SO_REQ_SEP },
     { OPT_LATENCY_MASK     , "--lm",  SO_REQ_SEP },
     { OPT_ONLY_LATENCY, "--lo",  SO_NONE  },
+    { OPT_PRECISE_PACING, "--precise-pacing",  SO_NONE  },
+    { OPT_LOW_POWER_IDLE, "--low-power-idle",  SO_NONE  },
+    { OPT_TX_BACKPRESSURE, "--tx-backpressure",  SO_NONE  },
+    { OPT_TSO, "--tso",  SO_NONE  },
 
     { OPT_1G_MODE,       "-1g",   SO_NONE   },
     { OPT_LATENCY_PREVIEW ,       "-k",   SO_REQ_SEP   },
     { OPT_PCAP,       "--pcap",       SO_NONE   },
+    { OPT_PCAPNG,     "--pcapng",     SO_NONE   },
+    { OPT_TEMPLATE_CACHE, "--template-cache", SO_REQ_SEP },
+    { OPT_REPLAY,           "--replay",           SO_REQ_SEP },
+    { OPT_REPLAY_RATE,      "--replay-rate",      SO_REQ_SEP },
+    { OPT_REPLAY_LOOPS,     "--replay-loops",     SO_REQ_SEP },
+    { OPT_REPLAY_IP_OFFSET, "--replay-ip-offset", SO_REQ_SEP },
+    { OPT_RX_CAPTURE,         "--rx-capture",         SO_REQ_SEP },
+    { OPT_RX_CAPTURE_FILTER,  "--rx-capture-filter",  SO_REQ_SEP },
+    { OPT_RX_CAPTURE_SNAPLEN, "--rx-capture-snaplen", SO_REQ_SEP },
+    { OPT_RX_CAPTURE_ROTATE,  "--rx-capture-rotate",  SO_REQ_SEP },
+    { OPT_MTU,                "--mtu",                SO_REQ_SEP },
 	{ OPT_RX_CHECK,   "--rx-check",  SO_REQ_SEP },
     { OPT_IO_MODE,   "--iom",  SO_REQ_SEP },      
     { OPT_RX_CHECK_HOPS, "--hops", SO_REQ_SEP },
@@ -558,6 +610,10 @@ static int usage(){
     printf(" --lm                         : latency mask  \n");
     printf("    0x1 only port 0 will send traffic  \n");
     printf(" --lo                         :only latency test   \n");
+    printf(" --precise-pacing             : send each packet at its exact time and flush it, better timing and lower Mpps \n");
+    printf(" --low-power-idle             : DP and latency cores sleep or tpause on long gaps instead of spinning \n");
+    printf(" --tx-backpressure            : keep the packets the NIC did not take and delay the schedule instead of dropping them \n");
+    printf(" --tso                        : zero IPG TCP trains of pcap timing templates are sent as one packet, NIC TSO on 10G (ixgbe) or software split \n");
 
     printf("  \n");
 
@@ -571,6 +627,8 @@ static int usage(){
     printf("    e.g --pm 2.0 will multiply all the results bps in this factor   \n");
     printf("  \n");
     printf(" -pubd                      : disable monitors publishers  \n");
+    printf(" -pubi [msec]               : monitors publish interval in msec, default 500 minimum 10  \n");
+    printf(" -pubb                      : publish compact binary telemetry on the 'trex-bin' topic in addition to the json ('{' topic) \n");
 
     printf(" -m                         : factor of bandwidth  \n");
     printf("  \n");
@@ -619,6 +677,17 @@ static int usage(){
     printf("  \n");
     printf(" -o [capfile_name]  simulate trex into pcap file  \n");
     printf(" --pcap             export the file in pcap mode \n");
+    printf(" --pcapng           export the file in pcapng mode (nsec timestamps, interface per port) \n");
+    printf(" --template-cache [file] : load the templates precompiled from file, it is built in case it is not valid for the profile \n");
+    printf(" --replay [file]        : replay the capture file instead of the templates, the flows are split between the cores \n");
+    printf(" --replay-rate [n]      : speed up of the replay, 2.0 is twice faster, the gaps between the packets are kept \n");
+    printf(" --replay-loops [n]     : number of loops of the replay file \n");
+    printf(" --replay-ip-offset [n] : added to the IPv4 addresses in each loop \n");
+    printf(" --rx-capture [file]          : write the packets received by the latency core to a pcap file, needs -l \n");
+    printf(" --rx-capture-filter [expr]   : capture only the matching packets, e.g. \"udp and dst port 53 or icmp\" \n");
+    printf(" --rx-capture-snaplen [n]     : max bytes of each captured packet, default 2048, up to 9216 \n");
+    printf(" --rx-capture-rotate [MB]     : start a new file (file.1, file.2 ..) each n MB \n");
+    printf(" --mtu [n]              : MTU of the ports, e.g. 9000 for jumbo frames. the templates can have packets up to 9216 bytes \n");
     printf(" t-rex-64 -d 10 -f cfg.yaml  -o my.pcap --pcap  # export 10 sec of what Trex will do on real-time to a file my.pcap \n");
     printf(" --vm-sim               : simulate vm with driver of one input queue and one output queue \n");
     printf("  \n");
@@ -765,6 +834,18 @@ static int parse_options(int argc, char *argv[], CParserOption* po, bool first_t
             case OPT_PUB_DISABLE:
                 po->preview.set_zmq_publish_enable(false);
                 break;
+            case OPT_PUB_INTERVAL: {
+                /* parse signed so a negative value is rejected rather than wrapped */
+                int msec = 0;
+                if ( (sscanf(args.OptionArg(),"%d", &msec) != 1) || (msec < 10) ){
+                    printf("minimum publish interval is 10 msec you set it to %s \n",args.OptionArg());
+                    return -1;
+                }
+                po->m_pub_interval_msec = (uint32_t)msec;
+                } break;
+            case OPT_PUB_BIN:
+                po->preview.set_zmq_bin_publish_enable(true);
+                break;
             case OPT_PLATFORM_FACTOR:
                 sscanf(args.OptionArg(),"%f", &po->m_platform_factor);
                 break;
@@ -778,6 +859,18 @@ static int parse_options(int argc, char *argv[], CParserOption* po, bool first_t
             case OPT_ONLY_LATENCY :
                 po->preview.setOnlyLatency(true);
                 break;
+            case OPT_PRECISE_PACING :
+                po->preview.set_precise_pacing_enable(true);
+                break;
+            case OPT_LOW_POWER_IDLE :
+                po->preview.set_low_power_idle_enable(true);
+                break;
+            case OPT_TX_BACKPRESSURE :
+                po->preview.set_tx_backpressure_enable(true);
+                break;
+            case OPT_TSO :
+                po->preview.set_tso_enable(true);
+                break;
             case OPT_1G_MODE :
                 po->preview.set_1g_mode(true);
                 break;
@@ -790,6 +883,52 @@ static int parse_options(int argc, char *argv[], CParserOption* po, bool first_t
                 po->preview.set_pcap_mode_enable(true);
                 break;
 
+            case OPT_PCAPNG:
+                po->preview.set_pcapng_mode_enable(true);
+                break;
+
+            case OPT_TEMPLATE_CACHE:
+                po->template_cache_file = args.OptionArg();
+                break;
+
+            case OPT_REPLAY:
+                po->replay_file = args.OptionArg();
+                break;
+
+            case OPT_REPLAY_RATE:
+                po->m_replay_rate = atof(args.OptionArg());
+                break;
+
+            case OPT_REPLAY_LOOPS:
+                sscanf(args.OptionArg(),"%u", &po->m_replay_loops);
+                break;
+
+            case OPT_REPLAY_IP_OFFSET:
+                sscanf(args.OptionArg(),"%u", &po->m_replay_ip_offset);
+                break;
+
+            case OPT_RX_CAPTURE:
+                po->rx_capture_file = args.OptionArg();
+                break;
+
+            case OPT_RX_CAPTURE_FILTER:
+                po->rx_capture_filter = args.OptionArg();
+                break;
+
+            case OPT_RX_CAPTURE_SNAPLEN:
+                sscanf(args.OptionArg(),"%d", &tmp_data);
+                po->m_rx_capture_snaplen=(uint16_t)tmp_data;
+                break;
+
+            case OPT_RX_CAPTURE_ROTATE:
+                sscanf(args.OptionArg(),"%u", &po->m_rx_capture_rotate_mb);
+                break;
+
+            case OPT_MTU:
+                sscanf(args.OptionArg(),"%d", &tmp_data);
+                po->m_mtu=(uint16_t)tmp_data;
+                break;
+
             case OPT_RX_CHECK :
                 sscanf(args.OptionArg(),"%d", &tmp_data);
                 po->m_rx_check_sampe=(uint16_t)tmp_data;
@@ -837,6 +976,11 @@ static int parse_options(int argc, char *argv[], CParserOption* po, bool first_t
          return -1;
      }
 
+    if ( po->m_pub_interval_msec < 10 ){
+       printf("minimum publish interval is 10 msec you set it to %u \n",po->m_pub_interval_msec);
+       return -1;
+    }
+
     if ( po->m_mac_splitter > 128 ){
        printf("maximum mac spreading is 128 you set it to %d \n",po->m_mac_splitter);
        return -1;
@@ -859,6 +1003,11 @@ static int parse_options(int argc, char *argv[], CParserOption* po, bool first_t
         return -1;
     }
 
+    if ( (po->rx_capture_file != "") &&  ( po->is_latency_disabled() ) ) {
+        printf(" --rx-capture works with latency check, packets are captured by the latency core. try adding '-l 1000'   \n");
+        return -1;
+    }
+
     if ( node_dump ){
         po->preview.setVMode(a);
     }
@@ -982,6 +1131,16 @@ struct port_cfg_t {
         get_ex_drv()->update_configuration(this);
     }
 
+    /* a frame above the rx mbuf is received as a chain */
+    inline void update_mtu(uint16_t mtu){
+        if ( mtu == 0 ) {
+            return;
+        }
+        m_port_conf.rxmode.max_rx_pkt_len = mtu + ETHER_HDR_LEN + 4 + ETHER_CRC_LEN; /* 4 for a vlan tag */
+        m_port_conf.rxmode.jumbo_frame    = (m_port_conf.rxmode.max_rx_pkt_len > ETHER_MAX_LEN)?1:0;
+        m_port_conf.rxmode.enable_scatter = (m_port_conf.rxmode.max_rx_pkt_len > MAX_BUF_SIZE)?1:0;
+    }
+
     inline void update_global_config_fdir(void){
         get_ex_drv()->update_global_config_fdir(this);
     }
@@ -1387,6 +1546,13 @@ void CPhyEthIF::configure(uint16_t nb_rx_queue,
     /* get device info */
     rte_eth_dev_info_get(m_port_id, &m_dev_info);
 
+    uint16_t mtu=CGlobalInfo::m_options.m_mtu;
+    if ( mtu ) {
+        ret = rte_eth_dev_set_mtu(m_port_id,mtu);
+        if (ret < 0) {
+            printf(" WARNING can't set MTU %d on port %d, err=%d \n",mtu,m_port_id,ret);
+        }
+    }
 }
 
 
@@ -1774,11 +1940,14 @@ public:
             m_table[i]=0;
         }
         m_port=0;
+        m_ovf_len=0;
     }
     uint16_t                m_tx_queue_id;
     uint16_t                m_len;
     rte_mbuf_t *            m_table[MAX_PKT_BURST];
     CPhyEthIF  *            m_port;  
+    uint16_t                m_ovf_len;  /* packets the NIC did not take, tx backpressure */
+    rte_mbuf_t *            m_ovf[MAX_TX_OVERFLOW];
 };
 
 
@@ -1808,13 +1977,17 @@ public:
     }
 
     virtual int close_file(void){
-        return (flush_tx_queue());
+        flush_tx_queue();
+        drain_overflow();
+        return (0);
     }
 
     virtual int send_node(CGenNode * node);
     virtual void send_one_pkt(pkt_dir_t       dir, rte_mbuf_t      *m);
+    virtual int send_mbuf(pkt_dir_t dir, rte_mbuf_t *m, dsec_t time);
 
     virtual int flush_tx_queue(void);
+    virtual bool is_tx_backpressure(void);
 
     __attribute__ ((noinline)) void flush_rx_queue();
     __attribute__ ((noinline)) void update_mac_addr(CGenNode * node,uint8_t *p);
@@ -1841,12 +2014,24 @@ private:
     int send_pkt(CCorePerPort * lp_port,
                  rte_mbuf_t *m,
                  CVirtualIFPerSideStats  * lp_stats);
+    int send_burst_bp(CCorePerPort * lp_port,
+                      uint16_t len,
+                      CVirtualIFPerSideStats  * lp_stats);
+    uint16_t tx_overflow(CCorePerPort * lp_port);
+    void drain_overflow();
+    void send_tso_train(CGenNode * node,
+                        CFlowPktInfo * lp,
+                        rte_mbuf_t * m,
+                        CCorePerPort * lp_port,
+                        CVirtualIFPerSideStats  * lp_stats);
 
 
 
 private:
     uint8_t      m_core_id;
     uint16_t     m_mbuf_cache; 
+    bool         m_is_tx_bp;   /* tx backpressure mode */
+    bool         m_is_tso;     /* TSO trains are split by the NIC */
     CCorePerPort m_ports[CS_NUM]; /* each core has 2 tx queues 1. client side and server side */
     CNodeRing *  m_ring_to_rx;
 };
@@ -1863,6 +2048,8 @@ bool CCoreEthIF::Create(uint8_t             core_id,
     m_ports[SERVER_SIDE].m_tx_queue_id = tx_server_queue_id;
     m_ports[SERVER_SIDE].m_port        = tx_server_port;
     m_core_id = core_id;
+    m_is_tx_bp = CGlobalInfo::m_options.preview.get_tx_backpressure_enable();
+    m_is_tso   = CGlobalInfo::m_options.preview.get_tso_enable() && get_ex_drv()->tso_is_supported();
 
     CMessagingManager * rx_dp=CMsgIns::Ins()->getRxDp();
     m_ring_to_rx = rx_dp->getRingDpToCp(core_id-1);
@@ -1960,6 +2147,10 @@ int CCoreEthIF::flush_tx_queue(void){
         if ( likely(lp_port->m_len > 0) ) {
             send_burst(lp_port,lp_port->m_len,lp_stats);
              lp_port->m_len = 0;
+        }else{
+            if ( unlikely(lp_port->m_ovf_len > 0) ) {
+                tx_overflow(lp_port);
+            }
         }
     }
 
@@ -2023,10 +2214,86 @@ void CCoreEthIF::DumpIfStats(FILE *fd){
 
 #define DELAY_IF_NEEDED
 
+/* send the head of the overflow, return the number of packets that are still there */
+uint16_t CCoreEthIF::tx_overflow(CCorePerPort * lp_port){
+    uint16_t ret = lp_port->m_port->tx_burst(lp_port->m_tx_queue_id,lp_port->m_ovf,lp_port->m_ovf_len);
+    if ( ret > 0 ) {
+        lp_port->m_ovf_len -= ret;
+        memmove(&lp_port->m_ovf[0],&lp_port->m_ovf[ret],lp_port->m_ovf_len*sizeof(rte_mbuf_t *));
+    }
+    return (lp_port->m_ovf_len);
+}
+
+bool CCoreEthIF::is_tx_backpressure(void){
+    bool res=false;
+    pkt_dir_t   dir ;
+    for (dir=CLIENT_SIDE; dir<CS_NUM; dir++) {
+        CCorePerPort * lp_port=&m_ports[dir];
+        if ( lp_port->m_ovf_len > 0 ) {
+            if ( tx_overflow(lp_port) > 0 ) {
+                res=true;
+            }
+        }
+    }
+    return (res);
+}
+
+/* the test is stopped, give the NIC some time and drop the rest */
+void CCoreEthIF::drain_overflow(){
+    int i;
+    for (i=0; i<1000; i++) {
+        if ( !is_tx_backpressure() ) {
+            return;
+        }
+        rte_delay_us(1);
+    }
+    pkt_dir_t   dir ;
+    for (dir=CLIENT_SIDE; dir<CS_NUM; dir++) {
+        CCorePerPort * lp_port=&m_ports[dir];
+        uint16_t j;
+        for (j=0; j<lp_port->m_ovf_len; j++) {
+            rte_pktmbuf_free(lp_port->m_ovf[j]);
+        }
+        m_stats[dir].m_tx_drop += lp_port->m_ovf_len;
+        lp_port->m_ovf_len=0;
+    }
+}
+
+/* tx backpressure, the packets the NIC does not take wait in the overflow in their order.
+   the generator sees is_tx_backpressure() and pushes its schedule. only a full overflow blocks */
+int CCoreEthIF::send_burst_bp(CCorePerPort * lp_port,
+                              uint16_t len,
+                              CVirtualIFPerSideStats  * lp_stats){
+    uint16_t ret=0;
+    if ( likely( (lp_port->m_ovf_len == 0) || (tx_overflow(lp_port)==0) ) ) {
+        ret = lp_port->m_port->tx_burst(lp_port->m_tx_queue_id,lp_port->m_table,len);
+        if ( likely( ret == len ) ) {
+            return (0);
+        }
+    }
+    lp_stats->m_tx_delay += (len-ret);
+    while ( ret < len ) {
+        if ( unlikely( lp_port->m_ovf_len == MAX_TX_OVERFLOW ) ) {
+            rte_delay_us(1);
+            lp_stats->m_tx_queue_full += 1;
+            tx_overflow(lp_port);
+            continue;
+        }
+        lp_port->m_ovf[lp_port->m_ovf_len++] = lp_port->m_table[ret++];
+    }
+    return (0);
+}
+
 int CCoreEthIF::send_burst(CCorePerPort * lp_port,
                            uint16_t len,
                            CVirtualIFPerSideStats  * lp_stats){
 
+    DP_CYCLE_START(t_tx);
+    if ( unlikely( m_is_tx_bp ) ) {
+        send_burst_bp(lp_port,len,lp_stats);
+        DP_CYCLE_END(t_tx,cpTX_BURST);
+        return (0);
+    }
     uint16_t ret = lp_port->m_port->tx_burst(lp_port->m_tx_queue_id,lp_port->m_table,len);
     #ifdef DELAY_IF_NEEDED
     while ( unlikely( ret<len ) ){
@@ -2050,6 +2317,8 @@ int CCoreEthIF::send_burst(CCorePerPort * lp_port,
             rte_pktmbuf_free(m);
         }
     }
+    DP_CYCLE_END(t_tx,cpTX_BURST);
+    return (0);
 }
                          
 
@@ -2085,6 +2354,20 @@ void CCoreEthIF::send_one_pkt(pkt_dir_t       dir,
 }
 
 
+int CCoreEthIF::send_mbuf(pkt_dir_t dir, rte_mbuf_t *m, dsec_t time){
+    CCorePerPort *  lp_port=&m_ports[dir];
+    CVirtualIFPerSideStats  * lp_stats = &m_stats[dir];
+
+    /* update mac addr dest/src 12 bytes */
+    uint8_t *p=rte_pktmbuf_mtod(m, uint8_t*);
+    uint8_t p_id=lp_port->m_port->get_port_id();
+    memcpy(p,CGlobalInfo::m_options.get_dst_src_mac_addr(p_id),12);
+
+    send_pkt(lp_port,m,lp_stats);
+    return (0);
+}
+
+
 void CCoreEthIF::update_mac_addr(CGenNode * node,uint8_t *p){
 
     if ( CGlobalInfo::m_options.preview.getDestMacSplit() ) {
@@ -2193,12 +2476,87 @@ int CCoreEthIF::send_node(CGenNode * node){
     /*printf("send packet -- \n");
     rte_pktmbuf_dump(stdout,m, rte_pktmbuf_pkt_len(m));*/
 
+    if ( unlikely( lp->is_tso_head() ) ) {
+        send_tso_train(node,lp,m,lp_port,lp_stats);
+        return (0);
+    }
+
     /* send the packet */
     send_pkt(lp_port,m,lp_stats);
     return (0);
 }
 
 
+/* m is the first packet of a TSO train, ready to send */
+void CCoreEthIF::send_tso_train(CGenNode * node,
+                                CFlowPktInfo * lp,
+                                rte_mbuf_t * m,
+                                CCorePerPort * lp_port,
+                                CVirtualIFPerSideStats  * lp_stats){
+    uint32_t index=lp->m_pkt_indication.m_packet->pkt_cnt;
+    uint16_t segs=lp->m_tso_segs;
+    int i;
+
+    /* the NIC needs all the headers in the first (rewritten) segment */
+    if ( !m_is_tso || (lp->m_pkt_indication.getPayloadOffset() > FIRST_PKT_SIZE) ) {
+        /* software split, each packet from its own header with the mac/vlan of the first one */
+        uint8_t mac[12];
+        memcpy(mac,rte_pktmbuf_mtod(m, uint8_t*),12);
+        uint64_t ol_flags = m->ol_flags;
+        uint16_t vlan_tci = m->vlan_tci;
+        send_pkt(lp_port,m,lp_stats);
+        for (i=1; i<segs; i++) {
+            rte_mbuf_t * mn=node->m_flow_info->GetPacket(index-1+i)->generate_new_mbuf(node);
+            memcpy(rte_pktmbuf_mtod(mn, uint8_t*),mac,12);
+            if ( ol_flags & PKT_TX_VLAN_PKT ) {
+                mn->ol_flags = ol_flags;
+                mn->l2_len   = 14;
+                mn->vlan_tci = vlan_tci;
+            }
+            send_pkt(lp_port,mn,lp_stats);
+        }
+        return;
+    }
+
+    /* one frame with the payload of all the train, the const payload mbufs are chained after the first packet */
+    rte_mbuf_t * last=m;
+    while ( last->next ) {
+        last=last->next;
+    }
+    socket_id_t socket=node->get_socket_id();
+    for (i=1; i<segs; i++) {
+        rte_mbuf_t * mp=node->m_flow_info->GetPacket(index-1+i)->get_tso_mbuf(socket);
+        rte_mbuf_refcnt_update(mp,1);
+        last->next = mp;
+        last = mp;
+        m->pkt_len += mp->data_len;
+        m->nb_segs++;
+    }
+    TCPHeader * last_tcp = node->m_flow_info->GetPacket(index-1+segs-1)->m_pkt_indication.l4.m_tcp;
+
+    uint8_t * p=rte_pktmbuf_mtod(m, uint8_t*);
+    IPHeader  * ipv4=(IPHeader *)(p+lp->m_pkt_indication.getFastIpOffsetFast());
+    TCPHeader * tcp =(TCPHeader *)(p+lp->m_pkt_indication.getFastTcpOffset());
+    uint8_t l3_len=ipv4->getHeaderLength();
+    uint8_t l4_len=tcp->getHeaderLength();
+    ipv4->setTotalLength(l3_len+l4_len+lp->m_tso_payload);
+    ipv4->myChecksum=0;
+    /* PSH of the last packet, the NIC sets it only in the last segment */
+    tcp->setFlag(last_tcp->getFlags());
+    m->ol_flags |= (PKT_TX_TCP_SEG | PKT_TX_IPV4 | PKT_TX_IP_CKSUM);
+    m->l2_len    = lp->m_pkt_indication.getFastIpOffsetFast();
+    m->l3_len    = l3_len;
+    m->l4_len    = l4_len;
+    m->tso_segsz = lp->m_tso_mss;
+    ((struct tcp_hdr *)tcp)->cksum = rte_ipv4_phdr_cksum((struct ipv4_hdr *)ipv4,m->ol_flags);
+
+    /* counters are per segment on the wire */
+    lp_stats->m_tx_pkt   += (segs-1);
+    lp_stats->m_tx_bytes += (segs-1)*(lp->m_pkt_indication.getPayloadOffset()+4);
+    send_pkt(lp_port,m,lp_stats);
+}
+
+
 
 class CLatencyHWPort : public CPortLatencyHWBase {
 public:
@@ -2213,13 +2571,7 @@ public:
     virtual int tx(rte_mbuf_t * m){
         rte_mbuf_t * tx_pkts[2];
         tx_pkts[0]=m;
-        if ( likely( CGlobalInfo::m_options.preview.get_vlan_mode_enable() ) ){
-             /* vlan mode is the default */
-             /* set the vlan */
-             m->ol_flags = PKT_TX_VLAN_PKT;
-             m->vlan_tci =CGlobalInfo::m_options.m_vlan_port[0];
-			 m->l2_len   =14;
-        }
+        update_tx_flags(m);
         uint16_t res=m_port->tx_burst(m_tx_queue_id,tx_pkts,1);
         if ( res == 0 ) {
             rte_pktmbuf_free(m);
@@ -2236,6 +2588,16 @@ public:
 
         return (0);
     }
+
+    virtual uint16_t tx_burst(rte_mbuf_t ** tx_pkts,
+                              uint16_t nb_pkts){
+        uint16_t i;
+        for (i=0; i<nb_pkts; i++) {
+            update_tx_flags(tx_pkts[i]);
+        }
+        return (m_port->tx_burst(m_tx_queue_id,tx_pkts,nb_pkts));
+    }
+
     virtual rte_mbuf_t * rx(){
         rte_mbuf_t * rx_pkts[1];
         uint16_t cnt=m_port->rx_burst(m_rx_queue_id,rx_pkts,1);
@@ -2253,6 +2615,17 @@ public:
     }
 
 
+private:
+    inline void update_tx_flags(rte_mbuf_t * m){
+        if ( likely( CGlobalInfo::m_options.preview.get_vlan_mode_enable() ) ){
+             /* vlan mode is the default */
+             /* set the vlan */
+             m->ol_flags = PKT_TX_VLAN_PKT;
+             m->vlan_tci =CGlobalInfo::m_options.m_vlan_port[0];
+			 m->l2_len   =14;
+        }
+    }
+
 private:
     CPhyEthIF  * m_port;
     uint8_t      m_tx_queue_id ;
@@ -2284,11 +2657,13 @@ public:
             node->m_msg_type = CGenNodeMsgBase::LATENCY_PKT;
             node->m_dir      = m_dir;
             node->m_pkt      = m;
-            node->m_latency_offset = m_mgr->get_latency_header_offset();
+            node->m_latency_offset = CLatencyManager::get_latency_header_offset(m);
 
             if ( m_ring_to_dp->Enqueue((CGenNode*)node) ==0 ){
                 return (0);
             }
+            /* ring is full, m is freed by the caller */
+            CGlobalInfo::free_node((CGenNode*)node);
         }
         return (-1);
     }
@@ -2320,6 +2695,10 @@ public:
     bool Create(uint16_t port,bool disable);
     void Delete();
     void publish_json(std::string & s);
+    bool try_publish_json(std::string & s);
+    bool is_enabled(){
+        return (m_publisher?true:false);
+    }
 private:
     void show_zmq_last_error(char *s);
 private:
@@ -2376,6 +2755,98 @@ void CZMqPublisher::publish_json(std::string & s){
     }
 }
 
+/* does not block, return false in case the socket is busy and the message should be sent later */
+bool CZMqPublisher::try_publish_json(std::string & s){
+    if ( m_publisher ){
+        int size = zmq_send (m_publisher, s.c_str(), s.length(), ZMQ_DONTWAIT);
+        if ( size < 0 ) {
+            return ( (zmq_errno() == EAGAIN)?false:true );
+        }
+        assert(size==s.length());
+    }
+    return (true);
+}
+
+
+/* bounded queue of preallocated json buffers between the telemetry sampler and the
+   publisher. the buffers keep their capacity so building the json does not allocate.
+   in case the subscribers are slow the oldest message is dropped  */
+class CTelemetryQueue {
+public:
+    enum {
+        QUEUE_SIZE  = 32,
+        BUFFER_SIZE = (64*1024)
+    };
+
+    void Create();
+    void Delete();
+
+    /* buffer for the next message, the oldest is dropped if the queue is full */
+    std::string & alloc();
+    void commit();
+
+    bool is_empty(){
+        return (m_cnt==0);
+    }
+    std::string & front(){
+        return (m_buf[m_tail]);
+    }
+    void pop();
+
+public:
+    uint64_t    m_sent;
+    uint64_t    m_drop;
+private:
+    uint32_t    m_head;
+    uint32_t    m_tail;
+    uint32_t    m_cnt;
+    std::string m_buf[QUEUE_SIZE];
+};
+
+void CTelemetryQueue::Create(){
+    int i;
+    for (i=0; i<QUEUE_SIZE; i++) {
+        m_buf[i].reserve(BUFFER_SIZE);
+    }
+    m_head=0;
+    m_tail=0;
+    m_cnt=0;
+    m_sent=0;
+    m_drop=0;
+}
+
+void CTelemetryQueue::Delete(){
+    int i;
+    for (i=0; i<QUEUE_SIZE; i++) {
+        std::string().swap(m_buf[i]);
+    }
+}
+
+std::string & CTelemetryQueue::alloc(){
+    if ( m_cnt == QUEUE_SIZE ) {
+        pop();
+        m_drop++;
+    }
+    return (m_buf[m_head]);
+}
+
+void CTelemetryQueue::commit(){
+    m_head++;
+    if (m_head==QUEUE_SIZE) {
+        m_head=0;
+    }
+    m_cnt++;
+}
+
+void CTelemetryQueue::pop(){
+    assert(m_cnt>0);
+    m_tail++;
+    if (m_tail==QUEUE_SIZE) {
+        m_tail=0;
+    }
+    m_cnt--;
+}
+
 class CPerPortStats {
 public:
     uint64_t opackets;
@@ -2403,6 +2874,7 @@ public:
     uint64_t  m_total_alloc_error;
     uint64_t  m_total_queue_full;
     uint64_t  m_total_queue_drop;
+    uint64_t  m_total_queue_delay;
 
     uint64_t  m_total_clients;
     uint64_t  m_total_servers;
@@ -2438,6 +2910,7 @@ public:
     void Dump(FILE *fd,DumpFormat mode);
     void DumpAllPorts(FILE *fd);
     void dump_json(std::string & json);
+    void dump_bin(std::string & buf,uint32_t seq,uint64_t time_usec);
 private:
     std::string get_field(std::string name,float &f);
     std::string get_field(std::string name,uint64_t &f);
@@ -2521,6 +2994,41 @@ void CGlobalStats::dump_json(std::string & json){
     json+="\"unknown\":0}}"  ;
 }
 
+void CGlobalStats::dump_bin(std::string & buf,uint32_t seq,uint64_t time_usec){
+    CTelemetryBinEncoder enc;
+    enc.begin(buf,CTelemetryBin::tbGLOBAL,seq,time_usec,
+              CTelemetryBin::G_LAST,m_num_of_ports,CTelemetryBin::P_LAST);
+
+    enc.set(CTelemetryBin::G_TX_PKTS,m_total_tx_pkts);
+    enc.set(CTelemetryBin::G_RX_PKTS,m_total_rx_pkts);
+    enc.set(CTelemetryBin::G_TX_BYTES,m_total_tx_bytes);
+    enc.set(CTelemetryBin::G_RX_BYTES,m_total_rx_bytes);
+    enc.set(CTelemetryBin::G_ALLOC_ERROR,m_total_alloc_error);
+    enc.set(CTelemetryBin::G_QUEUE_FULL,m_total_queue_full);
+    enc.set(CTelemetryBin::G_QUEUE_DROP,m_total_queue_drop);
+    enc.set(CTelemetryBin::G_QUEUE_DELAY,m_total_queue_delay);
+    enc.set_double(CTelemetryBin::G_ACTIVE_FLOWS,m_active_flows);
+    enc.set_double(CTelemetryBin::G_OPEN_FLOWS,m_open_flows);
+    enc.set_double(CTelemetryBin::G_TX_BPS,m_tx_bps);
+    enc.set_double(CTelemetryBin::G_RX_BPS,m_rx_bps);
+    enc.set_double(CTelemetryBin::G_TX_PPS,m_tx_pps);
+    enc.set_double(CTelemetryBin::G_TX_CPS,m_tx_cps);
+    enc.set_double(CTelemetryBin::G_RX_DROP_BPS,m_rx_drop_bps);
+    enc.set_double(CTelemetryBin::G_CPU_UTIL,m_cpu_util);
+
+    int i;
+    for (i=0; i<(int)m_num_of_ports; i++) {
+        CPerPortStats * lp=&m_port[i];
+        enc.set_rec(i,CTelemetryBin::P_OPACKETS,lp->opackets);
+        enc.set_rec(i,CTelemetryBin::P_OBYTES,lp->obytes);
+        enc.set_rec(i,CTelemetryBin::P_IPACKETS,lp->ipackets);
+        enc.set_rec(i,CTelemetryBin::P_IBYTES,lp->ibytes);
+        enc.set_rec(i,CTelemetryBin::P_IERRORS,lp->ierrors);
+        enc.set_rec(i,CTelemetryBin::P_OERRORS,lp->oerrors);
+        enc.set_rec_double(i,CTelemetryBin::P_TX_BPS,lp->m_total_tx_bps);
+    }
+}
+
 void CGlobalStats::DumpAllPorts(FILE *fd){
 
     //fprintf (fd," Total-Tx-Pkts   : %s  \n",double_to_human_str((double)m_total_tx_pkts,"pkts",KBYE_1000).c_str());
@@ -2587,6 +3095,9 @@ void CGlobalStats::DumpAllPorts(FILE *fd){
     if (m_total_queue_drop) {
         fprintf (fd," Total_queue_drop : %llu         \n",(uint64_t)m_total_queue_drop);
     }
+    if (m_total_queue_delay) {
+        fprintf (fd," Total_queue_delay: %llu         \n",(uint64_t)m_total_queue_delay);
+    }
 
     //m_template.Dump(fd);
 
@@ -2698,6 +3209,11 @@ public:
        m_expected_pps=0.0;                
        m_expected_cps=0.0;
        m_expected_bps=0.0;
+       m_last_cpu_update_msec=0;
+       m_telemetry_stop=false;
+       m_telemetry_running=false;
+       memset(m_telemetry_bin_seq,0,sizeof(m_telemetry_bin_seq));
+       pthread_mutex_init(&m_latency_lock,NULL);
     }
 public:
 
@@ -2737,6 +3253,11 @@ public:
     int run_in_master();
     int stop_master();
 
+    /* telemetry thread, sample the counters and publish them to zmq */
+    void start_telemetry();
+    void stop_telemetry();
+    void run_in_telemetry();
+
 
     /* return the minimum number of dp cores need to support the active ports 
        this is for c==1 or  m_cores_mul==1
@@ -2773,6 +3294,9 @@ public:
 private:
     bool is_all_cores_finished();
 
+    void telemetry_sample(bool slow_path);
+    void telemetry_flush();
+
     int test_send_pkts(uint16_t queue_id,
                           int pkt,
                           int port);
@@ -2785,8 +3309,7 @@ private:
 
 
 public:
-    void dump_stats(FILE *fd,
-                    std::string & json,CGlobalStats::DumpFormat format);
+    void dump_stats(FILE *fd,CGlobalStats::DumpFormat format);
 
     void dump_template_info(std::string & json);
 
@@ -2794,6 +3317,7 @@ public:
 
     void update_stats(void);
     void get_stats(CGlobalStats & stats);
+    void get_last_stats(CGlobalStats & stats);
 
 
     void dump_post_test_stats(FILE *fd);
@@ -2828,6 +3352,7 @@ public:
     float        m_expected_cps;                
     float        m_expected_bps;//bps           
     float        m_last_total_cps;
+    uint32_t     m_last_cpu_update_msec;
 
 
 
@@ -2842,7 +3367,9 @@ public:
     volatile uint8_t       m_signal[BP_MAX_CORES] __rte_cache_aligned ;
 
     CLatencyManager     m_mg;
+    std::vector<CLatencyStreamYamlInfo> m_latency_streams; /* from the traffic yaml */
     CTrexGlobalIoMode   m_io_modes;
+    CDpStatsSnapshot    m_snap; /* copy of the DP snapshots, reused by update_stats/get_stats */
 
 private:
 
@@ -2855,6 +3382,14 @@ private:
 
     CLatencyPktInfo     m_latency_pkt;
     CZMqPublisher       m_zmq_publisher;
+
+    CTelemetryQueue     m_telemetry_queue;
+    CSeqLockSnapshot<CGlobalStats> m_last_stats; /* written by the telemetry thread, read by the master */
+    pthread_t           m_telemetry_tid;
+    volatile bool       m_telemetry_stop;
+    bool                m_telemetry_running;
+    pthread_mutex_t     m_latency_lock;  /* m_mg is updated by the master and dumped by the telemetry thread */
+    uint32_t            m_telemetry_bin_seq[CTelemetryBin::tbLAST]; /* per binary message type */
 };
 
 
@@ -3200,6 +3735,7 @@ int  CGlobalPortCfg::ixgbe_configure_mg(void){
     }else{
         mg_cfg.m_cps = 100.0;
     }
+    mg_cfg.m_streams = m_latency_streams;
 
     if ( get_vm_one_queue_enable() ) {
         /* vm mode, indirect queues  */
@@ -3226,7 +3762,10 @@ int  CGlobalPortCfg::ixgbe_configure_mg(void){
     }
 
 
-    m_mg.Create(&mg_cfg);
+    if ( !m_mg.Create(&mg_cfg) ) {
+        printf(" ERROR could not create the latency streams \n");
+        exit(-1);
+    }
     m_mg.set_mask(CGlobalInfo::m_options.m_latency_mask);
 }
 
@@ -3381,6 +3920,7 @@ bool CGlobalPortCfg::Create(){
                                  !CGlobalInfo::m_options.preview.get_zmq_publish_enable() ) ){
        return (false);
    }
+   m_telemetry_queue.Create();
 
 
    /* We load the YAML twice, 
@@ -3391,6 +3931,7 @@ bool CGlobalPortCfg::Create(){
    if ( pre_yaml_info.m_vlan_info.m_enable ){
        CGlobalInfo::m_options.preview.set_vlan_mode_enable(true);
    }
+   m_latency_streams = pre_yaml_info.m_latency_streams;
    /* End update pre flags */
 
    ixgbe_prob_init();
@@ -3426,6 +3967,7 @@ bool CGlobalPortCfg::Create(){
 
 }
 void CGlobalPortCfg::Delete(){
+    m_telemetry_queue.Delete();
     m_zmq_publisher.Delete();
 }
 
@@ -3508,6 +4050,7 @@ int  CGlobalPortCfg::ixgbe_prob_init(void){
 
 
     m_port_cfg.update_var();
+    m_port_cfg.update_mtu(CGlobalInfo::m_options.m_mtu);
 
     if ( get_is_rx_filter_enable() ){
         m_port_cfg.update_global_config_fdir();
@@ -3625,6 +4168,8 @@ void CGlobalPortCfg::dump_post_test_stats(FILE *fd){
     fprintf (fd," Total-rx-pkt         : %llu pkts \n",pkt_in);
     fprintf (fd," Total-sw-tx-pkt      : %llu pkts \n",sw_pkt_out);
     fprintf (fd," Total-sw-err         : %llu pkts \n",sw_pkt_out_err);
+    fprintf (fd," \n");
+    m_fl.DumpLateness(fd);
 
 
     if ( !CGlobalInfo::m_options.is_latency_disabled() ){
@@ -3650,11 +4195,17 @@ void CGlobalPortCfg::update_stats(){
     CFlowGenListPerThread   * lpt;
     for (i=0; i<get_cores_tx(); i++) {
         lpt = m_fl.m_threads_info[i];
-        total_open_flows +=   lpt->m_stats.m_total_open_flows ;
+        lpt->get_stats_snapshot(m_snap);
+        total_open_flows +=   m_snap.m_stats.m_total_open_flows ;
     }
     m_last_total_cps = m_cps.add(total_open_flows);
-    m_fl.Update();
 
+    /* the cpu utilization filter is tuned for 500msec updates, the sampling could be faster */
+    uint32_t c_msec=os_get_time_msec();
+    if ( (c_msec - m_last_cpu_update_msec) >= 500 ) {
+        m_last_cpu_update_msec = c_msec;
+        m_fl.Update();
+    }
 }
 
 
@@ -3672,6 +4223,7 @@ void CGlobalPortCfg::get_stats(CGlobalStats & stats){
     stats.m_total_alloc_error=0;
     stats.m_total_queue_full=0;
     stats.m_total_queue_drop=0;
+    stats.m_total_queue_delay=0;
 
 
     stats.m_num_of_ports = m_max_ports;
@@ -3724,19 +4276,23 @@ void CGlobalPortCfg::get_stats(CGlobalStats & stats){
 
     for (i=0; i<get_cores_tx(); i++) {
         lpt = m_fl.m_threads_info[i];
-        total_open_flows +=   lpt->m_stats.m_total_open_flows ;
-        total_active_flows += (lpt->m_stats.m_total_open_flows-lpt->m_stats.m_total_close_flows) ;
+        /* never read the live DP counters, take a consistent copy */
+        lpt->get_stats_snapshot(m_snap);
+        total_open_flows +=   m_snap.m_stats.m_total_open_flows ;
+        total_active_flows += (m_snap.m_stats.m_total_open_flows-m_snap.m_stats.m_total_close_flows) ;
 
-        stats.m_total_alloc_error += lpt->m_node_gen.m_v_if->m_stats[0].m_tx_alloc_error+
-                               lpt->m_node_gen.m_v_if->m_stats[1].m_tx_alloc_error;
-        stats.m_total_queue_full +=lpt->m_node_gen.m_v_if->m_stats[0].m_tx_queue_full+
-                               lpt->m_node_gen.m_v_if->m_stats[1].m_tx_queue_full;
+        stats.m_total_alloc_error += m_snap.m_if_stats[0].m_tx_alloc_error+
+                               m_snap.m_if_stats[1].m_tx_alloc_error;
+        stats.m_total_queue_full +=m_snap.m_if_stats[0].m_tx_queue_full+
+                               m_snap.m_if_stats[1].m_tx_queue_full;
 
-        stats.m_total_queue_drop =lpt->m_node_gen.m_v_if->m_stats[0].m_tx_drop+
-                               lpt->m_node_gen.m_v_if->m_stats[1].m_tx_drop;
+        stats.m_total_queue_drop +=m_snap.m_if_stats[0].m_tx_drop+
+                               m_snap.m_if_stats[1].m_tx_drop;
+        stats.m_total_queue_delay +=m_snap.m_if_stats[0].m_tx_delay+
+                               m_snap.m_if_stats[1].m_tx_delay;
 
-        stats.m_template.Add(&lpt->m_node_gen.m_v_if->m_stats[0].m_template);
-        stats.m_template.Add(&lpt->m_node_gen.m_v_if->m_stats[1].m_template);
+        stats.m_template.Add(&m_snap.m_if_stats[0].m_template);
+        stats.m_template.Add(&m_snap.m_if_stats[1].m_template);
 
 
         total_clients   += lpt->m_smart_gen.getTotalClients();
@@ -3744,11 +4300,11 @@ void CGlobalPortCfg::get_stats(CGlobalStats & stats){
         active_sockets  += lpt->m_smart_gen.ActiveSockets();
         total_sockets   += lpt->m_smart_gen.MaxSockets();
 
-        total_nat_time_out +=lpt->m_stats.m_nat_flow_timeout;
-        total_nat_no_fid   +=lpt->m_stats.m_nat_lookup_no_flow_id ;
-        total_nat_active   +=lpt->m_stats.m_nat_lookup_add_flow_id - lpt->m_stats.m_nat_lookup_remove_flow_id;
-        total_nat_open     +=lpt->m_stats.m_nat_lookup_add_flow_id;
-        total_nat_learn_error   +=lpt->m_stats.m_nat_flow_learn_error;
+        total_nat_time_out +=m_snap.m_stats.m_nat_flow_timeout;
+        total_nat_no_fid   +=m_snap.m_stats.m_nat_lookup_no_flow_id ;
+        total_nat_active   +=m_snap.m_stats.m_nat_lookup_add_flow_id - m_snap.m_stats.m_nat_lookup_remove_flow_id;
+        total_nat_open     +=m_snap.m_stats.m_nat_lookup_add_flow_id;
+        total_nat_learn_error   +=m_snap.m_stats.m_nat_flow_learn_error;
     }
 
     stats.m_total_nat_time_out = total_nat_time_out;
@@ -3819,11 +4375,20 @@ void CGlobalPortCfg::dump_template_info(std::string & json){
     json+="]}" ;
 }
 
-void CGlobalPortCfg::dump_stats(FILE *fd,std::string & json,
+/* last stats sampled by the telemetry thread, or fresh one in case it does not run */
+void CGlobalPortCfg::get_last_stats(CGlobalStats & stats){
+    if ( m_telemetry_running ) {
+        m_last_stats.read(stats);
+    }else{
+        update_stats();
+        get_stats(stats);
+    }
+}
+
+void CGlobalPortCfg::dump_stats(FILE *fd,
                                 CGlobalStats::DumpFormat format){
     CGlobalStats  stats;
-    update_stats();
-    get_stats(stats);
+    get_last_stats(stats);
     if (format==CGlobalStats::dmpTABLE) {
         if ( m_io_modes.m_g_mode == CTrexGlobalIoMode::gNORMAL ){
             switch (m_io_modes.m_pp_mode ){
@@ -3855,14 +4420,134 @@ void CGlobalPortCfg::dump_stats(FILE *fd,std::string & json,
         stats.Dump(fd,format);
         stats.DumpAllPorts(fd);
     }
-    stats.dump_json(json);
+}
+
+
+static void * telemetry_thread(void * arg){
+    CGlobalPortCfg * lp=(CGlobalPortCfg *)arg;
+    lp->run_in_telemetry();
+    return (0);
+}
+
+void CGlobalPortCfg::start_telemetry(){
+    /* first sample before the master reads it */
+    telemetry_sample(true);
+    m_telemetry_stop=false;
+    if ( pthread_create(&m_telemetry_tid,NULL,telemetry_thread,this) !=0 ){
+        printf(" ERROR can't create telemetry thread \n");
+        exit(-1);
+    }
+    m_telemetry_running=true;
+}
+
+void CGlobalPortCfg::stop_telemetry(){
+    if ( !m_telemetry_running ) {
+        return;
+    }
+    m_telemetry_stop=true;
+    pthread_join(m_telemetry_tid,NULL);
+    m_telemetry_running=false;
+    /* best effort for the last messages */
+    telemetry_flush();
+}
+
+void CGlobalPortCfg::run_in_telemetry(){
+    uint32_t interval = CGlobalInfo::m_options.m_pub_interval_msec;
+    /* latency, rx-check and templates are published at the legacy rate */
+    uint32_t slow_ticks = (interval<500)?(500/interval):1;
+    uint32_t tick=0;
+
+    while ( !m_telemetry_stop ) {
+        delay(interval);
+        tick++;
+        bool slow_path = (tick >= slow_ticks);
+        if (slow_path) {
+            tick=0;
+        }
+        telemetry_sample(slow_path);
+        telemetry_flush();
+    }
+}
+
+void CGlobalPortCfg::telemetry_sample(bool slow_path){
+    CGlobalStats  stats;
+    update_stats();
+    get_stats(stats);
+    m_last_stats.publish(stats);
+
+    if ( !m_zmq_publisher.is_enabled() ) {
+        return;
+    }
+
+    bool bin = CGlobalInfo::m_options.preview.get_zmq_bin_publish_enable();
+    uint64_t time_usec = (uint64_t)(now_sec()*1000000.0);
+
+    stats.dump_json(m_telemetry_queue.alloc());
+    m_telemetry_queue.commit();
+
+    if ( bin ) {
+        stats.dump_bin(m_telemetry_queue.alloc(),
+                       m_telemetry_bin_seq[CTelemetryBin::tbGLOBAL]++,
+                       time_usec);
+        m_telemetry_queue.commit();
+    }
+
+    /* generator json , lateness of all the cores */
+    m_fl.dump_lateness_json(m_telemetry_queue.alloc());
+    m_telemetry_queue.commit();
+
+    if ( !slow_path ) {
+        return;
+    }
+
+    dump_template_info(m_telemetry_queue.alloc());
+    m_telemetry_queue.commit();
+
+    if ( CDpCycleStats::is_enabled() ) {
+        m_fl.dump_cycles_json(m_telemetry_queue.alloc());
+        m_telemetry_queue.commit();
+    }
+
+    if ( !CGlobalInfo::m_options.is_latency_disabled() ){
+        pthread_mutex_lock(&m_latency_lock);
+        if ( get_is_rx_check_mode() ) {
+            m_mg.rx_check_dump_json(m_telemetry_queue.alloc());
+            m_telemetry_queue.commit();
+        }
+        /* backward compatible */
+        m_mg.dump_json(m_telemetry_queue.alloc());
+        m_telemetry_queue.commit();
+
+        /* more info */
+        m_mg.dump_json_v2(m_telemetry_queue.alloc());
+        m_telemetry_queue.commit();
+
+        if ( bin ) {
+            m_mg.dump_bin(m_telemetry_queue.alloc(),
+                          m_telemetry_bin_seq[CTelemetryBin::tbLATENCY]++,
+                          time_usec);
+            m_telemetry_queue.commit();
+        }
+        pthread_mutex_unlock(&m_latency_lock);
+    }
+}
+
+void CGlobalPortCfg::telemetry_flush(){
+    while ( !m_telemetry_queue.is_empty() ) {
+        if ( !m_zmq_publisher.try_publish_json(m_telemetry_queue.front()) ){
+            /* socket is busy, try again in the next interval */
+            break;
+        }
+        m_telemetry_queue.m_sent++;
+        m_telemetry_queue.pop();
+    }
 }
 
 
 int CGlobalPortCfg::run_in_master(){
 
-    std::string json;
     bool was_stopped=false;
+    start_telemetry();
     while ( true ) {
 
         if ( CGlobalInfo::m_options.preview.get_no_keyboard() ==false ){
@@ -3896,7 +4581,7 @@ int CGlobalPortCfg::run_in_master(){
             m_io_modes.DumpHelp(stdout);
         }
 
-        dump_stats(stdout,json,CGlobalStats::dmpTABLE);
+        dump_stats(stdout,CGlobalStats::dmpTABLE);
 
         if (m_io_modes.m_g_mode == CTrexGlobalIoMode::gNORMAL ) {
     		fprintf (stdout," current time    : %.1f sec  \n",now_sec());
@@ -3908,18 +4593,8 @@ int CGlobalPortCfg::run_in_master(){
     		fprintf (stdout," test duration   : %.1f sec  \n",d);
         }
 
-        m_zmq_publisher.publish_json(json);
-
-        /* generator json , all cores are the same just sample the first one */
-        m_fl.m_threads_info[0]->m_node_gen.dump_json(json);
-        m_zmq_publisher.publish_json(json);
-
-        dump_template_info(json);
-        m_zmq_publisher.publish_json(json);
-
-
-
         if ( !CGlobalInfo::m_options.is_latency_disabled() ){
+            pthread_mutex_lock(&m_latency_lock);
             m_mg.update();
 
             if ( m_io_modes.m_g_mode ==  CTrexGlobalIoMode::gNORMAL ){
@@ -3953,21 +4628,16 @@ int CGlobalPortCfg::run_in_master(){
                     break;
                 }
 
-                m_mg.rx_check_dump_json(json );
-                m_zmq_publisher.publish_json(json);
-
               }/* ex checked */
 
             }
+            pthread_mutex_unlock(&m_latency_lock);
+        }
 
-            /* backward compatible */
-            m_mg.dump_json(json );
-            m_zmq_publisher.publish_json(json);
-
-            /* more info */
-            m_mg.dump_json_v2(json );
-            m_zmq_publisher.publish_json(json);
-
+        if ( (m_io_modes.m_g_mode ==  CTrexGlobalIoMode::gNORMAL) &&
+             (m_io_modes.m_cy_mode == CTrexGlobalIoMode::cyENABLE) ){
+            fprintf(stdout,"\n-DP cycles per phase \n");
+            m_fl.DumpCycles(stdout);
         }
 
         delay(500);
@@ -3976,6 +4646,7 @@ int CGlobalPortCfg::run_in_master(){
             break;
         }
     }
+    stop_telemetry();
     m_mg.stop();
     delay(1000);
     if ( was_stopped ){
@@ -4026,11 +4697,10 @@ int CGlobalPortCfg::run_in_core(virtual_thread_id_t virt_core_id){
 int CGlobalPortCfg::stop_master(){
 
     delay(1000);
-    std::string json;
     fprintf(stdout," ==================\n");
     fprintf(stdout," interface sum \n");
     fprintf(stdout," ==================\n");
-    dump_stats(stdout,json,CGlobalStats::dmpSTANDARD);
+    dump_stats(stdout,CGlobalStats::dmpSTANDARD);
     fprintf(stdout," ==================\n");
     fprintf(stdout," \n\n");
 
@@ -4071,7 +4741,7 @@ int CGlobalPortCfg::stop_master(){
         m_mg.DumpRxCheckVerification(stdout,total_tx_rx_check);
     }
     
-    dump_stats(stdout,json,CGlobalStats::dmpSTANDARD);
+    dump_stats(stdout,CGlobalStats::dmpSTANDARD);
     dump_post_test_stats(stdout);
     m_fl.Delete();
 
@@ -4089,6 +4759,43 @@ bool CGlobalPortCfg::is_all_cores_finished(){
 
 
 
+/* the slave lcores wait for the DP launch while the templates are loaded, use them */
+class CLcoreJobRunner : public CParallelJobRunner {
+public:
+    virtual uint32_t get_workers(){
+        return (rte_lcore_count());
+    }
+
+    virtual void run(void (*func)(void *),void * arg){
+        m_func=func;
+        m_arg=arg;
+        std::vector<uint32_t> launched;
+        uint32_t lcore_id;
+        RTE_LCORE_FOREACH_SLAVE(lcore_id) {
+            if ( rte_eal_remote_launch(lcore_job,this,lcore_id) == 0 ) {
+                launched.push_back(lcore_id);
+            }
+        }
+        func(arg);
+        int i;
+        for (i=0; i<(int)launched.size(); i++) {
+            rte_eal_wait_lcore(launched[i]);
+        }
+    }
+
+private:
+    static int lcore_job(void * arg){
+        CLcoreJobRunner * lp=(CLcoreJobRunner *)arg;
+        lp->m_func(lp->m_arg);
+        return (0);
+    }
+
+private:
+    void (* m_func)(void *);
+    void *  m_arg;
+};
+
+
 int CGlobalPortCfg::start_send_master(){
     int i;
     for (i=0; i<BP_MAX_CORES; i++) {
@@ -4096,7 +4803,8 @@ int CGlobalPortCfg::start_send_master(){
     }
 
     m_fl.Create();
-    m_fl.load_from_yaml(CGlobalInfo::m_options.cfg_file,get_cores_tx());
+    CLcoreJobRunner runner;
+    m_fl.load_from_yaml(CGlobalInfo::m_options.cfg_file,get_cores_tx(),&runner);
     if (CGlobalInfo::m_options.mac_file != "") {
         CGlobalInfo::m_options.preview.set_mac_ip_mapping_enable(true);
         m_fl.load_from_mac_file(CGlobalInfo::m_options.mac_file);
@@ -119,6 +119,87 @@ uint32_t os_get_time_freq(){
 }
 
 
+#ifndef RTE_DPDK
+
+#ifdef OS_HR_CLOCK_TSC
+#include <cpuid.h>
+#endif
+
+os_hr_clock_t os_hr_clock;
+
+#define OS_HR_CALIB_ROUNDS  3
+#define OS_HR_CALIB_NSEC    20000000  /* each round */
+#define OS_HR_CALIB_READS   5         /* keep the narrowest TSC bracket */
+
+#ifdef OS_HR_CLOCK_TSC
+/* monotonic time and the TSC at the same moment */
+static void os_hr_clock_read_pair(uint64_t & nsec,uint64_t & tsc){
+    uint64_t best=~0ULL;
+    int i;
+    for (i=0; i<OS_HR_CALIB_READS; i++) {
+        uint64_t t0=platform_time_rdtsc_ordered();
+        uint64_t ns=platform_time_monotonic_nsec();
+        uint64_t t1=platform_time_rdtsc_ordered();
+        if ( (t1-t0) < best ) {
+            best = t1-t0;
+            nsec = ns;
+            tsc  = t0+(t1-t0)/2;
+        }
+    }
+}
+
+static uint64_t os_hr_clock_measure(void){
+    uint64_t ns0,tsc0,ns1,tsc1;
+    os_hr_clock_read_pair(ns0,tsc0);
+    struct timespec req;
+    req.tv_sec  = 0;
+    req.tv_nsec = OS_HR_CALIB_NSEC;
+    nanosleep(&req,0);
+    os_hr_clock_read_pair(ns1,tsc1);
+    return ( (uint64_t)((double)(tsc1-tsc0)*1e9/(double)(ns1-ns0)) );
+}
+#endif
+
+void os_hr_clock_calibrate(void){
+    os_hr_clock.m_use_tsc     = false;
+    os_hr_clock.m_has_rdtscp  = false;
+
+#ifdef OS_HR_CLOCK_TSC
+    unsigned int a,b,c,d;
+    bool invariant=false;
+    if ( __get_cpuid(0x80000001,&a,&b,&c,&d) ) {
+        os_hr_clock.m_has_rdtscp = ((d>>27) & 1)?true:false;
+    }
+    if ( __get_cpuid(0x80000007,&a,&b,&c,&d) ) {
+        invariant = ((d>>8) & 1)?true:false;
+    }
+    if ( invariant ) {
+        uint64_t f[OS_HR_CALIB_ROUNDS];
+        int i,j;
+        for (i=0; i<OS_HR_CALIB_ROUNDS; i++) {
+            f[i]=os_hr_clock_measure();
+        }
+        /* median, a round could be preempted */
+        for (i=0; i<OS_HR_CALIB_ROUNDS; i++) {
+            for (j=i+1; j<OS_HR_CALIB_ROUNDS; j++) {
+                if ( f[j] < f[i] ) {
+                    uint64_t t=f[i];
+                    f[i]=f[j];
+                    f[j]=t;
+                }
+            }
+        }
+        os_hr_clock.m_freq    = f[OS_HR_CALIB_ROUNDS/2];
+        os_hr_clock.m_use_tsc = true;
+        return;
+    }
+#endif
+    os_hr_clock.m_freq = 1000000000ULL;
+}
+
+#endif
+
+
 
 #endif 
 
@@ -53,46 +53,113 @@ static inline hr_time_t    os_get_hr_freq(void){
     return (rte_get_tsc_hz() );
 }
 
+/* the reads before it are done, use it to measure a section of code */
+static inline hr_time_t    os_get_hr_tick_64_ordered(void){
+    return (rte_rdtsc_precise());
+}
+
+static inline void os_hr_clock_init(void){
+}
+
+/* the ticks are TSC cycles */
+static inline bool os_hr_is_tsc(void){
+    return (true);
+}
 
 
 #else
 
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OS_HR_CLOCK_TSC
+#endif
 
-/* read the rdtsc register for ticks
-   works for 64 bit aswell
+/*
+  the simulator clock. the TSC is used only if it is invariant (constant rate in all
+  the C/P states), its frequency is calibrated against CLOCK_MONOTONIC_RAW on the first use.
+  without it the clock is CLOCK_MONOTONIC_RAW in nsec
 */
-static inline void  platform_time_get_highres_tick_64(uint64_t* t)
-{
+struct os_hr_clock_t {
+    hr_time_t   m_freq;        /* 0 before the calibration */
+    bool        m_use_tsc;
+    bool        m_has_rdtscp;
+};
+
+extern os_hr_clock_t os_hr_clock;
+
+void os_hr_clock_calibrate(void);
+
+static inline void os_hr_clock_init(void){
+    if ( os_hr_clock.m_freq == 0 ) {
+        os_hr_clock_calibrate();
+    }
+}
+
+static inline uint64_t platform_time_monotonic_nsec(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW,&ts);
+    return ((uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+#ifdef OS_HR_CLOCK_TSC
+/* not serialized, the read could move before earlier instructions */
+static inline uint64_t platform_time_rdtsc(void){
     uint32_t lo, hi;
-    __asm__ __volatile__ (      // serialize
-	  "xorl %%eax,%%eax \n        cpuid"
-	  ::: "%rax", "%rbx", "%rcx", "%rdx");
      /* We cannot use "=A", since this would use %rax on x86_64 and return
      only the lower 32bits of the TSC */
-     __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
-    *t = (uint64_t)hi << 32 | lo;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32 | lo);
 }
 
-static inline uint32_t  platform_time_get_highres_tick_32()
-{
-    uint64_t t;
-    platform_time_get_highres_tick_64(&t);
-    return ((uint32_t)t);
+/* wait for the earlier instructions, much cheaper than cpuid */
+static inline uint64_t platform_time_rdtsc_ordered(void){
+    uint32_t lo, hi;
+    if ( os_hr_clock.m_has_rdtscp ) {
+        __asm__ __volatile__ ("rdtscp" : "=a" (lo), "=d" (hi) :: "%rcx");
+    }else{
+        __asm__ __volatile__ ("lfence\n rdtsc" : "=a" (lo), "=d" (hi) :: "memory");
+    }
+    return ((uint64_t)hi << 32 | lo);
 }
-
+#endif
 
 static inline hr_time_t    os_get_hr_freq(void){
-	return (3000000000ULL);
+    if ( __builtin_expect(os_hr_clock.m_freq == 0,0) ) {
+        os_hr_clock_calibrate();
+    }
+    return (os_hr_clock.m_freq);
 }
 
 static inline hr_time_t os_get_hr_tick_64(void) {
- hr_time_t res;
- platform_time_get_highres_tick_64(&res);
- return (res);
+#ifdef OS_HR_CLOCK_TSC
+    if ( __builtin_expect(os_hr_clock.m_use_tsc,1) ) {
+        return (platform_time_rdtsc());
+    }
+    os_hr_clock_init();
+    if ( os_hr_clock.m_use_tsc ) {
+        return (platform_time_rdtsc());
+    }
+#endif
+    return (platform_time_monotonic_nsec());
+}
+
+static inline bool os_hr_is_tsc(void){
+    return (os_hr_clock.m_use_tsc);
+}
+
+/* the reads before it are done, use it to measure a section of code */
+static inline hr_time_t os_get_hr_tick_64_ordered(void) {
+#ifdef OS_HR_CLOCK_TSC
+    if ( __builtin_expect(os_hr_clock.m_use_tsc,1) ) {
+        return (platform_time_rdtsc_ordered());
+    }
+#endif
+    return (os_get_hr_tick_64());
 }
 
 static inline uint32_t os_get_hr_tick_32(void) {
-	return (platform_time_get_highres_tick_32());
+	return ((uint32_t)os_get_hr_tick_64());
 }
 
 #endif
@@ -102,6 +169,17 @@ static inline uint32_t os_get_hr_tick_32(void) {
 hr_time_t    os_get_hr_tick_64(void);
 hr_time_32_t os_get_hr_tick_32(void);
 hr_time_t    os_get_hr_freq(void);
+
+static inline hr_time_t os_get_hr_tick_64_ordered(void) {
+    return (os_get_hr_tick_64());
+}
+
+static inline void os_hr_clock_init(void){
+}
+
+static inline bool os_hr_is_tsc(void){
+    return (false);
+}
 #endif
 
 
@@ -119,6 +197,7 @@ static inline dsec_t  ptime_convert_hr_dsec(hr_time_t hrt){
 extern  hr_time_t start_time;
 
 static inline void time_init(){
+    os_hr_clock_init();
 	start_time=os_get_hr_tick_64();
 }
 
@@ -0,0 +1,380 @@
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "pcap_replay.h"
+#include "bp_sim.h"
+#include "utl_seqlock.h"
+#include <common/Network/Packet/IPHeader.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#define PCAP_REPLAY_HUGE_PAGE     (2*1024*1024)
+#define PCAP_REPLAY_UNDERRUN_WAIT (0.000010) /* retry of the DP core when the ring is empty */
+#define PCAP_REPLAY_MIN_PERIOD    (0.000001) /* loop period of a file with one packet */
+
+
+void CPcapReplayStats::Dump(FILE *fd){
+    #define DP_R(f) fprintf(fd," %-40s : %llu \n",#f,(unsigned long long)f)
+    DP_R(m_file_pkts);
+    DP_R(m_loaded);
+    DP_R(m_sent);
+    DP_R(m_sent_bytes);
+    DP_R(m_skip_big);
+    DP_R(m_ring_full);
+    DP_R(m_underrun);
+    DP_R(m_alloc_error);
+}
+
+
+CPcapReplay::CPcapReplay(){
+    m_thread_id=0;
+    m_max_threads=1;
+    m_socket_id=0;
+    m_is_realtime=false;
+    m_is_huge=false;
+    m_thread_started=false;
+    m_rate=1.0;
+    m_start_time=0.0;
+    m_loops=1;
+    m_ip_offset=0;
+    m_ring=0;
+    m_ring_bytes=0;
+    m_head=0;
+    m_tail=0;
+    m_loader_done=false;
+    m_stop=false;
+    m_loader_run_cpu=-1;
+}
+
+
+bool CPcapReplay::Create(std::string file_name,
+                         uint8_t     thread_id,
+                         uint8_t     max_threads,
+                         uint8_t     socket_id,
+                         double      rate,
+                         uint32_t    loops,
+                         uint32_t    ip_offset,
+                         bool        is_realtime){
+    if ( rate <= 0.0 ) {
+        fprintf(stderr," ERROR replay rate should be positive \n");
+        return (false);
+    }
+    m_file_name   = file_name;
+    m_thread_id   = thread_id;
+    m_max_threads = (max_threads>0)?max_threads:1;
+    m_socket_id   = socket_id;
+    m_rate        = rate;
+    m_loops       = (loops>0)?loops:1;
+    m_ip_offset   = ip_offset;
+    m_is_realtime = is_realtime;
+    m_head=0;
+    m_tail=0;
+    m_loader_done=false;
+    m_stop=false;
+    m_loader_run_cpu=-1;
+    m_stats.Clear();
+
+    /* huge pages, transparent huge pages in case there are no free ones */
+    uint64_t size = sizeof(pcap_replay_slot_t)*RING_SIZE;
+    m_ring_bytes = ((size + PCAP_REPLAY_HUGE_PAGE-1)/PCAP_REPLAY_HUGE_PAGE)*PCAP_REPLAY_HUGE_PAGE;
+    void * p=MAP_FAILED;
+    #ifdef MAP_HUGETLB
+    p=mmap(NULL,m_ring_bytes,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+    #endif
+    m_is_huge = (p != MAP_FAILED);
+    if ( !m_is_huge ) {
+        p=mmap(NULL,m_ring_bytes,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+        if (p == MAP_FAILED) {
+            fprintf(stderr," ERROR can't allocate replay ring \n");
+            m_ring_bytes=0;
+            return (false);
+        }
+        #ifdef MADV_HUGEPAGE
+        madvise(p,m_ring_bytes,MADV_HUGEPAGE);
+        #endif
+    }
+    m_ring=(pcap_replay_slot_t *)p;
+    return (true);
+}
+
+
+bool CPcapReplay::start(double start_time,int loader_cpu){
+    assert(m_ring);
+    m_start_time=start_time;
+    /* called by the DP core, the loader must not inherit its cpu */
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if ( loader_cpu >= 0 ) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(loader_cpu,&cpus);
+        if ( pthread_attr_setaffinity_np(&attr,sizeof(cpus),&cpus) != 0 ) {
+            fprintf(stderr," WARNING can't set replay loader affinity to cpu %d \n",loader_cpu);
+        }
+    }
+    int res=pthread_create(&m_thread,&attr,loader_thread,this);
+    pthread_attr_destroy(&attr);
+    if ( res != 0 ) {
+        fprintf(stderr," ERROR can't start replay loader thread \n");
+        m_loader_done=true;
+        return (false);
+    }
+    m_thread_started=true;
+    return (true);
+}
+
+
+void * CPcapReplay::loader_thread(void * obj){
+    ((CPcapReplay *)obj)->loader();
+    return (NULL);
+}
+
+
+/* symmetric hash of the flow, both directions of a flow go to the same core.
+   only the addresses and the protocol, the fragments of a packet have no ports
+   and must go to the core of their flow */
+bool CPcapReplay::is_my_pkt(uint8_t * p,uint16_t len){
+    if ( m_max_threads == 1 ) {
+        return (true);
+    }
+    uint32_t h=0;
+    uint16_t l3=14;
+    if ( len < l3 ) {
+        return (m_thread_id==0);
+    }
+    uint16_t ether=(p[12]<<8)|p[13];
+    if ( (ether == EthernetHeader::Protocol::VLAN) && (len >= 18) ) {
+        ether=(p[16]<<8)|p[17];
+        l3+=4;
+    }
+    if ( (ether == EthernetHeader::Protocol::IP) && (len >= l3+20) ) {
+        uint8_t * ip=p+l3;
+        uint32_t src,dst;
+        memcpy(&src,ip+12,4);
+        memcpy(&dst,ip+16,4);
+        h = src ^ dst;
+        h ^= ip[9];
+    }else{
+        if ( (ether == EthernetHeader::Protocol::IPv6) && (len >= l3+40) ) {
+            /* the next header of a fragment is the fragment header, addresses only */
+            uint8_t * ip=p+l3;
+            int i;
+            for (i=0; i<8; i++) {
+                uint32_t w;
+                memcpy(&w,ip+8+i*4,4);
+                h ^= w;
+            }
+        }else{
+            return (m_thread_id==0);
+        }
+    }
+    /* mix the bits */
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    return ( (h % m_max_threads) == m_thread_id );
+}
+
+
+void CPcapReplay::rewrite_ip(uint8_t * p,uint16_t len,uint32_t offset){
+    uint16_t l3=14;
+    if ( len < l3+20 ) {
+        return;
+    }
+    uint16_t ether=(p[12]<<8)|p[13];
+    if ( ether == EthernetHeader::Protocol::VLAN ) {
+        ether=(p[16]<<8)|p[17];
+        l3+=4;
+    }
+    if ( (ether != EthernetHeader::Protocol::IP) || (len < l3+20) ) {
+        return;
+    }
+    IPHeader * ipv4=(IPHeader *)(p+l3);
+    ipv4->setSourceIp(ipv4->getSourceIp()+offset);
+    ipv4->setDestIp(ipv4->getDestIp()+offset);
+    ipv4->updateCheckSum();
+}
+
+
+/* wait for a free slot, NULL in case of stop */
+pcap_replay_slot_t * CPcapReplay::get_free_slot(){
+    bool full=false;
+    while ( (uint32_t)(m_head - m_tail) >= RING_SIZE ) {
+        if ( m_stop ) {
+            return (NULL);
+        }
+        if (!full) {
+            m_stats.m_ring_full++;
+            full=true;
+        }
+        sched_yield();
+    }
+    utl_seq_rmb();
+    return (&m_ring[m_head & (RING_SIZE-1)]);
+}
+
+
+void CPcapReplay::loader(){
+    m_loader_run_cpu=sched_getcpu();
+    CCapPktRaw raw;
+    double   first_time=0.0;
+    double   last_time=0.0;
+    double   period=0.0;
+    uint64_t file_pkts=0;
+    bool     first=true;
+    uint32_t loop;
+
+    for (loop=0; loop<m_loops; loop++) {
+        /* a new reader each loop, not all the readers support rewind */
+        CCapReaderBase * reader=CCapReaderFactory::CreateReader((char *)m_file_name.c_str(),0);
+        if ( reader == NULL ) {
+            fprintf(stderr," ERROR can't open replay file %s \n",m_file_name.c_str());
+            break;
+        }
+        double loop_offset = period*loop;
+        while ( !m_stop && reader->ReadPacket(&raw) ) {
+            double t=raw.get_time();
+            if ( first ) {
+                first_time=t;
+                first=false;
+            }
+            if ( loop == 0 ) {
+                last_time=t;
+                file_pkts++;
+            }
+            if ( raw.pkt_len > sizeof(((pcap_replay_slot_t *)0)->m_data) ) {
+                m_stats.m_skip_big++;
+                continue;
+            }
+            if ( !is_my_pkt((uint8_t *)raw.raw,raw.pkt_len) ) {
+                continue;
+            }
+            pcap_replay_slot_t * slot=get_free_slot();
+            if ( slot == NULL ) {
+                break;
+            }
+            double rel=t-first_time;
+            if ( rel < 0.0 ) {
+                rel=0.0;
+            }
+            slot->m_time = (rel+loop_offset)/m_rate;
+            slot->m_len  = raw.pkt_len;
+            slot->m_dir  = raw.getInterface() & 1;
+            memcpy(slot->m_data,raw.raw,raw.pkt_len);
+            if ( m_ip_offset && loop ) {
+                rewrite_ip((uint8_t *)slot->m_data,slot->m_len,m_ip_offset*loop);
+            }
+            m_stats.m_loaded++;
+            /* the slot is written before the DP core can see it */
+            utl_seq_wmb();
+            m_head = m_head + 1;
+        }
+        delete reader;
+        if ( m_stop ) {
+            break;
+        }
+        if ( loop == 0 ) {
+            double len=last_time-first_time;
+            if ( file_pkts > 1 ) {
+                period = len + len/(double)(file_pkts-1);
+            }
+            if ( period < PCAP_REPLAY_MIN_PERIOD ) {
+                period = PCAP_REPLAY_MIN_PERIOD;
+            }
+        }
+    }
+    m_stats.m_file_pkts=file_pkts;
+    utl_seq_wmb();
+    m_loader_done=true;
+}
+
+
+bool CPcapReplay::send(CVirtualIF * v_if,double & time){
+    uint16_t cnt=0;
+    while ( true ) {
+        if ( m_tail == m_head ) {
+            if ( m_loader_done ) {
+                utl_seq_rmb();
+                if ( m_tail == m_head ) {
+                    return (false);
+                }
+                continue;
+            }
+            if ( m_is_realtime ) {
+                m_stats.m_underrun++;
+                time += PCAP_REPLAY_UNDERRUN_WAIT;
+                return (true);
+            }
+            /* simulation, wait for the loader so the output does not depend on its speed */
+            sched_yield();
+            continue;
+        }
+        utl_seq_rmb();
+        pcap_replay_slot_t * slot=&m_ring[m_tail & (RING_SIZE-1)];
+        double t=m_start_time+slot->m_time;
+        if ( t > time ) {
+            time = t;
+            return (true);
+        }
+        if ( cnt == BURST ) {
+            /* the rest in the next call, let the other nodes run */
+            return (true);
+        }
+        rte_mbuf_t * m=CGlobalInfo::pktmbuf_alloc(m_socket_id,slot->m_len);
+        if ( unlikely(m == 0) ) {
+            m_stats.m_alloc_error++;
+        }else{
+            char *p=rte_pktmbuf_append(m,slot->m_len);
+            memcpy(p,slot->m_data,slot->m_len);
+            m_stats.m_sent++;
+            m_stats.m_sent_bytes+=slot->m_len;
+            v_if->send_mbuf((pkt_dir_t)slot->m_dir,m,t);
+        }
+        /* the slot is read before the loader can write it */
+        utl_seq_wmb();
+        m_tail = m_tail + 1;
+        cnt++;
+    }
+}
+
+
+void CPcapReplay::Delete(){
+    if ( m_thread_started ) {
+        m_stop=true;
+        pthread_join(m_thread,NULL);
+        m_thread_started=false;
+    }
+    if ( m_ring ) {
+        munmap(m_ring,m_ring_bytes);
+    }
+    m_ring=0;
+    m_ring_bytes=0;
+    m_is_huge=false;
+}
+
+
+void CPcapReplay::Dump(FILE *fd){
+    fprintf(fd," replay %s, thread %d/%d, rate %.2f, loops %u, %s ring \n",
+            m_file_name.c_str(),m_thread_id,m_max_threads,m_rate,m_loops,
+            m_is_huge?"huge page":"normal");
+    fprintf(fd," loader cpu %d \n",m_loader_run_cpu);
+    m_stats.Dump(fd);
+}
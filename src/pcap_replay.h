@@ -0,0 +1,161 @@
+#ifndef PCAP_REPLAY_H
+#define PCAP_REPLAY_H
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <pthread.h>
+#include <common/captureFile.h>
+
+class CVirtualIF;
+
+/*
+  replay of a capture file, one object per DP core.
+
+  a loader thread of the core reads the file (mmap reader for pcap) and
+  keeps only the flows of the core (symmetric hash of the IPs and protocol % cores,
+  non IP packets go to core 0), so the packets of a flow keep their order.
+  each packet is written to a slot of a single producer/single consumer ring
+  in huge page memory with its time after the rate and the loop, already
+  rewritten. the DP core takes the slots that are due, copies each one to an
+  mbuf and sends it.
+
+  time of a packet = (pkt_time - first_pkt_time + loop * period) / rate
+  period is the length of the file plus the average gap between packets
+*/
+
+/* one packet of the ring */
+struct pcap_replay_slot_t {
+    double   m_time;       /* from the start of the replay */
+    uint16_t m_len;
+    uint8_t  m_dir;
+    uint8_t  m_pad[53];    /* data is cache line aligned */
+    char     m_data[MAX_PKT_SIZE]; /* jumbo frames, a multiple of the cache line */
+};
+
+
+class CPcapReplayStats {
+public:
+    CPcapReplayStats(){
+        Clear();
+    }
+    void Clear(){
+        m_file_pkts=0;
+        m_loaded=0;
+        m_sent=0;
+        m_sent_bytes=0;
+        m_skip_big=0;
+        m_ring_full=0;
+        m_underrun=0;
+        m_alloc_error=0;
+    }
+    void Dump(FILE *fd);
+
+public:
+    uint64_t m_file_pkts;    /* packets in one pass of the file, all the cores */
+    uint64_t m_loaded;       /* packets of this core written to the ring */
+    uint64_t m_sent;
+    uint64_t m_sent_bytes;
+    uint64_t m_skip_big;     /* bigger than a slot */
+    uint64_t m_ring_full;    /* the loader waited for the DP core */
+    uint64_t m_underrun;     /* the DP core waited for the loader, realtime */
+    uint64_t m_alloc_error;
+};
+
+
+class CPcapReplay {
+public:
+    enum {
+        RING_SIZE = 4096,  /* power of 2 */
+        BURST     = 32     /* max packets in one call of send */
+    };
+
+    CPcapReplay();
+
+    bool Create(std::string file_name,
+                uint8_t     thread_id,
+                uint8_t     max_threads,
+                uint8_t     socket_id,
+                double      rate,
+                uint32_t    loops,
+                uint32_t    ip_offset,
+                bool        is_realtime);
+
+    /* start the loader thread, start_time is the time of the first packet.
+       loader_cpu, the only cpu of the loader (not a DP core), -1 for the cpus of the caller */
+    bool start(double start_time,int loader_cpu=-1);
+
+    /* cpu the loader started on, -1 before it started */
+    int get_loader_run_cpu(){
+        return (m_loader_run_cpu);
+    }
+
+    /**
+     * send the packets that are due at time (the time of the scheduler node)
+     *
+     * @param v_if
+     * @param time    updated to the time of the next packet
+     *
+     * @return false in case the replay is done
+     */
+    bool send(CVirtualIF * v_if,double & time);
+
+    /* stop the loader, free the ring */
+    void Delete();
+
+    void Dump(FILE *fd);
+
+public:
+    CPcapReplayStats m_stats;
+
+private:
+    static void * loader_thread(void * obj);
+    void loader();
+    pcap_replay_slot_t * get_free_slot();
+    bool is_my_pkt(uint8_t * p,uint16_t len);
+    void rewrite_ip(uint8_t * p,uint16_t len,uint32_t offset);
+
+private:
+    std::string          m_file_name;
+    uint8_t              m_thread_id;
+    uint8_t              m_max_threads;
+    uint8_t              m_socket_id;
+    bool                 m_is_realtime;
+    bool                 m_is_huge;
+    bool                 m_thread_started;
+    double               m_rate;
+    double               m_start_time;
+    uint32_t             m_loops;
+    uint32_t             m_ip_offset;    /* added to the IPv4 addresses each loop, 0 for none */
+
+    pcap_replay_slot_t * m_ring;
+    uint64_t             m_ring_bytes;
+    volatile uint32_t    m_head;         /* written by the loader */
+    volatile uint32_t    m_tail;         /* written by the DP core */
+    volatile bool        m_loader_done;
+    volatile bool        m_stop;
+    volatile int         m_loader_run_cpu;
+    pthread_t            m_thread;
+};
+
+#endif
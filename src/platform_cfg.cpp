@@ -40,6 +40,9 @@ void CPlatformMemoryYamlInfo::reset(){
 
        m_mbuf[MBUF_DP_FLOWS]     = (1024*1024/2);
        m_mbuf[MBUF_GLOBAL_FLOWS] =(10*1024/2);
+
+       m_mbuf[MBUF_9k]           = 256;
+       m_mbuf[TRAFFIC_MBUF_9k]   = 256;
 }
 const std::string names []={
                    "MBUF_64",
@@ -57,7 +60,10 @@ const std::string names []={
                    "TRAFFIC_MBUF_2048",      
 
                    "MBUF_DP_FLOWS",  
-                   "MBUF_GLOBAL_FLOWS"
+                   "MBUF_GLOBAL_FLOWS",
+
+                   "MBUF_9k",
+                   "TRAFFIC_MBUF_9k"
 
     };
 
@@ -258,6 +264,16 @@ void operator >> (const YAML::Node& node, CPlatformMemoryYamlInfo & plat_info) {
        node["global_flows"] >> plat_info.m_mbuf[MBUF_GLOBAL_FLOWS];      
     } catch ( const std::exception& e ) {
     }
+
+    try {
+     node["mbuf_9k"] >> plat_info.m_mbuf[MBUF_9k];
+    } catch ( const std::exception& e ) {
+    }
+
+    try {
+     node["traffic_mbuf_9k"] >> plat_info.m_mbuf[TRAFFIC_MBUF_9k];
+    } catch ( const std::exception& e ) {
+    }
 }
 
 
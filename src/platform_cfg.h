@@ -49,7 +49,11 @@ typedef enum {         MBUF_64         =0, // per dual port, per NUMA
 
                        MBUF_DP_FLOWS   =12,
                        MBUF_GLOBAL_FLOWS =13, 
-                       MBUF_SIZE         =14
+
+                        // jumbo packets, above 2048 bytes
+                       MBUF_9k           =14,
+                       TRAFFIC_MBUF_9k   =15,
+                       MBUF_SIZE         =16
               } mbuf_sizes_t;
 
 const std::string * get_mbuf_names(void);
@@ -85,6 +89,9 @@ const std::string * get_mbuf_names(void);
 
      dp_flows    : 1048576 
      global_flows : 10240 
+
+     mbuf_9k           : 256   # jumbo packets, above 2048 bytes
+     traffic_mbuf_9k   : 256
             
 */
 
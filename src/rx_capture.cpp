@@ -0,0 +1,583 @@
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "rx_capture.h"
+#include "os_time.h"
+#include "utl_seqlock.h"
+#include <common/Network/Packet/EthernetHeader.h>
+#include <common/Network/Packet/IPHeader.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#define RX_CAPTURE_HUGE_PAGE   (2*1024*1024)
+#define RX_CAPTURE_NSEC_MAGIC  0xa1b23c4d
+#define RX_CAPTURE_IDLE_USEC   1000 /* writer sleep when all the rings are empty */
+
+
+/* fields of the packet the filter looks at */
+struct rx_capture_pkt_t {
+    uint16_t m_ether;      /* after the vlan tag */
+    bool     m_vlan;
+    bool     m_ipv4;
+    bool     m_ipv6;
+    uint8_t  m_proto;
+    bool     m_ports;      /* not a fragment, tcp/udp */
+    uint32_t m_src;        /* IPv4, host order */
+    uint32_t m_dst;
+    uint16_t m_sport;
+    uint16_t m_dport;
+};
+
+static void rx_capture_parse(const uint8_t * p,uint16_t len,rx_capture_pkt_t & pkt){
+    memset(&pkt,0,sizeof(pkt));
+    uint16_t l3=14;
+    if ( len < l3 ) {
+        return;
+    }
+    pkt.m_ether=(p[12]<<8)|p[13];
+    if ( (pkt.m_ether == EthernetHeader::Protocol::VLAN) && (len >= 18) ) {
+        pkt.m_vlan=true;
+        pkt.m_ether=(p[16]<<8)|p[17];
+        l3+=4;
+    }
+    uint16_t l4=0;
+    if ( (pkt.m_ether == EthernetHeader::Protocol::IP) && (len >= l3+20) ) {
+        const uint8_t * ip=p+l3;
+        pkt.m_ipv4=true;
+        pkt.m_proto=ip[9];
+        pkt.m_src=(ip[12]<<24)|(ip[13]<<16)|(ip[14]<<8)|ip[15];
+        pkt.m_dst=(ip[16]<<24)|(ip[17]<<16)|(ip[18]<<8)|ip[19];
+        l4=l3+(ip[0]&0xf)*4;
+        if ( ((((ip[6]&0x1f)<<8)|ip[7]) != 0) ) {
+            return;
+        }
+    }else{
+        if ( (pkt.m_ether == EthernetHeader::Protocol::IPv6) && (len >= l3+40) ) {
+            pkt.m_ipv6=true;
+            pkt.m_proto=p[l3+6];
+            l4=l3+40;
+        }else{
+            return;
+        }
+    }
+    if ( ((pkt.m_proto == IPHeader::Protocol::TCP) || (pkt.m_proto == IPHeader::Protocol::UDP)) &&
+         (len >= l4+4) ) {
+        pkt.m_ports=true;
+        pkt.m_sport=(p[l4]<<8)|p[l4+1];
+        pkt.m_dport=(p[l4+2]<<8)|p[l4+3];
+    }
+}
+
+static bool rx_capture_match_val(uint8_t dir,uint32_t src,uint32_t dst,uint32_t val,uint32_t mask){
+    bool s=((src & mask) == val);
+    bool d=((dst & mask) == val);
+    switch (dir) {
+    case CRxCaptureFilter::DIR_SRC:
+        return (s);
+    case CRxCaptureFilter::DIR_DST:
+        return (d);
+    default:
+        return (s||d);
+    }
+}
+
+
+bool CRxCaptureFilter::Create(std::string filter){
+    m_or.clear();
+    std::vector<std::string> tokens;
+    char * buf=strdup(filter.c_str());
+    char * save=NULL;
+    char * tok=strtok_r(buf," \t",&save);
+    while (tok) {
+        tokens.push_back(tok);
+        tok=strtok_r(NULL," \t",&save);
+    }
+    free(buf);
+
+    std::vector<term_t> and_list;
+    int i=0;
+    int n=(int)tokens.size();
+    while ( i<n ) {
+        term_t t;
+        t.m_dir=DIR_ANY;
+        t.m_not=false;
+        t.m_val=0;
+        t.m_mask=0xffffffff;
+        if ( (tokens[i] == "not") || (tokens[i] == "!") ) {
+            t.m_not=true;
+            i++;
+        }
+        if ( (i<n) && ((tokens[i] == "src") || (tokens[i] == "dst")) ) {
+            t.m_dir=(tokens[i] == "src")?DIR_SRC:DIR_DST;
+            i++;
+        }
+        if ( i>=n ) {
+            fprintf(stderr," ERROR rx capture filter, missing primitive \n");
+            return (false);
+        }
+        std::string w=tokens[i++];
+        bool has_arg=false;
+        if ( w=="ip" ) {
+            t.m_type=F_IP;
+        }else if ( w=="ip6" ) {
+            t.m_type=F_IP6;
+        }else if ( w=="arp" ) {
+            t.m_type=F_ARP;
+        }else if ( w=="tcp" ) {
+            t.m_type=F_TCP;
+        }else if ( w=="udp" ) {
+            t.m_type=F_UDP;
+        }else if ( w=="icmp" ) {
+            t.m_type=F_ICMP;
+        }else if ( w=="vlan" ) {
+            t.m_type=F_VLAN;
+        }else if ( (w=="host") || (w=="net") || (w=="port") || (w=="greater") || (w=="less") ) {
+            has_arg=true;
+        }else{
+            fprintf(stderr," ERROR rx capture filter, unknown primitive %s \n",w.c_str());
+            return (false);
+        }
+        if ( (t.m_dir != DIR_ANY) && !((w=="host") || (w=="net") || (w=="port")) ) {
+            fprintf(stderr," ERROR rx capture filter, src/dst is not valid before %s \n",w.c_str());
+            return (false);
+        }
+        if ( has_arg ) {
+            if ( i>=n ) {
+                fprintf(stderr," ERROR rx capture filter, %s without a value \n",w.c_str());
+                return (false);
+            }
+            std::string a=tokens[i++];
+            if ( (w=="host") || (w=="net") ) {
+                uint32_t len=32;
+                std::string addr=a;
+                if ( w=="net" ) {
+                    size_t pos=a.find('/');
+                    if ( pos==std::string::npos ) {
+                        fprintf(stderr," ERROR rx capture filter, net %s without /len \n",a.c_str());
+                        return (false);
+                    }
+                    addr=a.substr(0,pos);
+                    len=atoi(a.substr(pos+1).c_str());
+                    if ( len>32 ) {
+                        fprintf(stderr," ERROR rx capture filter, net %s is not valid \n",a.c_str());
+                        return (false);
+                    }
+                }
+                struct in_addr in;
+                if ( inet_pton(AF_INET,addr.c_str(),&in) != 1 ) {
+                    fprintf(stderr," ERROR rx capture filter, %s is not an IPv4 address \n",addr.c_str());
+                    return (false);
+                }
+                t.m_type=(w=="host")?F_HOST:F_NET;
+                t.m_mask=(len==0)?0:(0xffffffff<<(32-len));
+                t.m_val=ntohl(in.s_addr) & t.m_mask;
+            }else{
+                char * end;
+                unsigned long v=strtoul(a.c_str(),&end,0);
+                if ( (*end != 0) || ((w=="port") && (v>0xffff)) ) {
+                    fprintf(stderr," ERROR rx capture filter, %s %s is not valid \n",w.c_str(),a.c_str());
+                    return (false);
+                }
+                t.m_type=(w=="port")?F_PORT:((w=="greater")?F_GREATER:F_LESS);
+                t.m_val=(uint32_t)v;
+            }
+        }
+        and_list.push_back(t);
+
+        if ( i<n ) {
+            std::string op=tokens[i++];
+            if ( (op=="or") || (op=="||") ) {
+                m_or.push_back(and_list);
+                and_list.clear();
+            }else if ( !((op=="and") || (op=="&&")) ) {
+                fprintf(stderr," ERROR rx capture filter, expected and/or, not %s \n",op.c_str());
+                return (false);
+            }
+            if ( i>=n ) {
+                fprintf(stderr," ERROR rx capture filter, missing primitive after %s \n",op.c_str());
+                return (false);
+            }
+        }
+    }
+    if ( and_list.size() ) {
+        m_or.push_back(and_list);
+    }
+    return (true);
+}
+
+
+static bool rx_capture_match_term(const CRxCaptureFilter::term_t & t,const rx_capture_pkt_t & pkt,uint16_t len){
+    bool res=false;
+    switch (t.m_type) {
+    case CRxCaptureFilter::F_IP:
+        res=pkt.m_ipv4;
+        break;
+    case CRxCaptureFilter::F_IP6:
+        res=pkt.m_ipv6;
+        break;
+    case CRxCaptureFilter::F_ARP:
+        res=(pkt.m_ether == EthernetHeader::Protocol::ARP);
+        break;
+    case CRxCaptureFilter::F_TCP:
+        res=(pkt.m_ipv4 || pkt.m_ipv6) && (pkt.m_proto == IPHeader::Protocol::TCP);
+        break;
+    case CRxCaptureFilter::F_UDP:
+        res=(pkt.m_ipv4 || pkt.m_ipv6) && (pkt.m_proto == IPHeader::Protocol::UDP);
+        break;
+    case CRxCaptureFilter::F_ICMP:
+        res=(pkt.m_ipv4 && (pkt.m_proto == IPHeader::Protocol::ICMP)) ||
+            (pkt.m_ipv6 && (pkt.m_proto == IPHeader::Protocol::IPV6_ICMP));
+        break;
+    case CRxCaptureFilter::F_VLAN:
+        res=pkt.m_vlan;
+        break;
+    case CRxCaptureFilter::F_HOST:
+    case CRxCaptureFilter::F_NET:
+        res=pkt.m_ipv4 && rx_capture_match_val(t.m_dir,pkt.m_src,pkt.m_dst,t.m_val,t.m_mask);
+        break;
+    case CRxCaptureFilter::F_PORT:
+        res=pkt.m_ports && rx_capture_match_val(t.m_dir,pkt.m_sport,pkt.m_dport,t.m_val,0xffff);
+        break;
+    case CRxCaptureFilter::F_GREATER:
+        res=(len >= t.m_val);
+        break;
+    case CRxCaptureFilter::F_LESS:
+        res=(len <= t.m_val);
+        break;
+    }
+    return (t.m_not?!res:res);
+}
+
+
+bool CRxCaptureFilter::match(const uint8_t * p,uint16_t len,uint16_t pkt_len){
+    if ( m_or.size() == 0 ) {
+        return (true);
+    }
+    rx_capture_pkt_t pkt;
+    rx_capture_parse(p,len,pkt);
+    int i;
+    for (i=0; i<(int)m_or.size(); i++) {
+        std::vector<term_t> & and_list=m_or[i];
+        bool res=true;
+        int j;
+        for (j=0; j<(int)and_list.size(); j++) {
+            if ( !rx_capture_match_term(and_list[j],pkt,pkt_len) ) {
+                res=false;
+                break;
+            }
+        }
+        if ( res ) {
+            return (true);
+        }
+    }
+    return (false);
+}
+
+
+void CRxCaptureStats::Dump(FILE *fd){
+    #define DP_C(f) fprintf(fd," %-40s : %llu \n",#f,(unsigned long long)f)
+    DP_C(m_rx);
+    DP_C(m_filtered);
+    DP_C(m_captured);
+    DP_C(m_drop);
+    DP_C(m_written);
+    DP_C(m_files);
+    DP_C(m_write_error);
+}
+
+
+CRxCapture::CRxCapture(){
+    m_has_filter=false;
+    m_num_ports=0;
+    m_snaplen=0;
+    m_rotate_bytes=0;
+    m_wall_offset=0.0;
+    m_mem=0;
+    m_mem_size=0;
+    m_is_huge=false;
+    memset(m_rings,0,sizeof(m_rings));
+    m_out=0;
+    m_file_bytes=0;
+    m_file_index=0;
+    m_written=0;
+    m_files=0;
+    m_write_error=0;
+    m_thread_started=false;
+    m_stop=false;
+}
+
+
+bool CRxCapture::Create(std::string file_name,
+                        std::string filter,
+                        uint8_t     num_ports,
+                        uint16_t    snaplen,
+                        uint64_t    rotate_bytes){
+    if ( !m_filter.Create(filter) ) {
+        return (false);
+    }
+    m_has_filter   = !m_filter.is_empty();
+    m_file_name    = file_name;
+    m_num_ports    = (num_ports>MAX_PORTS)?MAX_PORTS:num_ports;
+    m_snaplen      = ((snaplen==0) || (snaplen>sizeof(((rx_capture_slot_t *)0)->m_data)))?
+                      sizeof(((rx_capture_slot_t *)0)->m_data):snaplen;
+    m_rotate_bytes = rotate_bytes;
+    m_stop         = false;
+
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    m_wall_offset = (double)tv.tv_sec+(double)tv.tv_usec/1000000.0 - now_sec();
+
+    /* huge pages, transparent huge pages in case there are no free ones */
+    uint64_t size = sizeof(rx_capture_slot_t)*CRxCaptureRing::RING_SIZE*m_num_ports;
+    m_mem_size = ((size + RX_CAPTURE_HUGE_PAGE-1)/RX_CAPTURE_HUGE_PAGE)*RX_CAPTURE_HUGE_PAGE;
+    void * p=MAP_FAILED;
+    #ifdef MAP_HUGETLB
+    p=mmap(NULL,m_mem_size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+    #endif
+    m_is_huge = (p != MAP_FAILED);
+    if ( !m_is_huge ) {
+        p=mmap(NULL,m_mem_size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+        if (p == MAP_FAILED) {
+            fprintf(stderr," ERROR can't allocate rx capture rings \n");
+            m_mem_size=0;
+            return (false);
+        }
+        #ifdef MADV_HUGEPAGE
+        madvise(p,m_mem_size,MADV_HUGEPAGE);
+        #endif
+    }
+    m_mem=(char *)p;
+    int i;
+    for (i=0; i<m_num_ports; i++) {
+        CRxCaptureRing * r=&m_rings[i];
+        memset(r,0,sizeof(CRxCaptureRing));
+        r->m_slots=(rx_capture_slot_t *)m_mem+i*CRxCaptureRing::RING_SIZE;
+    }
+
+    m_file_index=0;
+    if ( !open_file() ) {
+        Delete();
+        return (false);
+    }
+    if ( pthread_create(&m_thread,NULL,writer_thread,this) != 0 ) {
+        fprintf(stderr," ERROR can't start rx capture writer thread \n");
+        Delete();
+        return (false);
+    }
+    m_thread_started=true;
+    printf(" -- rx capture to %s, snaplen %d, %s rings \n",m_file_name.c_str(),m_snaplen,
+           m_is_huge?"huge page":"normal");
+    return (true);
+}
+
+
+void CRxCapture::capture_pkt(CRxCaptureRing * r,uint8_t port,rte_mbuf_t * m){
+    r->m_rx++;
+    const uint8_t * p=rte_pktmbuf_mtod(m, uint8_t*);
+    uint16_t len=rte_pktmbuf_pkt_len(m);
+    if ( m_has_filter && !m_filter.match(p,m->data_len,len) ) {
+        r->m_filtered++;
+        return;
+    }
+    if ( (uint32_t)(r->m_head - r->m_tail) >= CRxCaptureRing::RING_SIZE ) {
+        r->m_drop++;
+        return;
+    }
+    utl_seq_rmb();
+    rx_capture_slot_t * slot=&r->m_slots[r->m_head & (CRxCaptureRing::RING_SIZE-1)];
+    slot->m_time   = now_sec();
+    slot->m_len    = len;
+    slot->m_port   = port;
+    uint16_t caplen= (len>m_snaplen)?m_snaplen:len;
+    slot->m_caplen = caplen;
+    /* copy the segments */
+    char * d=slot->m_data;
+    while ( (m != NULL) && (caplen>0) ) {
+        uint16_t l=(m->data_len>caplen)?caplen:m->data_len;
+        memcpy(d,rte_pktmbuf_mtod(m, char*),l);
+        d+=l;
+        caplen-=l;
+        m=m->next;
+    }
+    slot->m_caplen-=caplen;
+    r->m_captured++;
+    /* the slot is written before the writer can see it */
+    utl_seq_wmb();
+    r->m_head = r->m_head + 1;
+}
+
+
+void * CRxCapture::writer_thread(void * obj){
+    ((CRxCapture *)obj)->writer();
+    return (NULL);
+}
+
+
+bool CRxCapture::open_file(){
+    std::string name=m_file_name;
+    if ( m_file_index ) {
+        char buf[20];
+        sprintf(buf,".%u",m_file_index);
+        name+=buf;
+    }
+    if ( m_out ) {
+        if ( !m_out->Close() ) {
+            m_write_error++;
+        }
+        delete m_out;
+    }
+    m_out=new CCapFileOut();
+    if ( !m_out->Create((char *)name.c_str()) ) {
+        fprintf(stderr," ERROR can't create rx capture file %s \n",name.c_str());
+        delete m_out;
+        m_out=0;
+        return (false);
+    }
+    packet_file_header_t * header=(packet_file_header_t *)m_out->reserve(sizeof(packet_file_header_t));
+    if ( header == NULL ) {
+        m_write_error++;
+        return (false);
+    }
+    header->magic          = RX_CAPTURE_NSEC_MAGIC;
+    header->version_major  = 0x0002;
+    header->version_minor  = 0x0004;
+    header->thiszone       = 0;
+    header->sigfigs        = 0;
+    header->snaplen        = m_snaplen;
+    header->linktype       = 1;
+    m_file_bytes=sizeof(packet_file_header_t);
+    m_files++;
+    return (true);
+}
+
+
+bool CRxCapture::write_slot(rx_capture_slot_t * slot){
+    uint32_t size=sizeof(sf_pkthdr_t)+slot->m_caplen;
+    if ( m_rotate_bytes && (m_file_bytes+size > m_rotate_bytes) &&
+         (m_file_bytes > sizeof(packet_file_header_t)) ) {
+        m_file_index++;
+        if ( !open_file() ) {
+            return (false);
+        }
+    }
+    if ( m_out == NULL ) {
+        return (false);
+    }
+    char * p=m_out->reserve(size);
+    if ( p == NULL ) {
+        m_write_error++;
+        return (false);
+    }
+    double t=slot->m_time+m_wall_offset;
+    sf_pkthdr_t * hdr=(sf_pkthdr_t *)p;
+    hdr->ts.sec  = (uint32_t)t;
+    hdr->ts.msec = (uint32_t)((t-(double)hdr->ts.sec)*1000000000.0); /* nsec file */
+    hdr->caplen  = slot->m_caplen;
+    hdr->len     = slot->m_len;
+    memcpy(p+sizeof(sf_pkthdr_t),slot->m_data,slot->m_caplen);
+    m_file_bytes+=size;
+    m_written++;
+    return (true);
+}
+
+
+/* all the packets in the rings, returns the number of packets */
+uint32_t CRxCapture::drain(){
+    uint32_t cnt=0;
+    int i;
+    for (i=0; i<m_num_ports; i++) {
+        CRxCaptureRing * r=&m_rings[i];
+        while ( r->m_tail != r->m_head ) {
+            utl_seq_rmb();
+            write_slot(&r->m_slots[r->m_tail & (CRxCaptureRing::RING_SIZE-1)]);
+            /* the slot is read before the rx core can write it */
+            utl_seq_wmb();
+            r->m_tail = r->m_tail + 1;
+            cnt++;
+        }
+    }
+    return (cnt);
+}
+
+
+void CRxCapture::writer(){
+    while ( true ) {
+        /* read the stop before the drain, the last packets are written */
+        bool stop=m_stop;
+        utl_seq_rmb();
+        uint32_t cnt=drain();
+        if ( stop ) {
+            break;
+        }
+        if ( cnt == 0 ) {
+            usleep(RX_CAPTURE_IDLE_USEC);
+        }
+    }
+}
+
+
+void CRxCapture::Delete(){
+    if ( m_thread_started ) {
+        m_stop=true;
+        pthread_join(m_thread,NULL);
+        m_thread_started=false;
+    }
+    if ( m_out ) {
+        if ( !m_out->Close() ) {
+            m_write_error++;
+        }
+        delete m_out;
+        m_out=0;
+    }
+    if ( m_mem ) {
+        munmap(m_mem,m_mem_size);
+    }
+    m_mem=0;
+    m_mem_size=0;
+    m_num_ports=0;
+}
+
+
+void CRxCapture::get_stats(CRxCaptureStats & stats){
+    stats.Clear();
+    int i;
+    for (i=0; i<MAX_PORTS; i++) {
+        CRxCaptureRing * r=&m_rings[i];
+        stats.m_rx       += r->m_rx;
+        stats.m_filtered += r->m_filtered;
+        stats.m_captured += r->m_captured;
+        stats.m_drop     += r->m_drop;
+    }
+    stats.m_written     = m_written;
+    stats.m_files       = m_files;
+    stats.m_write_error = m_write_error;
+}
+
+
+void CRxCapture::Dump(FILE *fd){
+    CRxCaptureStats stats;
+    get_stats(stats);
+    fprintf(fd," rx capture %s \n",m_file_name.c_str());
+    stats.Dump(fd);
+}
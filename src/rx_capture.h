@@ -0,0 +1,228 @@
+#ifndef RX_CAPTURE_H
+#define RX_CAPTURE_H
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "mbuf.h"
+#include <common/cap_file_out.h>
+#include <common/pcap.h>
+
+/*
+  capture of the received packets to a pcap file.
+
+  the rx core checks the filter and copies the packet (up to snaplen) to the
+  ring of its port, a slot in huge page memory. a writer thread drains the
+  rings to the file, a full ring is a drop. the file is rotated by size:
+  name, name.1, name.2 ...
+*/
+
+
+/**
+ * a small subset of the BPF filter syntax.
+ *
+ *  primitives : ip ip6 arp tcp udp icmp vlan
+ *               [src|dst] host A.B.C.D
+ *               [src|dst] net A.B.C.D/len
+ *               [src|dst] port N
+ *               greater N, less N (packet length)
+ *  each one can have a "not" (or "!") before it, "and" ("&&") is before
+ *  "or" ("||"), there are no parentheses. host/net are IPv4 only.
+ *  an empty filter matches all the packets
+ */
+class CRxCaptureFilter {
+public:
+    enum {
+        F_IP,
+        F_IP6,
+        F_ARP,
+        F_TCP,
+        F_UDP,
+        F_ICMP,
+        F_VLAN,
+        F_HOST,
+        F_NET,
+        F_PORT,
+        F_GREATER,
+        F_LESS
+    };
+
+    enum {
+        DIR_ANY = 0,
+        DIR_SRC = 1,
+        DIR_DST = 2
+    };
+
+    struct term_t {
+        uint8_t  m_type;
+        uint8_t  m_dir;
+        bool     m_not;
+        uint32_t m_val;
+        uint32_t m_mask;
+    };
+
+    /* false in case of a syntax error */
+    bool Create(std::string filter);
+
+    /* p/len is the first segment of the packet, pkt_len for greater/less */
+    bool match(const uint8_t * p,uint16_t len,uint16_t pkt_len);
+
+    bool is_empty(){
+        return (m_or.size()==0);
+    }
+
+private:
+    std::vector<std::vector<term_t> > m_or; /* or of and lists */
+};
+
+
+/* one packet of the ring */
+struct rx_capture_slot_t {
+    double   m_time;       /* now_sec of the rx core */
+    uint16_t m_caplen;
+    uint16_t m_len;
+    uint8_t  m_port;
+    uint8_t  m_pad[51];    /* data is cache line aligned */
+    char     m_data[MAX_PKT_SIZE]; /* max snaplen, jumbo frames */
+};
+
+
+class CRxCaptureStats {
+public:
+    CRxCaptureStats(){
+        Clear();
+    }
+    void Clear(){
+        m_rx=0;
+        m_filtered=0;
+        m_captured=0;
+        m_drop=0;
+        m_written=0;
+        m_files=0;
+        m_write_error=0;
+    }
+    void Dump(FILE *fd);
+
+public:
+    uint64_t m_rx;          /* packets seen by the rx core */
+    uint64_t m_filtered;    /* did not match the filter */
+    uint64_t m_captured;    /* written to a ring */
+    uint64_t m_drop;        /* the ring was full, the writer is behind */
+    uint64_t m_written;     /* written by the writer thread */
+    uint64_t m_files;
+    uint64_t m_write_error;
+};
+
+
+/* ring of one rx queue, the rx core is the producer and the writer thread the consumer */
+class CRxCaptureRing {
+public:
+    enum {
+        RING_SIZE = 2048 /* power of 2 */
+    };
+    rx_capture_slot_t *  m_slots;
+    volatile uint32_t    m_head;  /* written by the rx core */
+    volatile uint32_t    m_tail;  /* written by the writer thread */
+    uint64_t             m_rx;
+    uint64_t             m_filtered;
+    uint64_t             m_captured;
+    uint64_t             m_drop;
+};
+
+
+class CRxCapture {
+public:
+    enum {
+        MAX_PORTS = 8
+    };
+
+    CRxCapture();
+
+    /**
+     * allocate the rings and start the writer
+     *
+     * @param file_name
+     * @param filter        BPF like filter, empty for all
+     * @param num_ports     rx queues, one ring each
+     * @param snaplen       max bytes of each packet
+     * @param rotate_bytes  size of each file, 0 for one file
+     */
+    bool Create(std::string file_name,
+                std::string filter,
+                uint8_t     num_ports,
+                uint16_t    snaplen,
+                uint64_t    rotate_bytes);
+
+    /* rx core, the mbuf is not changed */
+    inline void capture(uint8_t port,rte_mbuf_t * m);
+
+    /* drain the rings, stop the writer and close the file */
+    void Delete();
+
+    void get_stats(CRxCaptureStats & stats);
+    void Dump(FILE *fd);
+
+private:
+    void capture_pkt(CRxCaptureRing * r,uint8_t port,rte_mbuf_t * m);
+    static void * writer_thread(void * obj);
+    void writer();
+    uint32_t drain();
+    bool open_file();
+    bool write_slot(rx_capture_slot_t * slot);
+
+private:
+    std::string       m_file_name;
+    CRxCaptureFilter  m_filter;
+    bool              m_has_filter;
+    uint8_t           m_num_ports;
+    uint16_t          m_snaplen;
+    uint64_t          m_rotate_bytes;
+    double            m_wall_offset;   /* now_sec to wall clock */
+
+    char *            m_mem;
+    uint64_t          m_mem_size;
+    bool              m_is_huge;
+    CRxCaptureRing    m_rings[MAX_PORTS];
+
+    /* writer thread side */
+    CCapFileOut *     m_out;
+    uint64_t          m_file_bytes;
+    uint32_t          m_file_index;
+    uint64_t          m_written;
+    uint64_t          m_files;
+    uint64_t          m_write_error;
+    pthread_t         m_thread;
+    bool              m_thread_started;
+    volatile bool     m_stop;
+};
+
+
+inline void CRxCapture::capture(uint8_t port,rte_mbuf_t * m){
+    if ( port < m_num_ports ) {
+        capture_pkt(&m_rings[port],port,m);
+    }
+}
+
+#endif
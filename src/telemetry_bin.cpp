@@ -0,0 +1,141 @@
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "telemetry_bin.h"
+#include <string.h>
+#include <assert.h>
+
+
+static inline uint64_t double_to_u64(double val){
+    uint64_t res;
+    memcpy(&res,&val,sizeof(res));
+    return (res);
+}
+
+static inline double u64_to_double(uint64_t val){
+    double res;
+    memcpy(&res,&val,sizeof(res));
+    return (res);
+}
+
+
+void CTelemetryBinEncoder::begin(std::string & buf,
+                                 uint16_t type,
+                                 uint32_t seq,
+                                 uint64_t time_usec,
+                                 uint16_t num_fields,
+                                 uint16_t num_rec,
+                                 uint16_t rec_size){
+    uint32_t length = sizeof(telemetry_bin_hdr_t)+
+                      sizeof(uint64_t)*(num_fields+(uint32_t)num_rec*rec_size);
+    /* keep the capacity of the buffer */
+    buf.resize(length);
+    m_buf        = &buf;
+    m_num_fields = num_fields;
+    m_num_rec    = num_rec;
+    m_rec_size   = rec_size;
+
+    telemetry_bin_hdr_t * hdr=(telemetry_bin_hdr_t *)&buf[0];
+    memcpy(hdr->m_topic,TELEMETRY_BIN_TOPIC,TELEMETRY_BIN_TOPIC_LEN);
+    hdr->m_version    = TELEMETRY_BIN_VERSION;
+    hdr->m_type       = type;
+    hdr->m_length     = length;
+    hdr->m_seq        = seq;
+    hdr->m_num_fields = num_fields;
+    hdr->m_num_rec    = num_rec;
+    hdr->m_rec_size   = rec_size;
+    memset(hdr->m_pad,0,sizeof(hdr->m_pad));
+    hdr->m_time_usec  = time_usec;
+    memset(get_values(),0,length-sizeof(telemetry_bin_hdr_t));
+}
+
+void CTelemetryBinEncoder::set(uint16_t field,uint64_t val){
+    assert(field<m_num_fields);
+    get_values()[field]=val;
+}
+
+void CTelemetryBinEncoder::set_double(uint16_t field,double val){
+    set(field,double_to_u64(val));
+}
+
+void CTelemetryBinEncoder::set_rec(uint16_t rec,uint16_t field,uint64_t val){
+    assert(rec<m_num_rec);
+    assert(field<m_rec_size);
+    get_values()[m_num_fields+(uint32_t)rec*m_rec_size+field]=val;
+}
+
+void CTelemetryBinEncoder::set_rec_double(uint16_t rec,uint16_t field,double val){
+    set_rec(rec,field,double_to_u64(val));
+}
+
+
+bool CTelemetryBinDecoder::is_bin_msg(const char * p,uint32_t size){
+    if (size < sizeof(telemetry_bin_hdr_t)) {
+        return (false);
+    }
+    return ( memcmp(p,TELEMETRY_BIN_TOPIC,TELEMETRY_BIN_TOPIC_LEN)==0 );
+}
+
+bool CTelemetryBinDecoder::decode(const char * p,uint32_t size){
+    m_hdr=0;
+    m_values=0;
+    if ( !is_bin_msg(p,size) ) {
+        return (false);
+    }
+    const telemetry_bin_hdr_t * hdr=(const telemetry_bin_hdr_t *)p;
+    if ( hdr->m_length != size ) {
+        return (false);
+    }
+    uint32_t length = sizeof(telemetry_bin_hdr_t)+
+                      sizeof(uint64_t)*(hdr->m_num_fields+(uint32_t)hdr->m_num_rec*hdr->m_rec_size);
+    if ( length != size ) {
+        return (false);
+    }
+    m_hdr    = hdr;
+    m_values = (const uint64_t *)(p+sizeof(telemetry_bin_hdr_t));
+    return (true);
+}
+
+uint64_t CTelemetryBinDecoder::get(uint16_t field){
+    if ( (m_hdr == 0) || (field >= m_hdr->m_num_fields) ) {
+        /* older publisher */
+        return (0);
+    }
+    uint64_t res;
+    memcpy(&res,&m_values[field],sizeof(res));
+    return (res);
+}
+
+double CTelemetryBinDecoder::get_double(uint16_t field){
+    return (u64_to_double(get(field)));
+}
+
+uint64_t CTelemetryBinDecoder::get_rec(uint16_t rec,uint16_t field){
+    if ( (m_hdr == 0) || (rec >= m_hdr->m_num_rec) || (field >= m_hdr->m_rec_size) ) {
+        return (0);
+    }
+    uint64_t res;
+    memcpy(&res,&m_values[m_hdr->m_num_fields+(uint32_t)rec*m_hdr->m_rec_size+field],sizeof(res));
+    return (res);
+}
+
+double CTelemetryBinDecoder::get_rec_double(uint16_t rec,uint16_t field){
+    return (u64_to_double(get_rec(rec,field)));
+}
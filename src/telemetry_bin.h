@@ -0,0 +1,203 @@
+#ifndef TELEMETRY_BIN_H
+#define TELEMETRY_BIN_H
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <string>
+
+/*
+  compact binary telemetry, published on the same zmq socket as the json
+  under the "trex-bin" topic (subscribe to it to get only the binary messages).
+  the json messages start with '{', a json subscriber subscribes to "{" and not
+  to "" that gets the binary messages too.
+
+  message :
+     header
+     m_num_fields x 64bit global values
+     m_num_rec x m_rec_size x 64bit per port values
+
+  all values are little endian 64bit, counters are uint64_t and rates are the
+  bit pattern of a double. the schema of each type is fixed, newer versions only
+  append fields so an old decoder still works and a new decoder return 0 for
+  fields an old publisher does not have.
+*/
+
+#define TELEMETRY_BIN_TOPIC      "trex-bin"
+#define TELEMETRY_BIN_TOPIC_LEN  8
+#define TELEMETRY_BIN_VERSION    1
+
+struct telemetry_bin_hdr_t {
+    char     m_topic[TELEMETRY_BIN_TOPIC_LEN]; /* zmq topic */
+    uint16_t m_version;
+    uint16_t m_type;       /* tbGLOBAL, tbLATENCY */
+    uint32_t m_length;     /* total message length in bytes */
+    uint32_t m_seq;        /* per type, a gap means lost messages */
+    uint16_t m_num_fields; /* number of global fields */
+    uint16_t m_num_rec;    /* number of per port records */
+    uint16_t m_rec_size;   /* number of fields in each record */
+    uint16_t m_pad[3];
+    uint64_t m_time_usec;  /* publisher time */
+} __attribute__((packed));
+
+
+class CTelemetryBin {
+public:
+    enum msg_type_t {
+        tbGLOBAL  = 1,
+        tbLATENCY = 2,
+        tbLAST
+    };
+
+    /* tbGLOBAL fields */
+    enum {
+        G_TX_PKTS,
+        G_RX_PKTS,
+        G_TX_BYTES,
+        G_RX_BYTES,
+        G_ALLOC_ERROR,
+        G_QUEUE_FULL,
+        G_QUEUE_DROP,
+        G_ACTIVE_FLOWS, /* double */
+        G_OPEN_FLOWS,   /* double */
+        G_TX_BPS,       /* double */
+        G_RX_BPS,       /* double */
+        G_TX_PPS,       /* double */
+        G_TX_CPS,       /* double */
+        G_RX_DROP_BPS,  /* double */
+        G_CPU_UTIL,     /* double */
+        G_QUEUE_DELAY,
+        G_LAST
+    };
+
+    /* tbGLOBAL per port record */
+    enum {
+        P_OPACKETS,
+        P_OBYTES,
+        P_IPACKETS,
+        P_IBYTES,
+        P_IERRORS,
+        P_OERRORS,
+        P_TX_BPS,       /* double */
+        P_LAST
+    };
+
+    /* tbLATENCY fields */
+    enum {
+        L_CPU_UTIL,     /* double */
+        L_LAST
+    };
+
+    /* tbLATENCY per port record */
+    enum {
+        LP_TX_PKTS,
+        LP_RX_PKTS,
+        LP_ERRORS,
+        LP_AVG_USEC,    /* double */
+        LP_MAX_USEC,    /* double */
+        LP_JITTER_USEC,
+        LP_TX_DROP,
+        LP_LAST
+    };
+};
+
+
+/* build one message into a reusable buffer */
+class CTelemetryBinEncoder {
+public:
+    CTelemetryBinEncoder(){
+        m_buf=0;
+        m_num_fields=0;
+        m_num_rec=0;
+        m_rec_size=0;
+    }
+
+    void begin(std::string & buf,
+               uint16_t type,
+               uint32_t seq,
+               uint64_t time_usec,
+               uint16_t num_fields,
+               uint16_t num_rec,
+               uint16_t rec_size);
+
+    void set(uint16_t field,uint64_t val);
+    void set_double(uint16_t field,double val);
+    void set_rec(uint16_t rec,uint16_t field,uint64_t val);
+    void set_rec_double(uint16_t rec,uint16_t field,double val);
+
+private:
+    uint64_t * get_values(){
+        return ((uint64_t *)(&(*m_buf)[0]+sizeof(telemetry_bin_hdr_t)));
+    }
+
+private:
+    std::string * m_buf;
+    uint16_t      m_num_fields;
+    uint16_t      m_num_rec;
+    uint16_t      m_rec_size;
+};
+
+
+/* decode one message, the message buffer should be valid while the decoder is used */
+class CTelemetryBinDecoder {
+public:
+    CTelemetryBinDecoder(){
+        m_hdr=0;
+        m_values=0;
+    }
+
+    /* return false in case this is not a valid binary telemetry message,
+       the decoder is then empty and all the getters return 0 */
+    bool decode(const char * p,uint32_t size);
+
+    static bool is_bin_msg(const char * p,uint32_t size);
+
+    bool is_valid(){
+        return (m_hdr != 0);
+    }
+
+    uint16_t get_version(){
+        return (m_hdr?m_hdr->m_version:0);
+    }
+    uint16_t get_type(){
+        return (m_hdr?m_hdr->m_type:0);
+    }
+    uint32_t get_seq(){
+        return (m_hdr?m_hdr->m_seq:0);
+    }
+    uint64_t get_time_usec(){
+        return (m_hdr?m_hdr->m_time_usec:0);
+    }
+    uint16_t get_num_rec(){
+        return (m_hdr?m_hdr->m_num_rec:0);
+    }
+
+    uint64_t get(uint16_t field);
+    double   get_double(uint16_t field);
+    uint64_t get_rec(uint16_t rec,uint16_t field);
+    double   get_rec_double(uint16_t rec,uint16_t field);
+
+private:
+    const telemetry_bin_hdr_t * m_hdr;
+    const uint64_t            * m_values;
+};
+
+#endif
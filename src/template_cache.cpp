@@ -0,0 +1,350 @@
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "template_cache.h"
+#include "bp_sim.h"
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TEMPLATE_CACHE_PKT_ALIGN 128
+#define TEMPLATE_CACHE_HUGE_PAGE (2*1024*1024)
+
+/* one packet of a template */
+struct template_cache_pkt_t {
+    double              m_cap_ipg;
+    uint64_t            m_data_offset;  /* packet bytes, from the start of the file */
+    uint64_t            m_pkt_cnt;
+    uint32_t            m_time_sec;
+    uint32_t            m_time_nsec;
+    uint16_t            m_pkt_len;
+    uint16_t            m_payload_len;
+    uint16_t            m_packet_padding;
+    uint16_t            m_ether;        /* offsets of the headers */
+    uint16_t            m_ip;
+    uint16_t            m_l4;
+    uint16_t            m_payload;      /* 0 for no payload */
+    uint8_t             m_is_ipv6;
+    uint8_t             m_ether_offset;
+    uint8_t             m_ip_offset;
+    uint8_t             m_udp_tcp_offset;
+    uint8_t             m_payload_offset;
+    uint8_t             m_pad;
+    uint16_t            m_tso_segs;
+    uint16_t            m_tso_mss;
+    uint32_t            m_tso_payload;
+    uint16_t            m_train_len;
+    CFlowKey            m_flow_key;
+    CPacketDescriptor   m_desc;
+};
+
+
+/* FNV-1a */
+static inline uint64_t tc_hash(uint64_t h,const void * p,uint64_t len){
+    const uint8_t * b=(const uint8_t *)p;
+    uint64_t i;
+    for (i=0; i<len; i++) {
+        h ^= b[i];
+        h *= 0x100000001b3ULL;
+    }
+    return (h);
+}
+
+static uint64_t tc_hash_file(uint64_t h,std::string file_name){
+    FILE * fd=fopen(file_name.c_str(),"rb");
+    if (fd == NULL) {
+        /* load_cap_file reports it */
+        return (tc_hash(h,file_name.c_str(),file_name.size()));
+    }
+    char buf[64*1024];
+    size_t n;
+    while ( (n=fread(buf,1,sizeof(buf),fd)) > 0 ) {
+        h=tc_hash(h,buf,n);
+    }
+    fclose(fd);
+    return (h);
+}
+
+uint64_t CTemplateCache::calc_hash(std::string yaml_file,
+                                   CFlowsYamlInfo * yaml_info){
+    uint64_t h=0xcbf29ce484222325ULL;
+    uint32_t v[8];
+    v[0] = TEMPLATE_CACHE_VERSION;
+    v[1] = sizeof(template_cache_pkt_t);
+    v[2] = CGlobalInfo::is_ipv6_enable()?1:0;
+    v[3] = CGlobalInfo::is_learn_mode()?1:0;
+    v[4] = get_is_rx_filter_enable()?1:0;
+    v[5] = CGlobalInfo::m_options.preview.get_tso_enable()?1:0;
+    v[6] = FIRST_PKT_SIZE;
+    v[7] = (uint32_t)yaml_info->m_vec.size();
+    h=tc_hash(h,v,sizeof(v));
+    h=tc_hash_file(h,yaml_file);
+    int i;
+    for (i=0; i<(int)yaml_info->m_vec.size(); i++) {
+        h=tc_hash_file(h,yaml_info->m_vec[i].m_name);
+    }
+    return (h);
+}
+
+
+bool CTemplateCache::Open(std::string file_name,uint64_t hash){
+    Delete();
+    FILE * fd=fopen(file_name.c_str(),"rb");
+    if (fd == NULL) {
+        return (false);
+    }
+    template_cache_hdr_t hdr;
+    if ( (fread(&hdr,1,sizeof(hdr),fd) != sizeof(hdr)) ||
+         (memcmp(hdr.m_magic,TEMPLATE_CACHE_MAGIC,sizeof(hdr.m_magic)) != 0) ||
+         (hdr.m_version != TEMPLATE_CACHE_VERSION) ||
+         (hdr.m_pkt_rec_size != sizeof(template_cache_pkt_t)) ||
+         (hdr.m_hash != hash) ) {
+        fclose(fd);
+        printf(" -- template cache %s is not valid for this profile, rebuild it \n",file_name.c_str());
+        return (false);
+    }
+    struct stat st;
+    if ( (fstat(fileno(fd),&st) != 0) || ((uint64_t)st.st_size != hdr.m_file_size) ) {
+        fclose(fd);
+        return (false);
+    }
+
+    /* huge pages, transparent huge pages in case there are no free ones */
+    m_size = ((hdr.m_file_size + TEMPLATE_CACHE_HUGE_PAGE-1)/TEMPLATE_CACHE_HUGE_PAGE)*TEMPLATE_CACHE_HUGE_PAGE;
+    void * p=MAP_FAILED;
+    #ifdef MAP_HUGETLB
+    p=mmap(NULL,m_size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+    #endif
+    m_is_huge = (p != MAP_FAILED);
+    if ( !m_is_huge ) {
+        p=mmap(NULL,m_size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+        if (p == MAP_FAILED) {
+            fclose(fd);
+            m_size=0;
+            return (false);
+        }
+        #ifdef MADV_HUGEPAGE
+        madvise(p,m_size,MADV_HUGEPAGE);
+        #endif
+    }
+    m_base=(char *)p;
+    rewind(fd);
+    if (fread(m_base,1,hdr.m_file_size,fd) != hdr.m_file_size) {
+        fclose(fd);
+        Delete();
+        return (false);
+    }
+    fclose(fd);
+    m_hash          = hash;
+    m_offset        = sizeof(template_cache_hdr_t);
+    m_num_templates = hdr.m_num_templates;
+    m_cur_template  = 0;
+    printf(" -- template cache %s, %u templates, %s memory \n",file_name.c_str(),
+           m_num_templates,m_is_huge?"huge page":"normal");
+    return (true);
+}
+
+
+bool CTemplateCache::load(CCapFileFlowInfo * flow_info){
+    template_cache_hdr_t * hdr=(template_cache_hdr_t *)m_base;
+    if ( (m_base == 0) || (m_cur_template >= m_num_templates) ||
+         (m_offset + sizeof(template_cache_tmpl_t) > hdr->m_file_size) ) {
+        return (false);
+    }
+    template_cache_tmpl_t * t=(template_cache_tmpl_t *)(m_base+m_offset);
+    m_offset += sizeof(template_cache_tmpl_t);
+    if ( (t->m_num_pkts == 0) ||
+         (m_offset + (uint64_t)t->m_num_pkts*sizeof(template_cache_pkt_t) > hdr->m_file_size) ) {
+        return (false);
+    }
+
+    flow_info->RemoveAll();
+    uint32_t i;
+    for (i=0; i<t->m_num_pkts; i++) {
+        template_cache_pkt_t * rec=(template_cache_pkt_t *)(m_base+m_offset);
+        m_offset += sizeof(template_cache_pkt_t);
+        if ( (rec->m_data_offset + rec->m_pkt_len > hdr->m_file_size) ||
+             (rec->m_payload+rec->m_payload_len > rec->m_pkt_len) ) {
+            return (false);
+        }
+
+        CCapPktRaw raw(0);
+        raw.raw       = m_base+rec->m_data_offset;
+        raw.pkt_len   = rec->m_pkt_len;
+        raw.pkt_cnt   = rec->m_pkt_cnt;
+        raw.time_sec  = rec->m_time_sec;
+        raw.time_nsec = rec->m_time_nsec;
+        raw.setDoNotFree(true);
+
+        CPacketIndication ind;
+        ind.Clean();
+        ind.m_packet         = &raw;
+        ind.m_cap_ipg        = rec->m_cap_ipg;
+        ind.m_flow           = 0;
+        ind.m_ether          = (EthernetHeader *)(raw.raw+rec->m_ether);
+        ind.l3.m_ipv4        = (IPHeader *)(raw.raw+rec->m_ip);
+        ind.l4.m_tcp         = (TCPHeader *)(raw.raw+rec->m_l4);
+        ind.m_payload        = rec->m_payload?(uint8_t *)(raw.raw+rec->m_payload):0;
+        ind.m_is_ipv6        = rec->m_is_ipv6?true:false;
+        ind.m_payload_len    = rec->m_payload_len;
+        ind.m_packet_padding = rec->m_packet_padding;
+        ind.m_flow_key       = rec->m_flow_key;
+        ind.m_desc           = rec->m_desc;
+        ind.m_ether_offset   = rec->m_ether_offset;
+        ind.m_ip_offset      = rec->m_ip_offset;
+        ind.m_udp_tcp_offset = rec->m_udp_tcp_offset;
+        ind.m_payload_offset = rec->m_payload_offset;
+
+        /* the template packet points to the cache memory */
+        flow_info->Append(&ind,true);
+        CFlowPktInfo * lp=flow_info->GetPacket(i);
+        lp->m_tso_segs    = rec->m_tso_segs;
+        lp->m_tso_mss     = rec->m_tso_mss;
+        lp->m_tso_payload = rec->m_tso_payload;
+        lp->m_train_len   = rec->m_train_len;
+        if ( lp->m_tso_segs == 1 ) {
+            lp->alloc_tso_mbuf();
+        }
+    }
+    flow_info->m_total_bytes  = t->m_total_bytes;
+    flow_info->m_total_flows  = t->m_total_flows;
+    flow_info->m_total_errors = t->m_total_errors;
+    flow_info->m_tso_trains   = t->m_tso_trains;
+    flow_info->m_trains       = t->m_trains;
+    m_cur_template++;
+    return (true);
+}
+
+
+bool CTemplateCache::save(std::string file_name,
+                          uint64_t hash,
+                          std::vector<CCapFileFlowInfo *> & flows){
+    /* records first, the packet bytes after all of them */
+    uint64_t data_offset = sizeof(template_cache_hdr_t);
+    int i;
+    for (i=0; i<(int)flows.size(); i++) {
+        data_offset += sizeof(template_cache_tmpl_t)+flows[i]->Size()*sizeof(template_cache_pkt_t);
+    }
+
+    std::string tmp_name=file_name+".tmp";
+    FILE * fd=fopen(tmp_name.c_str(),"wb");
+    if (fd == NULL) {
+        printf(" ERROR can't create template cache %s \n",tmp_name.c_str());
+        return (false);
+    }
+
+    template_cache_hdr_t hdr;
+    memset(&hdr,0,sizeof(hdr));
+    memcpy(hdr.m_magic,TEMPLATE_CACHE_MAGIC,sizeof(hdr.m_magic));
+    hdr.m_version       = TEMPLATE_CACHE_VERSION;
+    hdr.m_pkt_rec_size  = sizeof(template_cache_pkt_t);
+    hdr.m_hash          = hash;
+    hdr.m_num_templates = (uint32_t)flows.size();
+    /* file size is set at the end */
+    bool res = (fwrite(&hdr,1,sizeof(hdr),fd) == sizeof(hdr));
+
+    uint64_t data = (data_offset+TEMPLATE_CACHE_PKT_ALIGN-1) & ~((uint64_t)TEMPLATE_CACHE_PKT_ALIGN-1);
+    for (i=0; i<(int)flows.size(); i++) {
+        CCapFileFlowInfo * fi=flows[i];
+        template_cache_tmpl_t t;
+        memset(&t,0,sizeof(t));
+        t.m_total_bytes  = fi->m_total_bytes;
+        t.m_total_flows  = fi->m_total_flows;
+        t.m_total_errors = fi->m_total_errors;
+        t.m_tso_trains   = fi->m_tso_trains;
+        t.m_trains       = fi->m_trains;
+        t.m_num_pkts     = (uint32_t)fi->Size();
+        res = res && (fwrite(&t,1,sizeof(t),fd) == sizeof(t));
+
+        uint32_t j;
+        for (j=0; j<t.m_num_pkts; j++) {
+            CFlowPktInfo * lp=fi->GetPacket(j);
+            CPacketIndication * pi=&lp->m_pkt_indication;
+            template_cache_pkt_t rec;
+            memset(&rec,0,sizeof(rec));
+            rec.m_cap_ipg        = pi->m_cap_ipg;
+            rec.m_data_offset    = data;
+            rec.m_pkt_cnt        = lp->m_packet->pkt_cnt;
+            rec.m_time_sec       = lp->m_packet->time_sec;
+            rec.m_time_nsec      = lp->m_packet->time_nsec;
+            rec.m_pkt_len        = lp->m_packet->pkt_len;
+            rec.m_payload_len    = pi->m_payload_len;
+            rec.m_packet_padding = pi->m_packet_padding;
+            rec.m_ether          = pi->getEtherOffset();
+            rec.m_ip             = pi->getIpOffset();
+            rec.m_l4             = pi->getTcpOffset();
+            rec.m_payload        = pi->getPayloadOffset();
+            rec.m_is_ipv6        = pi->m_is_ipv6?1:0;
+            rec.m_ether_offset   = pi->m_ether_offset;
+            rec.m_ip_offset      = pi->m_ip_offset;
+            rec.m_udp_tcp_offset = pi->m_udp_tcp_offset;
+            rec.m_payload_offset = pi->m_payload_offset;
+            rec.m_tso_segs       = lp->m_tso_segs;
+            rec.m_tso_mss        = lp->m_tso_mss;
+            rec.m_tso_payload    = lp->m_tso_payload;
+            rec.m_train_len      = lp->m_train_len;
+            rec.m_flow_key       = pi->m_flow_key;
+            rec.m_desc           = pi->m_desc;
+            res = res && (fwrite(&rec,1,sizeof(rec),fd) == sizeof(rec));
+            data = (data+rec.m_pkt_len+TEMPLATE_CACHE_PKT_ALIGN-1) & ~((uint64_t)TEMPLATE_CACHE_PKT_ALIGN-1);
+        }
+    }
+
+    /* packet bytes */
+    static const char zero[TEMPLATE_CACHE_PKT_ALIGN]={0};
+    uint64_t pos=data_offset;
+    for (i=0; i<(int)flows.size(); i++) {
+        uint32_t j;
+        for (j=0; j<flows[i]->Size(); j++) {
+            CCapPktRaw * pkt=flows[i]->GetPacket(j)->m_packet;
+            uint64_t pad = ((pos+TEMPLATE_CACHE_PKT_ALIGN-1) & ~((uint64_t)TEMPLATE_CACHE_PKT_ALIGN-1))-pos;
+            res = res && (fwrite(zero,1,pad,fd) == pad);
+            res = res && (fwrite(pkt->raw,1,pkt->pkt_len,fd) == pkt->pkt_len);
+            pos += pad+pkt->pkt_len;
+        }
+    }
+
+    hdr.m_file_size = pos;
+    rewind(fd);
+    res = res && (fwrite(&hdr,1,sizeof(hdr),fd) == sizeof(hdr));
+    res = (fclose(fd)==0) && res;
+    if ( !res || (rename(tmp_name.c_str(),file_name.c_str()) != 0) ) {
+        printf(" ERROR can't write template cache %s \n",file_name.c_str());
+        unlink(tmp_name.c_str());
+        return (false);
+    }
+    printf(" -- template cache %s saved, %u templates \n",file_name.c_str(),hdr.m_num_templates);
+    return (true);
+}
+
+
+void CTemplateCache::Delete(){
+    if (m_base) {
+        munmap(m_base,m_size);
+    }
+    m_base=0;
+    m_size=0;
+    m_is_huge=false;
+    m_offset=0;
+    m_num_templates=0;
+    m_cur_template=0;
+}
@@ -0,0 +1,118 @@
+#ifndef TEMPLATE_CACHE_H
+#define TEMPLATE_CACHE_H
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class CCapFileFlowInfo;
+struct CFlowsYamlInfo;
+
+/*
+  precompiled templates of a profile.
+
+  the file keeps every template after load_cap_file/update_info/update_tso/
+  update_trains: the packet bytes, the parser offsets, the descriptors and the
+  IPGs, so a run with the same inputs skips the pcap parsing.
+
+  file :
+     header
+     per template : template header, m_num_pkts x packet record
+     packet bytes, each one 128 bytes aligned (PKT_ALIGN)
+
+  the header has a hash of the content of the yaml, of every pcap file and of
+  the options that change the processing. a different hash, version or record
+  size means the file is rebuilt. the file is read in one shot to huge page
+  memory and the template packets point to it, it is freed with the templates
+*/
+
+#define TEMPLATE_CACHE_MAGIC   "TRXTMPL"
+#define TEMPLATE_CACHE_VERSION 1
+
+struct template_cache_hdr_t {
+    char     m_magic[8];
+    uint32_t m_version;
+    uint32_t m_pkt_rec_size;  /* sizeof(template_cache_pkt_t) of the writer */
+    uint64_t m_hash;
+    uint64_t m_file_size;
+    uint32_t m_num_templates;
+    uint32_t m_pad;
+};
+
+struct template_cache_tmpl_t {
+    uint64_t m_total_bytes;
+    uint64_t m_total_flows;
+    uint64_t m_total_errors;
+    uint32_t m_tso_trains;
+    uint32_t m_trains;
+    uint32_t m_num_pkts;
+    uint32_t m_pad;
+};
+
+
+class CTemplateCache {
+public:
+    CTemplateCache(){
+        m_base=0;
+        m_size=0;
+        m_is_huge=false;
+        m_hash=0;
+        m_offset=0;
+        m_num_templates=0;
+        m_cur_template=0;
+    }
+
+    /* hash of the inputs of the profile */
+    static uint64_t calc_hash(std::string yaml_file,
+                              CFlowsYamlInfo * yaml_info);
+
+    /* read the file, false in case it does not exist or it is not valid for hash */
+    bool Open(std::string file_name,uint64_t hash);
+
+    bool is_valid(){
+        return (m_base?true:false);
+    }
+
+    /* load the next template, in the order they were saved */
+    bool load(CCapFileFlowInfo * flow_info);
+
+    /* write all the templates */
+    static bool save(std::string file_name,
+                     uint64_t hash,
+                     std::vector<CCapFileFlowInfo *> & flows);
+
+    /* free the memory, after the templates are deleted */
+    void Delete();
+
+private:
+    char *   m_base;
+    uint64_t m_size;    /* size of the mapping */
+    bool     m_is_huge;
+    uint64_t m_hash;
+    uint64_t m_offset;  /* next template */
+    uint32_t m_num_templates;
+    uint32_t m_cur_template;
+};
+
+#endif
@@ -35,24 +35,17 @@ void CTimeHistogram::Reset(){
 	memset(&m_max_ar[0],0,sizeof(m_max_ar));
 	m_win_cnt=0;
 
-    int i;
-    int j;
-    for (i=0;i<HISTOGRAM_SIZE; i++) {
-        for (j=0; j<HISTOGRAM_SIZE_LOG;j++) {
-            m_hcnt[j][i]=0;
-        }
-    }
-    for (i=0;i<HISTOGRAM_SIZE; i++) {
-        for (j=0; j<HISTOGRAM_SIZE_LOG;j++) {
-            m_hcnt_shadow[j][i]=0;
-        }
-    }
+    m_sum=0.0;
+    m_sum_shadow=0.0;
     m_cnt_shadow=0;
-    m_high_cnt_shadow=0;
+    m_hdr.Reset();
 }
 
-bool CTimeHistogram::Create(){
+bool CTimeHistogram::Create(uint8_t digits){
     m_min_delta =10.0/1000000.0;
+    if ( !m_hdr.Create(HDR_LOWEST_NSEC,HDR_HIGHEST_NSEC,digits) ) {
+        return (false);
+    }
     Reset();
     return (true);
 }
@@ -62,41 +55,44 @@ void CTimeHistogram::Delete(){
 bool CTimeHistogram::Add(dsec_t dt){
 
     m_cnt++;
-    if (dt < m_min_delta) {
-        return false;
+    if ( dt > 0.0 ) {
+        m_sum+=dt;
+        m_hdr.add((uint64_t)(dt*1000000000.0));
+    }else{
+        m_hdr.add(0);
     }
-    m_high_cnt++;
-
     if ( m_max_dt < dt){
         m_max_dt = dt;
     }
 	if ( m_max_win_dt < dt){
 		m_max_win_dt = dt;
 	}
-
-    uint32_t d_10usec=(uint32_t)(dt*100000.0);
-    // 1 10-19 usec
-    //,2 -20-29 usec
-    //,3,
-
-    int j;
-    for (j=0; j<HISTOGRAM_SIZE_LOG; j++) {
-        uint32_t low  = d_10usec % 10;
-        uint32_t high = d_10usec / 10;
-        if (high == 0 ) {
-            if (low>0) {
-                low=low-1;
-            }
-            m_hcnt[j][low]++;
-            break;
-        }else{
-            d_10usec =high;
-        }
+    if (dt < m_min_delta) {
+        return false;
     }
-
+    m_high_cnt++;
     return true;
 }
 
+bool CTimeHistogram::merge(const CTimeHistogram & o){
+    if ( !m_hdr.merge(o.m_hdr) ) {
+        return (false);
+    }
+    if ( (m_cnt+o.m_cnt) > 0 ) {
+        m_average = ((m_average*(double)m_cnt)+(o.m_average*(double)o.m_cnt))/(double)(m_cnt+o.m_cnt);
+    }
+    m_cnt      += o.m_cnt;
+    m_high_cnt += o.m_high_cnt;
+    m_sum      += o.m_sum;
+    if ( m_max_dt < o.m_max_dt ) {
+        m_max_dt = o.m_max_dt;
+    }
+    if ( m_max_win_last_dt < o.m_max_win_last_dt ) {
+        m_max_win_last_dt = o.m_max_win_last_dt;
+    }
+    return (true);
+}
+
 
 void CTimeHistogram::update(){
 
@@ -110,36 +106,16 @@ void CTimeHistogram::update(){
     update_average();
 }
 
+/* average in usec of the samples since the last call */
 double  CTimeHistogram::get_cur_average(){
-    int i,j;
-    uint64_t d_cnt;
-    uint64_t d_cnt_high;
-
-    d_cnt = m_cnt - m_cnt_shadow;
-    m_cnt_shadow =m_cnt;
-    d_cnt_high   = m_high_cnt - m_high_cnt_shadow;
-    m_high_cnt_shadow =m_high_cnt;
-
-    uint64_t low_events = d_cnt - d_cnt_high;
-    uint64_t sum= low_events;
-    double s = ((double)low_events * 5.0); 
-
-
-    for (j=0; j<HISTOGRAM_SIZE_LOG; j++) {
-        for (i=0; i<HISTOGRAM_SIZE; i++) {
-            uint64_t cnt=m_hcnt[j][i];
-            if (cnt  > 0 ) {
-                uint64_t d= cnt - m_hcnt_shadow[j][i];
-                sum += d;
-                s+= ((double)d)*1.5*get_base_usec(j,i);
-                m_hcnt_shadow[j][i] = cnt;
-            }
-        }
-    }
+    uint64_t d_cnt = m_cnt - m_cnt_shadow;
+    dsec_t   d_sum = m_sum - m_sum_shadow;
+    m_cnt_shadow = m_cnt;
+    m_sum_shadow = m_sum;
 
     double c_average;
-    if ( sum > 0 ) {
-       c_average=s/(double)sum;
+    if ( d_cnt > 0 ) {
+       c_average=(d_sum*1000000.0)/(double)d_cnt;
     }else{
         c_average=0.0;
     }
@@ -162,6 +138,45 @@ dsec_t  CTimeHistogram::get_average_latency(){
 }
 
 
+double  CTimeHistogram::get_percentile_usec(double p){
+    return ( (double)m_hdr.get_value_at_percentile(p)/1000.0 );
+}
+
+void CTimeHistogram::get_decade_hist(uint64_t hcnt[HISTOGRAM_SIZE_LOG][HISTOGRAM_SIZE]){
+    memset(hcnt,0,sizeof(uint64_t)*HISTOGRAM_SIZE_LOG*HISTOGRAM_SIZE);
+    uint32_t idx;
+    for (idx=0; idx<m_hdr.get_used_len(); idx++) {
+        uint64_t cnt=m_hdr.get_count_at_index(idx);
+        if ( cnt == 0 ) {
+            continue;
+        }
+        // 1 10-19 usec
+        //,2 -20-29 usec
+        uint64_t d_10usec=m_hdr.get_median_value_at_index(idx)/10000;
+        if ( d_10usec == 0 ) {
+            continue;
+        }
+        int j;
+        for (j=0; j<HISTOGRAM_SIZE_LOG; j++) {
+            uint64_t low  = d_10usec % 10;
+            uint64_t high = d_10usec / 10;
+            if ( (high == 0) || (j == HISTOGRAM_SIZE_LOG-1) ) {
+                if ( high ) {
+                    /* above the last decade */
+                    low=HISTOGRAM_SIZE;
+                }
+                if (low>0) {
+                    low=low-1;
+                }
+                hcnt[j][low]+=cnt;
+                break;
+            }else{
+                d_10usec =high;
+            }
+        }
+    }
+}
+
 uint32_t CTimeHistogram::get_usec(dsec_t d){
     return (uint32_t)(d*1000000.0);
 }
@@ -190,6 +205,15 @@ void CTimeHistogram::Dump(FILE *fd){
     fprintf (fd," sliding_average    : %.0f usec\n", get_average_latency());
     fprintf (fd," precent    : %.1f %%\n",(100.0*(double)m_high_cnt/(double)m_cnt));
 
+    fprintf (fd," p50/p90/p99/p99.9/p99.99 : %.1f/%.1f/%.1f/%.1f/%.1f usec\n",
+             get_percentile_usec(50.0),
+             get_percentile_usec(90.0),
+             get_percentile_usec(99.0),
+             get_percentile_usec(99.9),
+             get_percentile_usec(99.99));
+
+    uint64_t hcnt[HISTOGRAM_SIZE_LOG][HISTOGRAM_SIZE];
+    get_decade_hist(hcnt);
     fprintf (fd," histogram \n");
     fprintf (fd," -----------\n");
     int i;
@@ -197,8 +221,8 @@ void CTimeHistogram::Dump(FILE *fd){
     int base=10;
     for (j=0; j<HISTOGRAM_SIZE_LOG; j++) {
         for (i=0; i<HISTOGRAM_SIZE; i++) {
-            if (m_hcnt[j][i] >0 ) {
-                fprintf (fd," h[%lu]  :  %lu \n",(base*(i+1)),m_hcnt[j][i]);
+            if (hcnt[j][i] >0 ) {
+                fprintf (fd," h[%lu]  :  %lu \n",(base*(i+1)),hcnt[j][i]);
             }
         }
         base=base*10;
@@ -221,6 +245,13 @@ void CTimeHistogram::dump_json(std::string name,std::string & json ){
     json+=add_json("cnt",m_cnt);
     //json+=add_json("t_avg",get_total_average());
     json+=add_json("s_avg",get_average_latency());
+    json+=add_json("p50_usec",get_percentile_usec(50.0));
+    json+=add_json("p90_usec",get_percentile_usec(90.0));
+    json+=add_json("p99_usec",get_percentile_usec(99.0));
+    json+=add_json("p99_9_usec",get_percentile_usec(99.9));
+    json+=add_json("p99_99_usec",get_percentile_usec(99.99));
+    uint64_t hcnt[HISTOGRAM_SIZE_LOG][HISTOGRAM_SIZE];
+    get_decade_hist(hcnt);
     int i;
     int j;
     uint32_t base=10;
@@ -229,7 +260,7 @@ void CTimeHistogram::dump_json(std::string name,std::string & json ){
     bool first=true; 
     for (j=0; j<HISTOGRAM_SIZE_LOG; j++) {
         for (i=0; i<HISTOGRAM_SIZE; i++) {
-            if (m_hcnt[j][i] >0 ) {
+            if (hcnt[j][i] >0 ) {
                 if ( first ){
                     first=false;
                 }else{
@@ -237,7 +268,7 @@ void CTimeHistogram::dump_json(std::string name,std::string & json ){
                 }
                 json+="{";
                 json+=add_json("key",(base*(i+1)));
-                json+=add_json("val",m_hcnt[j][i],true);
+                json+=add_json("val",hcnt[j][i],true);
                 json+="}";
             }
         }
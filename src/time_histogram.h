@@ -27,20 +27,37 @@ limitations under the License.
 #include <stdio.h>
 #include <math.h>
 #include "mbuf.h"
+#include "hdr_histogram.h"
 #include <string>
 
 
+/* latency histogram, the samples are kept in a HDR histogram (nsec) from
+   HDR_LOWEST_NSEC to HDR_HIGHEST_NSEC. the decade buckets (10usec and up) of
+   Dump/dump_json are derived from it */
 class CTimeHistogram {
 public:
     enum {
         HISTOGRAM_SIZE=9,
         HISTOGRAM_SIZE_LOG=5,
         HISTOGRAM_QUEUE_SIZE=14,
+        HDR_DIGITS=3
     };
-    bool Create(void);
+    static const uint64_t HDR_LOWEST_NSEC  = 100;
+    static const uint64_t HDR_HIGHEST_NSEC = 10000000000ULL;
+
+    CTimeHistogram(){
+    }
+    /* the counters of the precision are allocated here, Create with the same digits keeps them */
+    CTimeHistogram(uint8_t digits) : m_hdr(HDR_LOWEST_NSEC,HDR_HIGHEST_NSEC,digits) {
+    }
+
+    /* digits, significant digits of the percentiles 1..3 */
+    bool Create(uint8_t digits=HDR_DIGITS);
     void Delete();
     void Reset();
     bool Add(dsec_t dt);
+    /* add the samples of o, false in case the precision is different */
+    bool merge(const CTimeHistogram & o);
     void Dump(FILE *fd);
     void DumpWinMax(FILE *fd);
     /* should be called each 1 sec */
@@ -58,6 +75,13 @@ public:
         return ( get_usec(m_max_win_last_dt) );
     }
 
+    /* p in 0..100, value in usec (not dsec_t seconds), resolution of the histogram precision */
+    double  get_percentile_usec(double p);
+
+    CHdrHistogram & get_hdr(){
+        return (m_hdr);
+    }
+
     void  dump_json(std::string name,std::string & json );
 
 
@@ -65,11 +89,8 @@ private:
     uint32_t get_usec(dsec_t d);
     double  get_cur_average();
     void  update_average();
-
-    double get_base_usec(int j,int i){
-        double base=pow(10.0,(double)j+1.0);
-        return ( base * ((double)i+1.0) );
-    }
+    /* HDR counters folded to the decade buckets, values below 10usec are not included */
+    void  get_decade_hist(uint64_t hcnt[HISTOGRAM_SIZE_LOG][HISTOGRAM_SIZE]);
 
 public:
     dsec_t   m_min_delta;/* set to 10usec*/
@@ -83,10 +104,11 @@ public:
     uint32_t m_win_cnt;
     dsec_t   m_max_ar[HISTOGRAM_QUEUE_SIZE];
 
-    uint64_t m_hcnt[HISTOGRAM_SIZE_LOG][HISTOGRAM_SIZE] __rte_cache_aligned ;
-    uint64_t m_hcnt_shadow[HISTOGRAM_SIZE_LOG][HISTOGRAM_SIZE] __rte_cache_aligned ; // this this contorl side 
+    dsec_t   m_sum;
+    dsec_t   m_sum_shadow; // this this contorl side
     uint64_t m_cnt_shadow;
-    uint64_t m_high_cnt_shadow;
+
+    CHdrHistogram m_hdr __rte_cache_aligned ;
 };
 
 #endif
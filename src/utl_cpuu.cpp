@@ -1,5 +1,7 @@
 #include "utl_cpuu.h"
+#include "utl_json.h"
 #include <stdio.h>
+#include <string.h>
 /*
  Hanoh Haim
  Cisco Systems, Inc.
@@ -55,3 +57,60 @@ double CCpuUtlCp::GetVal(){
     return (m_cpu_util*100);
 }
 
+
+__thread CDpCycleStats * CDpCycleStats::m_cur;
+
+void CDpCycleStats::Clear(){
+    memset(m_cycles,0,sizeof(m_cycles));
+    memset(m_cnt,0,sizeof(m_cnt));
+    m_work_cycles=0;
+}
+
+const char * CDpCycleStats::get_phase_name(int phase){
+    static const char * names[cpLAST]={
+        "sched_pop",
+        "sched_push",
+        "tuple_gen",
+        "mbuf_alloc",
+        "pkt_rewrite",
+        "plugin",
+        "tx_burst",
+        "msg"
+    };
+    return (names[phase]);
+}
+
+void CDpCycleStats::DumpHeader(FILE *fd){
+    fprintf(fd," core  %-12s %14s %12s %10s %8s \n","phase","cycles","calls","cyc/call","%work");
+}
+
+void CDpCycleStats::Dump(int core,FILE *fd){
+    int i;
+    for (i=0; i<cpLAST; i++) {
+        double avg = m_cnt[i]?((double)m_cycles[i]/(double)m_cnt[i]):0.0;
+        double pr  = m_work_cycles?(100.0*(double)m_cycles[i]/(double)m_work_cycles):0.0;
+        fprintf(fd," %4d  %-12s %14llu %12llu %10.1f %8.1f \n",
+                core,
+                get_phase_name(i),
+                (unsigned long long)m_cycles[i],
+                (unsigned long long)m_cnt[i],
+                avg,
+                pr);
+    }
+}
+
+void CDpCycleStats::dump_json(int core,std::string & json){
+    char buff[200];
+    sprintf(buff,"\"core-%d\":{",core);
+    json+=std::string(buff);
+    json+=add_json("work_cycles",m_work_cycles);
+    int i;
+    for (i=0; i<cpLAST; i++) {
+        sprintf(buff,"\"%s\":{",get_phase_name(i));
+        json+=std::string(buff);
+        json+=add_json("cycles",m_cycles[i]);
+        json+=add_json("cnt",m_cnt[i],true);
+        json+="},";
+    }
+    json+="\"unknown\":0},";
+}
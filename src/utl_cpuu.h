@@ -22,6 +22,8 @@ limitations under the License.
 */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string>
 #include "os_time.h"
 #include "mbuf.h"
 
@@ -54,6 +56,82 @@ private:
 
 } __rte_cache_aligned; 
 
+/*
+  cycles per hot path phase of a DP core. compiled in only with
+  TREX_CYCLE_STATS (configure --cycle-stats), otherwise the DP_CYCLE_xx
+  macros are empty and the counters stay zero.
+
+  phases may nest, a plugin includes its own alloc/rewrite
+*/
+class CDpCycleStats {
+public:
+    enum phase_t {
+        cpSCHED_POP,
+        cpSCHED_PUSH,
+        cpTUPLE_GEN,
+        cpMBUF_ALLOC,
+        cpPKT_REWRITE,
+        cpPLUGIN,
+        cpTX_BURST,
+        cpMSG,
+        cpLAST
+    };
+
+    CDpCycleStats(){
+        Clear();
+    }
+
+    void Clear();
+
+    inline void add(phase_t phase,uint64_t cycles){
+        m_cycles[phase]+=cycles;
+        m_cnt[phase]++;
+    }
+
+    /* the stats of the DP core that runs the calling thread, NULL for other threads */
+    static inline void add_cur(phase_t phase,uint64_t cycles){
+        CDpCycleStats * lp=m_cur;
+        if ( lp ) {
+            lp->add(phase,cycles);
+        }
+    }
+
+    static void set_cur(CDpCycleStats * lp){
+        m_cur=lp;
+    }
+
+    static const char * get_phase_name(int phase);
+
+    void DumpHeader(FILE *fd);
+    void Dump(int core,FILE *fd);
+    void dump_json(int core,std::string & json);
+
+    static bool is_enabled(){
+        #ifdef TREX_CYCLE_STATS
+        return (true);
+        #else
+        return (false);
+        #endif
+    }
+
+public:
+    uint64_t m_cycles[cpLAST];
+    uint64_t m_cnt[cpLAST];
+    uint64_t m_work_cycles; /* total busy cycles of the core, set by the publisher */
+
+private:
+    static __thread CDpCycleStats * m_cur;
+};
+
+#ifdef TREX_CYCLE_STATS
+#define DP_CYCLE_START(t)       uint64_t t=os_get_hr_tick_64_ordered()
+#define DP_CYCLE_END(t,phase)   CDpCycleStats::add_cur(CDpCycleStats::phase,os_get_hr_tick_64_ordered()-(t))
+#else
+#define DP_CYCLE_START(t)
+#define DP_CYCLE_END(t,phase)
+#endif
+
+
 class CCpuUtlCp {
 public:
     void Create(CCpuUtlDp * cdp);
@@ -0,0 +1,87 @@
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "utl_idle.h"
+#include "utl_json.h"
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+
+bool CIdlePolicy::cpu_has_tpause(){
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int a,b,c,d;
+    if ( __get_cpuid_max(0,0) < 7 ) {
+        return (false);
+    }
+    __cpuid_count(7,0,a,b,c,d);
+    /* WAITPKG, the deadline is in TSC cycles */
+    return ( ((c>>5) & 1) && os_hr_is_tsc() );
+#else
+    return (false);
+#endif
+}
+
+void CIdlePolicy::Create(bool enable){
+    m_enable      = enable;
+    m_has_tpause  = enable && cpu_has_tpause();
+    m_tpause_cnt  = 0;
+    m_sleep_cnt   = 0;
+    m_last_wait_sec = 0.0;
+    m_wake_his.Create(2);
+}
+
+void CIdlePolicy::Delete(){
+    m_wake_his.Delete();
+}
+
+void CIdlePolicy::do_sleep(dsec_t sec){
+    struct timespec req;
+    req.tv_sec  = (time_t)sec;
+    req.tv_nsec = (long)((sec-(dsec_t)req.tv_sec)*1000000000.0);
+    nanosleep(&req,0);
+}
+
+void CIdlePolicy::do_tpause(dsec_t sec){
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t deadline=os_get_hr_tick_64()+ptime_convert_dsec_hr(sec);
+    uint32_t lo=(uint32_t)deadline;
+    uint32_t hi=(uint32_t)(deadline>>32);
+    /* tpause %ecx, C0.1 for a fast wake up. the OS limits the time, the caller loops */
+    __asm__ __volatile__ (".byte 0x66,0x0f,0xae,0xf1" :: "c" (1), "a" (lo), "d" (hi) : "cc");
+#endif
+}
+
+void CIdlePolicy::dump_json(std::string & json){
+    json+="\"idle\" : {";
+    json+=add_json("tpause_cnt",m_tpause_cnt);
+    json+=add_json("sleep_cnt",m_sleep_cnt);
+    m_wake_his.dump_json("wake-hist",json);
+    json+=add_json("wake_p99_9_usec",m_wake_his.get_percentile_usec(99.9),true);
+    json+="},";
+}
+
+void CIdlePolicy::Dump(FILE *fd){
+    fprintf(fd," idle : %s tpause : %s \n",m_enable?"on":"off",m_has_tpause?"yes":"no");
+    fprintf(fd," tpause_cnt : %llu sleep_cnt : %llu \n",(unsigned long long)m_tpause_cnt,(unsigned long long)m_sleep_cnt);
+    fprintf(fd," wake lateness p99.9 : %.1f usec max : %.1f usec \n",
+            m_wake_his.get_percentile_usec(99.9),m_wake_his.get_max_latency());
+}
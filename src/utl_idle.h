@@ -0,0 +1,107 @@
+#ifndef UTL_IDLE_H
+#define UTL_IDLE_H
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include "os_time.h"
+#include "time_histogram.h"
+#include "pal_utl.h"
+
+/*
+  idle policy of a polling loop that knows the time of its next event.
+  short waits spin, longer waits use tpause (when the CPU has WAITPKG) and long
+  waits sleep. each low power wait ends WAKE_MARGIN before the event and the loop
+  spins the rest, so the lateness of the event is not changed. the lateness of the
+  events that came after a low power wait is kept in m_wake_his to verify it
+*/
+class CIdlePolicy {
+public:
+    enum {
+        SPIN_USEC         = 20,  /* shorter waits only spin */
+        TPAUSE_MARGIN_USEC= 5,   /* tpause wake up is fast */
+        SLEEP_USEC        = 300, /* longer waits sleep */
+        SLEEP_MARGIN_USEC = 150  /* timer slack and the scheduler */
+    };
+
+    CIdlePolicy(){
+        m_enable=false;
+        m_has_tpause=false;
+        m_tpause_cnt=0;
+        m_sleep_cnt=0;
+        m_last_wait_sec=0.0;
+    }
+
+    void Create(bool enable);
+    void Delete();
+
+    bool is_enable(){
+        return (m_enable);
+    }
+
+    /* wait some of remaining_sec, return true if it was a low power wait */
+    inline bool idle(dsec_t remaining_sec){
+        if ( (!m_enable) || (remaining_sec < (SPIN_USEC/1000000.0)) ) {
+            rte_pause();
+            return (false);
+        }
+        if ( remaining_sec >= (SLEEP_USEC/1000000.0) ) {
+            m_last_wait_sec = remaining_sec - (SLEEP_MARGIN_USEC/1000000.0);
+            do_sleep(m_last_wait_sec);
+            m_sleep_cnt++;
+            return (true);
+        }
+        if ( m_has_tpause ) {
+            m_last_wait_sec = remaining_sec - (TPAUSE_MARGIN_USEC/1000000.0);
+            do_tpause(m_last_wait_sec);
+            m_tpause_cnt++;
+            return (true);
+        }
+        rte_pause();
+        return (false);
+    }
+
+    /* lateness of an event that came after a low power wait */
+    void add_wake(dsec_t dt){
+        m_wake_his.Add(dt);
+    }
+
+    void dump_json(std::string & json);
+    void Dump(FILE *fd);
+
+private:
+    void do_sleep(dsec_t sec);
+    void do_tpause(dsec_t sec);
+    static bool cpu_has_tpause();
+
+public:
+    bool            m_enable;
+    bool            m_has_tpause;
+    uint64_t        m_tpause_cnt;
+    uint64_t        m_sleep_cnt;
+    dsec_t          m_last_wait_sec; /* length of the last low power wait that was requested */
+    CTimeHistogram  m_wake_his;
+};
+
+#endif
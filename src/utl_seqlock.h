@@ -0,0 +1,191 @@
+#ifndef UTL_SEQLOCK_H
+#define UTL_SEQLOCK_H
+/*
+ Hanoh Haim
+ Cisco Systems, Inc.
+*/
+
+/*
+Copyright (c) 2015-2015 Cisco Systems, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <pthread.h>
+#include "mbuf.h"
+#include "pal_utl.h"
+
+/* x86 does not reorder store/store or load/load, a compiler barrier is enough */
+#if defined(__x86_64__) || defined(__i386__)
+#define utl_seq_wmb() asm volatile ("":::"memory")
+#define utl_seq_rmb() asm volatile ("":::"memory")
+#else
+#define utl_seq_wmb() __sync_synchronize()
+#define utl_seq_rmb() __sync_synchronize()
+#endif
+
+/* the objects are members of bigger classes allocated by new, which does not
+   keep the alignment, pad them so they never share a line with the DP fields */
+#define UTL_SEQ_CACHE_LINE 64
+
+/*
+  single writer (DP core) / many readers (master) snapshot of T.
+
+  the writer never waits, it bumps the sequence to odd, copies the object and
+  bumps it back to even. the reader retries until it sees the same even
+  sequence before and after the copy, so 64bit counters can't be torn and the
+  object is consistent as a whole.
+
+  the reader copy is a full T, keep one per reader and reuse it. T must be
+  trivially copyable, a retried read may copy a torn object and an object that
+  owns memory could follow a torn pointer
+*/
+template <class T>
+class CSeqLockSnapshot {
+
+public:
+    CSeqLockSnapshot(){
+        static_assert(__has_trivial_copy(T),"seqlock object must be trivially copyable");
+        m_seq=0;
+    }
+
+    /* writer side, called only by the owner thread. update the object in place
+       between write_begin() and write_end() */
+    inline T & write_begin(){
+        m_seq=m_seq+1;
+        utl_seq_wmb();
+        return (m_data);
+    }
+
+    inline void write_end(){
+        utl_seq_wmb();
+        m_seq=m_seq+1;
+    }
+
+    inline void publish(const T & obj){
+        write_begin()=obj;
+        write_end();
+    }
+
+    /* reader side, return the number of retries */
+    inline uint32_t read(T & obj) const {
+        uint32_t retry=0;
+        uint32_t seq;
+        while (true) {
+            seq=m_seq;
+            if ( (seq & 1)==0 ) {
+                utl_seq_rmb();
+                obj=m_data;
+                utl_seq_rmb();
+                if (seq == m_seq) {
+                    break;
+                }
+            }
+            retry++;
+            rte_pause();
+        }
+        return (retry);
+    }
+
+    /* number of snapshots published so far */
+    uint32_t get_version() const {
+        return (m_seq>>1);
+    }
+
+private:
+    uint8_t           m_pad_head[UTL_SEQ_CACHE_LINE];
+    volatile uint32_t m_seq __rte_cache_aligned;
+    T                 m_data;
+    uint8_t           m_pad_tail[UTL_SEQ_CACHE_LINE];
+};
+
+
+/*
+  single writer (DP core) / many readers (master) copy of T on request, for
+  objects that are too big to copy each tick or that own memory (histograms).
+
+  the reader takes the last copy made by the writer and asks for a new one,
+  the writer makes the copy only when there is a request. so a reader sees the
+  copy made after its previous read, a read is one request behind.
+  the writer never waits, the readers are serialized by a lock.
+*/
+template <class T>
+class CRequestSnapshot {
+
+public:
+    CRequestSnapshot(){
+        m_req=1; /* first copy at the first serve */
+        m_ack=0;
+        pthread_mutex_init(&m_lock,NULL);
+    }
+
+    ~CRequestSnapshot(){
+        pthread_mutex_destroy(&m_lock);
+    }
+
+    /* writer side, called only by the owner thread */
+    inline bool is_requested() const {
+        return (m_req != m_ack);
+    }
+
+    /* copy the object in place between write_begin() and write_end(), only
+       in case is_requested() */
+    inline T & write_begin(){
+        return (m_writer_copy);
+    }
+
+    inline void write_end(){
+        utl_seq_wmb();
+        m_ack=m_req;
+    }
+
+    /* reader side, ask for a new copy in case the last one was taken */
+    void request(){
+        pthread_mutex_lock(&m_lock);
+        take();
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    /* reader side, the last copy of the writer */
+    void read(T & obj){
+        pthread_mutex_lock(&m_lock);
+        take();
+        obj=m_reader_copy;
+        pthread_mutex_unlock(&m_lock);
+    }
+
+private:
+    /* under the lock */
+    void take(){
+        if ( m_ack == m_req ) {
+            utl_seq_rmb();
+            m_reader_copy=m_writer_copy;
+            /* the copy is done before the writer may start the next one */
+            utl_seq_wmb();
+            m_req=m_req+1;
+        }
+    }
+
+private:
+    uint8_t           m_pad_head[UTL_SEQ_CACHE_LINE];
+    volatile uint32_t m_req;  /* written by the readers */
+    uint8_t           m_pad_req[UTL_SEQ_CACHE_LINE];
+    volatile uint32_t m_ack;  /* written by the writer */
+    T                 m_writer_copy;
+    uint8_t           m_pad_writer[UTL_SEQ_CACHE_LINE];
+    T                 m_reader_copy;
+    pthread_mutex_t   m_lock;
+};
+
+#endif